@@ -19,20 +19,44 @@
 
 #include "../../../MCUSilk/CPU_usage.h"
 #include "../../../MCUSilk/isr_trace.h"
+#include "../../../MCUSilk/isr_wrap.h"
 #include "../../../MCUSilk/AWS_WIFI.h"
+#include "../../../MCUSilk/flashlog.h"
 
 
 #define BUTTON_GPIO     GPIO_NUM_0   // BOOT button
 #define LED_GPIO        GPIO_NUM_2   // Built-in LED
 
 
+#define BUTTON_WAKEUP_CHANNEL   0   // ISR_Trace_Signal / ISR_Trace_Received channel
+
+#define LOG_PARTITION           "tlmlog"            // partitions.csv
+#define LOG_RETENTION_S         (24 * 60 * 60)      // keep the last day in flash
+
+
 volatile bool led_state = false;
+static TaskHandle_t button_task_handle = NULL;
+static flashlog_t flash_log;
 
 
 // --------------------------------------------------------------------
 // Function prototypes
 // --------------------------------------------------------------------
 void dummy_task(void *arg);
+void button_task(void *arg);
+void button_task(void *arg)
+{
+  while(1)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    ISR_Trace_Received(BUTTON_WAKEUP_CHANNEL);
+
+    // Toggle LED
+    led_state = !led_state;
+    gpio_set_level(LED_GPIO, led_state);
+  }
+}
+
 void custom_user_printf(char *received_json);
 static void button_isr_handler(void* arg);
 void button_LED_interrupt_initilize(void);
@@ -47,16 +71,29 @@ void app_main(void)
   cpu_usage_cfg_t cpu_cfg = {
       .tag = "ESP32",           // whatever label you want
       .print_fn = custom_user_printf,
-      .enable_AWS_upload = true
+      .enable_AWS_upload = true,
+      .log_retention_s = LOG_RETENTION_S,
+      .sink_pool = 12           // ~49 KB instead of the worst case of 18 buffers
   };
 
+  // Reports for a dump after the fact, when nothing was connected
+  flashlog_backend_t log_backend;
+  if (flashlog_partition_backend(&log_backend, LOG_PARTITION) &&
+      flashlog_open(&flash_log, &log_backend))
+  {
+    cpu_cfg.flash_log = &flash_log;
+  }
+
+  // Deferred processing of the button interrupt
+  xTaskCreatePinnedToCore(button_task, "button task", 2048, NULL, 3, &button_task_handle, CPU_USAGE_TASK_CORE);
+
   // Initialize button and LED with interrupt
   button_LED_interrupt_initilize();
 
   // pass struct to init
   CPU_usage_start(&cpu_cfg);
 
-  xTaskCreatePinnedToCore(dummy_task, "dummy task", 2048, NULL, 2, NULL, 1);
+  xTaskCreatePinnedToCore(dummy_task, "dummy task", 2048, NULL, 2, NULL, CPU_USAGE_TASK_CORE);
 
 
 }
@@ -79,13 +116,14 @@ void custom_user_printf(char *received_json)
 static void IRAM_ATTR button_isr_handler(void* arg)
 {
 
-  ISR_Trace_Enter(0);
-  
-  // Toggle LED
-  led_state = !led_state;
-  gpio_set_level(LED_GPIO, led_state);
+  // Traced by isr_wrap, no ISR_Trace_Enter/Exit needed here
+  BaseType_t higher_priority_task_woken = pdFALSE;
+
+  // Hand the work to button_task and measure how long it takes to run
+  ISR_Trace_Signal(BUTTON_WAKEUP_CHANNEL);
+  vTaskNotifyGiveFromISR(button_task_handle, &higher_priority_task_woken);
 
-  ISR_Trace_Exit(0);
+  portYIELD_FROM_ISR(higher_priority_task_woken);
 
 }
 
@@ -113,7 +151,7 @@ void button_LED_interrupt_initilize(void)
     // Install ISR service
     gpio_install_isr_service(0);
 
-    // Attach ISR handler
-    gpio_isr_handler_add(BUTTON_GPIO, button_isr_handler, NULL);
+    // Attach ISR handler, traced under the name "button"
+    isr_wrap_gpio_isr_handler_add("button", BUTTON_GPIO, button_isr_handler, NULL);
 
 }
\ No newline at end of file
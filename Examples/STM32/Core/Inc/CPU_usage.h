@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
+#include <stdarg.h>
 
 
 #include "cmsis_os.h"
@@ -18,12 +19,20 @@
 #define UART_PRINT_TASK     2
 #define ARRAY_SIZE_OFFSET   5
 
+// Upper bound for the per-core arrays, the real count is cpu_usage_core_count()
+#if defined(configNUMBER_OF_CORES)
+    #define CPU_USAGE_MAX_CORES configNUMBER_OF_CORES
+#else
+    #define CPU_USAGE_MAX_CORES 1
+#endif
+
 // Changable
 #define NUM_OF_SPIN_TASKS   3
 #define SPIN_ITER           500000   // CPU cycles per spin task
 #define STATS_TICKS         pdMS_TO_TICKS(1000)
 #define MEASURING_TICKS     pdMS_TO_TICKS(2000)
 #define CPU_LOAD            1
+#define DEVICE_INFO_PERIOD  10      // re-send the device header every N reports
 
 
 // --------------------------------------------------------------------
@@ -54,6 +63,8 @@ typedef struct {
 typedef struct {
     task_stats_t *tasks;
     size_t task_count;
+    uint32_t core_count;
+    uint32_t core_load[CPU_USAGE_MAX_CORES];   // 100 - idle % of each core
     esp_err_t status;
 } stats_result_t;
 
@@ -69,3 +80,7 @@ char* generate_json_stats(stats_result_t res);
 void CPU_usage_start(void (*user_printf)(char *));
 void uart_print_task(void *arg);
 void get_memory_usage();
+uint32_t cpu_usage_core_count(void);
+void send_device_info(void);
+void send_isr_report(void);
+void json_append(char *json, size_t size, size_t *offset, const char *fmt, ...);
@@ -143,6 +143,7 @@ standard names. */
 #define configUSE_TRACE_FACILITY             1
 #define configUSE_STATS_FORMATTING_FUNCTIONS 1
 #define configUSE_COUNTING_SEMAPHORES 1
+#define INCLUDE_xTaskGetIdleTaskHandle       1
 
 /* Use TIM2 as FreeRTOS run time counter */
 #define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()  configureTimerForRunTimeStats()
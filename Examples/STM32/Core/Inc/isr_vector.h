@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "main.h"
+
+
+// --------------------------------------------------------------------
+// Interrupt tracing through a RAM vector table
+// --------------------------------------------------------------------
+//
+// isr_vector_init() copies the vector table into RAM and points VTOR at
+// the copy. A traced IRQ gets a stub in its RAM entry that times the
+// original handler with the DWT cycle counter. The handlers themselves
+// stay as they are. A nested interrupt is part of the inclusive time of
+// the one it preempted, and not of its exclusive (self) time.
+//
+// Only external interrupts (IRQn >= 0) are traced. SVC, PendSV and SysTick
+// carry the FreeRTOS context switch and keep their own entries. A handler
+// written in assembly that relies on LR holding EXC_RETURN cannot be traced
+// either: behind the stub it returns to the stub.
+//
+// The report has the shape of the ESP32 ISR report (core 0, tag = IRQn),
+// so the GUI shows it the same way.
+//
+#define ISR_VECTOR_ENABLE           1
+#define ISR_VECTOR_IRQS             (FMPI2C1_ER_IRQn + 1)   // STM32F446
+#define ISR_VECTOR_MAX_TRACED       16      // IRQs with stats at once
+#define ISR_VECTOR_NAME_LEN         16
+#define ISR_VECTOR_MAX_NESTING      8       // nested interrupts tracked
+#define ISR_VECTOR_HIST_BUCKETS     16      // log2 self-time buckets per IRQ
+#define ISR_VECTOR_HIST_SHIFT       7       // bucket 0 = below 2^(SHIFT+1) ns, as on the ESP32
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+
+// RAM vector table and cycle counter, before any isr_vector_trace()
+bool isr_vector_init(void);
+
+// Route irq through the traced stub under name (NULL = "irq<n>").
+// False if irq is out of range, not initialized or all slots are taken.
+bool isr_vector_trace(IRQn_Type irq, const char *name);
+
+// Give irq its own handler back
+void isr_vector_untrace(IRQn_Type irq);
+
+// Trace every IRQ whose handler is not Default_Handler, returns how many
+size_t isr_vector_trace_all(void);
+
+// Window report as a malloc'd JSON string, NULL if no traced IRQ ran.
+// Starts the next window.
+char *isr_vector_report_json(void);
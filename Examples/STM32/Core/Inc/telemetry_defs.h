@@ -0,0 +1,208 @@
+// Generated by schema/generate.py from schema/telemetry.py, do not edit.
+#pragma once
+
+#include <inttypes.h>
+
+
+// --------------------------------------------------------------------
+// Binary layouts (payload of a wire frame, see wire.h)
+// --------------------------------------------------------------------
+//
+//  DEVICE  : u8 cores, u32 cpu_hz, char tag[16]
+//  TASKS   : u8 core_count, u8 task_count, u8 cores[core_count], u8 isr_load[core_count],
+//            task_count x { char task_name[16], u32 run_time, u32 isr_time, u8 percentage, i8 core, u8 flags }
+//  MEMORY  : u32 heap_total, u32 heap_free, u32 internal_total, u32 internal_free
+//  ISR     : u64 uptime_us, u32 cpu_hz, u8 hist_shift, u16 freq_changes, u16 bad_tag, u8 count,
+//            count x { u8 tag, i8 core, char name[16], u32 count, u32 dropped, u32 incl_min_ns, u32 incl_avg_ns, u32 incl_max_ns, u32 excl_min_ns, u32 excl_avg_ns, u32 excl_max_ns, u32 hist[16] }
+//  WAKEUP  : u8 count,
+//            count x { u8 channel, u32 count, u32 coalesced, u32 min_us, u32 avg_us, u32 max_us, u32 hist[16] }
+//  REPORT  : u32 seq, u64 uptime_us, u32 window_us, u32 period_ms, u8 coalesced, u8 core_count, u8 task_count, u8 cores[core_count], u8 isr_load[core_count],
+//            task_count x { char task_name[16], u32 run_time, u32 isr_time, u8 percentage, i8 core, u8 flags }, u32 heap_total, u32 heap_free, u32 internal_total, u32 internal_free
+//  LINK    : u32 baud, u8 status, u16 pattern_len, u8 pattern[pattern_len]
+//  BUDGET  : u32 baud, u32 capacity, u32 used, u8 count,
+//            count x { u8 type, u32 bytes_per_s, u32 msgs_per_min }
+//  REPLY   : u8 request, u8 cmd, u8 status
+//  TASK_INFO: u8 request, u8 count,
+//            count x { char task_name[16], u32 number, u8 state, u8 priority, u8 base_priority, i8 core, u32 stack_free, u32 run_time }
+//  HEAP    : u8 request, u8 count,
+//            count x { u32 caps, u32 total, u32 free, u32 largest_free, u32 min_free, u32 allocated_blocks, u32 free_blocks }
+//  LOG_INFO: u8 request, u32 records, u32 bytes, u32 capacity, u16 sectors, u32 sector_size
+//  JSON    : UTF-8 JSON text without terminator (messages with no binary layout)
+//  CBOR    : one CBOR map, same keys and nesting as the JSON message
+//  DELTA   : u8 type, u16 CRC-16 of the previous integers of that type (u32 LE, u64 as
+//            low and high half), zig-zag varint of the change of every integer field, see delta.h
+//  LZ      : u8 type of the frame it replaces (JSON or CBOR), u16 length uncompressed,
+//            LZSS bit stream of that payload, see lz.h
+//  CMD     : host to device: u8 WIRE_CMD_*, u8 request id, arguments, see link.h
+//
+#define WIRE_VERSION            3
+#define WIRE_NAME_LEN           16
+#define TLM_HIST_BUCKETS        16
+#define WIRE_LZ_WINDOW_BITS     8
+#define WIRE_LZ_LOOKAHEAD_BITS  4
+
+#define WIRE_TASK_CREATED       0x01
+#define WIRE_TASK_DELETED       0x02
+#define WIRE_TASK_ISR           0x04
+
+#define WIRE_CMD_BAUD           1
+#define WIRE_CMD_LINK_TEST      2
+#define WIRE_CMD_SNAPSHOT       3
+#define WIRE_CMD_TASK           4
+#define WIRE_CMD_STACKS         5
+#define WIRE_CMD_HEAP           6
+#define WIRE_CMD_DUMP           7
+#define LINK_ACK                0
+#define LINK_CONFIRMED          1
+#define LINK_REFUSED            2
+#define LINK_REVERTED           3
+#define LINK_TEST_LEN           256
+#define QUERY_OK                0
+#define QUERY_UNKNOWN           1
+#define QUERY_NOT_FOUND         2
+#define QUERY_NO_MEM            3
+#define QUERY_BAD_ARGS          4
+#define QUERY_FAILED            5
+
+typedef enum {
+    WIRE_MSG_DEVICE = 1,
+    WIRE_MSG_TASKS  = 2,
+    WIRE_MSG_MEMORY = 3,
+    WIRE_MSG_ISR    = 4,
+    WIRE_MSG_WAKEUP = 5,
+    WIRE_MSG_JSON   = 6,
+    WIRE_MSG_CBOR   = 7,
+    WIRE_MSG_DELTA  = 8,
+    WIRE_MSG_LZ     = 9,
+    WIRE_MSG_REPORT = 10,
+    WIRE_MSG_CMD    = 11,
+    WIRE_MSG_LINK   = 12,
+    WIRE_MSG_BUDGET = 13,
+    WIRE_MSG_REPLY  = 14,
+    WIRE_MSG_TASK_INFO = 15,
+    WIRE_MSG_HEAP   = 16,
+    WIRE_MSG_LOG_INFO = 17,
+} wire_msg_type_t;
+
+
+// --------------------------------------------------------------------
+// JSON / CBOR keys
+// --------------------------------------------------------------------
+#define TLM_KEY_DEVICE                  "device"
+#define TLM_KEY_CORES                   "cores"
+#define TLM_KEY_CPU_HZ                  "cpu_hz"
+#define TLM_KEY_TAG                     "tag"
+#define TLM_KEY_ISR_LOAD                "isr_load"
+#define TLM_KEY_TASKS                   "tasks"
+#define TLM_KEY_HEAP_TOTAL              "heap_total"
+#define TLM_KEY_HEAP_FREE               "heap_free"
+#define TLM_KEY_INTERNAL_TOTAL          "internal_total"
+#define TLM_KEY_INTERNAL_FREE           "internal_free"
+#define TLM_KEY_UPTIME_US               "uptime_us"
+#define TLM_KEY_HIST_SHIFT              "hist_shift"
+#define TLM_KEY_FREQ_CHANGES            "freq_changes"
+#define TLM_KEY_BAD_TAG                 "bad_tag"
+#define TLM_KEY_ISR                     "isr"
+#define TLM_KEY_HIST_UNIT               "hist_unit"
+#define TLM_KEY_WAKEUP                  "wakeup"
+#define TLM_KEY_REPORT                  "report"
+#define TLM_KEY_SEQ                     "seq"
+#define TLM_KEY_WINDOW_US               "window_us"
+#define TLM_KEY_PERIOD_MS               "period_ms"
+#define TLM_KEY_COALESCED               "coalesced"
+#define TLM_KEY_LINK                    "link"
+#define TLM_KEY_BAUD                    "baud"
+#define TLM_KEY_STATUS                  "status"
+#define TLM_KEY_PATTERN                 "pattern"
+#define TLM_KEY_BUDGET                  "budget"
+#define TLM_KEY_CAPACITY                "capacity"
+#define TLM_KEY_USED                    "used"
+#define TLM_KEY_METRICS                 "metrics"
+#define TLM_KEY_REPLY                   "reply"
+#define TLM_KEY_REQUEST                 "request"
+#define TLM_KEY_CMD                     "cmd"
+#define TLM_KEY_TASK_INFO               "task_info"
+#define TLM_KEY_HEAP                    "heap"
+#define TLM_KEY_REGIONS                 "regions"
+#define TLM_KEY_LOG_INFO                "log_info"
+#define TLM_KEY_RECORDS                 "records"
+#define TLM_KEY_BYTES                   "bytes"
+#define TLM_KEY_SECTORS                 "sectors"
+#define TLM_KEY_SECTOR_SIZE             "sector_size"
+#define TLM_KEY_TASK_NAME               "task_name"
+#define TLM_KEY_RUN_TIME                "run_time"
+#define TLM_KEY_ISR_TIME                "isr_time"
+#define TLM_KEY_PERCENTAGE              "percentage"
+#define TLM_KEY_CORE                    "core"
+#define TLM_KEY_NAME                    "name"
+#define TLM_KEY_COUNT                   "count"
+#define TLM_KEY_DROPPED                 "dropped"
+#define TLM_KEY_INCL_MIN_NS             "incl_min_ns"
+#define TLM_KEY_INCL_AVG_NS             "incl_avg_ns"
+#define TLM_KEY_INCL_MAX_NS             "incl_max_ns"
+#define TLM_KEY_EXCL_MIN_NS             "excl_min_ns"
+#define TLM_KEY_EXCL_AVG_NS             "excl_avg_ns"
+#define TLM_KEY_EXCL_MAX_NS             "excl_max_ns"
+#define TLM_KEY_HIST                    "hist"
+#define TLM_KEY_TYPE                    "type"
+#define TLM_KEY_BYTES_PER_S             "bytes_per_s"
+#define TLM_KEY_MSGS_PER_MIN            "msgs_per_min"
+#define TLM_KEY_NUMBER                  "number"
+#define TLM_KEY_STATE                   "state"
+#define TLM_KEY_PRIORITY                "priority"
+#define TLM_KEY_BASE_PRIORITY           "base_priority"
+#define TLM_KEY_STACK_FREE              "stack_free"
+#define TLM_KEY_CAPS                    "caps"
+#define TLM_KEY_TOTAL                   "total"
+#define TLM_KEY_FREE                    "free"
+#define TLM_KEY_LARGEST_FREE            "largest_free"
+#define TLM_KEY_MIN_FREE                "min_free"
+#define TLM_KEY_ALLOCATED_BLOCKS        "allocated_blocks"
+#define TLM_KEY_FREE_BLOCKS             "free_blocks"
+#define TLM_KEY_CHANNEL                 "channel"
+#define TLM_KEY_MIN_US                  "min_us"
+#define TLM_KEY_AVG_US                  "avg_us"
+#define TLM_KEY_MAX_US                  "max_us"
+#define TLM_KEY_TRIGGER                 "trigger"
+#define TLM_KEY_ERROR                   "error"
+
+
+// --------------------------------------------------------------------
+// Binary sizes: fixed part of each message, one list entry
+// --------------------------------------------------------------------
+#define TLM_WIRE_DEVICE_SIZE         21
+#define TLM_WIRE_TASKS_SIZE          2
+#define TLM_WIRE_MEMORY_SIZE         16
+#define TLM_WIRE_ISR_SIZE            18
+#define TLM_WIRE_WAKEUP_SIZE         1
+#define TLM_WIRE_REPORT_SIZE         39
+#define TLM_WIRE_LINK_SIZE           7
+#define TLM_WIRE_BUDGET_SIZE         13
+#define TLM_WIRE_REPLY_SIZE          3
+#define TLM_WIRE_TASK_INFO_SIZE      2
+#define TLM_WIRE_HEAP_SIZE           2
+#define TLM_WIRE_LOG_INFO_SIZE       19
+#define TLM_WIRE_TASK_SIZE           27
+#define TLM_WIRE_ISR_ENTRY_SIZE      114
+#define TLM_WIRE_BUDGET_ENTRY_SIZE   9
+#define TLM_WIRE_TASK_DETAIL_SIZE    32
+#define TLM_WIRE_HEAP_REGION_SIZE    28
+#define TLM_WIRE_WAKEUP_ENTRY_SIZE   85
+
+
+// --------------------------------------------------------------------
+// printf formats of the flat JSON messages and entries, for targets
+// without telemetry.c. Arguments in schema order: integers as
+// uint32_t / int32_t, names as char * (not escaped).
+// --------------------------------------------------------------------
+#define TLM_JSON_DEVICE_FMT "{\"device\": {\"cores\": %" PRIu32 ", \"cpu_hz\": %" PRIu32 ", \"tag\": \"%s\"}}"
+#define TLM_JSON_MEMORY_FMT "{\"heap_total\": %" PRIu32 ", \"heap_free\": %" PRIu32 ", \"internal_total\": %" PRIu32 ", \"internal_free\": %" PRIu32 "}"
+#define TLM_JSON_REPLY_FMT "{\"reply\": {\"request\": %" PRIu32 ", \"cmd\": %" PRIu32 ", \"status\": %" PRIu32 "}}"
+#define TLM_JSON_LOG_INFO_FMT "{\"log_info\": {\"request\": %" PRIu32 ", \"records\": %" PRIu32 ", \"bytes\": %" PRIu32 ", \"capacity\": %" PRIu32 ", \"sectors\": %" PRIu32 ", \"sector_size\": %" PRIu32 "}}"
+#define TLM_JSON_TASK_CREATED_FMT "{\"task_name\": \"%s\", \"status\": \"created\"}"
+#define TLM_JSON_TASK_DELETED_FMT "{\"task_name\": \"%s\", \"status\": \"deleted\"}"
+#define TLM_JSON_TASK_ISR_FMT "{\"task_name\": \"%s\", \"run_time\": %" PRIu32 ", \"percentage\": %" PRIu32 ", \"core\": %" PRId32 ", \"isr\": true}"
+#define TLM_JSON_TASK_FMT "{\"task_name\": \"%s\", \"run_time\": %" PRIu32 ", \"isr_time\": %" PRIu32 ", \"percentage\": %" PRIu32 ", \"core\": %" PRId32 "}"
+#define TLM_JSON_BUDGET_ENTRY_FMT "{\"type\": %" PRIu32 ", \"bytes_per_s\": %" PRIu32 ", \"msgs_per_min\": %" PRIu32 "}"
+#define TLM_JSON_TASK_DETAIL_FMT "{\"task_name\": \"%s\", \"number\": %" PRIu32 ", \"state\": %" PRIu32 ", \"priority\": %" PRIu32 ", \"base_priority\": %" PRIu32 ", \"core\": %" PRId32 ", \"stack_free\": %" PRIu32 ", \"run_time\": %" PRIu32 "}"
+#define TLM_JSON_HEAP_REGION_FMT "{\"caps\": %" PRIu32 ", \"total\": %" PRIu32 ", \"free\": %" PRIu32 ", \"largest_free\": %" PRIu32 ", \"min_free\": %" PRIu32 ", \"allocated_blocks\": %" PRIu32 ", \"free_blocks\": %" PRIu32 "}"
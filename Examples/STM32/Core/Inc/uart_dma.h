@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#include "main.h"
+#include "cmsis_os.h"
+
+
+// --------------------------------------------------------------------
+// Double buffered DMA UART output
+// --------------------------------------------------------------------
+//
+// Writers copy into one buffer while DMA sends the other, so a task only
+// waits when both are full, and then on a semaphore instead of polling
+// the UART. The TX complete callback starts the next buffer right away.
+// At 115200 baud a 1 KB report takes ~90 ms on the line but only the
+// copy on the CPU.
+//
+#define UART_DMA_BUF_SIZE   512     // bytes per buffer, two of them
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+void uart_dma_init(UART_HandleTypeDef *huart);
+void uart_dma_write(const uint8_t *data, size_t len);
+
+// Call from HAL_UART_TxCpltCallback()
+void uart_dma_tx_complete(UART_HandleTypeDef *huart);
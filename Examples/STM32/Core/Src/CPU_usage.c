@@ -1,4 +1,6 @@
 #include "CPU_usage.h"
+#include "telemetry_defs.h"     // generated from schema/telemetry.py
+#include "isr_vector.h"
 
 
 // --------------------------------------------------------------------
@@ -10,6 +12,9 @@
 #endif
 SemaphoreHandle_t sync_stats_task;
 QueueHandle_t jsonQueue;
+#if ISR_VECTOR_ENABLE
+    static bool isr_traced;
+#endif
 
 
 
@@ -34,6 +39,11 @@ void CPU_usage_start(void (*custom_user_printf)(char *))
 
     #endif
 
+    #if ISR_VECTOR_ENABLE
+        // Every IRQ the application installed a handler for, timed from here on
+        isr_traced = isr_vector_init() && isr_vector_trace_all() > 0;
+    #endif
+
     sync_stats_task = xSemaphoreCreateBinary();
 
     jsonQueue = xQueueCreate(5, sizeof(char *));  // 5 messages max, each is a pointer to char*
@@ -57,6 +67,73 @@ void CPU_usage_start(void (*custom_user_printf)(char *))
 
 }
 
+// --------------------------------------------------------------------
+// Core count (single core Cortex-M unless built for FreeRTOS SMP)
+// --------------------------------------------------------------------
+uint32_t cpu_usage_core_count(void)
+{
+    return CPU_USAGE_MAX_CORES;
+}
+
+// --------------------------------------------------------------------
+// Device info header, lets the host size its per-core views
+// --------------------------------------------------------------------
+void send_device_info(void)
+{
+    char *info_json = malloc(128);
+    if (info_json) {
+        snprintf(info_json, 128, TLM_JSON_DEVICE_FMT,
+            cpu_usage_core_count(), (uint32_t)SystemCoreClock, "STM32");
+
+        if (xQueueSend(jsonQueue, &info_json, 0) != pdPASS)
+        {
+            free(info_json);
+        }
+    }
+}
+
+// --------------------------------------------------------------------
+// Interrupt times of the window, see isr_vector.h
+// --------------------------------------------------------------------
+void send_isr_report(void)
+{
+    if (!isr_traced) {
+        return;
+    }
+
+    char *isr_json = isr_vector_report_json();
+    if (isr_json == NULL) {
+        isr_json = strdup("{ \"error\": \"Not enough memory to build ISR JSON\" }");
+    }
+
+    if (isr_json)
+    {
+        if (xQueueSend(jsonQueue, &isr_json, 0) != pdPASS)
+        {
+            free(isr_json);
+        }
+    }
+}
+
+// --------------------------------------------------------------------
+// snprintf at offset, clamped to size. A piece that does not fit sets
+// offset to size and every later piece is skipped, so the caller checks
+// offset < size once at the end.
+// --------------------------------------------------------------------
+void json_append(char *json, size_t size, size_t *offset, const char *fmt, ...)
+{
+    if (*offset >= size) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(json + *offset, size - *offset, fmt, args);
+    va_end(args);
+
+    *offset = (n < 0 || (size_t)n >= size - *offset) ? size : *offset + n;
+}
+
 // --------------------------------------------------------------------
 // Memory usage
 // --------------------------------------------------------------------
@@ -74,10 +151,9 @@ void get_memory_usage()
 
     char *memory_json = malloc(200);
     if (memory_json) {
-        snprintf( memory_json, 200,
-            "{ \"heap_total\": %d, \"heap_free\": %d, \"internal_total\": %d, \"internal_free\": %d }",
-            total_heap, free_heap,
-            total_internal, free_internal
+        snprintf( memory_json, 200, TLM_JSON_MEMORY_FMT,
+            (uint32_t)total_heap, (uint32_t)free_heap,
+            (uint32_t)total_internal, (uint32_t)free_internal
         );
     }
 
@@ -97,7 +173,7 @@ void get_memory_usage()
 // --------------------------------------------------------------------
 stats_result_t print_real_time_stats(TickType_t xTicksToWait)
 {
-    stats_result_t result = { .tasks = NULL, .task_count = 0, .status = ESP_OK };
+    stats_result_t result = { .tasks = NULL, .task_count = 0, .core_count = cpu_usage_core_count(), .status = ESP_OK };
     TaskStatus_t *start_array = NULL, *end_array = NULL;
     UBaseType_t start_array_size, end_array_size;
     uint32_t  start_run_time, end_run_time;
@@ -144,6 +220,10 @@ stats_result_t print_real_time_stats(TickType_t xTicksToWait)
             break;
         }
 
+        for (uint32_t core = 0; core < result.core_count; core++) {
+            result.core_load[core] = 100;
+        }
+
         // Match tasks and calculate stats
         for (int i = 0; i < start_array_size; i++) {
             for (int j = 0; j < end_array_size; j++) {
@@ -152,8 +232,14 @@ stats_result_t print_real_time_stats(TickType_t xTicksToWait)
                     snprintf(t.task_name, sizeof(t.task_name), "%s", start_array[i].pcTaskName);
                     t.run_time = end_array[j].ulRunTimeCounter - start_array[i].ulRunTimeCounter;
                     t.percentage = (t.run_time * 100UL) /
-                                   (total_elapsed_time);
+                                   (total_elapsed_time * result.core_count);
                     t.core_id = 0;
+
+                    // Core load is everything the idle task did not get
+                    if (end_array[j].xHandle == xTaskGetIdleTaskHandle()) {
+                        uint32_t idle_pct = (t.run_time * 100UL) / total_elapsed_time;
+                        result.core_load[0] = idle_pct > 100 ? 0 : 100 - idle_pct;
+                    }
                     result.tasks[result.task_count++] = t;
                     start_array[i].xHandle = NULL;
                     end_array[j].xHandle = NULL;
@@ -188,36 +274,43 @@ stats_result_t print_real_time_stats(TickType_t xTicksToWait)
 }
 
 // --------------------------------------------------------------------
-// Generate JSON string from stats result (no cJSON)
+// Generate JSON string from stats result (no cJSON). Every piece is
+// clamped to the room left, NULL if the estimate was short after all.
 // --------------------------------------------------------------------
 char* generate_json_stats(stats_result_t res)
 {
-    // Rough estimate: 100 bytes per task entry
-    size_t buffer_size = res.task_count * 100 + 64;
+    // Worst case entry: TLM_JSON_TASK_FMT with a 16 char name and 10 digit values
+    size_t buffer_size = res.task_count * 128 + 64 + res.core_count * 6;
     char *json = malloc(buffer_size);
     if (!json) return NULL;
 
     size_t offset = 0;
-    offset += snprintf(json + offset, buffer_size - offset, "{ \"tasks\": [ ");
+    json_append(json, buffer_size, &offset, "{ \"" TLM_KEY_TASKS "\": [ ");
 
     for (size_t i = 0; i < res.task_count; i++) {
         const task_stats_t *t = &res.tasks[i];
         if (t->created)
-            offset += snprintf(json + offset, buffer_size - offset,
-                "    {\"task_name\": \"%s\", \"status\": \"created\"}%s",
-                t->task_name, (i < res.task_count - 1) ? "," : "");
+            json_append(json, buffer_size, &offset, TLM_JSON_TASK_CREATED_FMT, t->task_name);
         else if (t->deleted)
-            offset += snprintf(json + offset, buffer_size - offset,
-                "    {\"task_name\": \"%s\", \"status\": \"deleted\"}%s",
-                t->task_name, (i < res.task_count - 1) ? "," : "");
+            json_append(json, buffer_size, &offset, TLM_JSON_TASK_DELETED_FMT, t->task_name);
         else
-            offset += snprintf(json + offset, buffer_size - offset,
-                "    {\"task_name\": \"%s\", \"run_time\": %" PRIu32 ", \"percentage\": %" PRIu32 ", \"core\": %d}%s",
-                t->task_name, t->run_time, t->percentage, t->core_id,
-                (i < res.task_count - 1) ? "," : "");
+            json_append(json, buffer_size, &offset, TLM_JSON_TASK_FMT,
+                t->task_name, t->run_time, (uint32_t)0, t->percentage, (int32_t)t->core_id);
+
+        if (i < res.task_count - 1)
+            json_append(json, buffer_size, &offset, ", ");
     }
 
-    offset += snprintf(json + offset, buffer_size - offset, " ] }");
+    json_append(json, buffer_size, &offset, " ], \"" TLM_KEY_CORES "\": [");
+    for (uint32_t core = 0; core < res.core_count; core++) {
+        json_append(json, buffer_size, &offset, "%s%" PRIu32, core ? ", " : "", res.core_load[core]);
+    }
+
+    json_append(json, buffer_size, &offset, "] }");
+    if (offset >= buffer_size) {
+        free(json);
+        return NULL;
+    }
     return json;
 }
 
@@ -278,10 +371,19 @@ void stats_task(void *arg)
         }
     #endif
 
+    uint32_t report_count = 0;
+
     while (1) {
+        if (report_count++ % DEVICE_INFO_PERIOD == 0) {
+            send_device_info();
+        }
+
         // printf("\nCollecting real-time stats...\n");
         stats_result_t res = print_real_time_stats(STATS_TICKS);
         get_memory_usage();
+        #if ISR_VECTOR_ENABLE
+            send_isr_report();
+        #endif
 
         if (res.status != ESP_OK)
         {
@@ -323,6 +425,7 @@ void stats_task(void *arg)
             }
             else
             {
+                // No memory, or the estimate of generate_json_stats() was short
                 char *err_json = strdup("{ \"error\": \"Not enough memory to build JSON\" }");
                 if (err_json)
                 {
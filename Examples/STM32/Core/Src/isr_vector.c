@@ -0,0 +1,311 @@
+#include "isr_vector.h"
+#include "CPU_usage.h"
+#include "telemetry_defs.h"     // generated from schema/telemetry.py
+
+
+typedef void (*isr_vector_handler_t)(void);
+
+typedef struct {
+    uint32_t count;
+    uint32_t dropped;               // ran nested too deep to be timed
+    uint32_t incl_min, incl_max;    // cycles
+    uint32_t excl_min, excl_max;
+    uint64_t incl_sum, excl_sum;
+    uint32_t hist[ISR_VECTOR_HIST_BUCKETS];
+} isr_vector_stats_t;
+
+typedef struct {
+    isr_vector_handler_t handler;   // the one from the flash table, NULL = free
+    IRQn_Type irq;
+    char name[ISR_VECTOR_NAME_LEN];
+    isr_vector_stats_t stats;
+} isr_vector_slot_t;
+
+
+// --------------------------------------------------------------------
+// Globals
+// --------------------------------------------------------------------
+extern void Default_Handler(void);     // startup_stm32f446retx.s
+
+// VTOR wants the table aligned to its size rounded up to a power of two
+static isr_vector_handler_t isr_vector_ram[16 + ISR_VECTOR_IRQS] __attribute__((aligned(512)));
+_Static_assert((16 + ISR_VECTOR_IRQS) * 4 <= 512, "vector table outgrew its alignment");
+
+static const isr_vector_handler_t *isr_vector_flash;
+static isr_vector_slot_t isr_vector_slots[ISR_VECTOR_MAX_TRACED];
+static uint8_t isr_vector_slot_of[ISR_VECTOR_IRQS];     // slot index + 1, 0 = not traced
+static volatile uint32_t isr_vector_ns_q16;             // ns per cycle, 16.16
+static uint32_t isr_vector_bad_tag;                     // stub ran for an IRQ without a slot
+
+// Interrupts in progress, innermost last: when each started and how much of
+// that went to the ones nested in it
+static uint32_t isr_vector_start[ISR_VECTOR_MAX_NESTING];
+static uint32_t isr_vector_child[ISR_VECTOR_MAX_NESTING];
+static uint32_t isr_vector_depth;
+
+
+// --------------------------------------------------------------------
+// Traced stub, the RAM table entry of every traced IRQ
+// --------------------------------------------------------------------
+//
+// Entered as the exception handler, so the hardware has already stacked the
+// caller saved registers and LR holds EXC_RETURN. The original handler is
+// an ordinary call from here. The nesting stack is only touched with
+// PRIMASK set, a higher priority interrupt can come in at any other point.
+//
+static void isr_vector_stub(void)
+{
+    int irq = (int)(__get_IPSR() & 0x1FF) - 16;
+    uint8_t index = (irq >= 0 && irq < ISR_VECTOR_IRQS) ? isr_vector_slot_of[irq] : 0;
+
+    if (index == 0)
+    {
+        isr_vector_bad_tag++;
+        if (irq >= 0 && irq < ISR_VECTOR_IRQS) {
+            isr_vector_flash[16 + irq]();
+        }
+        return;
+    }
+
+    isr_vector_slot_t *slot = &isr_vector_slots[index - 1];
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t depth = isr_vector_depth;
+    if (depth >= ISR_VECTOR_MAX_NESTING)
+    {
+        slot->stats.dropped++;
+        __set_PRIMASK(primask);
+        slot->handler();
+        return;
+    }
+    isr_vector_depth = depth + 1;
+    isr_vector_child[depth] = 0;
+    isr_vector_start[depth] = DWT->CYCCNT;
+    __set_PRIMASK(primask);
+
+    slot->handler();
+
+    __disable_irq();
+    uint32_t inclusive = DWT->CYCCNT - isr_vector_start[depth];
+    uint32_t exclusive = inclusive - isr_vector_child[depth];
+    isr_vector_depth = depth;
+    if (depth > 0) {
+        isr_vector_child[depth - 1] += inclusive;
+    }
+
+    isr_vector_stats_t *s = &slot->stats;
+    if (s->count == 0 || inclusive < s->incl_min) s->incl_min = inclusive;
+    if (s->count == 0 || exclusive < s->excl_min) s->excl_min = exclusive;
+    if (inclusive > s->incl_max) s->incl_max = inclusive;
+    if (exclusive > s->excl_max) s->excl_max = exclusive;
+    s->incl_sum += inclusive;
+    s->excl_sum += exclusive;
+    s->count++;
+
+    // log2 bucket of the self time in ns, same buckets as isr_trace.c
+    uint32_t ns = (uint32_t)(((uint64_t)exclusive * isr_vector_ns_q16) >> 16);
+    int bucket = (ns >> ISR_VECTOR_HIST_SHIFT) ? (31 - __builtin_clz(ns)) - ISR_VECTOR_HIST_SHIFT : 0;
+    if (bucket >= ISR_VECTOR_HIST_BUCKETS) {
+        bucket = ISR_VECTOR_HIST_BUCKETS - 1;
+    }
+    s->hist[bucket]++;
+    __set_PRIMASK(primask);
+}
+
+
+// --------------------------------------------------------------------
+// Setup
+// --------------------------------------------------------------------
+bool isr_vector_init(void)
+{
+    if (isr_vector_flash != NULL) {
+        return true;
+    }
+
+    // DWT cycle counter, also running without a debugger attached
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0) {
+        return false;
+    }
+    isr_vector_ns_q16 = (uint32_t)((1000000000ULL << 16) / SystemCoreClock);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    isr_vector_flash = (const isr_vector_handler_t *)SCB->VTOR;
+    memcpy(isr_vector_ram, isr_vector_flash, sizeof(isr_vector_ram));
+    SCB->VTOR = (uint32_t)isr_vector_ram;
+    __DSB();
+    __ISB();
+    __set_PRIMASK(primask);
+
+    return true;
+}
+
+// Names go into the report as they are, keep them plain
+static void isr_vector_set_name(char *dst, const char *name, IRQn_Type irq)
+{
+    if (name == NULL)
+    {
+        snprintf(dst, ISR_VECTOR_NAME_LEN, "irq%d", (int)irq);
+        return;
+    }
+
+    size_t i = 0;
+    for (; name[i] && i < ISR_VECTOR_NAME_LEN - 1; i++) {
+        dst[i] = (name[i] == '"' || name[i] == '\\' || (unsigned char)name[i] < 0x20) ? '_' : name[i];
+    }
+    dst[i] = '\0';
+}
+
+bool isr_vector_trace(IRQn_Type irq, const char *name)
+{
+    if (isr_vector_flash == NULL || irq < 0 || irq >= ISR_VECTOR_IRQS) {
+        return false;
+    }
+
+    // Already traced, only a new name (trace_all keeps the one it has)
+    if (isr_vector_slot_of[irq])
+    {
+        if (name) {
+            isr_vector_set_name(isr_vector_slots[isr_vector_slot_of[irq] - 1].name, name, irq);
+        }
+        return true;
+    }
+
+    for (uint8_t i = 0; i < ISR_VECTOR_MAX_TRACED; i++)
+    {
+        isr_vector_slot_t *slot = &isr_vector_slots[i];
+        if (slot->handler != NULL) {
+            continue;
+        }
+
+        // Slot complete before the table entry points at the stub
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        memset(&slot->stats, 0, sizeof(slot->stats));
+        isr_vector_set_name(slot->name, name, irq);
+        slot->irq = irq;
+        slot->handler = isr_vector_ram[16 + irq];
+        isr_vector_slot_of[irq] = i + 1;
+        isr_vector_ram[16 + irq] = isr_vector_stub;
+        __DSB();
+        __set_PRIMASK(primask);
+        return true;
+    }
+    return false;
+}
+
+void isr_vector_untrace(IRQn_Type irq)
+{
+    if (isr_vector_flash == NULL || irq < 0 || irq >= ISR_VECTOR_IRQS || isr_vector_slot_of[irq] == 0) {
+        return;
+    }
+
+    isr_vector_slot_t *slot = &isr_vector_slots[isr_vector_slot_of[irq] - 1];
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    isr_vector_ram[16 + irq] = slot->handler;
+    isr_vector_slot_of[irq] = 0;
+    slot->handler = NULL;
+    __DSB();
+    __set_PRIMASK(primask);
+}
+
+size_t isr_vector_trace_all(void)
+{
+    size_t traced = 0;
+
+    for (int irq = 0; irq < ISR_VECTOR_IRQS; irq++)
+    {
+        isr_vector_handler_t h = isr_vector_flash ? isr_vector_flash[16 + irq] : NULL;
+        if (h != NULL && h != Default_Handler && isr_vector_trace((IRQn_Type)irq, NULL)) {
+            traced++;
+        }
+    }
+    return traced;
+}
+
+
+// --------------------------------------------------------------------
+// Report
+// --------------------------------------------------------------------
+static uint32_t isr_vector_ns(uint64_t cycles)
+{
+    uint64_t ns = cycles * 1000000000ULL / SystemCoreClock;
+    return ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+}
+
+// Worst case entry: a 16 char name, 10 digit values and a full histogram
+#define ISR_VECTOR_ENTRY_JSON   512
+
+char *isr_vector_report_json(void)
+{
+    if (isr_vector_flash == NULL) {
+        return NULL;
+    }
+    isr_vector_ns_q16 = (uint32_t)((1000000000ULL << 16) / SystemCoreClock);
+
+    size_t size = 192 + ISR_VECTOR_MAX_TRACED * ISR_VECTOR_ENTRY_JSON;
+    char *json = malloc(size);
+    if (!json) return NULL;
+
+    size_t offset = 0;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t bad_tag = isr_vector_bad_tag;
+    isr_vector_bad_tag = 0;
+    __set_PRIMASK(primask);
+
+    json_append(json, size, &offset,
+        "{ \"" TLM_KEY_UPTIME_US "\": %" PRIu64 ", \"" TLM_KEY_CPU_HZ "\": %" PRIu32
+        ", \"" TLM_KEY_HIST_SHIFT "\": %d, \"" TLM_KEY_FREQ_CHANGES "\": 0, \"" TLM_KEY_BAD_TAG "\": %" PRIu32
+        ", \"" TLM_KEY_ISR "\": [ ",
+        (uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS * 1000, (uint32_t)SystemCoreClock,
+        ISR_VECTOR_HIST_SHIFT, bad_tag);
+
+    bool first = true;
+    for (int i = 0; i < ISR_VECTOR_MAX_TRACED; i++)
+    {
+        isr_vector_slot_t *slot = &isr_vector_slots[i];
+        if (slot->handler == NULL) {
+            continue;
+        }
+
+        // Take the window and start the next one
+        isr_vector_stats_t s;
+        primask = __get_PRIMASK();
+        __disable_irq();
+        s = slot->stats;
+        memset(&slot->stats, 0, sizeof(slot->stats));
+        __set_PRIMASK(primask);
+
+        uint32_t n = s.count ? s.count : 1;
+        json_append(json, size, &offset,
+            "%s{\"" TLM_KEY_TAG "\": %d, \"" TLM_KEY_CORE "\": 0, \"" TLM_KEY_NAME "\": \"%s\", \""
+            TLM_KEY_COUNT "\": %" PRIu32 ", \"" TLM_KEY_DROPPED "\": %" PRIu32,
+            first ? "" : ", ", (int)slot->irq, slot->name, s.count, s.dropped);
+        json_append(json, size, &offset,
+            ", \"" TLM_KEY_INCL_MIN_NS "\": %" PRIu32 ", \"" TLM_KEY_INCL_AVG_NS "\": %" PRIu32
+            ", \"" TLM_KEY_INCL_MAX_NS "\": %" PRIu32,
+            isr_vector_ns(s.incl_min), isr_vector_ns(s.incl_sum / n), isr_vector_ns(s.incl_max));
+        json_append(json, size, &offset,
+            ", \"" TLM_KEY_EXCL_MIN_NS "\": %" PRIu32 ", \"" TLM_KEY_EXCL_AVG_NS "\": %" PRIu32
+            ", \"" TLM_KEY_EXCL_MAX_NS "\": %" PRIu32 ", \"" TLM_KEY_HIST "\": [",
+            isr_vector_ns(s.excl_min), isr_vector_ns(s.excl_sum / n), isr_vector_ns(s.excl_max));
+        for (int b = 0; b < ISR_VECTOR_HIST_BUCKETS; b++) {
+            json_append(json, size, &offset, "%s%" PRIu32, b ? ", " : "", s.hist[b]);
+        }
+        json_append(json, size, &offset, "]}");
+        first = false;
+    }
+
+    json_append(json, size, &offset, " ], \"" TLM_KEY_HIST_UNIT "\": \"ns\" }");
+    if (offset >= size)
+    {
+        free(json);
+        return NULL;
+    }
+    return json;
+}
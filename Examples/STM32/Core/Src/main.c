@@ -32,6 +32,7 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include "CPU_usage.h"
+#include "uart_dma.h"
 
 //this is a small change
 /* USER CODE END Includes */
@@ -55,6 +56,7 @@
 TIM_HandleTypeDef htim2;
 
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_tx;
 
 osThreadId defaultTaskHandle;
 /* USER CODE BEGIN PV */
@@ -64,6 +66,7 @@ volatile uint32_t ulHighFrequencyTimerTicks = 0;
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_TIM2_Init(void);
 static void MX_USART2_UART_Init(void);
 void StartDefaultTask(void const * argument);
@@ -111,6 +114,7 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_TIM2_Init();
   MX_USART2_UART_Init();
   /* USER CODE BEGIN 2 */
@@ -144,6 +148,7 @@ int main(void)
 
   /* USER CODE BEGIN RTOS_THREADS */
   /* add threads, ... */
+  uart_dma_init(&huart2);
   CPU_usage_start(custom_user_printf);
 
   status = xTaskCreate(dummy_task, "dummy task", 128, NULL, 2, NULL);
@@ -295,6 +300,22 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Stream6_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -359,12 +380,18 @@ void dummy_task(void *arg)
 
 void custom_user_printf(char *received_json)
 {
-	HAL_UART_Transmit(&huart2, (uint8_t *)received_json, strlen(received_json), HAL_MAX_DELAY);
+	// Queued for DMA, the print task formats the next message while this one goes out
+	uart_dma_write((const uint8_t *)received_json, strlen(received_json));
 	const char newline[] = "\r\n";
-	HAL_UART_Transmit(&huart2, (uint8_t *)newline, strlen(newline), HAL_MAX_DELAY);
+	uart_dma_write((const uint8_t *)newline, strlen(newline));
 //    printf("%s\n", received_json);
 }
 
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	uart_dma_tx_complete(huart);
+}
+
 void configureTimerForRunTimeStats(void)
 {
     /* Configure TIM2 as a free-running counter at 1 MHz */
@@ -0,0 +1,99 @@
+#include <string.h>
+#include <stdbool.h>
+#include "uart_dma.h"
+
+
+// --------------------------------------------------------------------
+// Globals
+// --------------------------------------------------------------------
+static UART_HandleTypeDef *uart;
+static uint8_t tx_buf[2][UART_DMA_BUF_SIZE];
+static volatile uint8_t fill;           // buffer the writers copy into
+static volatile size_t fill_len;
+static volatile bool busy;              // DMA is sending the other buffer
+static SemaphoreHandle_t tx_done;       // given on every TX complete
+static SemaphoreHandle_t tx_lock;       // one writer at a time, messages do not interleave
+
+
+void uart_dma_init(UART_HandleTypeDef *huart)
+{
+    uart = huart;
+    tx_done = xSemaphoreCreateBinary();
+    tx_lock = xSemaphoreCreateMutex();
+    configASSERT(tx_done != NULL && tx_lock != NULL);
+}
+
+// --------------------------------------------------------------------
+// Hand the fill buffer to DMA if the line is idle. Called with interrupts
+// masked, from a task or from the TX complete callback.
+// --------------------------------------------------------------------
+static void uart_dma_start(void)
+{
+    if (busy || fill_len == 0) {
+        return;
+    }
+
+    if (HAL_UART_Transmit_DMA(uart, tx_buf[fill], (uint16_t)fill_len) == HAL_OK) {
+        busy = true;
+        fill ^= 1;
+        fill_len = 0;
+    }
+}
+
+// --------------------------------------------------------------------
+// Copy data into the buffers and return once it is all queued. Blocks
+// only while both buffers are full.
+// --------------------------------------------------------------------
+void uart_dma_write(const uint8_t *data, size_t len)
+{
+    xSemaphoreTake(tx_lock, portMAX_DELAY);
+
+    while (len > 0)
+    {
+        bool full;
+
+        taskENTER_CRITICAL();
+        size_t n = UART_DMA_BUF_SIZE - fill_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&tx_buf[fill][fill_len], data, n);
+        fill_len += n;
+        if (fill_len == UART_DMA_BUF_SIZE) {
+            uart_dma_start();
+        }
+        full = (fill_len == UART_DMA_BUF_SIZE);
+        taskEXIT_CRITICAL();
+
+        data += n;
+        len -= n;
+
+        if (full) {
+            xSemaphoreTake(tx_done, portMAX_DELAY);
+        }
+    }
+
+    // Send the rest now if the line is idle, the TX complete callback does otherwise
+    taskENTER_CRITICAL();
+    uart_dma_start();
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(tx_lock);
+}
+
+void uart_dma_tx_complete(UART_HandleTypeDef *huart)
+{
+    BaseType_t woken = pdFALSE;
+
+    if (huart != uart) {
+        return;
+    }
+
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    busy = false;
+    uart_dma_start();
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+
+    xSemaphoreGiveFromISR(tx_done, &woken);
+    portYIELD_FROM_ISR(woken);
+}
@@ -14,11 +14,11 @@
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "cJSON.h"
-#include "freertos/queue.h"
+#include "freertos/message_buffer.h"
+#include "CPU_usage.h"
 
 static const char *TAG = "AWS_TASK_BASED";
 
-extern QueueHandle_t AWSQueue;
 
 // ==========================================
 // 1. CONFIGURATION
@@ -150,58 +150,27 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 }
 
 // ==========================================
-// 3. THE APPLICATION TASK
+// 3. THE MQTT SINK
 // ==========================================
-void publisher_task(void *param)
+// Called from the MQTT sink task (see sink.h). While the link is down the
+// task waits here and its queue fills, the monitor then drops the oldest
+// reports without ever waiting on Wi-Fi itself.
+void aws_publish(void *ctx, const char *data, size_t len)
 {
-
-    char *received_json = NULL;
-
-    while (1) {
-        // 1. WAIT: Pause here until BOTH Wi-Fi and MQTT are connected.
-        //    If connection drops, this line blocks automatically.
-        xEventGroupWaitBits(s_status_event_group,
-                                               WIFI_CONNECTED_BIT | MQTT_CONNECTED_BIT,
-                                               pdFALSE, // Do not clear bits on exit
-                                               pdTRUE,  // Wait for ALL bits (AND logic)
-                                               portMAX_DELAY);
-
-
-        if (xQueueReceive(AWSQueue, &received_json, portMAX_DELAY) == pdPASS)
-        {
-
-            if (client != NULL)
-            {
-                int msg_id = esp_mqtt_client_publish(client, AWS_PUB_TOPIC, received_json, 0, 1, 0);
-                ESP_LOGI(TAG, "Published msg_id=%d, data=%s", msg_id, received_json);
-            }
-
-            free(received_json);
-
-        }
-
-
-        // // 2. PREPARE DATA: Create JSON payload
-        // ESP_LOGI(TAG, "Generating Sensor Data...");
-        // cJSON *root = cJSON_CreateObject();
-        // cJSON_AddNumberToObject(root, "uptime", esp_timer_get_time() / 1000);
-        // cJSON_AddStringToObject(root, "status", "Task Loop Running");
-        // cJSON_AddNumberToObject(root, "random_val", rand() % 100);
-        
-        // char *post_data = cJSON_PrintUnformatted(root);
-
-        // // 3. PUBLISH: Send the data
-        // if (client != NULL) {
-        //     int msg_id = esp_mqtt_client_publish(client, AWS_PUB_TOPIC, post_data, 0, 1, 0);
-        //     ESP_LOGI(TAG, "Published msg_id=%d, data=%s", msg_id, post_data);
-        // }
-
-        // // 4. CLEANUP
-        // cJSON_Delete(root);
-        // free(post_data);
-
-        // // 5. BLOCKING DELAY (Sleep for 5 seconds)
-        // vTaskDelay(pdMS_TO_TICKS(5000));
+    (void)ctx;
+
+    // Pause here until BOTH Wi-Fi and MQTT are connected
+    xEventGroupWaitBits(s_status_event_group,
+                        WIFI_CONNECTED_BIT | MQTT_CONNECTED_BIT,
+                        pdFALSE, // Do not clear bits on exit
+                        pdTRUE,  // Wait for ALL bits (AND logic)
+                        portMAX_DELAY);
+
+    if (client != NULL)
+    {
+        // CBOR payloads are binary, pass the length and do not log them as text
+        int msg_id = esp_mqtt_client_publish(client, AWS_PUB_TOPIC, data, len, 1, 0);
+        ESP_LOGI(TAG, "Published msg_id=%d, %u bytes", msg_id, (unsigned)len);
     }
 }
 
@@ -281,7 +250,5 @@ void aws_and_wifi_start(void) {
     wifi_init_sta();
     mqtt_init();
 
-    // Start publisher Task test
-    xTaskCreatePinnedToCore(publisher_task, "publisher_task", 4096, NULL, 2, NULL, 0);
-
+    // Publishing is done by the MQTT sink task of the monitor, see aws_publish()
 }
\ No newline at end of file
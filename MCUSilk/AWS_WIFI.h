@@ -10,4 +10,4 @@ void wifi_event_handler(void* arg, esp_event_base_t event_base,
 void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
 void wifi_init_sta(void);
 void mqtt_init(void);
-void publisher_task(void *pvParameters);
+void aws_publish(void *ctx, const char *data, size_t len);
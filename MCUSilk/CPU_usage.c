@@ -1,5 +1,19 @@
 #include "CPU_usage.h"
 #include "../../../MCUSilk/AWS_WIFI.h"
+#include "postmortem.h"
+#include "trigger.h"
+#include "wire.h"
+#include "telemetry.h"
+#include "delta.h"
+#include "lz.h"
+#include "sink.h"
+#include "link.h"
+#include "flashlog.h"
+#include "esp_chip_info.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "driver/uart_vfs.h"
+#include "sdkconfig.h"
 
 
 
@@ -11,9 +25,285 @@
     SemaphoreHandle_t sync_spin_task;
 #endif
 SemaphoreHandle_t sync_stats_task;
-QueueHandle_t jsonQueue, ISRQueue, AWSQueue;
 
-#define CONFIG_FREERTOS_NUMBER_OF_CORES 2
+static const char *device_tag = "ESP32";
+static uint32_t core_count;
+static cpu_usage_format_t output_format = CPU_USAGE_FORMAT_JSON;
+static cpu_usage_format_t aws_format = CPU_USAGE_FORMAT_JSON;
+static bool serial_compress;
+static bool aws_compress;
+static void (*serial_write)(const uint8_t *data, size_t len);
+static void (*serial_print)(char *msg);
+static SemaphoreHandle_t serial_lock;      // one message at a time on the serial link
+static TaskHandle_t serial_holder;         // task holding the link for a run of frames
+static SemaphoreHandle_t flash_log_lock;   // appends and a dump of the flash log
+static flashlog_t *flash_log;
+static SemaphoreHandle_t publish_lock;     // one publisher at a time encodes and fans out
+static SemaphoreHandle_t alert_lock;       // same for alerts, so they never wait for bulk
+
+// The serial link is always the first sink
+#define SERIAL_SINK     0
+
+// Load of a sink over the last report period, see cpu_usage_adapt_rate()
+typedef struct {
+    uint32_t sent;
+    uint32_t overflow;
+    uint32_t bytes;
+    TickType_t busy;
+    uint32_t throughput;        // bytes per second
+    uint8_t busy_pct;
+} cpu_usage_link_t;
+
+static cpu_usage_link_t links[CPU_USAGE_MAX_SINKS];
+static TickType_t link_tick;
+static uint32_t coalesce = 1;              // base periods per report
+static uint32_t idle_reports;
+
+// Room left for the encoder so the COBS frame of the result still fits CPU_USAGE_MSG_MAX
+#define CPU_USAGE_PAYLOAD_MAX   (CPU_USAGE_MSG_MAX - CPU_USAGE_MSG_MAX / 254 - 6)
+
+// Plain JSON lines, or COBS frames (any other format, or compressed JSON)
+static bool cpu_usage_serial_framed(void)
+{
+    return output_format != CPU_USAGE_FORMAT_JSON || serial_compress;
+}
+
+// --------------------------------------------------------------------
+// Console UART through the IDF driver. uart_write_bytes() copies into the
+// TX ring and returns, the UART interrupt feeds the FIFO from it while the
+// next message is formatted. Without the driver every byte busy-waits on
+// the FIFO in the writing task and shows up as its CPU time.
+// --------------------------------------------------------------------
+static void cpu_usage_uart_write(const uint8_t *data, size_t len)
+{
+    uart_write_bytes(CONFIG_ESP_CONSOLE_UART_NUM, data, len);
+}
+
+static void cpu_usage_uart_init(void)
+{
+    uart_port_t port = CONFIG_ESP_CONSOLE_UART_NUM;
+
+    if (SERIAL_TX_RING_SIZE == 0) {
+        return;
+    }
+
+    // An application that installed the driver itself keeps its buffers
+    if (!uart_is_driver_installed(port) &&
+        uart_driver_install(port, SERIAL_RX_BUF_SIZE, SERIAL_TX_RING_SIZE, 0, NULL, 0) != ESP_OK) {
+        return;
+    }
+
+    // printf and ESP_LOGx go through the same ring, in order with the reports
+    uart_vfs_dev_use_driver(port);
+    serial_write = cpu_usage_uart_write;
+}
+
+// --------------------------------------------------------------------
+// Raw serial output: write_fn if set, the console UART otherwise
+// --------------------------------------------------------------------
+static void cpu_usage_serial_out(const char *data, size_t len)
+{
+    if (serial_write) {
+        serial_write((const uint8_t *)data, len);
+    } else {
+        fwrite(data, 1, len, stdout);
+        fflush(stdout);
+    }
+}
+
+static void cpu_usage_serial_flush(void *ctx, const char *data, size_t len)
+{
+    (void)ctx;
+    cpu_usage_serial_out(data, len);
+}
+
+// Serial sink: JSON lines or COBS frames, the line end / delimiter is in data
+static void cpu_usage_serial_sink(void *ctx, const char *data, size_t len)
+{
+    (void)ctx;
+    xSemaphoreTake(serial_lock, portMAX_DELAY);
+    cpu_usage_serial_out(data, len);
+    xSemaphoreGive(serial_lock);
+}
+
+// --------------------------------------------------------------------
+// Link control (link.c): a frame written between two messages, and a
+// baud switch once everything before it has left the UART
+// --------------------------------------------------------------------
+void cpu_usage_serial_raw(const char *data, size_t len)
+{
+    bool held = serial_holder == xTaskGetCurrentTaskHandle();
+
+    if (!held) {
+        xSemaphoreTake(serial_lock, portMAX_DELAY);
+    }
+    cpu_usage_serial_out(data, len);
+    if (!held) {
+        xSemaphoreGive(serial_lock);
+    }
+}
+
+// The sinks and the report stream wait until the link is released
+void cpu_usage_serial_hold(bool hold)
+{
+    if (hold)
+    {
+        xSemaphoreTake(serial_lock, portMAX_DELAY);
+        serial_holder = xTaskGetCurrentTaskHandle();
+    }
+    else
+    {
+        serial_holder = NULL;
+        xSemaphoreGive(serial_lock);
+    }
+}
+
+bool cpu_usage_serial_baud(uint32_t baud, const char *last, size_t len)
+{
+    uart_port_t port = CONFIG_ESP_CONSOLE_UART_NUM;
+    bool ok;
+
+    // A write_fn is somebody else's link
+    if (serial_write != cpu_usage_uart_write) {
+        return false;
+    }
+
+    xSemaphoreTake(serial_lock, portMAX_DELAY);
+    if (last) {
+        cpu_usage_serial_out(last, len);
+    }
+    uart_wait_tx_done(port, pdMS_TO_TICKS(500));
+    ok = uart_set_baudrate(port, baud) == ESP_OK;
+    xSemaphoreGive(serial_lock);
+    return ok;
+}
+
+// Serial sink through the user print function, one NUL terminated JSON message
+static void cpu_usage_print_sink(void *ctx, const char *data, size_t len)
+{
+    (void)ctx;
+    (void)len;
+    xSemaphoreTake(serial_lock, portMAX_DELAY);
+    serial_print((char *)data);
+    xSemaphoreGive(serial_lock);
+}
+
+// --------------------------------------------------------------------
+// File sink, pass the FILE * as ctx (SPIFFS, FAT, SD card)
+// --------------------------------------------------------------------
+void cpu_usage_file_sink(void *file, const char *data, size_t len)
+{
+    fwrite(data, 1, len, (FILE *)file);
+    fflush((FILE *)file);
+}
+
+// --------------------------------------------------------------------
+// Flash log sink (flashlog.h): every binary frame is one record
+// --------------------------------------------------------------------
+static void cpu_usage_log_sink(void *log, const char *data, size_t len)
+{
+    xSemaphoreTake(flash_log_lock, portMAX_DELAY);
+    flashlog_append(log, data, len);
+    xSemaphoreGive(flash_log_lock);
+}
+
+flashlog_t *cpu_usage_log_lock(void)
+{
+    if (flash_log == NULL) {
+        return NULL;
+    }
+    xSemaphoreTake(flash_log_lock, portMAX_DELAY);
+    return flash_log;
+}
+
+void cpu_usage_log_unlock(void)
+{
+    xSemaphoreGive(flash_log_lock);
+}
+
+// Serial link first, then MQTT and the flash log, then the ones from cfg
+static bool cpu_usage_sinks_init(const cpu_usage_cfg_t *cfg)
+{
+    cpu_usage_sink_cfg_t serial = {
+        .name = "uart print task",
+        .format = output_format,
+        .compress = serial_compress,
+        .write = cpu_usage_serial_sink,
+        .drop = CPU_USAGE_BLOCK,
+    };
+
+    // Frames are bytes for the wire, only JSON goes through print_fn
+    if (serial_print && !cpu_usage_serial_framed()) {
+        serial.packets = true;
+        serial.write = cpu_usage_print_sink;
+    }
+    if (!sink_add(&serial)) {
+        return false;
+    }
+
+    // A stalled Wi-Fi link keeps the newest reports for when it is back
+    if (cfg->enable_AWS_upload)
+    {
+        cpu_usage_sink_cfg_t aws = {
+            .name = "publisher",
+            .format = aws_format,
+            .compress = aws_compress,
+            .packets = true,
+            .write = aws_publish,
+            .drop = CPU_USAGE_DROP_OLDEST,
+        };
+        if (!sink_add(&aws)) {
+            return false;
+        }
+    }
+
+    // Binary frames stand alone, a dump that starts anywhere in the ring
+    // decodes. The rate spreads the capacity over the retention time.
+    if (flash_log)
+    {
+        cpu_usage_sink_cfg_t log = {
+            .name = "flash log",
+            .format = CPU_USAGE_FORMAT_BINARY,
+            .write = cpu_usage_log_sink,
+            .ctx = flash_log,
+            .depth = 1,             // the rate lets a message through every few reports
+            .drop = CPU_USAGE_DROP_NEWEST,
+        };
+        if (cfg->log_retention_s) {
+            log.rate = flashlog_capacity(flash_log) / cfg->log_retention_s;
+        }
+        if (!sink_add(&log)) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < cfg->sink_count; i++) {
+        if (!sink_add(&cfg->sinks[i])) {
+            return false;
+        }
+    }
+
+    return sink_start(cfg->sink_pool);
+}
+
+bool cpu_usage_sink_stats(size_t index, cpu_usage_sink_stats_t *stats)
+{
+    sink_t *s = sink_get(index);
+    if (s == NULL) {
+        return false;
+    }
+    stats->sent = s->sent;
+    stats->dropped = s->dropped;
+    stats->queued = uxQueueMessagesWaiting(s->queue) + uxQueueMessagesWaiting(s->alerts);
+    stats->bytes = s->bytes;
+    stats->throughput = links[index].throughput;
+    stats->busy_pct = links[index].busy_pct;
+    stats->alerts = s->alerts_sent;
+    stats->alerts_dropped = s->alerts_dropped;
+    stats->alert_wait_avg_ms = s->alerts_sent ? s->alert_wait * portTICK_PERIOD_MS / s->alerts_sent : 0;
+    stats->alert_wait_max_ms = s->alert_wait_max * portTICK_PERIOD_MS;
+    return true;
+}
 
 
 void CPU_usage_start(const cpu_usage_cfg_t *cfg)
@@ -25,6 +315,39 @@ void CPU_usage_start(const cpu_usage_cfg_t *cfg)
     if (cfg && cfg->print_fn) {
         user_print = cfg->print_fn;
     }
+    serial_print = user_print;
+
+    if (cfg && cfg->write_fn) {
+        serial_write = cfg->write_fn;
+    }
+
+    if (cfg && cfg->tag) {
+        device_tag = cfg->tag;
+    }
+
+    // Binary layouts only exist on the serial link, MQTT gets JSON or CBOR
+    if (cfg && cfg->aws_format == CPU_USAGE_FORMAT_CBOR) {
+        aws_format = CPU_USAGE_FORMAT_CBOR;
+    }
+
+    if (cfg) {
+        output_format = cfg->format;
+        serial_compress = cfg->compress;
+        aws_compress = cfg->aws_compress;
+        flash_log = cfg->flash_log;
+    }
+
+    // The console would turn every 0x0A of a frame into CR LF
+    if (cpu_usage_serial_framed() && serial_write == NULL) {
+        uart_vfs_dev_port_set_tx_line_endings(CONFIG_ESP_CONSOLE_UART_NUM, ESP_LINE_ENDINGS_LF);
+    }
+
+    if (serial_write == NULL) {
+        cpu_usage_uart_init();
+    }
+
+    // Dump the history of a crashed previous boot before normal reporting starts
+    postmortem_init(user_print);
 
     #if CPU_LOAD
 
@@ -34,99 +357,497 @@ void CPU_usage_start(const cpu_usage_cfg_t *cfg)
         for (int i = 0; i < NUM_OF_SPIN_TASKS; i++) {
             snprintf(task_names[i], sizeof(task_names[i]), "spin%d", i);
             xTaskCreatePinnedToCore(spin_task, task_names[i], 2048, NULL,
-                                    SPIN_TASK_PRIO, NULL, 1);
+                                    SPIN_TASK_PRIO, NULL, CPU_USAGE_TASK_CORE);
         }
 
     #endif
 
     sync_stats_task = xSemaphoreCreateBinary();
     
-    jsonQueue = xQueueCreate(5, sizeof(char *));
-    if (jsonQueue == NULL)
+    if (cfg->enable_AWS_upload)
+    {
+        // Start AWS and WiFi, before the MQTT sink task can publish
+        aws_and_wifi_start();
+    }
+
+    serial_lock = xSemaphoreCreateMutex();
+    publish_lock = xSemaphoreCreateMutex();
+    alert_lock = xSemaphoreCreateMutex();
+    flash_log_lock = xSemaphoreCreateMutex();
+    if (serial_lock == NULL || publish_lock == NULL || alert_lock == NULL || flash_log_lock == NULL ||
+        !cpu_usage_sinks_init(cfg))
     {
         while(1)
         {
         }
     }
 
-    ISRQueue = xQueueCreate(5, sizeof(isr_trace_record_t));
-    if (ISRQueue == NULL)
+    // Commands from the host come back on the RX line of the driver
+    if (serial_write == cpu_usage_uart_write) {
+        link_start(CONFIG_ESP_CONSOLE_UART_NUM);
+    }
+
+    // Create and start stats task
+    xTaskCreatePinnedToCore(stats_task, "stats", 4096, NULL,
+                            STATS_TASK_PRIO, NULL, CPU_USAGE_TASK_CORE);
+    
+
+    xTaskCreatePinnedToCore(ISR_uart_print_task, "ISR uart print task", 4096, (void *)user_print,
+                            ISR_UART_PRINT_PRIO, NULL, CPU_USAGE_TASK_CORE);
+
+    #if TRIGGER_ENABLE
+        xTaskCreatePinnedToCore(trigger_task, "trigger", 4096, NULL,
+                                TRIGGER_TASK_PRIO, NULL, CPU_USAGE_TASK_CORE);
+    #endif
+
+
+
+    xSemaphoreGive(sync_stats_task);
+
+
+}
+
+// --------------------------------------------------------------------
+// Core count, detected once at runtime and capped to what FreeRTOS runs on
+// --------------------------------------------------------------------
+uint32_t cpu_usage_core_count(void)
+{
+    if (core_count == 0)
     {
-        while(1)
-        {
+        esp_chip_info_t info;
+        esp_chip_info(&info);
+        core_count = info.cores;
+        if (core_count == 0 || core_count > CPU_USAGE_MAX_CORES) {
+            core_count = CPU_USAGE_MAX_CORES;
         }
     }
+    return core_count;
+}
 
-    if (cfg->enable_AWS_upload)
+// Core a task is pinned to, -1 if it can run on any core
+int cpu_usage_task_core(TaskHandle_t task)
+{
+    BaseType_t core = xTaskGetCoreID(task);
+    if (core < 0 || core >= (BaseType_t)cpu_usage_core_count()) {
+        return -1;
+    }
+    return (int)core;
+}
+
+uint32_t cpu_usage_coalesce(void)
+{
+    return coalesce;
+}
+
+cpu_usage_format_t cpu_usage_output_format(void)
+{
+    return output_format;
+}
+
+// --------------------------------------------------------------------
+// LZ form of a JSON / CBOR payload (u8 type | u16 length | stream, see
+// lz.h) into out, if that is smaller. Otherwise msg stays as it is.
+// --------------------------------------------------------------------
+static bool cpu_usage_compress(wire_msg_type_t *type, cpu_usage_msg_t *msg, char *out)
+{
+    if (msg->len <= 3 + 1 || msg->len > UINT16_MAX) {
+        return false;
+    }
+
+    uint8_t *o = (uint8_t *)out;
+    size_t len = lz_compress((const uint8_t *)msg->data, msg->len, o + 3, msg->len - 1 - 3);
+    if (len == 0) {
+        return false;
+    }
+
+    o[0] = (uint8_t)*type;
+    o[1] = (uint8_t)msg->len;
+    o[2] = (uint8_t)(msg->len >> 8);
+    msg->data = out;
+    msg->len = 3 + len;
+    *type = WIRE_MSG_LZ;
+    return true;
+}
+
+static void cpu_usage_swap(sink_buf_t **a, sink_buf_t **b)
+{
+    sink_buf_t *t = *a;
+    *a = *b;
+    *b = t;
+}
+
+// --------------------------------------------------------------------
+// Encode one message for the sinks taking cfg's encoding into a pool
+// buffer, each step writing into the other of two buffers. Messages
+// without a layout for the format fall back to JSON. On stream sinks
+// everything but plain JSON is COBS framed and ends with the frame
+// delimiter, JSON ends with '\n'. compress applies to JSON and CBOR,
+// binary frames are sent as they are. NULL if it does not fit (too_large
+// is then set) or the pool is out of buffers (the alert reserve only
+// serves alerts).
+// --------------------------------------------------------------------
+static sink_buf_t *cpu_usage_encode(const cpu_usage_sink_cfg_t *cfg, cpu_usage_encode_fn encode, const void *ctx,
+                                    bool alert, bool *too_large)
+{
+    wire_msg_type_t frame_type = WIRE_MSG_CBOR;
+    bool framed = !cfg->packets && (cfg->format != CPU_USAGE_FORMAT_JSON || cfg->compress);
+    bool raw = false;           // BINARY / DELTA frame, only needs the CRC and COBS
+    sink_buf_t *b = sink_buf_get(alert);
+    sink_buf_t *spare = sink_buf_get(alert);
+    cpu_usage_msg_t msg;
+
+    if (b == NULL || spare == NULL) {
+        goto fail;
+    }
+
+    msg = (cpu_usage_msg_t) { .data = b->data, .cap = CPU_USAGE_PAYLOAD_MAX };
+
+    if (cfg->format == CPU_USAGE_FORMAT_JSON || !encode(ctx, cfg->format, &msg))
+    {
+        msg.len = 0;
+        if (!encode(ctx, CPU_USAGE_FORMAT_JSON, &msg)) {
+            goto fail;
+        }
+        frame_type = WIRE_MSG_JSON;
+    }
+    else if (cfg->format == CPU_USAGE_FORMAT_BINARY || cfg->format == CPU_USAGE_FORMAT_DELTA)
+    {
+        raw = true;
+    }
+
+    if (cfg->compress && !raw && cpu_usage_compress(&frame_type, &msg, spare->data)) {
+        cpu_usage_swap(&b, &spare);
+    }
+
+    if (framed)
+    {
+        if (raw) {
+            msg.len = wire_frame((const uint8_t *)msg.data, msg.len, spare->data, CPU_USAGE_MSG_MAX);
+        } else {
+            msg.len = wire_payload_frame(frame_type, msg.data, msg.len, spare->data, CPU_USAGE_MSG_MAX);
+        }
+        if (msg.len == 0) {
+            goto fail;
+        }
+        cpu_usage_swap(&b, &spare);
+        msg.len++;              // the NUL after the frame is its delimiter
+    }
+    else
     {
+        if (!cfg->packets) {
+            b->data[msg.len++] = '\n';
+        }
+        b->data[msg.len] = '\0';
+    }
+
+    b->len = msg.len;
+    sink_buf_put(spare);
+    return b;
 
-        AWSQueue = xQueueCreate(10, sizeof(char *));
-        if (AWSQueue == NULL)
+fail:
+    *too_large = b != NULL && spare != NULL;
+    sink_buf_put(b);
+    sink_buf_put(spare);
+    return NULL;
+}
+
+static bool cpu_usage_same_encoding(const cpu_usage_sink_cfg_t *a, const cpu_usage_sink_cfg_t *b)
+{
+    return a->format == b->format && a->compress == b->compress && a->packets == b->packets;
+}
+
+// Queue one encoded message on sink j, the serial copy counts in the link budget
+static bool cpu_usage_offer(size_t j, sink_buf_t *b, uint8_t type, TickType_t ticks_to_wait, bool alert)
+{
+    sink_t *s = sink_get(j);
+    bool ok = alert ? sink_offer_alert(s, b) : sink_offer(s, b, ticks_to_wait);
+
+    if (ok && j == SERIAL_SINK) {
+        link_account(type, b->len);
+    }
+    return ok;
+}
+
+// --------------------------------------------------------------------
+// Encode a message once per distinct sink encoding and queue it on every
+// sink not in skip, on the bulk or the alert lane. Under publish_lock or
+// alert_lock, so it never waits: with a deferred array, CPU_USAGE_BLOCK
+// sinks get a reference there instead, to wait on once the lock is given.
+// Sinks the message was too large for are added to too_large. Returns
+// false if the serial copy was dropped.
+// --------------------------------------------------------------------
+static bool cpu_usage_offer_all(cpu_usage_encode_fn encode, const void *ctx, uint8_t type,
+                                uint32_t skip, bool alert, sink_buf_t *deferred[], uint32_t *too_large)
+{
+    uint32_t done = skip;
+    bool sent = true;
+
+    for (size_t i = 0; i < sink_count(); i++)
+    {
+        if (done & (1u << i)) {
+            continue;
+        }
+
+        sink_t *s = sink_get(i);
+        bool big = false;
+        sink_buf_t *b = cpu_usage_encode(&s->cfg, encode, ctx, alert, &big);
+        if (b) {
+            b->queued = xTaskGetTickCount();
+        }
+
+        for (size_t j = i; j < sink_count(); j++)
         {
-            while(1)
-            {
+            sink_t *o = sink_get(j);
+            if ((done & (1u << j)) || !cpu_usage_same_encoding(&s->cfg, &o->cfg)) {
+                continue;
+            }
+            done |= 1u << j;
+            if (big) {
+                *too_large |= 1u << j;
+            }
+
+            if (deferred != NULL && b != NULL && o->cfg.drop == CPU_USAGE_BLOCK) {
+                sink_buf_ref(b);
+                deferred[j] = b;
+                continue;
+            }
+
+            bool ok = cpu_usage_offer(j, b, type, 0, alert);
+            if (j == SERIAL_SINK) {
+                sent = ok;
             }
         }
 
-        // Start AWS and WiFi
-        aws_and_wifi_start();
+        // The queued sinks hold their own references
+        sink_buf_put(b);
     }
-    else
+
+    return sent;
+}
+
+// --------------------------------------------------------------------
+// A message a sink cannot take whole (too large once encoded, or no heap
+// for the copy a packet sink needs) is dropped there and counts in its
+// dropped. The first time on each sink it also says so on the alert lane,
+// so a report that outgrew the format does not just stop arriving. One
+// alert names all sinks of the message, it would replace another one in
+// a lane of CPU_USAGE_ALERT_DEPTH.
+// --------------------------------------------------------------------
+typedef struct {
+    uint32_t sinks;
+    uint8_t type;
+    esp_err_t code;
+} cpu_usage_dropped_t;
+
+static void cpu_usage_drop_json(stream_writer_t *s, const void *ctx)
+{
+    const cpu_usage_dropped_t *d = ctx;
+    bool first = true;
+
+    stream_printf(s, "{ \"error\": \"message dropped\", \"code\": \"%s\", \"sinks\": [", esp_err_to_name(d->code));
+    for (size_t i = 0; i < sink_count(); i++)
     {
-        AWSQueue = NULL;
+        if (d->sinks & (1u << i))
+        {
+            stream_puts(s, first ? " " : ", ");
+            stream_put_json_str(s, sink_get(i)->cfg.name);
+            first = false;
+        }
     }
+    stream_printf(s, " ], \"type\": %u, \"max\": %u }", d->type, (unsigned)CPU_USAGE_PAYLOAD_MAX);
+}
 
-    // Create and start stats task
-    xTaskCreatePinnedToCore(stats_task, "stats", 4096, NULL,
-                            STATS_TASK_PRIO, NULL, 1);
-    
-    xTaskCreatePinnedToCore(uart_print_task, "uart print task", 4096, (void *)user_print,
-                            UART_PRINT_TASK_PRIO, NULL, 1);
+static void cpu_usage_drop_alert(uint32_t sinks, uint8_t type, esp_err_t code)
+{
+    static uint32_t told;      // sinks that have had their alert
 
+    xSemaphoreTake(alert_lock, portMAX_DELAY);
+    sinks &= ~told;
+    told |= sinks;
+    xSemaphoreGive(alert_lock);
 
-    xTaskCreatePinnedToCore(ISR_uart_print_task, "ISR uart print task", 4096, (void *)user_print,
-                            ISR_UART_PRINT_PRIO, NULL, 1);
+    cpu_usage_dropped_t d = { .sinks = sinks, .type = type, .code = code };
+    char buffer[256];
+    if (sinks && stream_fill(cpu_usage_drop_json, &d, buffer, sizeof(buffer))) {
+        cpu_usage_alert_json(buffer);
+    }
+}
 
+// --------------------------------------------------------------------
+// Bulk telemetry. A sink that is full or over its rate drops it by its
+// own policy, only CPU_USAGE_BLOCK sinks make the caller wait, and only
+// after publish_lock is given: the lock covers the encoding alone, so
+// every publisher gets it within one encode and none is turned away.
+// type is the WIRE_MSG_* it counts as in the link budget.
+// --------------------------------------------------------------------
+static bool cpu_usage_fanout(cpu_usage_encode_fn encode, const void *ctx, uint8_t type,
+                             uint32_t skip, TickType_t ticks_to_wait)
+{
+    sink_buf_t *deferred[CPU_USAGE_MAX_SINKS] = { NULL };
+    uint32_t too_large = 0;
 
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    bool sent = cpu_usage_offer_all(encode, ctx, type, skip, false, ticks_to_wait > 0 ? deferred : NULL,
+                                    &too_large);
+    xSemaphoreGive(publish_lock);
 
-    xSemaphoreGive(sync_stats_task);
+    if (too_large) {
+        cpu_usage_drop_alert(too_large, type, ESP_ERR_INVALID_SIZE);
+    }
 
+    for (size_t j = 0; j < sink_count(); j++)
+    {
+        if (deferred[j] == NULL) {
+            continue;
+        }
 
+        bool ok = cpu_usage_offer(j, deferred[j], type, ticks_to_wait, false);
+        if (j == SERIAL_SINK) {
+            sent = ok;
+        }
+        sink_buf_put(deferred[j]);
+    }
+
+    return sent;
+}
+
+bool cpu_usage_publish(cpu_usage_encode_fn encode, const void *ctx, TickType_t ticks_to_wait)
+{
+    return cpu_usage_fanout(encode, ctx, WIRE_MSG_JSON, 0, ticks_to_wait);
+}
+
+static bool cpu_usage_encode_text(const void *ctx, cpu_usage_format_t fmt, cpu_usage_msg_t *msg)
+{
+    if (fmt != CPU_USAGE_FORMAT_JSON) {
+        return false;
+    }
+    msg->len = strlen((const char *)ctx);
+    if (msg->len > msg->cap) {
+        return false;
+    }
+    memcpy(msg->data, ctx, msg->len);
+    return true;
 }
 
 // --------------------------------------------------------------------
-// Memory usage
+// Publish a ready-made JSON message.
+// The text is copied, returns false if it was dropped.
 // --------------------------------------------------------------------
-void get_memory_usage()
+bool cpu_usage_queue_json(const char *json, TickType_t ticks_to_wait)
 {
+    if (json == NULL) {
+        return false;
+    }
+    return cpu_usage_publish(cpu_usage_encode_text, json, ticks_to_wait);
+}
 
-    // Get total and free heap (all dynamic memory)
-    size_t total_heap = heap_caps_get_total_size(MALLOC_CAP_DEFAULT);
-    size_t free_heap = esp_get_free_heap_size();
+// --------------------------------------------------------------------
+// Publish a JSON alert (errors) on the alert lane of every sink: written
+// before any queued bulk message, never rate limited, and never waiting
+// for a bulk publisher that blocks on a full sink. A full lane gives up
+// its oldest alert for this one. Returns false if it could not be encoded
+// for the serial link.
+// --------------------------------------------------------------------
+bool cpu_usage_alert_json(const char *json)
+{
+    if (json == NULL) {
+        return false;
+    }
 
-    // Internal SRAM only
-    size_t total_internal = heap_caps_get_total_size(MALLOC_CAP_INTERNAL);
-    size_t free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    uint32_t too_large = 0;
 
-    
-    char *memory_json = malloc(200);
-    if (memory_json) {
-        snprintf( memory_json, 200,
-            "{ \"heap_total\": %d, \"heap_free\": %d, \"internal_total\": %d, \"internal_free\": %d }",
-            total_heap, free_heap,
-            total_internal, free_internal
-        );
-    }
+    xSemaphoreTake(alert_lock, portMAX_DELAY);
+    bool sent = cpu_usage_offer_all(cpu_usage_encode_text, json, WIRE_MSG_JSON, 0, true, NULL, &too_large);
+    xSemaphoreGive(alert_lock);
+    return sent;
+}
 
+// --------------------------------------------------------------------
+// Encode a schema message (telemetry.h) in the format of the sink,
+// straight into the pool buffer
+// --------------------------------------------------------------------
+static bool cpu_usage_encode_tlm(const void *ctx, cpu_usage_format_t fmt, cpu_usage_msg_t *msg)
+{
+    const cpu_usage_tlm_t *t = ctx;
+    uint8_t *buf = (uint8_t *)msg->data;
 
-    if (memory_json)
+    if (fmt == CPU_USAGE_FORMAT_BINARY || fmt == CPU_USAGE_FORMAT_DELTA)
     {
-        if (xQueueSend(jsonQueue, &memory_json, 0) != pdPASS)
-        {
-            free(memory_json);
+        wire_writer_t w;
+        bool ok;
+        if (fmt == CPU_USAGE_FORMAT_DELTA) {
+            ok = delta_encode(t->codec, t->msg, &w, buf, msg->cap);
+        } else {
+            wire_begin_buffer(&w, buf, msg->cap, t->codec->type);
+            t->codec->payload(&w, t->msg);
+            ok = !w.overflow;
         }
+        msg->len = w.len;
+        return ok;
     }
 
+    if (fmt == CPU_USAGE_FORMAT_CBOR)
+    {
+        cbor_writer_t w;
+        cbor_init(&w, buf, msg->cap);
+        t->codec->cbor(&w, t->msg);
+        msg->len = w.len;
+        return !w.overflow;
+    }
+
+    // + 1 for the NUL stream_fill() ends with
+    msg->len = stream_fill(t->codec->json, t->msg, msg->data, msg->cap + 1);
+    return msg->len != 0;
+}
+
+bool cpu_usage_publish_tlm(const tlm_codec_t *codec, const void *msg, TickType_t ticks_to_wait)
+{
+    cpu_usage_tlm_t t = { .codec = codec, .msg = msg };
+    return cpu_usage_fanout(cpu_usage_encode_tlm, &t, codec->type, 0, ticks_to_wait);
+}
+
+// --------------------------------------------------------------------
+// Device info header, lets the host size its per-core views
+// --------------------------------------------------------------------
+void send_device_info(void)
+{
+    tlm_device_t m = {
+        .cores = cpu_usage_core_count(),
+        .cpu_hz = (uint32_t)esp_clk_cpu_freq(),
+        .tag = device_tag,
+    };
+
+    cpu_usage_publish_tlm(&tlm_device_codec, &m, 0);
+}
+
+// --------------------------------------------------------------------
+// Memory usage
+// --------------------------------------------------------------------
+tlm_memory_t cpu_usage_memory(void)
+{
+    return (tlm_memory_t) {
+        // Get total and free heap (all dynamic memory)
+        .heap_total = heap_caps_get_total_size(MALLOC_CAP_DEFAULT),
+        .heap_free = esp_get_free_heap_size(),
+
+        // Internal SRAM only
+        .internal_total = heap_caps_get_total_size(MALLOC_CAP_INTERNAL),
+        .internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+    };
+}
+
+void get_memory_usage()
+{
+    tlm_memory_t m = cpu_usage_memory();
+    cpu_usage_publish_tlm(&tlm_memory_codec, &m, 0);
+}
+
+// --------------------------------------------------------------------
+// Traced ISR time (ns) to FreeRTOS run time counter units
+// --------------------------------------------------------------------
+static uint32_t isr_ns_to_run_time(uint64_t ns)
+{
+    return (uint32_t)((ns * CPU_USAGE_RUN_TIME_HZ) / 1000000000ULL);
 }
 
 // --------------------------------------------------------------------
@@ -134,10 +855,13 @@ void get_memory_usage()
 // --------------------------------------------------------------------
 stats_result_t print_real_time_stats(TickType_t xTicksToWait)
 {
-    stats_result_t result = { .tasks = NULL, .task_count = 0, .status = ESP_OK };
+    stats_result_t result = { .tasks = NULL, .task_count = 0, .core_count = cpu_usage_core_count(), .status = ESP_OK };
     TaskStatus_t *start_array = NULL, *end_array = NULL;
     UBaseType_t start_array_size, end_array_size;
     configRUN_TIME_COUNTER_TYPE start_run_time, end_run_time;
+    int64_t start_us;
+    uint64_t *start_isr = NULL;
+    uint64_t start_core_isr[CPU_USAGE_MAX_CORES];
 
 
     do {
@@ -149,11 +873,25 @@ stats_result_t print_real_time_stats(TickType_t xTicksToWait)
         }
 
         start_array_size = uxTaskGetSystemState(start_array, start_array_size, &start_run_time);
+        start_us = esp_timer_get_time();
         if (start_array_size == 0) {
             result.status = ESP_ERR_INVALID_SIZE;
             break;
         }
 
+        // ISR time already charged to each task, and per core
+        start_isr = malloc(sizeof(uint64_t) * start_array_size);
+        if (!start_isr) {
+            result.status = ESP_ERR_NO_MEM;
+            break;
+        }
+        for (int i = 0; i < start_array_size; i++) {
+            start_isr[i] = ISR_Trace_Task_Ns(start_array[i].xHandle);
+        }
+        for (uint32_t core = 0; core < result.core_count; core++) {
+            start_core_isr[core] = ISR_Trace_Core_Ns(core);
+        }
+
         vTaskDelay(xTicksToWait);
 
         end_array_size = uxTaskGetNumberOfTasks() + ARRAY_SIZE_OFFSET;
@@ -164,23 +902,32 @@ stats_result_t print_real_time_stats(TickType_t xTicksToWait)
         }
 
         end_array_size = uxTaskGetSystemState(end_array, end_array_size, &end_run_time);
+        result.uptime_us = esp_timer_get_time();
+        result.window_us = (uint32_t)(result.uptime_us - start_us);
         if (end_array_size == 0) {
             result.status = ESP_ERR_INVALID_SIZE;
             break;
         }
 
+        // Victim slots of tasks gone by now are free again, before the matching clears the handles
+        ISR_Trace_Keep_Tasks(end_array, end_array_size);
+
         uint32_t total_elapsed_time = (end_run_time - start_run_time);
         if (total_elapsed_time == 0) {
             result.status = ESP_ERR_INVALID_STATE;
             break;
         }
 
-        result.tasks = malloc(sizeof(task_stats_t) * end_array_size * 2);
+        result.tasks = malloc(sizeof(task_stats_t) * (end_array_size * 2 + result.core_count));
         if (!result.tasks) {
             result.status = ESP_ERR_NO_MEM;
             break;
         }
 
+        for (uint32_t core = 0; core < result.core_count; core++) {
+            result.core_load[core] = 100;
+        }
+
         // Match tasks and calculate stats
         for (int i = 0; i < start_array_size; i++) {
             for (int j = 0; j < end_array_size; j++) {
@@ -188,9 +935,26 @@ stats_result_t print_real_time_stats(TickType_t xTicksToWait)
                     task_stats_t t = {0};
                     snprintf(t.task_name, sizeof(t.task_name), "%s", start_array[i].pcTaskName);
                     t.run_time = end_array[j].ulRunTimeCounter - start_array[i].ulRunTimeCounter;
+
+                    // FreeRTOS charges interrupt time to the interrupted task, take it back out
+                    uint64_t isr_ns = ISR_Trace_Task_Ns(end_array[j].xHandle);
+                    if (isr_ns > start_isr[i]) {
+                        t.isr_time = isr_ns_to_run_time(isr_ns - start_isr[i]);
+                        if (t.isr_time > t.run_time) t.isr_time = t.run_time;
+                        t.run_time -= t.isr_time;
+                    }
+
                     t.percentage = (t.run_time * 100UL) /
-                                   (total_elapsed_time * CONFIG_FREERTOS_NUMBER_OF_CORES);
-                    t.core_id = xTaskGetCoreID(end_array[j].xHandle);
+                                   (total_elapsed_time * result.core_count);
+                    t.core_id = cpu_usage_task_core(end_array[j].xHandle);
+
+                    // Core load is everything its idle task did not get
+                    for (uint32_t core = 0; core < result.core_count; core++) {
+                        if (end_array[j].xHandle == xTaskGetIdleTaskHandleForCore(core)) {
+                            uint32_t idle_pct = (t.run_time * 100UL) / total_elapsed_time;
+                            result.core_load[core] = idle_pct > 100 ? 0 : 100 - idle_pct;
+                        }
+                    }
                     result.tasks[result.task_count++] = t;
                     start_array[i].xHandle = NULL;
                     end_array[j].xHandle = NULL;
@@ -199,6 +963,19 @@ stats_result_t print_real_time_stats(TickType_t xTicksToWait)
             }
         }
 
+        // ISR time as its own line item per core
+        for (uint32_t core = 0; core < result.core_count; core++) {
+            uint64_t isr_ns = ISR_Trace_Core_Ns(core) - start_core_isr[core];
+            task_stats_t t = {0};
+            snprintf(t.task_name, sizeof(t.task_name), "ISR");
+            t.isr = true;
+            t.core_id = core;
+            t.run_time = isr_ns_to_run_time(isr_ns);
+            t.percentage = (t.run_time * 100UL) / (total_elapsed_time * result.core_count);
+            result.isr_load[core] = (t.run_time * 100UL) / total_elapsed_time;
+            result.tasks[result.task_count++] = t;
+        }
+
         // Mark deleted and created tasks
         for (int i = 0; i < start_array_size; i++) {
             if (start_array[i].xHandle != NULL) {
@@ -221,78 +998,240 @@ stats_result_t print_real_time_stats(TickType_t xTicksToWait)
 
     if (start_array) free(start_array);
     if (end_array) free(end_array);
+    if (start_isr) free(start_isr);
     return result;
 }
 
 // --------------------------------------------------------------------
-// Generate JSON string from stats result (no cJSON)
+// Stats result as a tasks message, entries are read in place
+// --------------------------------------------------------------------
+static void cpu_usage_get_task(const void *ctx, uint32_t index, tlm_task_t *out)
+{
+    const task_stats_t *t = &((const stats_result_t *)ctx)->tasks[index];
+
+    out->task_name = t->task_name;
+    out->run_time = t->run_time;
+    out->isr_time = t->isr_time;
+    out->percentage = t->percentage;
+    out->core = t->core_id;
+    out->flags = (t->created ? WIRE_TASK_CREATED : 0) |
+                 (t->deleted ? WIRE_TASK_DELETED : 0) |
+                 (t->isr ? WIRE_TASK_ISR : 0);
+}
+
+tlm_tasks_t cpu_usage_tasks_msg(const stats_result_t *res)
+{
+    return (tlm_tasks_t) {
+        .core_count = res->core_count,
+        .task_count = res->task_count,
+        .cores = res->core_load,
+        .isr_load = res->isr_load,
+        .get_tasks = cpu_usage_get_task,
+        .ctx = res,
+    };
+}
+
+// --------------------------------------------------------------------
+// One sampling period: stats result, memory and its place in time
+// --------------------------------------------------------------------
+static tlm_report_t cpu_usage_report_msg(const stats_result_t *res, uint32_t seq, const tlm_memory_t *mem)
+{
+    return (tlm_report_t) {
+        .seq = seq,
+        .uptime_us = res->uptime_us,
+        .window_us = res->window_us,
+        .period_ms = (STATS_TICKS + MEASURING_TICKS) * coalesce * portTICK_PERIOD_MS,
+        .coalesced = coalesce,
+        .core_count = res->core_count,
+        .task_count = res->task_count,
+        .cores = res->core_load,
+        .isr_load = res->isr_load,
+        .get_tasks = cpu_usage_get_task,
+        .heap_total = mem->heap_total,
+        .heap_free = mem->heap_free,
+        .internal_total = mem->internal_total,
+        .internal_free = mem->internal_free,
+        .ctx = res,
+    };
+}
+
+// --------------------------------------------------------------------
+// Generate JSON string from stats result, sized exactly
 // --------------------------------------------------------------------
 char* generate_json_stats(stats_result_t res)
 {
-    // Rough estimate: 100 bytes per task entry
-    size_t buffer_size = res.task_count * 100 + 64;
-    char *json = malloc(buffer_size);
-    if (!json) return NULL;
+    tlm_tasks_t m = cpu_usage_tasks_msg(&res);
+    return stream_alloc(tlm_tasks_codec.json, &m, NULL);
+}
+
+// --------------------------------------------------------------------
+// Report JSON streamed by the task of every plain JSON sink, in its turn
+// after the messages queued before it and any waiting alert. A byte stream
+// (serial line, file) gets it chunk by chunk, so only the chunk buffer is
+// used whatever the number of tasks. A packet sink (MQTT, print_fn) needs
+// the message whole, it gets an exactly sized copy from the heap for the
+// length of its write. The pool buffer holds the period, the task list
+// moves along with it and is freed with the buffer.
+// --------------------------------------------------------------------
+typedef struct {
+    stats_result_t res;
+    tlm_report_t m;             // ctx and the core arrays point into res
+} cpu_usage_stream_t;
+
+_Static_assert(sizeof(cpu_usage_stream_t) <= SINK_BUF_SIZE, "streamed report does not fit a sink buffer");
+
+static bool cpu_usage_text_sink(const sink_t *s)
+{
+    return s->cfg.format == CPU_USAGE_FORMAT_JSON && !s->cfg.compress;
+}
 
-    size_t offset = 0;
-    offset += snprintf(json + offset, buffer_size - offset, "{ \"tasks\": [ ");
+static void cpu_usage_sink_flush(void *ctx, const char *data, size_t len)
+{
+    sink_t *s = ctx;
+    s->cfg.write(s->cfg.ctx, data, len);
+}
 
-    for (size_t i = 0; i < res.task_count; i++) {
-        const task_stats_t *t = &res.tasks[i];
-        if (t->created)
-            offset += snprintf(json + offset, buffer_size - offset,
-                "    {\"task_name\": \"%s\", \"status\": \"created\"}%s",
-                t->task_name, (i < res.task_count - 1) ? "," : "");
-        else if (t->deleted)
-            offset += snprintf(json + offset, buffer_size - offset,
-                "    {\"task_name\": \"%s\", \"status\": \"deleted\"}%s",
-                t->task_name, (i < res.task_count - 1) ? "," : "");
-        else
-            offset += snprintf(json + offset, buffer_size - offset,
-                "    {\"task_name\": \"%s\", \"run_time\": %" PRIu32 ", \"percentage\": %" PRIu32 ", \"core\": %d}%s",
-                t->task_name, t->run_time, t->percentage, t->core_id,
-                (i < res.task_count - 1) ? "," : "");
+static size_t cpu_usage_stream_write(sink_t *s, sink_buf_t *b)
+{
+    cpu_usage_stream_t *r = (cpu_usage_stream_t *)b->data;
+    stream_writer_t w;
+    size_t bytes;
+
+    if (s->cfg.packets)
+    {
+        char *json = stream_alloc(tlm_report_codec.json, &r->m, &bytes);
+        if (json == NULL)
+        {
+            cpu_usage_drop_alert(1u << (s - sink_get(0)), WIRE_MSG_REPORT, ESP_ERR_NO_MEM);
+            return 0;
+        }
+        s->cfg.write(s->cfg.ctx, json, bytes);
+        free(json);
+        return bytes;
     }
 
-    offset += snprintf(json + offset, buffer_size - offset, " ] }");
-    return json;
+    // The serial link is held for the whole line, no link frame gets into it
+    bool serial = s->cfg.write == cpu_usage_serial_sink;
+    if (serial) {
+        xSemaphoreTake(serial_lock, portMAX_DELAY);
+    }
+    stream_init(&w, serial ? cpu_usage_serial_flush : cpu_usage_sink_flush, s);
+    tlm_report_codec.json(&w, &r->m);
+    stream_puts(&w, "\n");
+    bytes = stream_end(&w);
+    if (serial) {
+        xSemaphoreGive(serial_lock);
+    }
+    return bytes;
+}
+
+static void cpu_usage_stream_release(sink_buf_t *b)
+{
+    cpu_usage_stream_t *r = (cpu_usage_stream_t *)b->data;
+    free(r->res.tasks);
+}
+
+// Queue the report on the sinks in mask like any other message. Takes
+// res->tasks along (NULL after) if there was a buffer for it. Its length
+// is counted once here, for the rate limits and the link budget.
+static void cpu_usage_stream_report(stats_result_t *res, uint32_t seq, const tlm_memory_t *mem,
+                                    uint32_t mask, TickType_t ticks_to_wait)
+{
+    sink_buf_t *b = mask ? sink_buf_get(false) : NULL;
+
+    if (b)
+    {
+        cpu_usage_stream_t *r = (cpu_usage_stream_t *)b->data;
+        stream_writer_t w;
+        r->res = *res;
+        res->tasks = NULL;
+        r->m = cpu_usage_report_msg(&r->res, seq, mem);
+        stream_init(&w, NULL, NULL);
+        tlm_report_codec.json(&w, &r->m);
+        b->len = stream_end(&w) + 1;
+        b->stream = cpu_usage_stream_write;
+        b->release = cpu_usage_stream_release;
+        b->queued = xTaskGetTickCount();
+    }
+
+    // Only the serial link waits, as it does for the other messages
+    for (size_t i = 0; i < sink_count(); i++)
+    {
+        if (mask & (1u << i)) {
+            cpu_usage_offer(i, b, WIRE_MSG_REPORT, i == SERIAL_SINK ? ticks_to_wait : 0, false);
+        }
+    }
+    sink_buf_put(b);
 }
 
 // --------------------------------------------------------------------
-// Task that handle the uart
+// Link-aware report rate, once per report. A loaded sink that overflowed
+// its queue or spent most of the period in write makes the next window twice
+// as long: the report then covers (averages) several base periods and the
+// link carries half as many. Once every sink is mostly idle again for a
+// few reports the window is halved. A sink that wrote nothing at all is
+// stalled (MQTT without Wi-Fi), not slow, and is left to its drop policy;
+// drops from its own rate limit do not count either.
 // --------------------------------------------------------------------
-void uart_print_task(void *custom_user_printf)
+static void cpu_usage_adapt_rate(void)
 {
-    
-    char *received_json = NULL;
-    
-    while(1)
+    TickType_t now = xTaskGetTickCount();
+    TickType_t elapsed = now - link_tick;
+    bool busy = false;
+    bool idle = true;
+
+    if (elapsed == 0) {
+        return;
+    }
+    link_tick = now;
+
+    for (size_t i = 0; i < sink_count(); i++)
     {
-        // Wait until something arrives in the queue
-        if (xQueueReceive(jsonQueue, &received_json, portMAX_DELAY) == pdPASS)
-        {            
+        sink_t *s = sink_get(i);
+        cpu_usage_link_t *l = &links[i];
+        uint32_t sent = s->sent - l->sent;
+        uint32_t overflow = s->overflow - l->overflow;
+        uint32_t bytes = s->bytes - l->bytes;
+        TickType_t spent = s->busy - l->busy;
 
-            if (custom_user_printf == NULL)
-            {
-                printf("%s\n", received_json);
-            }
-            else
-            {     
-                // Print the received JSON using the user-defined function
-                ((void (*)(char *))custom_user_printf)(received_json);
-            }
+        l->sent = s->sent;
+        l->overflow = s->overflow;
+        l->bytes = s->bytes;
+        l->busy = s->busy;
+        l->throughput = (uint32_t)((uint64_t)bytes * configTICK_RATE_HZ / elapsed);
+        l->busy_pct = spent >= elapsed ? 100 : (uint8_t)(spent * 100 / elapsed);
 
-            if (AWSQueue)
-            {
-                if (xQueueSend(AWSQueue, &received_json, 0) == pdPASS) {}
-                else
-                {
-                    free(received_json);
-                }
-            }
+        if (sent == 0) {
+            continue;
+        }
+        // An overflow while the sink is mostly idle is a burst deeper than
+        // its queue, a longer period would not help
+        if (l->busy_pct > LINK_BUSY_PCT || (overflow > 0 && l->busy_pct >= LINK_IDLE_PCT)) {
+            busy = true;
+        }
+        if (overflow > 0 || l->busy_pct >= LINK_IDLE_PCT) {
+            idle = false;
+        }
+    }
 
+    if (busy)
+    {
+        idle_reports = 0;
+        if (coalesce < CPU_USAGE_MAX_COALESCE) {
+            coalesce *= 2;
+        }
+    }
+    else if (idle && coalesce > 1)
+    {
+        if (++idle_reports >= LINK_RESTORE_REPORTS) {
+            idle_reports = 0;
+            coalesce /= 2;
         }
     }
+    else
+    {
+        idle_reports = 0;
+    }
 }
 
 // --------------------------------------------------------------------
@@ -312,6 +1251,53 @@ void spin_task(void *arg)
 // --------------------------------------------------------------------
 // Task that collects and prints stats as JSON
 // --------------------------------------------------------------------
+// One report: the stats of STATS_TICKS * coalesce ticks out to every sink
+static void stats_period(uint32_t seq)
+{
+    if (seq % DEVICE_INFO_PERIOD == 0) {
+        send_device_info();
+        if (seq > 0) {
+            link_send_budget();
+        }
+    }
+
+    // One window of coalesce base periods, so a widened report is the
+    // average over all of them rather than a sample of one
+    stats_result_t res = print_real_time_stats(STATS_TICKS * coalesce);
+    tlm_memory_t mem = cpu_usage_memory();
+    postmortem_record_stats(&res, mem.heap_free);
+
+    if (res.status != ESP_OK)
+    {
+        const char *err_str = esp_err_to_name(res.status);
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer),
+                 "{ \"error\": \"stats collection failed\", \"code\": \"%s\" }",
+                 err_str);
+        
+        cpu_usage_alert_json(buffer);
+        
+    } 
+    else 
+    {
+        // Tasks and memory of the period go out as one report, streamed to
+        // the plain JSON sinks and encoded into a pool buffer for the others.
+        tlm_report_t m = cpu_usage_report_msg(&res, seq, &mem);
+        cpu_usage_tlm_t t = { .codec = &tlm_report_codec, .msg = &m };
+        uint32_t text = 0;
+        for (size_t i = 0; i < sink_count(); i++) {
+            text |= (uint32_t)cpu_usage_text_sink(sink_get(i)) << i;
+        }
+        // A report dropped by a full queue shows as a gap in seq on the
+        // host. An alert about it would only add to the load of the link
+        // that dropped it, only one too large for a sink gets one.
+        cpu_usage_fanout(cpu_usage_encode_tlm, &t, WIRE_MSG_REPORT, text, 0);
+        cpu_usage_stream_report(&res, seq, &mem, text, STATS_TICKS);
+    }
+
+    if (res.tasks) free(res.tasks);
+}
+
 void stats_task(void *arg)
 {
     xSemaphoreTake(sync_stats_task, portMAX_DELAY);
@@ -323,61 +1309,12 @@ void stats_task(void *arg)
         }
     #endif
 
-    while (1) {
-        // printf("\nCollecting real-time stats...\n");
-        stats_result_t res = print_real_time_stats(STATS_TICKS);
-        get_memory_usage();
+    uint32_t seq = 0;       // one per period, the host counts gaps as lost reports
 
-        if (res.status != ESP_OK)
-        {
-            const char *err_str = esp_err_to_name(res.status);
-            char buffer[128];
-            snprintf(buffer, sizeof(buffer),
-                     "{ \"error\": \"stats collection failed\", \"code\": \"%s\" }",
-                     err_str);
-            
-            
-            char *err_json = strdup(buffer);
-            if (err_json) {
-                if (xQueueSend(jsonQueue, &err_json, 0) != pdPASS)
-                {
-                    free(err_json);
-                }
-            }
-            
-        } 
-        else 
-        {
-            char *json = generate_json_stats(res);
-            if (json) {
-                
-                if (xQueueSend(jsonQueue, &json, 0) != pdPASS) {
-
-                    char *err_json = strdup("{ \"error\": \"JSON queue full, dropping message\" }");
-                    if (err_json)
-                    {
-                        if (xQueueSend(jsonQueue, &err_json, 0) != pdPASS)
-                        {
-                            free(err_json);
-                        }
-                    }
-                }
-
-            }
-            else
-            {
-                char *err_json = strdup("{ \"error\": \"Not enough memory to build JSON\" }");
-                if (err_json)
-                {
-                    if (xQueueSend(jsonQueue, &err_json, 0) != pdPASS)
-                    {
-                        free(err_json);
-                    }
-                }
-            }
-        }
-
-        if (res.tasks) free(res.tasks);
-        vTaskDelay(MEASURING_TICKS);
+    while (1) {
+        stats_period(seq);
+        seq++;
+        cpu_usage_adapt_rate();
+        vTaskDelay(MEASURING_TICKS * coalesce);
     }
 }
\ No newline at end of file
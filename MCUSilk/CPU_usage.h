@@ -12,6 +12,8 @@
 
 
 #include "isr_trace.h"
+#include "telemetry.h"
+#include "flashlog.h"
 
 
 // --------------------------------------------------------------------
@@ -21,10 +23,22 @@
 #define SPIN_TASK_PRIO          2
 #define STATS_TASK_PRIO         5
 #define ISR_UART_PRINT_PRIO     2
-#define UART_PRINT_TASK_PRIO    2
+#define SINK_TASK_PRIO          2
+#define TRIGGER_TASK_PRIO       5
+#define LINK_TASK_PRIO          3
 
 #define ARRAY_SIZE_OFFSET       5
 
+// Upper bound for the per-core arrays, the real count is cpu_usage_core_count()
+#if defined(configNUMBER_OF_CORES)
+    #define CPU_USAGE_MAX_CORES configNUMBER_OF_CORES
+#else
+    #define CPU_USAGE_MAX_CORES portNUM_PROCESSORS
+#endif
+
+// Core the monitor tasks are pinned to: the last one, core 0 on single-core builds
+#define CPU_USAGE_TASK_CORE     (CPU_USAGE_MAX_CORES - 1)
+
 // Changable
 #define NUM_OF_SPIN_TASKS   3
 #define SPIN_ITER           500000   // CPU cycles per spin task
@@ -32,6 +46,39 @@
 #define MEASURING_TICKS     pdMS_TO_TICKS(2000)
 #define CPU_LOAD            1
 
+// Clock of the FreeRTOS run time counter, used to convert ISR cycles to run time units
+#if CONFIG_FREERTOS_RUN_TIME_STATS_USING_CPU_CLK
+    #define CPU_USAGE_RUN_TIME_HZ   ((uint32_t)esp_clk_cpu_freq())
+#else
+    #define CPU_USAGE_RUN_TIME_HZ   1000000UL   // esp_timer, 1 us
+#endif
+#define DEVICE_INFO_PERIOD  10      // re-send the device header every N reports
+
+// Link-aware report rate: a sink that drops or is busy writing for more than
+// LINK_BUSY_PCT of the time widens the report window (x2, up to
+// CPU_USAGE_MAX_COALESCE base periods). It narrows again once every sink
+// stays under LINK_IDLE_PCT for LINK_RESTORE_REPORTS reports in a row.
+#define CPU_USAGE_MAX_COALESCE  8
+#define LINK_BUSY_PCT           80
+#define LINK_IDLE_PCT           30
+#define LINK_RESTORE_REPORTS    3
+
+// Sinks, see sink.h. A message that does not fit CPU_USAGE_MSG_MAX once
+// encoded and framed is dropped, with an alert the first time per sink.
+// The report is streamed to plain JSON sinks and has no such limit there.
+#ifndef CPU_USAGE_MSG_MAX
+    #define CPU_USAGE_MSG_MAX   4096
+#endif
+#define CPU_USAGE_MAX_SINKS     4
+#define CPU_USAGE_SINK_DEPTH    3       // messages waiting per sink unless the sink sets its own
+#define CPU_USAGE_ALERT_DEPTH   1       // alert slots per sink, reserved next to the bulk queue
+#define CPU_USAGE_SINK_STACK    4096
+
+// Console UART driver buffers, used when there is no write_fn. A TX ring of
+// 0 keeps the blocking console writes.
+#define SERIAL_TX_RING_SIZE 4096
+#define SERIAL_RX_BUF_SIZE  512     // more than the 128 byte FIFO, and a whole link test frame (link.h)
+
 
 // --------------------------------------------------------------------
 // Extern globals (shared semaphores and task names)
@@ -39,7 +86,6 @@
 extern SemaphoreHandle_t sync_spin_task;
 extern SemaphoreHandle_t sync_stats_task;
 extern char task_names[NUM_OF_SPIN_TASKS][16];
-extern QueueHandle_t jsonQueue, ISRQueue;
 
 // --------------------------------------------------------------------
 // Structs
@@ -48,22 +94,103 @@ typedef struct {
     char task_name[16];
     uint32_t run_time;
     uint32_t percentage;
+    uint32_t isr_time;          // interrupt time removed from run_time
     bool created;
     bool deleted;
+    bool isr;                   // per-core ISR line item, not a task
     int core_id;
 } task_stats_t;
 
 typedef struct {
     task_stats_t *tasks;
     size_t task_count;
+    uint32_t core_count;
+    uint32_t core_load[CPU_USAGE_MAX_CORES];   // 100 - idle % of each core, ISRs included
+    uint32_t isr_load[CPU_USAGE_MAX_CORES];    // traced ISR % of each core
+    uint64_t uptime_us;                         // end of the window
+    uint32_t window_us;                         // measured length of the window
     esp_err_t status;
 } stats_result_t;
 
+typedef enum {
+    CPU_USAGE_FORMAT_JSON = 0,      // one JSON object per line
+    CPU_USAGE_FORMAT_BINARY,        // COBS framed binary records, see wire.h (serial only)
+    CPU_USAGE_FORMAT_CBOR,          // CBOR maps with the JSON keys, COBS framed on serial
+    CPU_USAGE_FORMAT_DELTA,         // binary, varint deltas against the previous report, see delta.h (serial only)
+} cpu_usage_format_t;
+
+// One message being encoded into a sink buffer (sink.h). JSON is text,
+// serial frames are COBS strings (no zero inside), CBOR for AWS is raw bytes.
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;                 // room in data for the encoder
+} cpu_usage_msg_t;
+
+// Encode ctx in fmt into msg->data, BINARY and DELTA as a raw frame (see
+// wire_begin_buffer). Returns false if fmt is not supported by this message
+// (it is then sent as JSON) or it does not fit msg->cap.
+typedef bool (*cpu_usage_encode_fn)(const void *ctx, cpu_usage_format_t fmt, cpu_usage_msg_t *msg);
+
+// A schema message and its generated codec, see telemetry.h
+typedef struct {
+    const tlm_codec_t *codec;
+    const void *msg;
+} cpu_usage_tlm_t;
+
+// What a sink does when its queue is full
+typedef enum {
+    CPU_USAGE_DROP_NEWEST = 0,      // drop the new message
+    CPU_USAGE_DROP_OLDEST,          // drop the oldest queued one to make room
+    CPU_USAGE_BLOCK,                // let the publisher wait up to its ticks_to_wait
+} cpu_usage_drop_t;
+
+// --------------------------------------------------------------------
+// An output of the monitor. Each sink has its own queue and task, so a
+// slow one (Wi-Fi) only ever drops its own messages. Sinks with the same
+// format, compress and packets share one encoded buffer.
+// --------------------------------------------------------------------
+typedef struct {
+    const char *name;                   // task name
+    cpu_usage_format_t format;          // BINARY / DELTA only on stream sinks
+    bool compress;                      // LZ for JSON / CBOR, see lz.h
+    bool packets;                       // the transport keeps message boundaries (MQTT, print_fn):
+                                        // no COBS framing, no line ends, NUL terminated text
+    void (*write)(void *ctx, const char *data, size_t len);    // from the sink task, may block
+    void *ctx;
+    uint8_t depth;                      // queued messages, 0 = CPU_USAGE_SINK_DEPTH
+    uint32_t rate;                      // bytes per second, 0 = no limit
+    cpu_usage_drop_t drop;
+} cpu_usage_sink_cfg_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t dropped;                   // queue full, over the rate or too large
+    uint32_t queued;
+    uint32_t bytes;
+    uint32_t throughput;                // bytes per second over the last report period
+    uint8_t busy_pct;                   // share of that period spent writing
+    uint32_t alerts;                    // alerts written
+    uint32_t alerts_dropped;            // replaced by a newer one in a full lane, or not encoded
+    uint32_t alert_wait_avg_ms;         // from publish to write
+    uint32_t alert_wait_max_ms;
+} cpu_usage_sink_stats_t;
+
 // our struct type
 typedef struct {
     const char *tag;
     void (*print_fn)(char *msg);
     bool enable_AWS_upload;
+    cpu_usage_format_t format;          // serial link
+    cpu_usage_format_t aws_format;      // JSON or CBOR
+    void (*write_fn)(const uint8_t *data, size_t len);  // raw serial output, NULL = console UART
+    bool compress;                      // LZ compress JSON / CBOR on the serial link, see lz.h
+    bool aws_compress;                  // same for MQTT
+    const cpu_usage_sink_cfg_t *sinks;  // more sinks (file, callbacks), after serial and MQTT
+    size_t sink_count;
+    flashlog_t *flash_log;              // opened log to keep binary frames in, NULL = none
+    uint32_t log_retention_s;           // history the log should hold, 0 = as much as it is sent
+    size_t sink_pool;                   // message buffers shared by the sinks, 0 = every queue full at once
 } cpu_usage_cfg_t;
 
 
@@ -76,8 +203,29 @@ void stats_task(void *arg);
 
 stats_result_t print_real_time_stats(TickType_t xTicksToWait);
 char* generate_json_stats(stats_result_t res);
+cpu_usage_format_t cpu_usage_output_format(void);
+bool cpu_usage_publish(cpu_usage_encode_fn encode, const void *ctx, TickType_t ticks_to_wait);
+bool cpu_usage_publish_tlm(const tlm_codec_t *codec, const void *msg, TickType_t ticks_to_wait);
+bool cpu_usage_queue_json(const char *json, TickType_t ticks_to_wait);
+bool cpu_usage_alert_json(const char *json);
 void CPU_usage_start(const cpu_usage_cfg_t *cfg);
-void uart_print_task(void *arg);
+bool cpu_usage_sink_stats(size_t index, cpu_usage_sink_stats_t *stats);
+void cpu_usage_file_sink(void *file, const char *data, size_t len);
 void get_memory_usage();
+uint32_t cpu_usage_core_count(void);
+uint32_t cpu_usage_coalesce(void);
+int cpu_usage_task_core(TaskHandle_t task);
+void send_device_info(void);
+tlm_memory_t cpu_usage_memory(void);
+tlm_tasks_t cpu_usage_tasks_msg(const stats_result_t *res);
+
+// Serial link control for link.c, under the same lock as the serial sink
+void cpu_usage_serial_raw(const char *data, size_t len);
+void cpu_usage_serial_hold(bool hold);
+bool cpu_usage_serial_baud(uint32_t baud, const char *last, size_t len);
+
+// The flash log for a dump (query.c), appends wait until it is unlocked. NULL if there is none.
+flashlog_t *cpu_usage_log_lock(void);
+void cpu_usage_log_unlock(void);
 
 
@@ -0,0 +1,121 @@
+#include <string.h>
+#include "cbor.h"
+
+
+#define CBOR_MAJOR_UINT     0
+#define CBOR_MAJOR_NINT     1
+#define CBOR_MAJOR_TEXT     3
+#define CBOR_MAJOR_ARRAY    4
+#define CBOR_MAJOR_MAP      5
+#define CBOR_SIMPLE_FALSE   0xF4
+#define CBOR_SIMPLE_TRUE    0xF5
+
+
+void cbor_init(cbor_writer_t *w, uint8_t *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = false;
+}
+
+static void cbor_put_raw(cbor_writer_t *w, const void *data, size_t len)
+{
+    if (w->buf == NULL) {
+        w->len += len;      // sizing pass
+        return;
+    }
+    if (w->overflow || w->len + len > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+// Initial byte plus the shortest big-endian argument
+static void cbor_put_head(cbor_writer_t *w, uint8_t major, uint64_t v)
+{
+    uint8_t head[9];
+    size_t len;
+
+    major <<= 5;
+    if (v < 24) {
+        head[0] = major | (uint8_t)v;
+        len = 1;
+    } else if (v <= UINT8_MAX) {
+        head[0] = major | 24;
+        head[1] = (uint8_t)v;
+        len = 2;
+    } else if (v <= UINT16_MAX) {
+        head[0] = major | 25;
+        head[1] = (uint8_t)(v >> 8);
+        head[2] = (uint8_t)v;
+        len = 3;
+    } else if (v <= UINT32_MAX) {
+        head[0] = major | 26;
+        for (int i = 0; i < 4; i++) head[1 + i] = (uint8_t)(v >> (24 - 8 * i));
+        len = 5;
+    } else {
+        head[0] = major | 27;
+        for (int i = 0; i < 8; i++) head[1 + i] = (uint8_t)(v >> (56 - 8 * i));
+        len = 9;
+    }
+
+    cbor_put_raw(w, head, len);
+}
+
+void cbor_put_uint(cbor_writer_t *w, uint64_t v)
+{
+    cbor_put_head(w, CBOR_MAJOR_UINT, v);
+}
+
+void cbor_put_int(cbor_writer_t *w, int64_t v)
+{
+    if (v < 0) {
+        cbor_put_head(w, CBOR_MAJOR_NINT, (uint64_t)(-1 - v));
+    } else {
+        cbor_put_head(w, CBOR_MAJOR_UINT, (uint64_t)v);
+    }
+}
+
+void cbor_put_bool(cbor_writer_t *w, bool v)
+{
+    uint8_t b = v ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE;
+    cbor_put_raw(w, &b, 1);
+}
+
+void cbor_put_text(cbor_writer_t *w, const char *s)
+{
+    size_t len = s ? strlen(s) : 0;
+    cbor_put_head(w, CBOR_MAJOR_TEXT, len);
+    cbor_put_raw(w, s, len);
+}
+
+void cbor_put_array(cbor_writer_t *w, size_t count)
+{
+    cbor_put_head(w, CBOR_MAJOR_ARRAY, count);
+}
+
+void cbor_put_map(cbor_writer_t *w, size_t count)
+{
+    cbor_put_head(w, CBOR_MAJOR_MAP, count);
+}
+
+void cbor_put_key_uint(cbor_writer_t *w, const char *key, uint64_t v)
+{
+    cbor_put_text(w, key);
+    cbor_put_uint(w, v);
+}
+
+void cbor_put_key_int(cbor_writer_t *w, const char *key, int64_t v)
+{
+    cbor_put_text(w, key);
+    cbor_put_int(w, v);
+}
+
+void cbor_put_key_text(cbor_writer_t *w, const char *key, const char *s)
+{
+    cbor_put_text(w, key);
+    cbor_put_text(w, s);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// --------------------------------------------------------------------
+// Minimal CBOR (RFC 8949) encoder into a caller supplied buffer.
+// No allocation, no floats. Maps and arrays are definite length, so the
+// caller passes the number of entries up front. With a NULL buffer the
+// writer only counts, len is then the size of the encoded message.
+// --------------------------------------------------------------------
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;              // set once anything did not fit, the rest is skipped
+} cbor_writer_t;
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+void cbor_init(cbor_writer_t *w, uint8_t *buf, size_t cap);
+void cbor_put_uint(cbor_writer_t *w, uint64_t v);
+void cbor_put_int(cbor_writer_t *w, int64_t v);
+void cbor_put_bool(cbor_writer_t *w, bool v);
+void cbor_put_text(cbor_writer_t *w, const char *s);
+void cbor_put_array(cbor_writer_t *w, size_t count);
+void cbor_put_map(cbor_writer_t *w, size_t count);
+
+// key / value helpers for the common map entries
+void cbor_put_key_uint(cbor_writer_t *w, const char *key, uint64_t v);
+void cbor_put_key_int(cbor_writer_t *w, const char *key, int64_t v);
+void cbor_put_key_text(cbor_writer_t *w, const char *key, const char *s);
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include "delta.h"
+
+
+#define DELTA_TYPES     16      // wire_msg_type_t values that can have a delta
+
+typedef struct {
+    uint32_t *prev;             // integers of the last report sent
+    uint32_t *cur;
+    size_t count;
+    size_t cap;
+    uint32_t shape;
+    uint32_t since_key;
+    bool valid;
+} delta_state_t;
+
+static delta_state_t delta_state[DELTA_TYPES];
+
+
+// Next report of every type is a keyframe
+void delta_reset(void)
+{
+    for (int i = 0; i < DELTA_TYPES; i++) {
+        delta_state[i].valid = false;
+    }
+}
+
+static uint32_t delta_zigzag(int32_t v)
+{
+    return v < 0 ? ~((uint32_t)v << 1) : (uint32_t)v << 1;
+}
+
+// --------------------------------------------------------------------
+// Integers of msg into st->cur, growing both buffers when it has more
+// fields than any report of its type before
+// --------------------------------------------------------------------
+static bool delta_collect(delta_state_t *st, const tlm_codec_t *codec, const void *msg, wire_writer_t *v)
+{
+    wire_begin_values(v, st->cur, st->cap);
+    codec->payload(v, msg);
+    if (!v->overflow) {
+        return true;
+    }
+
+    size_t cap = v->len;
+    uint32_t *cur = realloc(st->cur, cap * sizeof(uint32_t));
+    if (cur == NULL) {
+        return false;
+    }
+    st->cur = cur;
+
+    uint32_t *prev = realloc(st->prev, cap * sizeof(uint32_t));
+    if (prev == NULL) {
+        return false;
+    }
+    st->prev = prev;
+    st->cap = cap;
+
+    wire_begin_values(v, st->cur, st->cap);
+    codec->payload(v, msg);
+    return !v->overflow;
+}
+
+// The normal binary frame
+static bool delta_keyframe(const tlm_codec_t *codec, const void *msg, wire_writer_t *w, uint8_t *buf, size_t cap)
+{
+    wire_begin_buffer(w, buf, cap, codec->type);
+    codec->payload(w, msg);
+    return !w->overflow;
+}
+
+static void delta_frame(wire_writer_t *w, wire_msg_type_t type, const delta_state_t *st, size_t count)
+{
+    uint16_t ref = 0xFFFF;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t p = st->prev[i];
+        uint8_t le[4] = { (uint8_t)p, (uint8_t)(p >> 8), (uint8_t)(p >> 16), (uint8_t)(p >> 24) };
+        ref = wire_crc16_update(ref, le, sizeof(le));
+    }
+
+    wire_put_u8(w, (uint8_t)type);
+    wire_put_u16(w, ref);
+    for (size_t i = 0; i < count; i++) {
+        wire_put_varint(w, delta_zigzag((int32_t)(st->cur[i] - st->prev[i])));
+    }
+}
+
+// --------------------------------------------------------------------
+// Raw delta or key frame of msg into buf (see wire_begin_buffer), false if
+// it does not fit or on no memory. The state only moves on once a frame
+// is built, a frame that is built but then dropped is found by the host
+// through the CRC.
+// --------------------------------------------------------------------
+bool delta_encode(const tlm_codec_t *codec, const void *msg, wire_writer_t *w, uint8_t *buf, size_t cap)
+{
+    if (codec->type >= DELTA_TYPES) {
+        return delta_keyframe(codec, msg, w, buf, cap);
+    }
+
+    delta_state_t *st = &delta_state[codec->type];
+    wire_writer_t v;
+
+    if (!delta_collect(st, codec, msg, &v)) {
+        st->valid = false;
+        return delta_keyframe(codec, msg, w, buf, cap);
+    }
+
+    bool key = !st->valid ||
+               st->since_key + 1 >= DELTA_KEYFRAME_PERIOD ||
+               v.len != st->count ||
+               v.shape != st->shape;
+
+    if (key) {
+        if (!delta_keyframe(codec, msg, w, buf, cap)) {
+            return false;
+        }
+    } else {
+        wire_begin_buffer(w, buf, cap, WIRE_MSG_DELTA);
+        delta_frame(w, codec->type, st, v.len);
+        if (w->overflow) {
+            return false;
+        }
+    }
+
+    uint32_t *sent = st->cur;
+    st->cur = st->prev;
+    st->prev = sent;
+    st->count = v.len;
+    st->shape = v.shape;
+    st->since_key = key ? 0 : st->since_key + 1;
+    st->valid = true;
+    return true;
+}
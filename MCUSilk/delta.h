@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry.h"
+
+
+// --------------------------------------------------------------------
+// Delta encoding (CPU_USAGE_FORMAT_DELTA)
+// --------------------------------------------------------------------
+//
+// Run times, loads and heap figures change little from one report to the
+// next. A report of the same shape as the previous one of its type (same
+// counts and names) is sent as a WIRE_MSG_DELTA frame: the zig-zag varint
+// of the change of every integer field, mostly one byte each. Anything
+// else, and every DELTA_KEYFRAME_PERIOD-th report, goes out as the normal
+// binary frame (keyframe).
+//
+// The delta carries the CRC-16 of the integers it applies to. A host that
+// lost a frame sees the mismatch and skips deltas until the next keyframe.
+//
+// State is kept per message type, so each type must be encoded from one
+// task only (stats_task: device, report; ISR print task: isr, wakeup).
+//
+#define DELTA_KEYFRAME_PERIOD   10      // a keyframe at least every N reports of a type
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+bool delta_encode(const tlm_codec_t *codec, const void *msg, wire_writer_t *w, uint8_t *buf, size_t cap);
+void delta_reset(void);
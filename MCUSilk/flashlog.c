@@ -0,0 +1,353 @@
+#include <string.h>
+#include "flashlog.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#endif
+
+
+static uint32_t flashlog_addr(const flashlog_t *log, uint32_t sector, uint32_t offset)
+{
+    return sector * log->backend.sector_size + offset;
+}
+
+// Sequence number of a formatted sector, 0 if it is not one
+static uint32_t flashlog_sector_seq(const flashlog_t *log, uint32_t sector)
+{
+    uint8_t h[FLASHLOG_HEADER];
+
+    if (!log->backend.read(log->backend.ctx, flashlog_addr(log, sector, 0), h, sizeof(h))) {
+        return 0;
+    }
+
+    uint32_t magic = (uint32_t)h[0] | (uint32_t)h[1] << 8 | (uint32_t)h[2] << 16 | (uint32_t)h[3] << 24;
+    uint32_t seq = (uint32_t)h[4] | (uint32_t)h[5] << 8 | (uint32_t)h[6] << 16 | (uint32_t)h[7] << 24;
+
+    return magic == FLASHLOG_MAGIC && seq != 0xFFFFFFFF ? seq : 0;
+}
+
+// Length field of the record at offset, FLASHLOG_ERASED_LEN past the last one
+static uint32_t flashlog_record_len(const flashlog_t *log, uint32_t sector, uint32_t offset)
+{
+    uint8_t l[2];
+
+    if (offset + sizeof(l) > log->backend.sector_size ||
+        !log->backend.read(log->backend.ctx, flashlog_addr(log, sector, offset), l, sizeof(l))) {
+        return FLASHLOG_ERASED_LEN;
+    }
+    return (uint32_t)l[0] | (uint32_t)l[1] << 8;
+}
+
+// Erase a sector and make it the head
+static bool flashlog_start_sector(flashlog_t *log, uint32_t sector, uint32_t seq)
+{
+    uint8_t h[FLASHLOG_HEADER] = {
+        FLASHLOG_MAGIC & 0xFF, (FLASHLOG_MAGIC >> 8) & 0xFF,
+        (FLASHLOG_MAGIC >> 16) & 0xFF, FLASHLOG_MAGIC >> 24,
+        seq & 0xFF, (seq >> 8) & 0xFF, (seq >> 16) & 0xFF, seq >> 24,
+    };
+    uint32_t addr = flashlog_addr(log, sector, 0);
+
+    if (!log->backend.erase(log->backend.ctx, addr, log->backend.sector_size) ||
+        !log->backend.write(log->backend.ctx, addr, h, sizeof(h))) {
+        return false;
+    }
+
+    log->head = sector;
+    log->head_seq = seq;
+    log->offset = FLASHLOG_HEADER;
+    return true;
+}
+
+bool flashlog_open(flashlog_t *log, const flashlog_backend_t *backend)
+{
+    memset(log, 0, sizeof(*log));
+    log->backend = *backend;
+
+    if (backend->sector_size <= FLASHLOG_HEADER + 2 || backend->size % backend->sector_size) {
+        return false;
+    }
+    log->sectors = backend->size / backend->sector_size;
+    if (log->sectors < 2) {
+        return false;
+    }
+
+    // The head is the newest sector
+    bool found = false;
+    for (uint32_t s = 0; s < log->sectors; s++)
+    {
+        uint32_t seq = flashlog_sector_seq(log, s);
+        if (seq != 0 && (!found || (int32_t)(seq - log->head_seq) > 0))
+        {
+            log->head = s;
+            log->head_seq = seq;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return flashlog_start_sector(log, 0, 1);
+    }
+
+    // Its free space starts after the last record. A length past the end
+    // was cut short by a reset, the sector counts as full.
+    log->offset = FLASHLOG_HEADER;
+    uint32_t len;
+    while ((len = flashlog_record_len(log, log->head, log->offset)) != FLASHLOG_ERASED_LEN) {
+        log->offset += 2 + len;
+    }
+    if (log->offset > backend->sector_size) {
+        log->offset = backend->sector_size;
+    }
+    return true;
+}
+
+size_t flashlog_record_max(const flashlog_t *log)
+{
+    size_t max = log->backend.sector_size - FLASHLOG_HEADER - 2;
+    return max < FLASHLOG_ERASED_LEN ? max : FLASHLOG_ERASED_LEN - 1;
+}
+
+uint32_t flashlog_capacity(const flashlog_t *log)
+{
+    return (log->sectors - 1) * (log->backend.sector_size - FLASHLOG_HEADER);
+}
+
+bool flashlog_append(flashlog_t *log, const void *data, size_t len)
+{
+    if (len == 0 || len > flashlog_record_max(log)) {
+        return false;
+    }
+
+    if (log->offset + 2 + len > log->backend.sector_size &&
+        !flashlog_start_sector(log, (log->head + 1) % log->sectors, log->head_seq + 1))
+    {
+        log->failed++;
+        return false;
+    }
+
+    // Length first: whatever happens to the data, the next record lands after it
+    uint8_t l[2] = { len & 0xFF, len >> 8 };
+    uint32_t addr = flashlog_addr(log, log->head, log->offset);
+    log->offset += 2 + len;
+
+    if (!log->backend.write(log->backend.ctx, addr, l, sizeof(l)) ||
+        !log->backend.write(log->backend.ctx, addr + 2, data, len))
+    {
+        log->failed++;
+        return false;
+    }
+
+    log->appended++;
+    return true;
+}
+
+bool flashlog_clear(flashlog_t *log)
+{
+    if (!log->backend.erase(log->backend.ctx, 0, log->backend.size)) {
+        return false;
+    }
+    return flashlog_start_sector(log, 0, log->head_seq + 1);
+}
+
+// --------------------------------------------------------------------
+// Read pass: the sectors after the head are the oldest, those left
+// from an earlier lap or never written are skipped
+// --------------------------------------------------------------------
+void flashlog_rewind(const flashlog_t *log, flashlog_cursor_t *c)
+{
+    (void)log;
+    c->step = 1;
+    c->offset = FLASHLOG_HEADER;
+}
+
+size_t flashlog_next(const flashlog_t *log, flashlog_cursor_t *c, void *buf, size_t cap)
+{
+    while (c->step <= log->sectors)
+    {
+        uint32_t sector = (log->head + c->step) % log->sectors;
+        uint32_t seq = flashlog_sector_seq(log, sector);
+        uint32_t age = log->head_seq - seq;
+        uint32_t end = sector == log->head ? log->offset : log->backend.sector_size;
+        uint32_t len = FLASHLOG_ERASED_LEN;
+
+        if (seq != 0 && age < log->sectors) {
+            len = flashlog_record_len(log, sector, c->offset);
+        }
+
+        if (len == FLASHLOG_ERASED_LEN || c->offset + 2 + len > end)
+        {
+            c->step++;
+            c->offset = FLASHLOG_HEADER;
+            continue;
+        }
+
+        uint32_t addr = flashlog_addr(log, sector, c->offset + 2);
+        c->offset += 2 + len;
+
+        if (len == 0 || len > cap) {
+            continue;
+        }
+        if (log->backend.read(log->backend.ctx, addr, buf, len)) {
+            return len;
+        }
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------
+// RAM backend, NOR semantics so it behaves like the flash it stands in for
+// --------------------------------------------------------------------
+static bool flashlog_ram_read(void *ctx, uint32_t offset, void *data, size_t len)
+{
+    memcpy(data, (uint8_t *)ctx + offset, len);
+    return true;
+}
+
+static bool flashlog_ram_write(void *ctx, uint32_t offset, const void *data, size_t len)
+{
+    uint8_t *mem = (uint8_t *)ctx + offset;
+    const uint8_t *src = data;
+
+    for (size_t i = 0; i < len; i++) {
+        mem[i] &= src[i];
+    }
+    return true;
+}
+
+static bool flashlog_ram_erase(void *ctx, uint32_t offset, size_t len)
+{
+    memset((uint8_t *)ctx + offset, 0xFF, len);
+    return true;
+}
+
+void flashlog_ram_backend(flashlog_backend_t *b, uint8_t *mem, uint32_t size, uint32_t sector_size)
+{
+    *b = (flashlog_backend_t) {
+        .read = flashlog_ram_read,
+        .write = flashlog_ram_write,
+        .erase = flashlog_ram_erase,
+        .ctx = mem,
+        .size = size,
+        .sector_size = sector_size,
+    };
+}
+
+// --------------------------------------------------------------------
+// File backend, an image of the partition: the same bytes
+// esptool read_flash gives for it
+// --------------------------------------------------------------------
+static bool flashlog_file_read(void *ctx, uint32_t offset, void *data, size_t len)
+{
+    FILE *f = ctx;
+    return fseek(f, offset, SEEK_SET) == 0 && fread(data, 1, len, f) == len;
+}
+
+static bool flashlog_file_write(void *ctx, uint32_t offset, const void *data, size_t len)
+{
+    FILE *f = ctx;
+    uint8_t old[64];
+    const uint8_t *src = data;
+
+    while (len > 0)
+    {
+        size_t n = len < sizeof(old) ? len : sizeof(old);
+        if (!flashlog_file_read(f, offset, old, n)) {
+            return false;
+        }
+        for (size_t i = 0; i < n; i++) {
+            old[i] &= src[i];
+        }
+        if (fseek(f, offset, SEEK_SET) != 0 || fwrite(old, 1, n, f) != n) {
+            return false;
+        }
+        offset += n;
+        src += n;
+        len -= n;
+    }
+    return fflush(f) == 0;
+}
+
+static bool flashlog_file_erase(void *ctx, uint32_t offset, size_t len)
+{
+    FILE *f = ctx;
+    uint8_t ff[64];
+
+    memset(ff, 0xFF, sizeof(ff));
+    if (fseek(f, offset, SEEK_SET) != 0) {
+        return false;
+    }
+    while (len > 0)
+    {
+        size_t n = len < sizeof(ff) ? len : sizeof(ff);
+        if (fwrite(ff, 1, n, f) != n) {
+            return false;
+        }
+        len -= n;
+    }
+    return fflush(f) == 0;
+}
+
+bool flashlog_file_backend(flashlog_backend_t *b, FILE *file, uint32_t size, uint32_t sector_size)
+{
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return false;
+    }
+
+    long end = ftell(file);
+    if (end < 0) {
+        return false;
+    }
+    if ((uint32_t)end < size && !flashlog_file_erase(file, end, size - end)) {
+        return false;
+    }
+
+    *b = (flashlog_backend_t) {
+        .read = flashlog_file_read,
+        .write = flashlog_file_write,
+        .erase = flashlog_file_erase,
+        .ctx = file,
+        .size = size,
+        .sector_size = sector_size,
+    };
+    return true;
+}
+
+// --------------------------------------------------------------------
+// Flash partition backend
+// --------------------------------------------------------------------
+#ifdef ESP_PLATFORM
+static bool flashlog_part_read(void *ctx, uint32_t offset, void *data, size_t len)
+{
+    return esp_partition_read(ctx, offset, data, len) == ESP_OK;
+}
+
+static bool flashlog_part_write(void *ctx, uint32_t offset, const void *data, size_t len)
+{
+    return esp_partition_write(ctx, offset, data, len) == ESP_OK;
+}
+
+static bool flashlog_part_erase(void *ctx, uint32_t offset, size_t len)
+{
+    return esp_partition_erase_range(ctx, offset, len) == ESP_OK;
+}
+
+bool flashlog_partition_backend(flashlog_backend_t *b, const char *label)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, label);
+    if (part == NULL) {
+        return false;
+    }
+
+    *b = (flashlog_backend_t) {
+        .read = flashlog_part_read,
+        .write = flashlog_part_write,
+        .erase = flashlog_part_erase,
+        .ctx = (void *)part,
+        .size = part->size - part->size % part->erase_size,
+        .sector_size = part->erase_size,
+    };
+    return true;
+}
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+
+// --------------------------------------------------------------------
+// Persistent telemetry log
+// --------------------------------------------------------------------
+//
+// A ring of erase sectors on a storage backend. Records are appended to
+// the head sector; when it is full the next one is erased and becomes the
+// head, so the oldest sector is dropped and every sector is erased once
+// per lap (wear levelling by construction, no metadata to rewrite).
+//
+// Sector:  u32 FLASHLOG_MAGIC | u32 seq | records ...
+// Record:  u16 length (0xFFFF = erased, end of the sector) | data
+//
+// The sector with the highest seq is the head, open() finds it and the end
+// of its records again after a reset. A record cut short by a power loss
+// keeps its length, so the next one still lands after it. The CPU monitor
+// stores COBS frames, whose CRC lets the host drop such a record.
+//
+// No RTOS or ESP-IDF dependency outside the partition backend, the RAM and
+// file backends build and run anywhere.
+//
+#define FLASHLOG_MAGIC          0x474F4C46      // "FLOG"
+#define FLASHLOG_HEADER         8               // sector header bytes
+#define FLASHLOG_ERASED_LEN     0xFFFF
+
+
+// --------------------------------------------------------------------
+// Structs
+// --------------------------------------------------------------------
+
+// Storage with NOR flash semantics: erase sets whole sectors to 0xFF,
+// write only clears bits. Offsets are from the start of the log.
+typedef struct {
+    bool (*read)(void *ctx, uint32_t offset, void *data, size_t len);
+    bool (*write)(void *ctx, uint32_t offset, const void *data, size_t len);
+    bool (*erase)(void *ctx, uint32_t offset, size_t len);
+    void *ctx;
+    uint32_t size;              // bytes, a multiple of sector_size
+    uint32_t sector_size;
+} flashlog_backend_t;
+
+typedef struct {
+    flashlog_backend_t backend;
+    uint32_t sectors;
+    uint32_t head;              // sector being written
+    uint32_t head_seq;
+    uint32_t offset;            // next free byte in the head sector
+    uint32_t appended;          // records since open
+    uint32_t failed;            // appends the backend refused
+} flashlog_t;
+
+// Position of a read pass, oldest record first
+typedef struct {
+    uint32_t step;              // sectors visited, the head is the last one
+    uint32_t offset;
+} flashlog_cursor_t;
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+
+// Mount the log, formatting the first sector if none is valid. Needs two sectors.
+bool flashlog_open(flashlog_t *log, const flashlog_backend_t *backend);
+
+// False if the record is empty, longer than a sector holds, or the write failed
+bool flashlog_append(flashlog_t *log, const void *data, size_t len);
+
+// Bytes of records the log keeps at least (all sectors but the one refilled)
+uint32_t flashlog_capacity(const flashlog_t *log);
+size_t flashlog_record_max(const flashlog_t *log);
+
+// Read pass: next record into buf, its length, 0 at the end. Records
+// longer than cap are skipped. No appends in between.
+void flashlog_rewind(const flashlog_t *log, flashlog_cursor_t *c);
+size_t flashlog_next(const flashlog_t *log, flashlog_cursor_t *c, void *buf, size_t cap);
+
+// Erase everything, the log starts over empty
+bool flashlog_clear(flashlog_t *log);
+
+// Backends. RAM: mem of size bytes. File: a file opened "r+b" or "w+b",
+// grown to size with 0xFF.
+void flashlog_ram_backend(flashlog_backend_t *b, uint8_t *mem, uint32_t size, uint32_t sector_size);
+bool flashlog_file_backend(flashlog_backend_t *b, FILE *file, uint32_t size, uint32_t sector_size);
+
+#ifdef ESP_PLATFORM
+// Data partition by label, e.g. "tlmlog, data, 0x40, , 256K" in partitions.csv
+bool flashlog_partition_backend(flashlog_backend_t *b, const char *label);
+#endif
@@ -1,81 +1,521 @@
 #include "isr_trace.h"
 #include "esp_attr.h"
 #include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
 #include "freertos/FreeRTOS.h"
 #include "CPU_usage.h"
+#include "postmortem.h"
+#include "telemetry.h"
 
-extern QueueHandle_t AWSQueue;
 
 
 
 
-DRAM_ATTR static volatile isr_trace_record_t isr_trace[ISR_TRACE_MAX_TAGS];
+// Each core only touches its own state, so the cycle counters of different
+// cores are never mixed and the lock is uncontended outside of snapshots.
+typedef struct {
+    portMUX_TYPE lock;
+    uint32_t depth;
+    uint32_t max_ns;
+    isr_trace_frame_t stack[ISR_TRACE_MAX_NESTING];
+    isr_trace_stats_t stats[ISR_TRACE_MAX_TAGS];
+    isr_trace_core_info_t info;
+
+    // Cycle -> ns scale of this core, redone when the CPU frequency changes
+    uint32_t ticks_per_us;
+    uint32_t ns_per_cycle_q;
+
+    // Totals for the task engine, never reset (readers take differences)
+    uint64_t total_ns;                  // outermost ISR time on this core
+    uint64_t unattributed_ns;           // victim table was full
+    TaskHandle_t victim;                // task interrupted by the outermost ISR
+    isr_trace_victim_t victims[ISR_TRACE_MAX_VICTIMS];
+} isr_trace_core_t;
+
+DRAM_ATTR static isr_trace_core_t isr_trace[CPU_USAGE_MAX_CORES] = {
+    [0 ... CPU_USAGE_MAX_CORES - 1] = { .lock = portMUX_INITIALIZER_UNLOCKED },
+};
+
+// Wakeup latency per channel. esp_timer is shared by both cores, the cycle
+// counters are not, and the woken task may run on the other core.
+DRAM_ATTR static isr_trace_wakeup_t isr_trace_wakeup[ISR_TRACE_MAX_CHANNELS];
+static portMUX_TYPE isr_trace_wakeup_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Names of the tags handed out by ISR_Trace_Register(), only written at registration
+static char isr_trace_names[ISR_TRACE_MAX_TAGS][ISR_TRACE_NAME_LEN];
+static uint32_t isr_trace_next_tag = ISR_TRACE_MANUAL_TAGS;
+static portMUX_TYPE isr_trace_names_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Called with the core lock held
+static inline void IRAM_ATTR isr_trace_charge_victim(isr_trace_core_t *c, uint32_t ns)
+{
+    c->total_ns += ns;
+
+    if (c->victim != NULL)
+    {
+        isr_trace_victim_t *free_slot = NULL;
+        for (int i = 0; i < ISR_TRACE_MAX_VICTIMS; i++)
+        {
+            if (c->victims[i].task == c->victim) {
+                c->victims[i].ns += ns;
+                return;
+            }
+            if (free_slot == NULL && c->victims[i].task == NULL) {
+                free_slot = &c->victims[i];
+            }
+        }
+
+        if (free_slot) {
+            free_slot->task = c->victim;
+            free_slot->ns = ns;
+            return;
+        }
+    }
+
+    c->unattributed_ns += ns;
+}
+
+// Called with the core lock held. There is no public DFS callback, so the
+// ROM tick rate of this core (updated on every switch) is polled instead.
+static inline uint32_t IRAM_ATTR isr_trace_cycles_to_ns(isr_trace_core_t *c, uint32_t cycles)
+{
+    uint32_t ticks_per_us = esp_rom_get_cpu_ticks_per_us();
+    if (ticks_per_us != c->ticks_per_us)
+    {
+        if (c->ticks_per_us != 0) {
+            c->info.freq_changes++;
+        }
+        c->ticks_per_us = ticks_per_us;
+        c->ns_per_cycle_q = (1000u << ISR_TRACE_NS_Q) / ticks_per_us;
+    }
+
+    return (uint32_t)(((uint64_t)cycles * c->ns_per_cycle_q) >> ISR_TRACE_NS_Q);
+}
 
 void IRAM_ATTR ISR_Trace_Enter(uint32_t tag)
 {
+    int core = esp_cpu_get_core_id();
+    isr_trace_core_t *c = &isr_trace[core];
+
     if (tag >= ISR_TRACE_MAX_TAGS) {
+        if (tag != ISR_TRACE_NO_TAG) {
+            c->info.bad_tag++;      // only this core writes it
+        }
         return;
     }
-    isr_trace[tag].tag = tag;
-    isr_trace[tag].start_cycles = (uint32_t)esp_cpu_get_cycle_count();
+
+    portENTER_CRITICAL_ISR(&c->lock);
+    if (c->depth == 0) {
+        c->victim = xTaskGetCurrentTaskHandleForCore(core);
+    }
+    if (c->depth < ISR_TRACE_MAX_NESTING)
+    {
+        isr_trace_frame_t *f = &c->stack[c->depth];
+        f->tag = tag;
+        f->nested_cycles = 0;
+        f->start_cycles = (uint32_t)esp_cpu_get_cycle_count();
+    }
+    c->depth++;     // counted even when too deep so Exit stays balanced
+    portEXIT_CRITICAL_ISR(&c->lock);
 
 }
 
 void IRAM_ATTR ISR_Trace_Exit(uint32_t tag)
 {
+    uint32_t end   = (uint32_t)esp_cpu_get_cycle_count();
+    int core = esp_cpu_get_core_id();
+    isr_trace_core_t *c = &isr_trace[core];
+
     if (tag >= ISR_TRACE_MAX_TAGS) {
+        if (tag != ISR_TRACE_NO_TAG) {
+            c->info.bad_tag++;
+        }
         return;
     }
 
-    uint32_t end   = (uint32_t)esp_cpu_get_cycle_count();
-    isr_trace[tag].duration_cycles =  end - isr_trace[tag].start_cycles;
+    portENTER_CRITICAL_ISR(&c->lock);
 
-    xQueueSendFromISR(ISRQueue, (void *)&isr_trace[tag], NULL);
+    if (c->depth == 0) {
+        c->stats[tag].dropped++;
+        portEXIT_CRITICAL_ISR(&c->lock);
+        return;     // Exit without Enter
+    }
+
+    c->depth--;
+    if (c->depth >= ISR_TRACE_MAX_NESTING || c->stack[c->depth].tag != tag) {
+        c->stats[tag].dropped++;
+        portEXIT_CRITICAL_ISR(&c->lock);
+        return;     // too deep to track, or unbalanced Enter/Exit
+    }
+
+    isr_trace_frame_t *f = &c->stack[c->depth];
+    uint32_t inclusive_cycles = end - f->start_cycles;
+
+    // The whole nested ISR is charged to the interrupted one,
+    // the outermost one to the interrupted task
+    if (c->depth > 0) {
+        c->stack[c->depth - 1].nested_cycles += inclusive_cycles;
+    }
+
+    uint32_t inclusive = isr_trace_cycles_to_ns(c, inclusive_cycles);
+    uint32_t exclusive = isr_trace_cycles_to_ns(c, inclusive_cycles - f->nested_cycles);
+
+    if (c->depth == 0) {
+        isr_trace_charge_victim(c, inclusive);
+    }
+
+    // log2 bucket of the self time, __builtin_clz is a single NSAU instruction on Xtensa
+    int bucket = (exclusive >> ISR_TRACE_HIST_SHIFT) ? (31 - __builtin_clz(exclusive)) - ISR_TRACE_HIST_SHIFT : 0;
+    if (bucket >= ISR_TRACE_HIST_BUCKETS) {
+        bucket = ISR_TRACE_HIST_BUCKETS - 1;
+    }
+
+    isr_trace_stats_t *s = &c->stats[tag];
+    if (s->count == 0 || inclusive < s->incl_min_ns) {
+        s->incl_min_ns = inclusive;
+    }
+    if (s->count == 0 || exclusive < s->excl_min_ns) {
+        s->excl_min_ns = exclusive;
+    }
+    if (inclusive > s->incl_max_ns) {
+        s->incl_max_ns = inclusive;
+    }
+    if (exclusive > s->excl_max_ns) {
+        s->excl_max_ns = exclusive;
+    }
+    s->count++;
+    s->incl_sum_ns += inclusive;
+    s->excl_sum_ns += exclusive;
+    s->hist[bucket]++;
+
+    if (inclusive > c->max_ns) {
+        c->max_ns = inclusive;
+    }
+
+    // Into this core's own ring, under the lock already held
+    postmortem_record_isr(core, tag, end, inclusive_cycles);
+
+    portEXIT_CRITICAL_ISR(&c->lock);
 
 }
 
+// Call from the ISR right where it gives the semaphore / notifies the task
+void IRAM_ATTR ISR_Trace_Signal(uint32_t channel)
+{
+    if (channel >= ISR_TRACE_MAX_CHANNELS) {
+        return;
+    }
 
-void ISR_uart_print_task(void *custom_user_printf)
+    int64_t now = esp_timer_get_time();
+    isr_trace_wakeup_t *w = &isr_trace_wakeup[channel];
+
+    portENTER_CRITICAL_ISR(&isr_trace_wakeup_lock);
+    if (w->pending) {
+        w->coalesced++;     // the task will handle both, measure from the first
+    } else {
+        w->pending = true;
+        w->signal_us = now;
+    }
+    portEXIT_CRITICAL_ISR(&isr_trace_wakeup_lock);
+}
+
+// Call from the deferred-processing task right after it wakes up
+void ISR_Trace_Received(uint32_t channel)
 {
+    if (channel >= ISR_TRACE_MAX_CHANNELS) {
+        return;
+    }
 
-    uint32_t CPU_hz = esp_clk_cpu_freq();
+    int64_t now = esp_timer_get_time();
+    isr_trace_wakeup_t *w = &isr_trace_wakeup[channel];
 
-    isr_trace_record_t received_record;
-    
-    while(1)
+    portENTER_CRITICAL(&isr_trace_wakeup_lock);
+    if (w->pending)
     {
-        
-        if (xQueueReceive(ISRQueue, &received_record, portMAX_DELAY) == pdPASS)
-        {
+        uint32_t latency = (uint32_t)(now - w->signal_us);
+        w->pending = false;
 
-            // Convert to JSON
-            char *json = malloc(128);
-            if (!json)
-                continue;
+        int bucket = (latency >> 1) ? (31 - __builtin_clz(latency)) : 0;
+        if (bucket >= ISR_TRACE_HIST_BUCKETS) {
+            bucket = ISR_TRACE_HIST_BUCKETS - 1;
+        }
+
+        if (w->count == 0 || latency < w->min_us) {
+            w->min_us = latency;
+        }
+        if (latency > w->max_us) {
+            w->max_us = latency;
+        }
+        w->count++;
+        w->sum_us += latency;
+        w->hist[bucket]++;
+    }
+    portEXIT_CRITICAL(&isr_trace_wakeup_lock);
+}
+
+// Copy the wakeup aggregates and start a new window, pending signals are kept
+static void isr_trace_wakeup_snapshot(isr_trace_wakeup_t out[ISR_TRACE_MAX_CHANNELS])
+{
+    portENTER_CRITICAL(&isr_trace_wakeup_lock);
+    for (int ch = 0; ch < ISR_TRACE_MAX_CHANNELS; ch++)
+    {
+        isr_trace_wakeup_t *w = &isr_trace_wakeup[ch];
+        out[ch] = *w;
+
+        bool pending = w->pending;
+        int64_t signal_us = w->signal_us;
+        memset(w, 0, sizeof(*w));
+        w->pending = pending;
+        w->signal_us = signal_us;
+    }
+    portEXIT_CRITICAL(&isr_trace_wakeup_lock);
+}
+
+// Assign a tag to a named handler, the same name always gets the same tag.
+// Returns ISR_TRACE_NO_TAG when all tags are used (the handler then runs untraced).
+uint32_t ISR_Trace_Register(const char *name)
+{
+    uint32_t tag = ISR_TRACE_NO_TAG;
+
+    portENTER_CRITICAL(&isr_trace_names_lock);
+    for (uint32_t i = ISR_TRACE_MANUAL_TAGS; i < isr_trace_next_tag; i++)
+    {
+        if (strncmp(isr_trace_names[i], name, ISR_TRACE_NAME_LEN - 1) == 0) {
+            tag = i;
+            break;
+        }
+    }
+    if (tag == ISR_TRACE_NO_TAG && isr_trace_next_tag < ISR_TRACE_MAX_TAGS)
+    {
+        tag = isr_trace_next_tag++;
+        snprintf(isr_trace_names[tag], ISR_TRACE_NAME_LEN, "%s", name);
+    }
+    portEXIT_CRITICAL(&isr_trace_names_lock);
+
+    return tag;
+}
+
+// Name of a registered tag, NULL for manual tags
+const char *ISR_Trace_Tag_Name(uint32_t tag)
+{
+    if (tag >= ISR_TRACE_MAX_TAGS || isr_trace_names[tag][0] == '\0') {
+        return NULL;
+    }
+    return isr_trace_names[tag];
+}
+
+// Longest ISR duration in ns (any tag, any core) since the previous call
+uint32_t ISR_Trace_Take_Max_Ns(void)
+{
+    uint32_t max_ns = 0;
+    for (int core = 0; core < CPU_USAGE_MAX_CORES; core++)
+    {
+        portENTER_CRITICAL(&isr_trace[core].lock);
+        if (isr_trace[core].max_ns > max_ns) {
+            max_ns = isr_trace[core].max_ns;
+        }
+        isr_trace[core].max_ns = 0;
+        portEXIT_CRITICAL(&isr_trace[core].lock);
+    }
+    return max_ns;
+}
+
+// Copy the aggregates of all cores and tags and start a new window.
+// The nesting stacks are left alone, ISRs may be running right now.
+void ISR_Trace_Snapshot(isr_trace_stats_t out[][ISR_TRACE_MAX_TAGS], isr_trace_core_info_t info[])
+{
+    for (int core = 0; core < CPU_USAGE_MAX_CORES; core++)
+    {
+        portENTER_CRITICAL(&isr_trace[core].lock);
+        memcpy(out[core], isr_trace[core].stats, sizeof(isr_trace[core].stats));
+        memset(isr_trace[core].stats, 0, sizeof(isr_trace[core].stats));
+        info[core] = isr_trace[core].info;
+        memset(&isr_trace[core].info, 0, sizeof(isr_trace[core].info));
+        portEXIT_CRITICAL(&isr_trace[core].lock);
+    }
+}
 
-            snprintf(json, 128,
-                     "{\"tag\":%lu,\"duration\":%.5f}",
-                     received_record.tag,
-                    ((float)received_record.duration_cycles * 1000000.0f) / CPU_hz);
+// Total outermost ISR time on a core since boot, in ns
+uint64_t ISR_Trace_Core_Ns(int core)
+{
+    portENTER_CRITICAL(&isr_trace[core].lock);
+    uint64_t ns = isr_trace[core].total_ns;
+    portEXIT_CRITICAL(&isr_trace[core].lock);
+    return ns;
+}
 
-            if (custom_user_printf == NULL)
-            {
-                printf("%s\n", json);
+// ISR time charged to a task since boot (all cores), in ns
+uint64_t ISR_Trace_Task_Ns(TaskHandle_t task)
+{
+    uint64_t ns = 0;
+    for (int core = 0; core < CPU_USAGE_MAX_CORES; core++)
+    {
+        portENTER_CRITICAL(&isr_trace[core].lock);
+        for (int i = 0; i < ISR_TRACE_MAX_VICTIMS; i++) {
+            if (isr_trace[core].victims[i].task == task) {
+                ns += isr_trace[core].victims[i].ns;
+                break;
             }
-            else
-            {     
-                ((void (*)(char *))custom_user_printf)(json);
+        }
+        portEXIT_CRITICAL(&isr_trace[core].lock);
+    }
+    return ns;
+}
+
+// Release the victim slots of every task missing from alive (a task list
+// taken with uxTaskGetSystemState). Catches tasks created and deleted between
+// two windows, which no window ever sees disappear.
+void ISR_Trace_Keep_Tasks(const TaskStatus_t *alive, UBaseType_t count)
+{
+    for (int core = 0; core < CPU_USAGE_MAX_CORES; core++)
+    {
+        for (int i = 0; i < ISR_TRACE_MAX_VICTIMS; i++)
+        {
+            // Looked up outside the lock, only this core's ISRs claim slots
+            TaskHandle_t task = isr_trace[core].victims[i].task;
+            if (task == NULL) {
+                continue;
             }
 
-            if (AWSQueue)
-            {
-                if (xQueueSend(AWSQueue, &json, 0) == pdPASS) {}
-                else
-                {
-                    free(json);
+            bool found = false;
+            for (UBaseType_t k = 0; k < count && !found; k++) {
+                found = alive[k].xHandle == task;
+            }
+            if (found) {
+                continue;
+            }
+
+            portENTER_CRITICAL(&isr_trace[core].lock);
+            if (isr_trace[core].victims[i].task == task) {
+                isr_trace[core].victims[i].task = NULL;
+                isr_trace[core].victims[i].ns = 0;
+            }
+            portEXIT_CRITICAL(&isr_trace[core].lock);
+        }
+    }
+}
+
+
+// --------------------------------------------------------------------
+// Wakeup latency report, one entry per channel that saw a wakeup
+// --------------------------------------------------------------------
+typedef struct {
+    const isr_trace_wakeup_t *channels;
+    uint8_t active[ISR_TRACE_MAX_CHANNELS];     // channel of each entry
+} isr_trace_wakeup_report_t;
+
+static void isr_trace_get_wakeup(const void *ctx, uint32_t index, tlm_wakeup_entry_t *out)
+{
+    const isr_trace_wakeup_report_t *r = ctx;
+    uint32_t ch = r->active[index];
+    const isr_trace_wakeup_t *w = &r->channels[ch];
+
+    out->channel = ch;
+    out->count = w->count;
+    out->coalesced = w->coalesced;
+    out->min_us = w->min_us;
+    out->avg_us = (uint32_t)(w->sum_us / w->count);
+    out->max_us = w->max_us;
+    out->hist = w->hist;
+}
+
+static void isr_trace_report_wakeup(void)
+{
+    static isr_trace_wakeup_t snapshot[ISR_TRACE_MAX_CHANNELS];
+    static isr_trace_wakeup_report_t report;
+
+    isr_trace_wakeup_snapshot(snapshot);
+
+    tlm_wakeup_t m = { .get_wakeup = isr_trace_get_wakeup, .ctx = &report };
+    report.channels = snapshot;
+    for (int ch = 0; ch < ISR_TRACE_MAX_CHANNELS; ch++) {
+        if (snapshot[ch].count) report.active[m.count++] = ch;
+    }
+    if (m.count == 0) {
+        return;
+    }
+
+    cpu_usage_publish_tlm(&tlm_wakeup_codec, &m, 0);
+}
+
+// --------------------------------------------------------------------
+// ISR report of one window, all cores and tags
+// --------------------------------------------------------------------
+typedef struct {
+    isr_trace_stats_t (*stats)[ISR_TRACE_MAX_TAGS];
+    struct {
+        uint8_t core;
+        uint8_t tag;
+    } active[CPU_USAGE_MAX_CORES * ISR_TRACE_MAX_TAGS];     // (core, tag) of each entry
+} isr_trace_report_t;
+
+static void isr_trace_get_isr(const void *ctx, uint32_t index, tlm_isr_entry_t *out)
+{
+    const isr_trace_report_t *r = ctx;
+    int core = r->active[index].core;
+    int tag = r->active[index].tag;
+    const isr_trace_stats_t *s = &r->stats[core][tag];
+
+    out->tag = tag;
+    out->core = core;
+    out->name = ISR_Trace_Tag_Name(tag);
+    out->count = s->count;
+    out->dropped = s->dropped;
+    out->incl_min_ns = s->incl_min_ns;
+    out->incl_avg_ns = s->count ? (uint32_t)(s->incl_sum_ns / s->count) : 0;
+    out->incl_max_ns = s->incl_max_ns;
+    out->excl_min_ns = s->excl_min_ns;
+    out->excl_avg_ns = s->count ? (uint32_t)(s->excl_sum_ns / s->count) : 0;
+    out->excl_max_ns = s->excl_max_ns;
+    out->hist = s->hist;
+}
+
+// --------------------------------------------------------------------
+// Task that prints one aggregated report per ISR_TRACE_REPORT_TICKS
+// --------------------------------------------------------------------
+void ISR_uart_print_task(void *custom_user_printf)
+{
+    // Reports go through cpu_usage_publish(), the serial sink applies the print function
+    (void)custom_user_printf;
+
+    static isr_trace_stats_t snapshot[CPU_USAGE_MAX_CORES][ISR_TRACE_MAX_TAGS];
+    static isr_trace_core_info_t info[CPU_USAGE_MAX_CORES];
+    static isr_trace_report_t report;
+
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while(1)
+    {
+        vTaskDelayUntil(&last_wake, ISR_TRACE_REPORT_TICKS);
+
+        isr_trace_report_wakeup();
+
+        ISR_Trace_Snapshot(snapshot, info);
+
+        report.stats = snapshot;
+        tlm_isr_t m = {
+            .uptime_us = esp_timer_get_time(),  // places the window next to the stats reports
+            .cpu_hz = esp_clk_cpu_freq(),       // informational, durations are already ns
+            .hist_shift = ISR_TRACE_HIST_SHIFT,
+            .get_isr = isr_trace_get_isr,
+            .ctx = &report,
+        };
+        for (int core = 0; core < CPU_USAGE_MAX_CORES; core++) {
+            for (int tag = 0; tag < ISR_TRACE_MAX_TAGS; tag++) {
+                if (snapshot[core][tag].count || snapshot[core][tag].dropped) {
+                    report.active[m.count].core = core;
+                    report.active[m.count].tag = tag;
+                    m.count++;
                 }
             }
-            
+            m.bad_tag += info[core].bad_tag;
+            m.freq_changes += info[core].freq_changes;
         }
+        if (m.count == 0 && m.bad_tag == 0 && m.freq_changes == 0) {
+            continue;
+        }
+
+        cpu_usage_publish_tlm(&tlm_isr_codec, &m, 0);
     }
 }
@@ -3,18 +3,80 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 
-#define ISR_TRACE_MAX_TAGS 16
+#define ISR_TRACE_MAX_TAGS      32
+#define ISR_TRACE_MANUAL_TAGS   8       // tags 0..7 are for hand-placed Enter/Exit, the rest are assigned by ISR_Trace_Register()
+#define ISR_TRACE_NAME_LEN      16
+#define ISR_TRACE_NO_TAG        0xFFFFFFFFu     // Enter/Exit ignore it
+#define ISR_TRACE_MAX_NESTING   8       // nested interrupts tracked per core
+#define ISR_TRACE_HIST_BUCKETS  16      // log2 self-time buckets per tag
+#define ISR_TRACE_HIST_SHIFT    7       // bucket 0 = below 2^(SHIFT+1) ns, bucket k = [2^(k+SHIFT), 2^(k+SHIFT+1)) ns
+#define ISR_TRACE_REPORT_TICKS  pdMS_TO_TICKS(1000)
+#define ISR_TRACE_MAX_VICTIMS   24      // tasks per core that ISR time can be charged to
+#define ISR_TRACE_MAX_CHANNELS  8       // ISR -> task wakeup paths
+#define ISR_TRACE_NS_Q          16      // fractional bits of the per-core cycle -> ns scale factor
 
 
+// Per-core, per-tag aggregate, updated in place by ISR_Trace_Exit().
+// Inclusive = enter to exit, exclusive (self) = inclusive minus nested ISRs.
+// Times are ns, converted at the CPU frequency of the moment so DFS does not skew them.
+typedef struct {
+    uint32_t count;
+    uint32_t dropped;           // too deeply nested, or Exit without a matching Enter
+    uint32_t incl_min_ns;
+    uint32_t incl_max_ns;
+    uint64_t incl_sum_ns;
+    uint32_t excl_min_ns;
+    uint32_t excl_max_ns;
+    uint64_t excl_sum_ns;
+    uint32_t hist[ISR_TRACE_HIST_BUCKETS];
+} isr_trace_stats_t;
+
+// One entry of the per-core nesting stack
 typedef struct {
     uint32_t tag;
     uint32_t start_cycles;
-    uint32_t duration_cycles;
-} isr_trace_record_t;
+    uint32_t nested_cycles;     // inclusive time of the ISRs that preempted this one
+} isr_trace_frame_t;
+
+// Latency from ISR_Trace_Signal() in an ISR to ISR_Trace_Received() in the woken task.
+// Histogram bucket 0 = below 2 us, bucket k = [2^k, 2^(k+1)) us.
+typedef struct {
+    bool pending;
+    int64_t signal_us;          // oldest signal not yet received
+    uint32_t count;
+    uint32_t coalesced;         // signals that arrived while one was pending
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t hist[ISR_TRACE_HIST_BUCKETS];
+} isr_trace_wakeup_t;
+
+// Outermost ISR time charged to the task it interrupted (monotonic)
+typedef struct {
+    TaskHandle_t task;
+    uint64_t ns;
+} isr_trace_victim_t;
+
+// Window counters that are not tied to a tag
+typedef struct {
+    uint32_t bad_tag;           // Enter/Exit with a tag >= ISR_TRACE_MAX_TAGS
+    uint32_t freq_changes;      // CPU frequency switches seen by this core
+} isr_trace_core_info_t;
 
 
 void ISR_Trace_Enter(uint32_t tag);
 void ISR_Trace_Exit(uint32_t tag);
+void ISR_Trace_Signal(uint32_t channel);
+void ISR_Trace_Received(uint32_t channel);
+uint32_t ISR_Trace_Register(const char *name);
+const char *ISR_Trace_Tag_Name(uint32_t tag);
+uint32_t ISR_Trace_Take_Max_Ns(void);
+void ISR_Trace_Snapshot(isr_trace_stats_t out[][ISR_TRACE_MAX_TAGS], isr_trace_core_info_t info[]);
+uint64_t ISR_Trace_Core_Ns(int core);
+uint64_t ISR_Trace_Task_Ns(TaskHandle_t task);
+void ISR_Trace_Keep_Tasks(const TaskStatus_t *alive, UBaseType_t count);
 void ISR_uart_print_task(void *custom_user_printf);
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include "isr_wrap.h"
+#include "isr_trace.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+
+
+// --------------------------------------------------------------------
+// Globals
+// --------------------------------------------------------------------
+typedef struct {
+    intr_handler_t handler;
+    void *arg;
+    uint32_t tag;
+    intr_handle_t handle;       // to release the slot in esp_intr_free()
+} isr_wrap_slot_t;
+
+// Read from ISRs that may run with the flash cache disabled
+DRAM_ATTR static isr_wrap_slot_t isr_wrap_intr[ISR_WRAP_MAX_INTR];
+DRAM_ATTR static isr_wrap_slot_t isr_wrap_gpio[GPIO_NUM_MAX];
+static portMUX_TYPE isr_wrap_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// With --wrap the linker sends every call to the __wrap_ version, the
+// original is reachable as __real_. Without it the plain API is used.
+#if ISR_TRACE_AUTO_WRAP
+    esp_err_t __real_esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg, intr_handle_t *ret_handle);
+    esp_err_t __real_esp_intr_alloc_intrstatus(int source, int flags, uint32_t intrstatusreg, uint32_t intrstatusmask,
+                                               intr_handler_t handler, void *arg, intr_handle_t *ret_handle);
+    esp_err_t __real_esp_intr_free(intr_handle_t handle);
+    esp_err_t __real_gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args);
+    #define ISR_WRAP_REAL(fn)   __real_##fn
+#else
+    #define ISR_WRAP_REAL(fn)   fn
+#endif
+
+
+// --------------------------------------------------------------------
+// Trampoline installed in place of the user handler
+// --------------------------------------------------------------------
+static void IRAM_ATTR isr_wrap_trampoline(void *arg)
+{
+    const isr_wrap_slot_t *slot = arg;
+
+    ISR_Trace_Enter(slot->tag);
+    slot->handler(slot->arg);
+    ISR_Trace_Exit(slot->tag);
+}
+
+// Level 4+ handlers run where spinlocks and C calls are not allowed
+static bool isr_wrap_traceable(int flags, intr_handler_t handler)
+{
+    return handler != NULL && (flags & ESP_INTR_FLAG_HIGH) == 0;
+}
+
+static isr_wrap_slot_t *isr_wrap_take_slot(void)
+{
+    isr_wrap_slot_t *slot = NULL;
+
+    portENTER_CRITICAL(&isr_wrap_lock);
+    for (int i = 0; i < ISR_WRAP_MAX_INTR; i++)
+    {
+        if (isr_wrap_intr[i].handler == NULL) {
+            slot = &isr_wrap_intr[i];
+            slot->handler = isr_wrap_trampoline;    // reserved until filled in
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&isr_wrap_lock);
+
+    return slot;
+}
+
+static esp_err_t isr_wrap_alloc(const char *name, int source, int flags,
+                                uint32_t intrstatusreg, uint32_t intrstatusmask, bool intrstatus,
+                                intr_handler_t handler, void *arg, intr_handle_t *ret_handle)
+{
+    isr_wrap_slot_t *slot = isr_wrap_traceable(flags, handler) ? isr_wrap_take_slot() : NULL;
+    if (slot == NULL)
+    {
+        // Untraceable or out of slots, install the handler as is
+        return intrstatus
+            ? ISR_WRAP_REAL(esp_intr_alloc_intrstatus)(source, flags, intrstatusreg, intrstatusmask, handler, arg, ret_handle)
+            : ISR_WRAP_REAL(esp_intr_alloc)(source, flags, handler, arg, ret_handle);
+    }
+
+    slot->arg = arg;
+    slot->tag = ISR_Trace_Register(name);
+    slot->handle = NULL;
+    slot->handler = handler;
+
+    intr_handle_t handle = NULL;
+    esp_err_t err = intrstatus
+        ? ISR_WRAP_REAL(esp_intr_alloc_intrstatus)(source, flags, intrstatusreg, intrstatusmask, isr_wrap_trampoline, slot, &handle)
+        : ISR_WRAP_REAL(esp_intr_alloc)(source, flags, isr_wrap_trampoline, slot, &handle);
+
+    if (err != ESP_OK)
+    {
+        slot->handler = NULL;
+        return err;
+    }
+
+    slot->handle = handle;
+    if (ret_handle) {
+        *ret_handle = handle;
+    }
+    return ESP_OK;
+}
+
+
+// --------------------------------------------------------------------
+// Named registration
+// --------------------------------------------------------------------
+esp_err_t isr_wrap_intr_alloc(const char *name, int source, int flags,
+                              intr_handler_t handler, void *arg, intr_handle_t *ret_handle)
+{
+    return isr_wrap_alloc(name, source, flags, 0, 0, false, handler, arg, ret_handle);
+}
+
+esp_err_t isr_wrap_gpio_isr_handler_add(const char *name, gpio_num_t gpio_num,
+                                        gpio_isr_t isr_handler, void *args)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX || isr_handler == NULL) {
+        return ISR_WRAP_REAL(gpio_isr_handler_add)(gpio_num, isr_handler, args);
+    }
+
+    // One slot per pin, the GPIO driver allows a single handler per pin as well.
+    // The handler runs nested inside the traced GPIO dispatcher interrupt.
+    // The tag goes in with the handler, a pin that fires in between must not
+    // be counted under the tag of the handler it had before.
+    isr_wrap_slot_t *slot = &isr_wrap_gpio[gpio_num];
+    uint32_t tag = ISR_Trace_Register(name);
+
+    portENTER_CRITICAL(&isr_wrap_lock);
+    slot->handler = isr_handler;
+    slot->arg = args;
+    slot->tag = tag;
+    portEXIT_CRITICAL(&isr_wrap_lock);
+
+    return ISR_WRAP_REAL(gpio_isr_handler_add)(gpio_num, isr_wrap_trampoline, slot);
+}
+
+
+// --------------------------------------------------------------------
+// Linker shims, named after the interrupt source / pin
+// --------------------------------------------------------------------
+#if ISR_TRACE_AUTO_WRAP
+
+esp_err_t __wrap_esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg, intr_handle_t *ret_handle)
+{
+    char name[ISR_TRACE_NAME_LEN];
+    snprintf(name, sizeof(name), "intr%d", source);
+    return isr_wrap_alloc(name, source, flags, 0, 0, false, handler, arg, ret_handle);
+}
+
+esp_err_t __wrap_esp_intr_alloc_intrstatus(int source, int flags, uint32_t intrstatusreg, uint32_t intrstatusmask,
+                                           intr_handler_t handler, void *arg, intr_handle_t *ret_handle)
+{
+    char name[ISR_TRACE_NAME_LEN];
+    snprintf(name, sizeof(name), "intr%d", source);
+    return isr_wrap_alloc(name, source, flags, intrstatusreg, intrstatusmask, true, handler, arg, ret_handle);
+}
+
+esp_err_t __wrap_esp_intr_free(intr_handle_t handle)
+{
+    esp_err_t err = __real_esp_intr_free(handle);
+    if (err != ESP_OK || handle == NULL) {
+        return err;
+    }
+
+    portENTER_CRITICAL(&isr_wrap_lock);
+    for (int i = 0; i < ISR_WRAP_MAX_INTR; i++)
+    {
+        if (isr_wrap_intr[i].handle == handle) {
+            isr_wrap_intr[i].handle = NULL;
+            isr_wrap_intr[i].handler = NULL;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&isr_wrap_lock);
+
+    return err;
+}
+
+esp_err_t __wrap_gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    char name[ISR_TRACE_NAME_LEN];
+    snprintf(name, sizeof(name), "gpio%d", (int)gpio_num);
+    return isr_wrap_gpio_isr_handler_add(name, gpio_num, isr_handler, args);
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_intr_alloc.h"
+#include "driver/gpio.h"
+
+
+// --------------------------------------------------------------------
+// Configuration
+// --------------------------------------------------------------------
+
+// Set by the component CMakeLists.txt together with the -Wl,--wrap link options.
+// With it every esp_intr_alloc() / gpio_isr_handler_add() in the firmware
+// (drivers included) gets traced without touching the handlers.
+#ifndef ISR_TRACE_AUTO_WRAP
+    #define ISR_TRACE_AUTO_WRAP     0
+#endif
+
+#define ISR_WRAP_MAX_INTR           32      // wrapped esp_intr_alloc() handlers
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+
+// Register a handler under a name, it is traced with a dynamically assigned tag.
+// High level (4+) interrupts and NULL handlers are passed through untraced.
+esp_err_t isr_wrap_intr_alloc(const char *name, int source, int flags,
+                              intr_handler_t handler, void *arg, intr_handle_t *ret_handle);
+esp_err_t isr_wrap_gpio_isr_handler_add(const char *name, gpio_num_t gpio_num,
+                                        gpio_isr_t isr_handler, void *args);
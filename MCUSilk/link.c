@@ -0,0 +1,294 @@
+#include <string.h>
+#include <stdlib.h>
+#include "link.h"
+#include "query.h"
+#include "CPU_usage.h"
+#include "wire.h"
+#include "telemetry.h"
+#include "freertos/task.h"
+
+
+// --------------------------------------------------------------------
+// Globals
+// --------------------------------------------------------------------
+static uart_port_t link_port;
+static uint32_t link_baud;                  // rate of the line, 0 = not a UART we drive
+static uint32_t link_prev_baud;             // last confirmed rate while a switch is pending, 0 = none
+static TickType_t link_deadline;
+
+static uint8_t link_rx[LINK_FRAME_MAX];
+static size_t link_rx_len;
+static bool link_rx_overflow;               // frame longer than any command, skip to the next 0x00
+
+static uint8_t link_raw[LINK_FRAME_MAX];
+static char link_tx[LINK_FRAME_MAX + 8];    // + CRC, COBS codes and the delimiters
+static uint32_t link_echo[LINK_TEST_LEN];
+
+static uint32_t budget_bytes[LINK_MSG_TYPES];
+static uint32_t budget_msgs[LINK_MSG_TYPES];
+static TickType_t budget_tick;
+static portMUX_TYPE budget_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+// Every byte value once, so a wrong bit rate or a bridge that mangles
+// 0x00 / 0xFF / 0x0A shows up as a mismatch
+static uint8_t link_pattern(size_t i)
+{
+    return (uint8_t)(i * 0x3B + 0x55);
+}
+
+// --------------------------------------------------------------------
+// LINK reply as a frame in link_tx, always binary so the pattern echo
+// survives on a JSON link. A leading delimiter ends whatever partial line
+// the host holds. Length with both delimiters, 0 if it does not fit.
+// --------------------------------------------------------------------
+static size_t link_encode(const tlm_link_t *m)
+{
+    wire_writer_t w;
+
+    wire_begin_buffer(&w, link_raw, sizeof(link_raw), WIRE_MSG_LINK);
+    tlm_link_codec.payload(&w, m);
+    if (w.overflow) {
+        return 0;
+    }
+
+    link_tx[0] = 0;
+    size_t len = wire_frame(link_raw, w.len, link_tx + 1, sizeof(link_tx) - 1);
+    return len ? len + 2 : 0;
+}
+
+static void link_reply(const tlm_link_t *m)
+{
+    size_t len = link_encode(m);
+    if (len) {
+        cpu_usage_serial_raw(link_tx, len);
+        link_account(WIRE_MSG_LINK, len);
+    }
+}
+
+bool link_send(const tlm_codec_t *codec, const void *msg)
+{
+    char *frame = codec->wire(msg);
+    if (frame == NULL) {
+        return false;
+    }
+
+    // COBS leaves no 0x00 in the frame, the one at the end is its delimiter.
+    // The NUL of "" goes first, like the leading delimiter of link_encode().
+    size_t len = strlen(frame) + 1;
+    cpu_usage_serial_raw("", 1);
+    cpu_usage_serial_raw(frame, len);
+    link_account(codec->type, len + 1);
+    free(frame);
+    return true;
+}
+
+static void link_set_baud(uint32_t baud)
+{
+    tlm_link_t m = { .baud = baud, .status = LINK_ACK };
+    size_t len = 0;
+
+    if (baud >= LINK_MIN_BAUD && baud <= LINK_MAX_BAUD) {
+        len = link_encode(&m);
+    }
+
+    // The ACK leaves at the old rate, the UART switches once it is out
+    if (len == 0 || !cpu_usage_serial_baud(baud, link_tx, len))
+    {
+        m = (tlm_link_t) { .baud = link_baud, .status = LINK_REFUSED };
+        link_reply(&m);
+        return;
+    }
+
+    // A second switch before the first was confirmed falls back to the last good rate
+    if (link_prev_baud == 0) {
+        link_prev_baud = link_baud;
+    }
+    link_baud = baud;
+    link_deadline = xTaskGetTickCount() + LINK_CONFIRM_TICKS;
+}
+
+static void link_test(const uint8_t *data, size_t len)
+{
+    if (len != LINK_TEST_LEN) {
+        return;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] != link_pattern(i)) {
+            return;
+        }
+        link_echo[i] = data[i];
+    }
+
+    link_prev_baud = 0;
+
+    tlm_link_t m = {
+        .baud = link_baud,
+        .status = LINK_CONFIRMED,
+        .pattern_len = LINK_TEST_LEN,
+        .pattern = link_echo,
+    };
+    link_reply(&m);
+}
+
+// No test pattern at the new rate in time, go back
+static void link_check_deadline(void)
+{
+    if (link_prev_baud == 0 || (int32_t)(xTaskGetTickCount() - link_deadline) < 0) {
+        return;
+    }
+
+    link_baud = link_prev_baud;
+    link_prev_baud = 0;
+    cpu_usage_serial_baud(link_baud, NULL, 0);
+
+    tlm_link_t m = { .baud = link_baud, .status = LINK_REVERTED };
+    link_reply(&m);
+}
+
+// --------------------------------------------------------------------
+// One received frame: version | CMD | command | request id | arguments.
+// The link commands are handled here, everything else is a query.
+// --------------------------------------------------------------------
+static void link_command(uint8_t *frame, size_t len)
+{
+    len = wire_unframe(frame, len);
+    if (len < 4 || frame[1] != WIRE_MSG_CMD) {
+        return;
+    }
+
+    const uint8_t *args = &frame[4];
+    size_t args_len = len - 4;
+
+    switch (frame[2])
+    {
+    case WIRE_CMD_BAUD:
+        if (args_len >= 4) {
+            link_set_baud((uint32_t)args[0] | (uint32_t)args[1] << 8 |
+                          (uint32_t)args[2] << 16 | (uint32_t)args[3] << 24);
+        }
+        break;
+
+    case WIRE_CMD_LINK_TEST:
+        link_test(args, args_len);
+        break;
+
+    default:
+        query_handle(frame[2], frame[3], args, args_len);
+        break;
+    }
+}
+
+// --------------------------------------------------------------------
+// Task that reads the UART RX line and splits it at the 0x00 delimiters
+// --------------------------------------------------------------------
+void link_receive(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] != 0)
+        {
+            if (link_rx_len < sizeof(link_rx)) {
+                link_rx[link_rx_len++] = data[i];
+            } else {
+                link_rx_overflow = true;
+            }
+            continue;
+        }
+
+        if (!link_rx_overflow) {
+            link_command(link_rx, link_rx_len);
+        }
+        link_rx_len = 0;
+        link_rx_overflow = false;
+    }
+}
+
+static void link_task(void *arg)
+{
+    uint8_t chunk[64];
+
+    while (1)
+    {
+        int n = uart_read_bytes(link_port, chunk, sizeof(chunk), LINK_RX_TICKS);
+        if (n > 0) {
+            link_receive(chunk, n);
+        }
+        link_check_deadline();
+    }
+}
+
+void link_start(uart_port_t port)
+{
+    link_port = port;
+    if (uart_get_baudrate(port, &link_baud) != ESP_OK) {
+        link_baud = 0;
+    }
+
+    // Queries (query.c) run in this task too
+    xTaskCreatePinnedToCore(link_task, "link", 4096, NULL,
+                            LINK_TASK_PRIO, NULL, CPU_USAGE_TASK_CORE);
+}
+
+// --------------------------------------------------------------------
+// Bandwidth budget
+// --------------------------------------------------------------------
+void link_account(uint8_t type, size_t bytes)
+{
+    if (type >= LINK_MSG_TYPES) {
+        return;
+    }
+
+    portENTER_CRITICAL(&budget_lock);
+    budget_bytes[type] += bytes;
+    budget_msgs[type]++;
+    portEXIT_CRITICAL(&budget_lock);
+}
+
+static void link_get_metric(const void *ctx, uint32_t index, tlm_budget_entry_t *out)
+{
+    *out = ((const tlm_budget_entry_t *)ctx)[index];
+}
+
+void link_send_budget(void)
+{
+    uint32_t bytes[LINK_MSG_TYPES];
+    uint32_t msgs[LINK_MSG_TYPES];
+    tlm_budget_entry_t metrics[LINK_MSG_TYPES];
+    TickType_t now = xTaskGetTickCount();
+    TickType_t elapsed = now - budget_tick;
+
+    if (elapsed == 0) {
+        return;
+    }
+
+    portENTER_CRITICAL(&budget_lock);
+    memcpy(bytes, budget_bytes, sizeof(bytes));
+    memcpy(msgs, budget_msgs, sizeof(msgs));
+    memset(budget_bytes, 0, sizeof(budget_bytes));
+    memset(budget_msgs, 0, sizeof(budget_msgs));
+    portEXIT_CRITICAL(&budget_lock);
+    budget_tick = now;
+
+    tlm_budget_t m = {
+        .baud = link_baud,
+        .capacity = link_baud / 10,
+        .get_metrics = link_get_metric,
+        .ctx = metrics,
+    };
+
+    for (uint32_t type = 0; type < LINK_MSG_TYPES; type++)
+    {
+        if (msgs[type] == 0) {
+            continue;
+        }
+        tlm_budget_entry_t *e = &metrics[m.count++];
+        e->type = type;
+        e->bytes_per_s = (uint32_t)((uint64_t)bytes[type] * configTICK_RATE_HZ / elapsed);
+        e->msgs_per_min = (uint32_t)((uint64_t)msgs[type] * 60 * configTICK_RATE_HZ / elapsed);
+        m.used += e->bytes_per_s;
+    }
+
+    cpu_usage_publish_tlm(&tlm_budget_codec, &m, 0);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/uart.h"
+#include "telemetry.h"
+
+
+// --------------------------------------------------------------------
+// Serial link control: baud negotiation and bandwidth budget
+// --------------------------------------------------------------------
+//
+// The host talks back on the UART RX line in CMD frames (same framing as
+// wire.h). WIRE_CMD_BAUD moves the link to another rate: the device
+// answers LINK ACK at the old rate, switches, then waits LINK_CONFIRM_TICKS
+// for the WIRE_CMD_LINK_TEST pattern at the new one. It echoes the pattern
+// in a CONFIRMED reply, or goes back to the old rate and says REVERTED.
+// The host does the same on its side when no echo arrives, so a rate the
+// cable or the USB bridge cannot do costs about a second.
+// Any other command is a query, see query.h.
+//
+// The budget adds up the bytes each kind of message takes on the serial
+// link, reported with link_send_budget() against the capacity of the line
+// (baud / 10 for 8N1).
+//
+#define LINK_MIN_BAUD           9600
+#define LINK_MAX_BAUD           2000000
+#define LINK_CONFIRM_TICKS      pdMS_TO_TICKS(1000)
+#define LINK_RX_TICKS           pdMS_TO_TICKS(100)      // also how often the confirm deadline is checked
+#define LINK_FRAME_MAX          (LINK_TEST_LEN + 16)    // COBS of the longest command
+#define LINK_MSG_TYPES          24                      // WIRE_MSG_* values the budget keeps apart
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+
+// Serial link on the UART driver: read commands from its RX line. Without
+// it the budget still counts, with an unknown capacity.
+void link_start(uart_port_t port);
+
+// Bytes of the RX line, each command runs when its 0x00 delimiter comes.
+// The link task reads them, a host test can hand them in itself.
+void link_receive(const uint8_t *data, size_t len);
+
+// Any message as a binary frame straight to the serial link, between two
+// messages of the sinks. False if there was no memory to encode it.
+bool link_send(const tlm_codec_t *codec, const void *msg);
+
+// A message of that type took bytes on the serial link
+void link_account(uint8_t type, size_t bytes);
+
+// Publish the budget since the last call
+void link_send_budget(void);
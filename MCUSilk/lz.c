@@ -0,0 +1,88 @@
+#include <stdbool.h>
+#include "lz.h"
+
+
+typedef struct {
+    uint8_t *out;
+    size_t cap;
+    size_t len;
+    uint32_t acc;               // pending bits, the low `bits` of it
+    uint8_t bits;
+    bool overflow;
+} lz_bits_t;
+
+static void lz_put_bits(lz_bits_t *b, uint32_t v, uint8_t n)
+{
+    b->acc = (b->acc << n) | v;
+    b->bits += n;
+
+    while (b->bits >= 8)
+    {
+        b->bits -= 8;
+        if (b->len < b->cap) {
+            b->out[b->len++] = (uint8_t)(b->acc >> b->bits);
+        } else {
+            b->overflow = true;
+        }
+    }
+}
+
+// --------------------------------------------------------------------
+// Longest match for in[pos..] in the window behind it, the nearest one
+// on a tie. Cost is at most LZ_WINDOW x LZ_MAX_MATCH compares per call,
+// in practice most candidates fail on the first byte.
+// --------------------------------------------------------------------
+static size_t lz_match(const uint8_t *in, size_t len, size_t pos, size_t *distance)
+{
+    size_t max = len - pos < LZ_MAX_MATCH ? len - pos : LZ_MAX_MATCH;
+    size_t start = pos > LZ_WINDOW ? pos - LZ_WINDOW : 0;
+    size_t best = 0;
+
+    for (size_t i = pos; i-- > start; )
+    {
+        if (in[i] != in[pos]) {
+            continue;
+        }
+
+        size_t n = 1;
+        while (n < max && in[i + n] == in[pos + n]) {
+            n++;
+        }
+        if (n > best) {
+            best = n;
+            *distance = pos - i;
+            if (n == max) {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+size_t lz_compress(const uint8_t *in, size_t len, uint8_t *out, size_t cap)
+{
+    lz_bits_t b = { .out = out, .cap = cap };
+    size_t pos = 0;
+
+    while (pos < len && !b.overflow)
+    {
+        size_t distance = 0;
+        size_t n = lz_match(in, len, pos, &distance);
+
+        if (n >= LZ_MIN_MATCH) {
+            lz_put_bits(&b, 0, 1);
+            lz_put_bits(&b, (uint32_t)(distance - 1), WIRE_LZ_WINDOW_BITS);
+            lz_put_bits(&b, (uint32_t)(n - 1), WIRE_LZ_LOOKAHEAD_BITS);
+            pos += n;
+        } else {
+            lz_put_bits(&b, 0x100 | in[pos], 9);
+            pos++;
+        }
+    }
+
+    // Zero padding up to the byte boundary
+    if (b.bits) {
+        lz_put_bits(&b, 0, 8 - b.bits);
+    }
+    return b.overflow ? 0 : b.len;
+}
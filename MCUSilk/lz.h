@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "telemetry_defs.h"
+
+
+// --------------------------------------------------------------------
+// LZSS compression (WIRE_MSG_LZ frames)
+// --------------------------------------------------------------------
+//
+// heatshrink style bit stream, packed MSB first:
+//   '1' + 8 bits                         literal byte
+//   '0' + WINDOW_BITS + LOOKAHEAD_BITS   copy (length - 1) + 1 bytes from
+//                                        (distance - 1) + 1 bytes back
+// A copy may overlap the bytes it produces. The last byte is padded with
+// zero bits, too few to form a copy, so the decoder stops there.
+//
+// The encoder searches the input itself for matches, so it needs no window
+// buffer, hash table or heap, only the caller's output buffer. A message is
+// compressed on its own, a lost frame does not affect the next one.
+//
+#define LZ_WINDOW           (1u << WIRE_LZ_WINDOW_BITS)
+#define LZ_MAX_MATCH        (1u << WIRE_LZ_LOOKAHEAD_BITS)
+#define LZ_MIN_MATCH        2       // a copy (13 bits) beats two literals (18 bits)
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+
+// Compressed size, 0 if the stream does not fit in cap
+size_t lz_compress(const uint8_t *in, size_t len, uint8_t *out, size_t cap);
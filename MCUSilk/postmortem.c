@@ -0,0 +1,263 @@
+#include <stddef.h>
+#include "postmortem.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "stream.h"
+
+
+// --------------------------------------------------------------------
+// Buffer kept across resets
+// --------------------------------------------------------------------
+typedef struct {
+    uint32_t magic;
+    uint32_t sample_head;           // next slot to write, range checked on boot
+    uint32_t sample_count;
+    postmortem_sample_t samples[POSTMORTEM_MAX_SAMPLES];
+
+    // Written from ISR context, one ring per core so no core waits for
+    // another. Validated per event instead of by the CRC.
+    uint32_t event_head[CPU_USAGE_MAX_CORES];   // total events written, slot = head % POSTMORTEM_MAX_EVENTS
+    postmortem_event_t events[CPU_USAGE_MAX_CORES][POSTMORTEM_MAX_EVENTS];
+} postmortem_buffer_t;
+
+#if POSTMORTEM_ENABLE
+    POSTMORTEM_ATTR static postmortem_buffer_t pm_buf;
+#endif
+
+static volatile bool pm_armed = false;
+
+
+// --------------------------------------------------------------------
+// Helpers
+// --------------------------------------------------------------------
+#if POSTMORTEM_ENABLE
+
+static uint32_t postmortem_sample_crc(const postmortem_sample_t *s)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)s, offsetof(postmortem_sample_t, crc));
+}
+
+static inline uint32_t IRAM_ATTR postmortem_event_check(const postmortem_event_t *e)
+{
+    return e->end_cycles ^ e->tag ^ e->duration_cycles ^ POSTMORTEM_MAGIC;
+}
+
+static const char *postmortem_reset_name(esp_reset_reason_t reason)
+{
+    switch (reason) {
+        case ESP_RST_SW:        return "SW";
+        case ESP_RST_PANIC:     return "PANIC";
+        case ESP_RST_INT_WDT:   return "INT_WDT";
+        case ESP_RST_TASK_WDT:  return "TASK_WDT";
+        case ESP_RST_WDT:       return "WDT";
+        case ESP_RST_BROWNOUT:  return "BROWNOUT";
+        case ESP_RST_DEEPSLEEP: return "DEEPSLEEP";
+        case ESP_RST_EXT:       return "EXT";
+        default:                return "UNKNOWN";
+    }
+}
+
+static void postmortem_print(void (*print_fn)(char *msg), char *msg)
+{
+    if (print_fn == NULL)
+    {
+        printf("%s\n", msg);
+    }
+    else
+    {
+        print_fn(msg);
+    }
+}
+
+static void postmortem_reset(void)
+{
+    memset(&pm_buf, 0, sizeof(pm_buf));
+    pm_buf.magic = POSTMORTEM_MAGIC;
+}
+
+// --------------------------------------------------------------------
+// One stored sample as a JSON line, task names escaped
+// --------------------------------------------------------------------
+typedef struct {
+    const char *reason;
+    const postmortem_sample_t *s;
+} postmortem_line_t;
+
+static void postmortem_sample_json(stream_writer_t *w, const void *ctx)
+{
+    const postmortem_line_t *l = ctx;
+    const postmortem_sample_t *s = l->s;
+
+    stream_printf(w, "{ \"postmortem\": { \"reset_reason\": \"%s\", ", l->reason);
+    stream_printf(w, "\"time_ms\": %" PRIu32 ", \"heap_free\": %" PRIu32 ", \"tasks\": [ ",
+                  s->timestamp_ms, s->heap_free);
+
+    uint32_t task_count = s->task_count < POSTMORTEM_MAX_TASKS ? s->task_count : POSTMORTEM_MAX_TASKS;
+    for (uint32_t i = 0; i < task_count; i++)
+    {
+        // Checked by the CRC, still never read past the field
+        char name[sizeof(s->tasks[i].task_name) + 1];
+        memcpy(name, s->tasks[i].task_name, sizeof(s->tasks[i].task_name));
+        name[sizeof(name) - 1] = '\0';
+
+        stream_puts(w, "{\"task_name\": ");
+        stream_put_json_str(w, name);
+        stream_printf(w, ", \"percentage\": %u, \"core\": %d}%s",
+                      s->tasks[i].percentage, s->tasks[i].core_id,
+                      (i < task_count - 1) ? "," : "");
+    }
+
+    stream_puts(w, " ] } }");
+}
+
+// --------------------------------------------------------------------
+// Dump the previous boot's history, oldest first, the ISR events core by core
+// --------------------------------------------------------------------
+static void postmortem_dump(void (*print_fn)(char *msg), const char *reason)
+{
+    static char line[POSTMORTEM_LINE_MAX];
+
+    uint32_t count = pm_buf.sample_count;
+    for (uint32_t n = 0; n < count; n++)
+    {
+        uint32_t idx = (pm_buf.sample_head + POSTMORTEM_MAX_SAMPLES - count + n) % POSTMORTEM_MAX_SAMPLES;
+        const postmortem_sample_t *s = &pm_buf.samples[idx];
+        if (s->crc != postmortem_sample_crc(s))
+        {
+            continue;   // reset while this sample was being written
+        }
+
+        postmortem_line_t l = { .reason = reason, .s = s };
+        if (stream_fill(postmortem_sample_json, &l, line, sizeof(line)) != 0) {
+            postmortem_print(print_fn, line);
+        }
+    }
+
+    for (int core = 0; core < CPU_USAGE_MAX_CORES; core++)
+    {
+        uint32_t head = pm_buf.event_head[core];
+        uint32_t events = head < POSTMORTEM_MAX_EVENTS ? head : POSTMORTEM_MAX_EVENTS;
+        for (uint32_t n = 0; n < events; n++)
+        {
+            const postmortem_event_t *e = &pm_buf.events[core][(head - events + n) % POSTMORTEM_MAX_EVENTS];
+            if (e->check != postmortem_event_check(e))
+            {
+                continue;   // torn write while the core went down
+            }
+
+            snprintf(line, sizeof(line),
+                "{ \"postmortem\": { \"reset_reason\": \"%s\", \"core\": %d, \"end_cycles\": %" PRIu32 ", "
+                "\"tag\": %" PRIu32 ", \"duration_cycles\": %" PRIu32 " } }",
+                reason, core, e->end_cycles, e->tag, e->duration_cycles);
+            postmortem_print(print_fn, line);
+        }
+    }
+}
+
+#endif
+
+// --------------------------------------------------------------------
+// Check for a valid buffer from the previous boot, dump it and re-arm.
+// Must run before any other monitor output. Returns true if a dump was printed.
+// --------------------------------------------------------------------
+bool postmortem_init(void (*print_fn)(char *msg))
+{
+    bool dumped = false;
+
+#if POSTMORTEM_ENABLE
+    esp_reset_reason_t reason = esp_reset_reason();
+
+    // On power-on the memory content is random, never trust it
+    if (reason != ESP_RST_POWERON &&
+        pm_buf.magic == POSTMORTEM_MAGIC &&
+        pm_buf.sample_count <= POSTMORTEM_MAX_SAMPLES &&
+        pm_buf.sample_head < POSTMORTEM_MAX_SAMPLES)
+    {
+        postmortem_dump(print_fn, postmortem_reset_name(reason));
+        dumped = true;
+    }
+
+    postmortem_reset();
+    pm_armed = true;
+#endif
+
+    return dumped;
+}
+
+// --------------------------------------------------------------------
+// Store one stats period, keeping the busiest POSTMORTEM_MAX_TASKS tasks
+// --------------------------------------------------------------------
+void postmortem_record_stats(const stats_result_t *res, uint32_t heap_free)
+{
+#if POSTMORTEM_ENABLE
+    if (!pm_armed || res == NULL || res->status != ESP_OK) {
+        return;
+    }
+
+    postmortem_sample_t *s = &pm_buf.samples[pm_buf.sample_head];
+    memset(s, 0, sizeof(*s));
+    s->timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    s->heap_free = heap_free;
+
+    for (size_t i = 0; i < res->task_count; i++)
+    {
+        const task_stats_t *t = &res->tasks[i];
+        if (t->created || t->deleted) {
+            continue;
+        }
+
+        uint32_t slot = s->task_count;
+        if (slot == POSTMORTEM_MAX_TASKS)
+        {
+            // Full: replace the least busy entry if this one is busier
+            slot = 0;
+            for (uint32_t k = 1; k < POSTMORTEM_MAX_TASKS; k++) {
+                if (s->tasks[k].percentage < s->tasks[slot].percentage) {
+                    slot = k;
+                }
+            }
+            if (s->tasks[slot].percentage >= t->percentage) {
+                continue;
+            }
+        }
+        else
+        {
+            s->task_count++;
+        }
+
+        memcpy(s->tasks[slot].task_name, t->task_name, sizeof(s->tasks[slot].task_name));
+        s->tasks[slot].percentage = (uint8_t)(t->percentage > 100 ? 100 : t->percentage);
+        s->tasks[slot].core_id = (int8_t)t->core_id;
+    }
+
+    // Sealed before it is counted, a reset in between leaves the older history intact
+    s->crc = postmortem_sample_crc(s);
+    pm_buf.sample_head = (pm_buf.sample_head + 1) % POSTMORTEM_MAX_SAMPLES;
+    if (pm_buf.sample_count < POSTMORTEM_MAX_SAMPLES) {
+        pm_buf.sample_count++;
+    }
+#endif
+}
+
+// --------------------------------------------------------------------
+// Store one ISR event (called from ISR_Trace_Exit under the lock of core):
+// no lock and no timer read of its own on the ISR path
+// --------------------------------------------------------------------
+void IRAM_ATTR postmortem_record_isr(int core, uint32_t tag, uint32_t end_cycles, uint32_t duration_cycles)
+{
+#if POSTMORTEM_ENABLE
+    if (!pm_armed) {
+        return;
+    }
+
+    postmortem_event_t *e = &pm_buf.events[core][pm_buf.event_head[core] % POSTMORTEM_MAX_EVENTS];
+    e->end_cycles = end_cycles;
+    e->tag = tag;
+    e->duration_cycles = duration_cycles;
+    e->check = postmortem_event_check(e);
+    pm_buf.event_head[core]++;
+#endif
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_attr.h"
+#include "CPU_usage.h"
+
+
+// --------------------------------------------------------------------
+// Configuration
+// --------------------------------------------------------------------
+
+// Keeps the last POSTMORTEM_MAX_SAMPLES stats periods (STATS_TICKS + MEASURING_TICKS
+// each, ~3 s by default) and the last POSTMORTEM_MAX_EVENTS ISR events of each core
+// in memory that is not cleared on a panic / watchdog / software reset.
+#define POSTMORTEM_ENABLE           1
+#define POSTMORTEM_MAX_SAMPLES      10
+#define POSTMORTEM_MAX_TASKS        12
+#define POSTMORTEM_MAX_EVENTS       32
+
+// __NOINIT_ATTR (.noinit in DRAM) survives panic and watchdog resets.
+// Use RTC_NOINIT_ATTR instead if the buffer must also survive deep sleep.
+#define POSTMORTEM_ATTR             __NOINIT_ATTR
+
+#define POSTMORTEM_MAGIC            0x504D5254  // "PMRT"
+
+// Longest dump line: the header and tail plus one task entry of at most
+// 141 characters (15 char name escaped as \u00XX each, "-128" core) per stored task
+#define POSTMORTEM_LINE_MAX         (128 + POSTMORTEM_MAX_TASKS * 152)
+
+
+// --------------------------------------------------------------------
+// Structs
+// --------------------------------------------------------------------
+typedef struct {
+    char task_name[16];
+    uint8_t percentage;
+    int8_t core_id;
+} postmortem_task_t;
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint32_t heap_free;
+    uint32_t task_count;
+    postmortem_task_t tasks[POSTMORTEM_MAX_TASKS];
+    uint32_t crc;               // covers this sample only, a torn write loses just this one
+} postmortem_sample_t;
+
+// Cycles are the count of the core the ISR ran on, taken in ISR_Trace_Exit().
+// Only events of one core can be put in order and apart by them.
+typedef struct {
+    uint32_t end_cycles;
+    uint32_t tag;
+    uint32_t duration_cycles;
+    uint32_t check;             // per-event checksum, the ISR path does not update the CRC
+} postmortem_event_t;
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+bool postmortem_init(void (*print_fn)(char *msg));
+void postmortem_record_stats(const stats_result_t *res, uint32_t heap_free);
+// From ISR_Trace_Exit() with the trace lock of core held, nothing else writes its ring
+void postmortem_record_isr(int core, uint32_t tag, uint32_t end_cycles, uint32_t duration_cycles);
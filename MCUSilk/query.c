@@ -0,0 +1,238 @@
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+#include "link.h"
+#include "CPU_usage.h"
+#include "telemetry.h"
+#include "flashlog.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+
+
+// Classes of heaps in the map, one line each, left out when no heap has them
+static const uint32_t query_heap_caps[] = {
+    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    MALLOC_CAP_DMA,
+    MALLOC_CAP_EXEC,
+    MALLOC_CAP_SPIRAM,
+    MALLOC_CAP_RTCRAM,
+};
+
+#define QUERY_HEAP_LINES    (sizeof(query_heap_caps) / sizeof(query_heap_caps[0]))
+
+
+static void query_get_task(const void *ctx, uint32_t index, tlm_task_detail_t *out)
+{
+    const TaskStatus_t *t = &((const TaskStatus_t *)ctx)[index];
+
+    out->task_name = t->pcTaskName;
+    out->number = t->xTaskNumber;
+    out->state = t->eCurrentState;
+    out->priority = t->uxCurrentPriority;
+    out->base_priority = t->uxBasePriority;
+    out->core = cpu_usage_task_core(t->xHandle);
+    out->stack_free = t->usStackHighWaterMark;
+    out->run_time = t->ulRunTimeCounter;
+}
+
+static void query_get_region(const void *ctx, uint32_t index, tlm_heap_region_t *out)
+{
+    *out = ((const tlm_heap_region_t *)ctx)[index];
+}
+
+// --------------------------------------------------------------------
+// Tasks and memory over a window starting now, as the tasks and memory
+// messages so the host shows them like any report
+// --------------------------------------------------------------------
+static uint32_t query_snapshot(const uint8_t *args, size_t len)
+{
+    uint32_t ms = QUERY_SNAPSHOT_MS;
+
+    if (len >= 2) {
+        ms = (uint32_t)args[0] | (uint32_t)args[1] << 8;
+    }
+    if (ms == 0 || ms > QUERY_SNAPSHOT_MAX_MS) {
+        return QUERY_BAD_ARGS;
+    }
+
+    stats_result_t res = print_real_time_stats(pdMS_TO_TICKS(ms));
+    if (res.status != ESP_OK)
+    {
+        if (res.tasks) free(res.tasks);
+        return res.status == ESP_ERR_NO_MEM ? QUERY_NO_MEM : QUERY_FAILED;
+    }
+
+    tlm_tasks_t tasks = cpu_usage_tasks_msg(&res);
+    tlm_memory_t mem = cpu_usage_memory();
+    bool ok = link_send(&tlm_tasks_codec, &tasks) && link_send(&tlm_memory_codec, &mem);
+
+    free(res.tasks);
+    return ok ? QUERY_OK : QUERY_NO_MEM;
+}
+
+// One task by name, only its stack is scanned
+static uint32_t query_task(uint8_t request, const uint8_t *args, size_t len)
+{
+    char name[configMAX_TASK_NAME_LEN];
+
+    // The host may pad the name with NULs
+    len = strnlen((const char *)args, len);
+    if (len == 0 || len >= sizeof(name)) {
+        return QUERY_BAD_ARGS;
+    }
+    memcpy(name, args, len);
+    name[len] = '\0';
+
+    TaskHandle_t task = xTaskGetHandle(name);
+    if (task == NULL) {
+        return QUERY_NOT_FOUND;
+    }
+
+    TaskStatus_t status;
+    vTaskGetInfo(task, &status, pdTRUE, eInvalid);
+
+    tlm_task_info_t m = { .request = request, .count = 1, .get_tasks = query_get_task, .ctx = &status };
+    return link_send(&tlm_task_info_codec, &m) ? QUERY_OK : QUERY_NO_MEM;
+}
+
+// Every task with its stack high water mark
+static uint32_t query_stacks(uint8_t request)
+{
+    UBaseType_t count = uxTaskGetNumberOfTasks() + ARRAY_SIZE_OFFSET;
+    TaskStatus_t *tasks = malloc(sizeof(TaskStatus_t) * count);
+
+    if (tasks == NULL) {
+        return QUERY_NO_MEM;
+    }
+
+    count = uxTaskGetSystemState(tasks, count, NULL);
+
+    tlm_task_info_t m = { .request = request, .count = count, .get_tasks = query_get_task, .ctx = tasks };
+    bool ok = link_send(&tlm_task_info_codec, &m);
+
+    free(tasks);
+    return ok ? QUERY_OK : QUERY_NO_MEM;
+}
+
+// Free space, fragmentation and low water mark per class of heaps
+static uint32_t query_heap(uint8_t request)
+{
+    tlm_heap_region_t regions[QUERY_HEAP_LINES];
+    tlm_heap_t m = { .request = request, .get_regions = query_get_region, .ctx = regions };
+
+    for (size_t i = 0; i < QUERY_HEAP_LINES; i++)
+    {
+        uint32_t caps = query_heap_caps[i];
+        size_t total = heap_caps_get_total_size(caps);
+        if (total == 0) {
+            continue;
+        }
+
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, caps);
+        regions[m.count++] = (tlm_heap_region_t) {
+            .caps = caps,
+            .total = total,
+            .free = info.total_free_bytes,
+            .largest_free = info.largest_free_block,
+            .min_free = info.minimum_free_bytes,
+            .allocated_blocks = info.allocated_blocks,
+            .free_blocks = info.free_blocks,
+        };
+    }
+
+    return link_send(&tlm_heap_codec, &m) ? QUERY_OK : QUERY_NO_MEM;
+}
+
+// --------------------------------------------------------------------
+// The flash log, oldest record first. The caller holds the serial link,
+// so nothing else gets between log_info and the REPLY.
+// --------------------------------------------------------------------
+static uint32_t query_dump(uint8_t request)
+{
+    flashlog_t *log = cpu_usage_log_lock();
+    if (log == NULL) {
+        return QUERY_NOT_FOUND;
+    }
+
+    size_t max = flashlog_record_max(log);
+    char *record = malloc(max);
+    if (record == NULL)
+    {
+        cpu_usage_log_unlock();
+        return QUERY_NO_MEM;
+    }
+
+    tlm_log_info_t m = {
+        .request = request,
+        .capacity = flashlog_capacity(log),
+        .sectors = log->sectors,
+        .sector_size = log->backend.sector_size,
+    };
+    flashlog_cursor_t c;
+    size_t len;
+
+    // One pass for the size, so the host can tell how far along it is
+    flashlog_rewind(log, &c);
+    while ((len = flashlog_next(log, &c, record, max)) > 0)
+    {
+        m.records++;
+        m.bytes += len;
+    }
+
+    bool ok = link_send(&tlm_log_info_codec, &m);
+
+    flashlog_rewind(log, &c);
+    while (ok && (len = flashlog_next(log, &c, record, max)) > 0) {
+        cpu_usage_serial_raw(record, len);
+    }
+    link_account(WIRE_MSG_LOG_INFO, m.bytes);
+
+    cpu_usage_log_unlock();
+    free(record);
+    return ok ? QUERY_OK : QUERY_NO_MEM;
+}
+
+void query_handle(uint8_t cmd, uint8_t request, const uint8_t *args, size_t len)
+{
+    uint32_t status;
+    bool hold = cmd == WIRE_CMD_DUMP;
+
+    if (hold) {
+        cpu_usage_serial_hold(true);
+    }
+
+    switch (cmd)
+    {
+    case WIRE_CMD_SNAPSHOT:
+        status = query_snapshot(args, len);
+        break;
+
+    case WIRE_CMD_TASK:
+        status = query_task(request, args, len);
+        break;
+
+    case WIRE_CMD_STACKS:
+        status = query_stacks(request);
+        break;
+
+    case WIRE_CMD_HEAP:
+        status = query_heap(request);
+        break;
+
+    case WIRE_CMD_DUMP:
+        status = query_dump(request);
+        break;
+
+    default:
+        status = QUERY_UNKNOWN;
+        break;
+    }
+
+    tlm_reply_t reply = { .request = request, .cmd = cmd, .status = status };
+    link_send(&tlm_reply_codec, &reply);
+
+    if (hold) {
+        cpu_usage_serial_hold(false);
+    }
+}
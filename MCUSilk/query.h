@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "telemetry_defs.h"
+
+
+// --------------------------------------------------------------------
+// Queries: what the periodic report leaves out, computed on request
+// --------------------------------------------------------------------
+//
+// The host asks with a CMD frame on the UART RX line (link.h) and gets the
+// answer as binary frames on the serial link, whatever its format. Every
+// query ends with a REPLY carrying its request id and a QUERY_* status,
+// after the data:
+//
+//   WIRE_CMD_SNAPSHOT  [u16 window ms]   tasks and memory measured now over
+//                                        the window (QUERY_SNAPSHOT_MS)
+//   WIRE_CMD_TASK      task name         task_info of that task
+//   WIRE_CMD_STACKS                      task_info of every task
+//   WIRE_CMD_HEAP                        heap map, one line per class of heaps
+//   WIRE_CMD_DUMP                        log_info, then the flash log (flashlog.h)
+//                                        oldest record first, each the frame it
+//                                        was stored as
+//
+// Stack high water marks scan the unused part of each stack and the heap map
+// walks every block with the heap locked, so both only run here. Queries run
+// in the link task one at a time, the reports go on meanwhile. A dump holds
+// the serial link until its REPLY: the reports wait and the flash log sink
+// drops what comes in the meantime.
+//
+#define QUERY_SNAPSHOT_MS       100
+#define QUERY_SNAPSHOT_MAX_MS   2000
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+
+// A CMD frame link.c does not handle itself: answer it on the serial link
+void query_handle(uint8_t cmd, uint8_t request, const uint8_t *args, size_t len);
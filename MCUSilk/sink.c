@@ -0,0 +1,328 @@
+#include <stdlib.h>
+#include "sink.h"
+#include "freertos/task.h"
+
+
+// --------------------------------------------------------------------
+// Globals
+// --------------------------------------------------------------------
+static sink_t sinks[CPU_USAGE_MAX_SINKS];
+static size_t sink_num;
+static QueueHandle_t pool;                  // free sink_buf_t *
+static QueueHandle_t reserve;               // free sink_buf_t * only alerts take, refilled first
+static portMUX_TYPE sink_ref_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+bool sink_add(const cpu_usage_sink_cfg_t *cfg)
+{
+    if (sink_num == CPU_USAGE_MAX_SINKS || cfg->write == NULL) {
+        return false;
+    }
+
+    sink_t *s = &sinks[sink_num++];
+    s->cfg = *cfg;
+    if (s->cfg.depth == 0) {
+        s->cfg.depth = CPU_USAGE_SINK_DEPTH;
+    }
+    if (s->cfg.name == NULL) {
+        s->cfg.name = "sink";
+    }
+
+    // Binary layouts need the COBS framing of a stream, and are never
+    // compressed, so all binary sinks share one encoding (and one delta state)
+    if (s->cfg.format == CPU_USAGE_FORMAT_BINARY || s->cfg.format == CPU_USAGE_FORMAT_DELTA)
+    {
+        if (s->cfg.packets) {
+            s->cfg.format = CPU_USAGE_FORMAT_JSON;
+        } else {
+            s->cfg.compress = false;
+        }
+    }
+    return true;
+}
+
+size_t sink_count(void)
+{
+    return sink_num;
+}
+
+sink_t *sink_get(size_t index)
+{
+    return index < sink_num ? &sinks[index] : NULL;
+}
+
+// --------------------------------------------------------------------
+// Buffer pool
+// --------------------------------------------------------------------
+// The reserve is a queue of its own, so no check of the pool level can
+// race another bulk publisher into it
+sink_buf_t *sink_buf_get(bool alert)
+{
+    sink_buf_t *b;
+
+    if (xQueueReceive(pool, &b, 0) != pdTRUE &&
+        (!alert || xQueueReceive(reserve, &b, 0) != pdTRUE)) {
+        return NULL;
+    }
+    b->refs = 1;
+    b->len = 0;
+    b->stream = NULL;
+    b->release = NULL;
+    return b;
+}
+
+void sink_buf_ref(sink_buf_t *b)
+{
+    portENTER_CRITICAL(&sink_ref_lock);
+    b->refs++;
+    portEXIT_CRITICAL(&sink_ref_lock);
+}
+
+void sink_buf_put(sink_buf_t *b)
+{
+    uint8_t refs;
+
+    if (b == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&sink_ref_lock);
+    refs = --b->refs;
+    portEXIT_CRITICAL(&sink_ref_lock);
+
+    if (refs != 0) {
+        return;
+    }
+    if (b->release) {
+        b->release(b);
+    }
+    if (xQueueSend(reserve, &b, 0) != pdTRUE) {
+        xQueueSend(pool, &b, 0);
+    }
+}
+
+// --------------------------------------------------------------------
+// Token bucket: rate bytes per second, bursts up to one second or one
+// full message. Credit is kept in bytes * ticks per second so slow rates
+// do not round down to nothing between two ticks.
+// --------------------------------------------------------------------
+static uint64_t sink_burst(const sink_t *s)
+{
+    uint32_t burst = s->cfg.rate > CPU_USAGE_MSG_MAX ? s->cfg.rate : CPU_USAGE_MSG_MAX;
+    return (uint64_t)burst * configTICK_RATE_HZ;
+}
+
+// Refill the bucket, true if len fits. Charged by sink_rate_take() once
+// the message is queued, a full queue costs no credit. Under s->lock.
+static bool sink_rate_ok(sink_t *s, size_t len)
+{
+    if (s->cfg.rate == 0) {
+        return true;
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    s->credit += (uint64_t)(TickType_t)(now - s->credit_tick) * s->cfg.rate;
+    s->credit_tick = now;
+    if (s->credit > sink_burst(s)) {
+        s->credit = sink_burst(s);
+    }
+
+    return s->credit >= (uint64_t)len * configTICK_RATE_HZ;
+}
+
+static void sink_rate_take(sink_t *s, size_t len)
+{
+    uint64_t cost = (uint64_t)len * configTICK_RATE_HZ;
+    s->credit = s->credit > cost ? s->credit - cost : 0;
+}
+
+static bool sink_queued(sink_t *s, sink_buf_t *b)
+{
+    if (s->cfg.rate)
+    {
+        portENTER_CRITICAL(&s->lock);
+        sink_rate_take(s, b->len);
+        portEXIT_CRITICAL(&s->lock);
+    }
+    xTaskNotifyGive(s->task);
+    return true;
+}
+
+static void sink_dropped(sink_t *s, bool overflow)
+{
+    portENTER_CRITICAL(&s->lock);
+    s->dropped++;
+    if (overflow) {
+        s->overflow++;
+    }
+    portEXIT_CRITICAL(&s->lock);
+}
+
+bool sink_offer(sink_t *s, sink_buf_t *b, TickType_t ticks_to_wait)
+{
+    bool rate_ok = false;
+
+    if (b != NULL)
+    {
+        portENTER_CRITICAL(&s->lock);
+        rate_ok = sink_rate_ok(s, b->len);
+        portEXIT_CRITICAL(&s->lock);
+    }
+    if (!rate_ok) {
+        sink_dropped(s, false);
+        return false;
+    }
+
+    sink_buf_ref(b);
+
+    TickType_t wait = s->cfg.drop == CPU_USAGE_BLOCK ? ticks_to_wait : 0;
+    if (xQueueSend(s->queue, &b, wait) == pdTRUE) {
+        return sink_queued(s, b);
+    }
+
+    // Make room by letting the oldest one go. The sink task may have taken
+    // it in the meantime, then there is room anyway.
+    if (s->cfg.drop == CPU_USAGE_DROP_OLDEST)
+    {
+        sink_buf_t *old;
+        if (xQueueReceive(s->queue, &old, 0) == pdTRUE) {
+            sink_buf_put(old);
+            sink_dropped(s, true);
+        }
+        if (xQueueSend(s->queue, &b, 0) == pdTRUE) {
+            return sink_queued(s, b);
+        }
+    }
+
+    sink_buf_put(b);
+    sink_dropped(s, true);
+    return false;
+}
+
+bool sink_offer_alert(sink_t *s, sink_buf_t *b)
+{
+    if (b == NULL) {
+        s->alerts_dropped++;
+        return false;
+    }
+
+    sink_buf_ref(b);
+
+    // A sink stalled in its write leaves its lane full. The newest alert
+    // replaces the oldest, the sink task may have taken that one meanwhile.
+    while (xQueueSend(s->alerts, &b, 0) != pdTRUE)
+    {
+        sink_buf_t *old;
+        if (xQueueReceive(s->alerts, &old, 0) == pdTRUE) {
+            sink_buf_put(old);
+            s->alerts_dropped++;
+        }
+    }
+
+    xTaskNotifyGive(s->task);
+    return true;
+}
+
+// Strict priority: a waiting alert goes before any bulk message
+static bool sink_next(sink_t *s, sink_buf_t **b, bool *alert)
+{
+    *alert = xQueueReceive(s->alerts, b, 0) == pdTRUE;
+    return *alert || xQueueReceive(s->queue, b, 0) == pdTRUE;
+}
+
+// --------------------------------------------------------------------
+// One per sink, the only place its write function is called from
+// --------------------------------------------------------------------
+void sink_drain(sink_t *s)
+{
+    sink_buf_t *b;
+    bool alert;
+
+    while (sink_next(s, &b, &alert))
+    {
+        TickType_t start = xTaskGetTickCount();
+        if (alert)
+        {
+            TickType_t wait = start - b->queued;
+            s->alert_wait += wait;
+            if (wait > s->alert_wait_max) {
+                s->alert_wait_max = wait;
+            }
+            s->alerts_sent++;
+        }
+        size_t len = b->len;
+        if (b->stream) {
+            len = b->stream(s, b);
+        } else {
+            s->cfg.write(s->cfg.ctx, b->data, b->len);
+        }
+        s->busy += xTaskGetTickCount() - start;
+        s->bytes += len;
+        s->sent++;
+        sink_buf_put(b);
+    }
+}
+
+static void sink_task(void *arg)
+{
+    sink_t *s = arg;
+
+    while (1)
+    {
+        // Every offer notifies, both lanes are emptied before waiting again
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        sink_drain(s);
+    }
+}
+
+// --------------------------------------------------------------------
+// Everything the sinks need, allocated once
+// --------------------------------------------------------------------
+bool sink_start(size_t pool_size)
+{
+    size_t count = 4;
+    size_t kept = 2;            // for alerts only
+
+    for (size_t i = 0; i < sink_num; i++) {
+        count += sinks[i].cfg.depth + CPU_USAGE_ALERT_DEPTH + 1 + (sinks[i].cfg.drop == CPU_USAGE_BLOCK);
+        kept += CPU_USAGE_ALERT_DEPTH;
+    }
+
+    // Bulk needs a message and its spare on top of the reserve
+    if (pool_size != 0) {
+        count = pool_size > kept + 2 ? pool_size : kept + 2;
+    }
+
+    // A put fills the reserve, the rest goes to the pool, which has room for all
+    pool = xQueueCreate(count, sizeof(sink_buf_t *));
+    reserve = xQueueCreate(kept, sizeof(sink_buf_t *));
+    if (pool == NULL || reserve == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        sink_buf_t *b = malloc(sizeof(sink_buf_t));
+        if (b == NULL) {
+            return false;
+        }
+        b->refs = 1;
+        b->release = NULL;
+        sink_buf_put(b);
+    }
+
+    for (size_t i = 0; i < sink_num; i++)
+    {
+        sink_t *s = &sinks[i];
+        portMUX_INITIALIZE(&s->lock);
+        s->queue = xQueueCreate(s->cfg.depth, sizeof(sink_buf_t *));
+        s->alerts = xQueueCreate(CPU_USAGE_ALERT_DEPTH, sizeof(sink_buf_t *));
+        s->credit = sink_burst(s);
+        s->credit_tick = xTaskGetTickCount();
+        if (s->queue == NULL || s->alerts == NULL ||
+            xTaskCreatePinnedToCore(sink_task, s->cfg.name, CPU_USAGE_SINK_STACK, s,
+                                    SINK_TASK_PRIO, &s->task, CPU_USAGE_TASK_CORE) != pdPASS) {
+            return false;
+        }
+    }
+    return true;
+}
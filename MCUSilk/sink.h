@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "CPU_usage.h"
+
+
+// --------------------------------------------------------------------
+// Sink registry and shared message buffers
+// --------------------------------------------------------------------
+//
+// A message is encoded once per distinct sink encoding into a buffer from
+// a fixed pool and handed to every sink that takes that encoding by
+// reference; the last sink to finish with it returns it to the pool.
+// Each sink has its own queue of buffers and its own task calling write,
+// so a sink that stalls (MQTT without Wi-Fi) fills only its own queue and
+// drops by its own policy while the others keep going.
+//
+// Two lanes per sink: alerts (errors) and bulk telemetry. The sink task
+// always writes a waiting alert before the next bulk message, alerts skip
+// the rate limit, and their lane of CPU_USAGE_ALERT_DEPTH is never taken by
+// bulk messages, so an error still gets out when the bulk queue is full.
+// A full alert lane drops its oldest alert, so the newest is always queued
+// even on a sink stuck in its write.
+//
+// By default the pool holds depth + CPU_USAGE_ALERT_DEPTH + 1 buffers per
+// sink (queued plus the one being written), one more for a CPU_USAGE_BLOCK
+// sink (the message a publisher waits to queue) and two each for the bulk
+// and the alert publisher (message and its compressed / framed form), so
+// taking a buffer never fails. A smaller pool trades that for heap: with
+// every buffer in use a bulk message is dropped on the sinks it was for.
+// The alert publisher's pair and one buffer per alert slot are kept for
+// alerts in a queue of their own that returned buffers fill first, so full
+// bulk queues never starve them.
+//
+// A message can also be left for the sink task to produce itself when its
+// turn comes, one that need not fit a buffer (the streamed JSON report):
+// stream is then called in place of write, with the sink and whatever the
+// publisher put into data, and returns the bytes it wrote. release, if set,
+// frees what data points to once the last sink is done with it.
+//
+#define SINK_BUF_SIZE   (CPU_USAGE_MSG_MAX + 2)     // + line end or frame delimiter, + NUL
+
+typedef struct sink_buf sink_buf_t;
+typedef struct sink sink_t;
+
+struct sink_buf {
+    uint8_t refs;
+    TickType_t queued;          // when it was published, for the wait of alerts
+    size_t len;                 // what write gets, line end or frame delimiter included
+    size_t (*stream)(sink_t *s, sink_buf_t *b);     // NULL = write data
+    void (*release)(sink_buf_t *b);                 // NULL = nothing outside data
+    char data[SINK_BUF_SIZE];
+};
+
+struct sink {
+    cpu_usage_sink_cfg_t cfg;
+    QueueHandle_t queue;        // sink_buf_t *, bulk lane
+    QueueHandle_t alerts;       // sink_buf_t *, served first
+    TaskHandle_t task;
+    portMUX_TYPE lock;          // publishers may offer at once: credit, dropped and overflow
+    uint64_t credit;            // rate limit, bytes * configTICK_RATE_HZ
+    TickType_t credit_tick;
+    uint32_t dropped;
+    uint32_t overflow;          // drops because the queue was full, a sign the link is too slow
+    uint32_t sent;              // sent, bytes, busy and alert_wait: sink task only
+    uint32_t bytes;             // written, for the achieved throughput
+    TickType_t busy;            // ticks spent in write
+    uint32_t alerts_sent;
+    uint32_t alerts_dropped;    // overwritten or not encoded, under the alert publisher's lock
+    TickType_t alert_wait;      // ticks from publish to write, all alerts
+    TickType_t alert_wait_max;
+};
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+
+// Register before sink_start(), false if the registry is full
+bool sink_add(const cpu_usage_sink_cfg_t *cfg);
+
+// Allocates the pool and the queues and starts one task per sink.
+// pool buffers, 0 = the worst case above, never less than the alert reserve
+// and a bulk message.
+bool sink_start(size_t pool);
+
+size_t sink_count(void);
+sink_t *sink_get(size_t index);
+
+// NULL if the pool is empty (for bulk: down to the alert reserve),
+// the buffer starts with one reference
+sink_buf_t *sink_buf_get(bool alert);
+void sink_buf_ref(sink_buf_t *b);
+void sink_buf_put(sink_buf_t *b);
+
+// Queue b for s with a reference of its own. NULL b (the message could not
+// be encoded) counts as a drop. ticks_to_wait only applies to CPU_USAGE_BLOCK.
+bool sink_offer(sink_t *s, sink_buf_t *b, TickType_t ticks_to_wait);
+
+// Same on the alert lane: no rate limit, never waits, drops the oldest alert if the lane is full
+bool sink_offer_alert(sink_t *s, sink_buf_t *b);
+
+// Writes everything queued for s, alerts first. The body of the sink task,
+// which host tests without tasks call themselves.
+void sink_drain(sink_t *s);
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+
+
+// Filling pass of stream_alloc() / stream_fill()
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+} stream_buffer_t;
+
+
+void stream_init(stream_writer_t *s, stream_flush_fn flush, void *ctx)
+{
+    s->len = 0;
+    s->total = 0;
+    s->truncated = false;
+    s->flush = flush;
+    s->ctx = ctx;
+    s->chunk[0] = '\0';
+}
+
+static void stream_flush(stream_writer_t *s)
+{
+    if (s->len == 0) {
+        return;
+    }
+    s->chunk[s->len] = '\0';
+    if (s->flush) {
+        s->flush(s->ctx, s->chunk, s->len);
+    }
+    s->len = 0;
+}
+
+void stream_write(stream_writer_t *s, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t room = STREAM_CHUNK_SIZE - 1 - s->len;
+        if (room == 0) {
+            stream_flush(s);
+            continue;
+        }
+
+        size_t n = len < room ? len : room;
+        memcpy(s->chunk + s->len, data, n);
+        s->len += n;
+        s->total += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void stream_puts(stream_writer_t *s, const char *str)
+{
+    stream_write(s, str, strlen(str));
+}
+
+// --------------------------------------------------------------------
+// Format into the free part of the chunk. If it does not fit, flush and
+// format again into the empty chunk, cutting what still does not fit.
+// --------------------------------------------------------------------
+void stream_printf(stream_writer_t *s, const char *fmt, ...)
+{
+    va_list ap;
+    size_t room = STREAM_CHUNK_SIZE - s->len;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(s->chunk + s->len, room, fmt, ap);
+    va_end(ap);
+
+    if (n < 0) {
+        s->chunk[s->len] = '\0';
+        s->truncated = true;
+        return;
+    }
+
+    if ((size_t)n >= room)
+    {
+        // Undo the partial item, it is formatted again after the flush
+        s->chunk[s->len] = '\0';
+        stream_flush(s);
+
+        va_start(ap, fmt);
+        n = vsnprintf(s->chunk, STREAM_CHUNK_SIZE, fmt, ap);
+        va_end(ap);
+
+        if (n < 0) {
+            s->chunk[0] = '\0';
+            s->truncated = true;
+            return;
+        }
+        if ((size_t)n >= STREAM_CHUNK_SIZE) {
+            n = STREAM_CHUNK_SIZE - 1;
+            s->truncated = true;
+        }
+    }
+
+    s->len += n;
+    s->total += n;
+}
+
+// --------------------------------------------------------------------
+// Quoted JSON string, escaping quotes, backslashes and control characters
+// --------------------------------------------------------------------
+void stream_put_json_str(stream_writer_t *s, const char *str)
+{
+    stream_write(s, "\"", 1);
+
+    for (const char *p = str; *p; p++)
+    {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            char esc[2] = { '\\', (char)c };
+            stream_write(s, esc, 2);
+        } else if (c < 0x20) {
+            stream_printf(s, "\\u%04x", c);
+        } else {
+            stream_write(s, p, 1);
+        }
+    }
+
+    stream_write(s, "\"", 1);
+}
+
+// Flush what is left, returns the message length
+size_t stream_end(stream_writer_t *s)
+{
+    stream_flush(s);
+    return s->total;
+}
+
+static void stream_to_buffer(void *ctx, const char *data, size_t len)
+{
+    stream_buffer_t *b = ctx;
+
+    if (len > b->cap - 1 - b->len) {
+        len = b->cap - 1 - b->len;
+    }
+    memcpy(b->buf + b->len, data, len);
+    b->len += len;
+}
+
+char *stream_alloc(stream_emit_fn emit, const void *ctx, size_t *len)
+{
+    stream_writer_t s;
+
+    stream_init(&s, NULL, NULL);
+    emit(&s, ctx);
+    size_t size = stream_end(&s);
+
+    char *buf = malloc(size + 1);
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    size = stream_fill(emit, ctx, buf, size + 1);
+    if (len) {
+        *len = size;
+    }
+    return buf;
+}
+
+// --------------------------------------------------------------------
+// Stream a message into buf (cap bytes, NUL included). Returns its length,
+// 0 if it does not fit.
+// --------------------------------------------------------------------
+size_t stream_fill(stream_emit_fn emit, const void *ctx, char *buf, size_t cap)
+{
+    stream_writer_t s;
+    stream_buffer_t b = { .buf = buf, .cap = cap, .len = 0 };
+
+    if (cap == 0) {
+        return 0;
+    }
+
+    stream_init(&s, stream_to_buffer, &b);
+    emit(&s, ctx);
+    size_t total = stream_end(&s);
+
+    b.buf[b.len] = '\0';
+    return total == b.len ? b.len : 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// --------------------------------------------------------------------
+// Streaming text writer
+// --------------------------------------------------------------------
+//
+// Text is formatted into a fixed chunk and handed to the flush function
+// whenever the chunk is full, so memory use does not depend on the size of
+// the message. Every write is bounds-checked against the chunk; a single
+// formatted item longer than a chunk is cut and sets truncated.
+//
+#define STREAM_CHUNK_SIZE       128     // including the NUL passed to flush
+
+// data is NUL terminated, len does not count the terminator
+typedef void (*stream_flush_fn)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    char chunk[STREAM_CHUNK_SIZE];
+    size_t len;                 // bytes waiting in chunk
+    size_t total;               // bytes produced so far, flushed or not
+    bool truncated;
+    stream_flush_fn flush;      // NULL only counts (sizing pass)
+    void *ctx;
+} stream_writer_t;
+
+// Writes one whole message, called once per pass by stream_alloc()
+typedef void (*stream_emit_fn)(stream_writer_t *s, const void *ctx);
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+void stream_init(stream_writer_t *s, stream_flush_fn flush, void *ctx);
+void stream_write(stream_writer_t *s, const char *data, size_t len);
+void stream_puts(stream_writer_t *s, const char *str);
+void stream_printf(stream_writer_t *s, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void stream_put_json_str(stream_writer_t *s, const char *str);
+size_t stream_end(stream_writer_t *s);
+
+// Exactly sized malloc'd copy of a streamed message (one counting pass, one filling pass)
+char *stream_alloc(stream_emit_fn emit, const void *ctx, size_t *len);
+
+// Into the caller's buffer instead, 0 if it does not fit
+size_t stream_fill(stream_emit_fn emit, const void *ctx, char *buf, size_t cap);
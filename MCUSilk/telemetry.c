@@ -0,0 +1,1390 @@
+// Generated by schema/generate.py from schema/telemetry.py, do not edit.
+#include <inttypes.h>
+#include "telemetry.h"
+
+
+// --------------------------------------------------------------------
+// Shared helpers
+// --------------------------------------------------------------------
+static uint32_t tlm_sat(uint32_t v, uint32_t max)
+{
+    return v > max ? max : v;
+}
+
+static void tlm_wire_array(wire_writer_t *w, const uint32_t *v, uint32_t n, size_t size)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t x = v ? v[i] : 0;
+        if (size == 1) {
+            wire_put_u8(w, (uint8_t)tlm_sat(x, UINT8_MAX));
+        } else if (size == 2) {
+            wire_put_u16(w, (uint16_t)tlm_sat(x, UINT16_MAX));
+        } else {
+            wire_put_u32(w, x);
+        }
+    }
+}
+
+static void tlm_json_key(stream_writer_t *s, bool *first, const char *key)
+{
+    stream_puts(s, *first ? "\"" : ", \"");
+    stream_puts(s, key);
+    stream_puts(s, "\": ");
+    *first = false;
+}
+
+static void tlm_json_array(stream_writer_t *s, const uint32_t *v, uint32_t n)
+{
+    stream_puts(s, "[");
+    for (uint32_t i = 0; i < n; i++) {
+        stream_printf(s, "%s%" PRIu32, i ? ", " : "", v ? v[i] : 0);
+    }
+    stream_puts(s, "]");
+}
+
+static void tlm_cbor_array(cbor_writer_t *w, const uint32_t *v, uint32_t n)
+{
+    cbor_put_array(w, n);
+    for (uint32_t i = 0; i < n; i++) {
+        cbor_put_uint(w, v ? v[i] : 0);
+    }
+}
+
+static bool tlm_has_name(const char *name)
+{
+    return name && name[0];
+}
+
+// --------------------------------------------------------------------
+// task entries
+// --------------------------------------------------------------------
+static void tlm_wire_put_task(wire_writer_t *w, const tlm_task_t *r)
+{
+    wire_put_name(w, r->task_name);
+    wire_put_u32(w, r->run_time);
+    wire_put_u32(w, r->isr_time);
+    wire_put_u8(w, (uint8_t)tlm_sat(r->percentage, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)(int8_t)r->core);
+    wire_put_u8(w, (uint8_t)tlm_sat(r->flags, UINT8_MAX));
+}
+
+static void tlm_json_put_task(stream_writer_t *s, const tlm_task_t *r)
+{
+    bool first = true;
+
+    stream_puts(s, "{");
+    if (r->flags & WIRE_TASK_CREATED) {
+        tlm_json_key(s, &first, TLM_KEY_TASK_NAME);
+        stream_put_json_str(s, r->task_name ? r->task_name : "");
+        tlm_json_key(s, &first, TLM_KEY_STATUS);
+        stream_put_json_str(s, "created");
+    }
+    else if (r->flags & WIRE_TASK_DELETED) {
+        tlm_json_key(s, &first, TLM_KEY_TASK_NAME);
+        stream_put_json_str(s, r->task_name ? r->task_name : "");
+        tlm_json_key(s, &first, TLM_KEY_STATUS);
+        stream_put_json_str(s, "deleted");
+    }
+    else if (r->flags & WIRE_TASK_ISR) {
+        tlm_json_key(s, &first, TLM_KEY_TASK_NAME);
+        stream_put_json_str(s, r->task_name ? r->task_name : "");
+        tlm_json_key(s, &first, TLM_KEY_RUN_TIME);
+        stream_printf(s, "%" PRIu32, r->run_time);
+        tlm_json_key(s, &first, TLM_KEY_PERCENTAGE);
+        stream_printf(s, "%" PRIu32, r->percentage);
+        tlm_json_key(s, &first, TLM_KEY_CORE);
+        stream_printf(s, "%" PRId32, r->core);
+        tlm_json_key(s, &first, TLM_KEY_ISR);
+        stream_puts(s, "true");
+    }
+    else {
+        tlm_json_key(s, &first, TLM_KEY_TASK_NAME);
+        stream_put_json_str(s, r->task_name ? r->task_name : "");
+        tlm_json_key(s, &first, TLM_KEY_RUN_TIME);
+        stream_printf(s, "%" PRIu32, r->run_time);
+        tlm_json_key(s, &first, TLM_KEY_ISR_TIME);
+        stream_printf(s, "%" PRIu32, r->isr_time);
+        tlm_json_key(s, &first, TLM_KEY_PERCENTAGE);
+        stream_printf(s, "%" PRIu32, r->percentage);
+        tlm_json_key(s, &first, TLM_KEY_CORE);
+        stream_printf(s, "%" PRId32, r->core);
+    }
+    stream_puts(s, "}");
+}
+
+static void tlm_cbor_put_task(cbor_writer_t *w, const tlm_task_t *r)
+{
+    if (r->flags & WIRE_TASK_CREATED) {
+        cbor_put_map(w, 2);
+        cbor_put_text(w, TLM_KEY_TASK_NAME);
+        cbor_put_text(w, r->task_name ? r->task_name : "");
+        cbor_put_text(w, TLM_KEY_STATUS);
+        cbor_put_text(w, "created");
+    }
+    else if (r->flags & WIRE_TASK_DELETED) {
+        cbor_put_map(w, 2);
+        cbor_put_text(w, TLM_KEY_TASK_NAME);
+        cbor_put_text(w, r->task_name ? r->task_name : "");
+        cbor_put_text(w, TLM_KEY_STATUS);
+        cbor_put_text(w, "deleted");
+    }
+    else if (r->flags & WIRE_TASK_ISR) {
+        cbor_put_map(w, 5);
+        cbor_put_text(w, TLM_KEY_TASK_NAME);
+        cbor_put_text(w, r->task_name ? r->task_name : "");
+        cbor_put_text(w, TLM_KEY_RUN_TIME);
+        cbor_put_uint(w, r->run_time);
+        cbor_put_text(w, TLM_KEY_PERCENTAGE);
+        cbor_put_uint(w, r->percentage);
+        cbor_put_text(w, TLM_KEY_CORE);
+        cbor_put_int(w, r->core);
+        cbor_put_text(w, TLM_KEY_ISR);
+        cbor_put_bool(w, true);
+    }
+    else {
+        cbor_put_map(w, 5);
+        cbor_put_text(w, TLM_KEY_TASK_NAME);
+        cbor_put_text(w, r->task_name ? r->task_name : "");
+        cbor_put_text(w, TLM_KEY_RUN_TIME);
+        cbor_put_uint(w, r->run_time);
+        cbor_put_text(w, TLM_KEY_ISR_TIME);
+        cbor_put_uint(w, r->isr_time);
+        cbor_put_text(w, TLM_KEY_PERCENTAGE);
+        cbor_put_uint(w, r->percentage);
+        cbor_put_text(w, TLM_KEY_CORE);
+        cbor_put_int(w, r->core);
+    }
+}
+
+// --------------------------------------------------------------------
+// isr_entry entries
+// --------------------------------------------------------------------
+static void tlm_wire_put_isr_entry(wire_writer_t *w, const tlm_isr_entry_t *r)
+{
+    wire_put_u8(w, (uint8_t)tlm_sat(r->tag, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)(int8_t)r->core);
+    wire_put_name(w, r->name);
+    wire_put_u32(w, r->count);
+    wire_put_u32(w, r->dropped);
+    wire_put_u32(w, r->incl_min_ns);
+    wire_put_u32(w, r->incl_avg_ns);
+    wire_put_u32(w, r->incl_max_ns);
+    wire_put_u32(w, r->excl_min_ns);
+    wire_put_u32(w, r->excl_avg_ns);
+    wire_put_u32(w, r->excl_max_ns);
+    tlm_wire_array(w, r->hist, 16, 4);
+}
+
+static void tlm_json_put_isr_entry(stream_writer_t *s, const tlm_isr_entry_t *r)
+{
+    bool first = true;
+
+    stream_puts(s, "{");
+    tlm_json_key(s, &first, TLM_KEY_TAG);
+    stream_printf(s, "%" PRIu32, r->tag);
+    tlm_json_key(s, &first, TLM_KEY_CORE);
+    stream_printf(s, "%" PRId32, r->core);
+    if (tlm_has_name(r->name)) {
+        tlm_json_key(s, &first, TLM_KEY_NAME);
+        stream_put_json_str(s, r->name);
+    }
+    tlm_json_key(s, &first, TLM_KEY_COUNT);
+    stream_printf(s, "%" PRIu32, r->count);
+    tlm_json_key(s, &first, TLM_KEY_DROPPED);
+    stream_printf(s, "%" PRIu32, r->dropped);
+    tlm_json_key(s, &first, TLM_KEY_INCL_MIN_NS);
+    stream_printf(s, "%" PRIu32, r->incl_min_ns);
+    tlm_json_key(s, &first, TLM_KEY_INCL_AVG_NS);
+    stream_printf(s, "%" PRIu32, r->incl_avg_ns);
+    tlm_json_key(s, &first, TLM_KEY_INCL_MAX_NS);
+    stream_printf(s, "%" PRIu32, r->incl_max_ns);
+    tlm_json_key(s, &first, TLM_KEY_EXCL_MIN_NS);
+    stream_printf(s, "%" PRIu32, r->excl_min_ns);
+    tlm_json_key(s, &first, TLM_KEY_EXCL_AVG_NS);
+    stream_printf(s, "%" PRIu32, r->excl_avg_ns);
+    tlm_json_key(s, &first, TLM_KEY_EXCL_MAX_NS);
+    stream_printf(s, "%" PRIu32, r->excl_max_ns);
+    tlm_json_key(s, &first, TLM_KEY_HIST);
+    tlm_json_array(s, r->hist, 16);
+    stream_puts(s, "}");
+}
+
+static void tlm_cbor_put_isr_entry(cbor_writer_t *w, const tlm_isr_entry_t *r)
+{
+    cbor_put_map(w, 11 + tlm_has_name(r->name));
+    cbor_put_text(w, TLM_KEY_TAG);
+    cbor_put_uint(w, r->tag);
+    cbor_put_text(w, TLM_KEY_CORE);
+    cbor_put_int(w, r->core);
+    if (tlm_has_name(r->name)) {
+        cbor_put_text(w, TLM_KEY_NAME);
+        cbor_put_text(w, r->name);
+    }
+    cbor_put_text(w, TLM_KEY_COUNT);
+    cbor_put_uint(w, r->count);
+    cbor_put_text(w, TLM_KEY_DROPPED);
+    cbor_put_uint(w, r->dropped);
+    cbor_put_text(w, TLM_KEY_INCL_MIN_NS);
+    cbor_put_uint(w, r->incl_min_ns);
+    cbor_put_text(w, TLM_KEY_INCL_AVG_NS);
+    cbor_put_uint(w, r->incl_avg_ns);
+    cbor_put_text(w, TLM_KEY_INCL_MAX_NS);
+    cbor_put_uint(w, r->incl_max_ns);
+    cbor_put_text(w, TLM_KEY_EXCL_MIN_NS);
+    cbor_put_uint(w, r->excl_min_ns);
+    cbor_put_text(w, TLM_KEY_EXCL_AVG_NS);
+    cbor_put_uint(w, r->excl_avg_ns);
+    cbor_put_text(w, TLM_KEY_EXCL_MAX_NS);
+    cbor_put_uint(w, r->excl_max_ns);
+    cbor_put_text(w, TLM_KEY_HIST);
+    tlm_cbor_array(w, r->hist, 16);
+}
+
+// --------------------------------------------------------------------
+// budget_entry entries
+// --------------------------------------------------------------------
+static void tlm_wire_put_budget_entry(wire_writer_t *w, const tlm_budget_entry_t *r)
+{
+    wire_put_u8(w, (uint8_t)tlm_sat(r->type, UINT8_MAX));
+    wire_put_u32(w, r->bytes_per_s);
+    wire_put_u32(w, r->msgs_per_min);
+}
+
+static void tlm_json_put_budget_entry(stream_writer_t *s, const tlm_budget_entry_t *r)
+{
+    bool first = true;
+
+    stream_puts(s, "{");
+    tlm_json_key(s, &first, TLM_KEY_TYPE);
+    stream_printf(s, "%" PRIu32, r->type);
+    tlm_json_key(s, &first, TLM_KEY_BYTES_PER_S);
+    stream_printf(s, "%" PRIu32, r->bytes_per_s);
+    tlm_json_key(s, &first, TLM_KEY_MSGS_PER_MIN);
+    stream_printf(s, "%" PRIu32, r->msgs_per_min);
+    stream_puts(s, "}");
+}
+
+static void tlm_cbor_put_budget_entry(cbor_writer_t *w, const tlm_budget_entry_t *r)
+{
+    cbor_put_map(w, 3);
+    cbor_put_text(w, TLM_KEY_TYPE);
+    cbor_put_uint(w, r->type);
+    cbor_put_text(w, TLM_KEY_BYTES_PER_S);
+    cbor_put_uint(w, r->bytes_per_s);
+    cbor_put_text(w, TLM_KEY_MSGS_PER_MIN);
+    cbor_put_uint(w, r->msgs_per_min);
+}
+
+// --------------------------------------------------------------------
+// task_detail entries
+// --------------------------------------------------------------------
+static void tlm_wire_put_task_detail(wire_writer_t *w, const tlm_task_detail_t *r)
+{
+    wire_put_name(w, r->task_name);
+    wire_put_u32(w, r->number);
+    wire_put_u8(w, (uint8_t)tlm_sat(r->state, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)tlm_sat(r->priority, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)tlm_sat(r->base_priority, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)(int8_t)r->core);
+    wire_put_u32(w, r->stack_free);
+    wire_put_u32(w, r->run_time);
+}
+
+static void tlm_json_put_task_detail(stream_writer_t *s, const tlm_task_detail_t *r)
+{
+    bool first = true;
+
+    stream_puts(s, "{");
+    tlm_json_key(s, &first, TLM_KEY_TASK_NAME);
+    stream_put_json_str(s, r->task_name ? r->task_name : "");
+    tlm_json_key(s, &first, TLM_KEY_NUMBER);
+    stream_printf(s, "%" PRIu32, r->number);
+    tlm_json_key(s, &first, TLM_KEY_STATE);
+    stream_printf(s, "%" PRIu32, r->state);
+    tlm_json_key(s, &first, TLM_KEY_PRIORITY);
+    stream_printf(s, "%" PRIu32, r->priority);
+    tlm_json_key(s, &first, TLM_KEY_BASE_PRIORITY);
+    stream_printf(s, "%" PRIu32, r->base_priority);
+    tlm_json_key(s, &first, TLM_KEY_CORE);
+    stream_printf(s, "%" PRId32, r->core);
+    tlm_json_key(s, &first, TLM_KEY_STACK_FREE);
+    stream_printf(s, "%" PRIu32, r->stack_free);
+    tlm_json_key(s, &first, TLM_KEY_RUN_TIME);
+    stream_printf(s, "%" PRIu32, r->run_time);
+    stream_puts(s, "}");
+}
+
+static void tlm_cbor_put_task_detail(cbor_writer_t *w, const tlm_task_detail_t *r)
+{
+    cbor_put_map(w, 8);
+    cbor_put_text(w, TLM_KEY_TASK_NAME);
+    cbor_put_text(w, r->task_name ? r->task_name : "");
+    cbor_put_text(w, TLM_KEY_NUMBER);
+    cbor_put_uint(w, r->number);
+    cbor_put_text(w, TLM_KEY_STATE);
+    cbor_put_uint(w, r->state);
+    cbor_put_text(w, TLM_KEY_PRIORITY);
+    cbor_put_uint(w, r->priority);
+    cbor_put_text(w, TLM_KEY_BASE_PRIORITY);
+    cbor_put_uint(w, r->base_priority);
+    cbor_put_text(w, TLM_KEY_CORE);
+    cbor_put_int(w, r->core);
+    cbor_put_text(w, TLM_KEY_STACK_FREE);
+    cbor_put_uint(w, r->stack_free);
+    cbor_put_text(w, TLM_KEY_RUN_TIME);
+    cbor_put_uint(w, r->run_time);
+}
+
+// --------------------------------------------------------------------
+// heap_region entries
+// --------------------------------------------------------------------
+static void tlm_wire_put_heap_region(wire_writer_t *w, const tlm_heap_region_t *r)
+{
+    wire_put_u32(w, r->caps);
+    wire_put_u32(w, r->total);
+    wire_put_u32(w, r->free);
+    wire_put_u32(w, r->largest_free);
+    wire_put_u32(w, r->min_free);
+    wire_put_u32(w, r->allocated_blocks);
+    wire_put_u32(w, r->free_blocks);
+}
+
+static void tlm_json_put_heap_region(stream_writer_t *s, const tlm_heap_region_t *r)
+{
+    bool first = true;
+
+    stream_puts(s, "{");
+    tlm_json_key(s, &first, TLM_KEY_CAPS);
+    stream_printf(s, "%" PRIu32, r->caps);
+    tlm_json_key(s, &first, TLM_KEY_TOTAL);
+    stream_printf(s, "%" PRIu32, r->total);
+    tlm_json_key(s, &first, TLM_KEY_FREE);
+    stream_printf(s, "%" PRIu32, r->free);
+    tlm_json_key(s, &first, TLM_KEY_LARGEST_FREE);
+    stream_printf(s, "%" PRIu32, r->largest_free);
+    tlm_json_key(s, &first, TLM_KEY_MIN_FREE);
+    stream_printf(s, "%" PRIu32, r->min_free);
+    tlm_json_key(s, &first, TLM_KEY_ALLOCATED_BLOCKS);
+    stream_printf(s, "%" PRIu32, r->allocated_blocks);
+    tlm_json_key(s, &first, TLM_KEY_FREE_BLOCKS);
+    stream_printf(s, "%" PRIu32, r->free_blocks);
+    stream_puts(s, "}");
+}
+
+static void tlm_cbor_put_heap_region(cbor_writer_t *w, const tlm_heap_region_t *r)
+{
+    cbor_put_map(w, 7);
+    cbor_put_text(w, TLM_KEY_CAPS);
+    cbor_put_uint(w, r->caps);
+    cbor_put_text(w, TLM_KEY_TOTAL);
+    cbor_put_uint(w, r->total);
+    cbor_put_text(w, TLM_KEY_FREE);
+    cbor_put_uint(w, r->free);
+    cbor_put_text(w, TLM_KEY_LARGEST_FREE);
+    cbor_put_uint(w, r->largest_free);
+    cbor_put_text(w, TLM_KEY_MIN_FREE);
+    cbor_put_uint(w, r->min_free);
+    cbor_put_text(w, TLM_KEY_ALLOCATED_BLOCKS);
+    cbor_put_uint(w, r->allocated_blocks);
+    cbor_put_text(w, TLM_KEY_FREE_BLOCKS);
+    cbor_put_uint(w, r->free_blocks);
+}
+
+// --------------------------------------------------------------------
+// wakeup_entry entries
+// --------------------------------------------------------------------
+static void tlm_wire_put_wakeup_entry(wire_writer_t *w, const tlm_wakeup_entry_t *r)
+{
+    wire_put_u8(w, (uint8_t)tlm_sat(r->channel, UINT8_MAX));
+    wire_put_u32(w, r->count);
+    wire_put_u32(w, r->coalesced);
+    wire_put_u32(w, r->min_us);
+    wire_put_u32(w, r->avg_us);
+    wire_put_u32(w, r->max_us);
+    tlm_wire_array(w, r->hist, 16, 4);
+}
+
+static void tlm_json_put_wakeup_entry(stream_writer_t *s, const tlm_wakeup_entry_t *r)
+{
+    bool first = true;
+
+    stream_puts(s, "{");
+    tlm_json_key(s, &first, TLM_KEY_CHANNEL);
+    stream_printf(s, "%" PRIu32, r->channel);
+    tlm_json_key(s, &first, TLM_KEY_COUNT);
+    stream_printf(s, "%" PRIu32, r->count);
+    tlm_json_key(s, &first, TLM_KEY_COALESCED);
+    stream_printf(s, "%" PRIu32, r->coalesced);
+    tlm_json_key(s, &first, TLM_KEY_MIN_US);
+    stream_printf(s, "%" PRIu32, r->min_us);
+    tlm_json_key(s, &first, TLM_KEY_AVG_US);
+    stream_printf(s, "%" PRIu32, r->avg_us);
+    tlm_json_key(s, &first, TLM_KEY_MAX_US);
+    stream_printf(s, "%" PRIu32, r->max_us);
+    tlm_json_key(s, &first, TLM_KEY_HIST);
+    tlm_json_array(s, r->hist, 16);
+    stream_puts(s, "}");
+}
+
+static void tlm_cbor_put_wakeup_entry(cbor_writer_t *w, const tlm_wakeup_entry_t *r)
+{
+    cbor_put_map(w, 7);
+    cbor_put_text(w, TLM_KEY_CHANNEL);
+    cbor_put_uint(w, r->channel);
+    cbor_put_text(w, TLM_KEY_COUNT);
+    cbor_put_uint(w, r->count);
+    cbor_put_text(w, TLM_KEY_COALESCED);
+    cbor_put_uint(w, r->coalesced);
+    cbor_put_text(w, TLM_KEY_MIN_US);
+    cbor_put_uint(w, r->min_us);
+    cbor_put_text(w, TLM_KEY_AVG_US);
+    cbor_put_uint(w, r->avg_us);
+    cbor_put_text(w, TLM_KEY_MAX_US);
+    cbor_put_uint(w, r->max_us);
+    cbor_put_text(w, TLM_KEY_HIST);
+    tlm_cbor_array(w, r->hist, 16);
+}
+
+// --------------------------------------------------------------------
+// device message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_device(wire_writer_t *w, const void *msg)
+{
+    const tlm_device_t *m = msg;
+
+    wire_put_u8(w, (uint8_t)tlm_sat(m->cores, UINT8_MAX));
+    wire_put_u32(w, m->cpu_hz);
+    wire_put_name(w, m->tag);
+}
+
+static char *tlm_wire_device(const void *msg)
+{
+    wire_writer_t w;
+
+    if (!wire_begin(&w, TLM_WIRE_DEVICE_SIZE, WIRE_MSG_DEVICE)) {
+        return NULL;
+    }
+    tlm_wire_payload_device(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_device(stream_writer_t *s, const void *msg)
+{
+    const tlm_device_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ \"" TLM_KEY_DEVICE "\": { ");
+    tlm_json_key(s, &first, TLM_KEY_CORES);
+    stream_printf(s, "%" PRIu32, m->cores);
+    tlm_json_key(s, &first, TLM_KEY_CPU_HZ);
+    stream_printf(s, "%" PRIu32, m->cpu_hz);
+    tlm_json_key(s, &first, TLM_KEY_TAG);
+    stream_put_json_str(s, m->tag ? m->tag : "");
+    stream_puts(s, " } }");
+}
+
+static void tlm_cbor_device(cbor_writer_t *w, const void *msg)
+{
+    const tlm_device_t *m = msg;
+
+    cbor_put_map(w, 1);
+    cbor_put_text(w, TLM_KEY_DEVICE);
+    cbor_put_map(w, 3);
+    cbor_put_text(w, TLM_KEY_CORES);
+    cbor_put_uint(w, m->cores);
+    cbor_put_text(w, TLM_KEY_CPU_HZ);
+    cbor_put_uint(w, m->cpu_hz);
+    cbor_put_text(w, TLM_KEY_TAG);
+    cbor_put_text(w, m->tag ? m->tag : "");
+}
+
+const tlm_codec_t tlm_device_codec = {
+    .type = WIRE_MSG_DEVICE,
+    .wire = tlm_wire_device,
+    .payload = tlm_wire_payload_device,
+    .json = tlm_json_device,
+    .cbor = tlm_cbor_device,
+};
+
+// --------------------------------------------------------------------
+// tasks message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_tasks(wire_writer_t *w, const void *msg)
+{
+    const tlm_tasks_t *m = msg;
+    uint32_t core_count = tlm_sat(m->core_count, UINT8_MAX);
+    uint32_t task_count = tlm_sat(m->task_count, UINT8_MAX);
+
+    wire_put_u8(w, (uint8_t)core_count);
+    wire_put_u8(w, (uint8_t)task_count);
+    tlm_wire_array(w, m->cores, core_count, 1);
+    tlm_wire_array(w, m->isr_load, core_count, 1);
+    for (uint32_t i = 0; i < task_count; i++) {
+        tlm_task_t r = {0};
+        m->get_tasks(m->ctx, i, &r);
+        tlm_wire_put_task(w, &r);
+    }
+}
+
+static char *tlm_wire_tasks(const void *msg)
+{
+    const tlm_tasks_t *m = msg;
+    wire_writer_t w;
+    uint32_t core_count = tlm_sat(m->core_count, UINT8_MAX);
+    uint32_t task_count = tlm_sat(m->task_count, UINT8_MAX);
+
+    if (!wire_begin(&w, TLM_WIRE_TASKS_SIZE + core_count * 1 + core_count * 1 + task_count * TLM_WIRE_TASK_SIZE, WIRE_MSG_TASKS)) {
+        return NULL;
+    }
+    tlm_wire_payload_tasks(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_tasks(stream_writer_t *s, const void *msg)
+{
+    const tlm_tasks_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ ");
+    tlm_json_key(s, &first, TLM_KEY_CORES);
+    tlm_json_array(s, m->cores, m->core_count);
+    tlm_json_key(s, &first, TLM_KEY_ISR_LOAD);
+    tlm_json_array(s, m->isr_load, m->core_count);
+    tlm_json_key(s, &first, TLM_KEY_TASKS);
+    stream_puts(s, "[ ");
+    for (uint32_t i = 0; i < m->task_count; i++) {
+        tlm_task_t r = {0};
+        m->get_tasks(m->ctx, i, &r);
+        if (i) stream_puts(s, ", ");
+        tlm_json_put_task(s, &r);
+    }
+    stream_puts(s, " ]");
+    stream_puts(s, " }");
+}
+
+static void tlm_cbor_tasks(cbor_writer_t *w, const void *msg)
+{
+    const tlm_tasks_t *m = msg;
+
+    cbor_put_map(w, 3);
+    cbor_put_text(w, TLM_KEY_CORES);
+    tlm_cbor_array(w, m->cores, m->core_count);
+    cbor_put_text(w, TLM_KEY_ISR_LOAD);
+    tlm_cbor_array(w, m->isr_load, m->core_count);
+    cbor_put_text(w, TLM_KEY_TASKS);
+    cbor_put_array(w, m->task_count);
+    for (uint32_t i = 0; i < m->task_count; i++) {
+        tlm_task_t r = {0};
+        m->get_tasks(m->ctx, i, &r);
+        tlm_cbor_put_task(w, &r);
+    }
+}
+
+const tlm_codec_t tlm_tasks_codec = {
+    .type = WIRE_MSG_TASKS,
+    .wire = tlm_wire_tasks,
+    .payload = tlm_wire_payload_tasks,
+    .json = tlm_json_tasks,
+    .cbor = tlm_cbor_tasks,
+};
+
+// --------------------------------------------------------------------
+// memory message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_memory(wire_writer_t *w, const void *msg)
+{
+    const tlm_memory_t *m = msg;
+
+    wire_put_u32(w, m->heap_total);
+    wire_put_u32(w, m->heap_free);
+    wire_put_u32(w, m->internal_total);
+    wire_put_u32(w, m->internal_free);
+}
+
+static char *tlm_wire_memory(const void *msg)
+{
+    wire_writer_t w;
+
+    if (!wire_begin(&w, TLM_WIRE_MEMORY_SIZE, WIRE_MSG_MEMORY)) {
+        return NULL;
+    }
+    tlm_wire_payload_memory(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_memory(stream_writer_t *s, const void *msg)
+{
+    const tlm_memory_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ ");
+    tlm_json_key(s, &first, TLM_KEY_HEAP_TOTAL);
+    stream_printf(s, "%" PRIu32, m->heap_total);
+    tlm_json_key(s, &first, TLM_KEY_HEAP_FREE);
+    stream_printf(s, "%" PRIu32, m->heap_free);
+    tlm_json_key(s, &first, TLM_KEY_INTERNAL_TOTAL);
+    stream_printf(s, "%" PRIu32, m->internal_total);
+    tlm_json_key(s, &first, TLM_KEY_INTERNAL_FREE);
+    stream_printf(s, "%" PRIu32, m->internal_free);
+    stream_puts(s, " }");
+}
+
+static void tlm_cbor_memory(cbor_writer_t *w, const void *msg)
+{
+    const tlm_memory_t *m = msg;
+
+    cbor_put_map(w, 4);
+    cbor_put_text(w, TLM_KEY_HEAP_TOTAL);
+    cbor_put_uint(w, m->heap_total);
+    cbor_put_text(w, TLM_KEY_HEAP_FREE);
+    cbor_put_uint(w, m->heap_free);
+    cbor_put_text(w, TLM_KEY_INTERNAL_TOTAL);
+    cbor_put_uint(w, m->internal_total);
+    cbor_put_text(w, TLM_KEY_INTERNAL_FREE);
+    cbor_put_uint(w, m->internal_free);
+}
+
+const tlm_codec_t tlm_memory_codec = {
+    .type = WIRE_MSG_MEMORY,
+    .wire = tlm_wire_memory,
+    .payload = tlm_wire_payload_memory,
+    .json = tlm_json_memory,
+    .cbor = tlm_cbor_memory,
+};
+
+// --------------------------------------------------------------------
+// isr message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_isr(wire_writer_t *w, const void *msg)
+{
+    const tlm_isr_t *m = msg;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    wire_put_u64(w, m->uptime_us);
+    wire_put_u32(w, m->cpu_hz);
+    wire_put_u8(w, (uint8_t)tlm_sat(m->hist_shift, UINT8_MAX));
+    wire_put_u16(w, (uint16_t)tlm_sat(m->freq_changes, UINT16_MAX));
+    wire_put_u16(w, (uint16_t)tlm_sat(m->bad_tag, UINT16_MAX));
+    wire_put_u8(w, (uint8_t)count);
+    for (uint32_t i = 0; i < count; i++) {
+        tlm_isr_entry_t r = {0};
+        m->get_isr(m->ctx, i, &r);
+        tlm_wire_put_isr_entry(w, &r);
+    }
+}
+
+static char *tlm_wire_isr(const void *msg)
+{
+    const tlm_isr_t *m = msg;
+    wire_writer_t w;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    if (!wire_begin(&w, TLM_WIRE_ISR_SIZE + count * TLM_WIRE_ISR_ENTRY_SIZE, WIRE_MSG_ISR)) {
+        return NULL;
+    }
+    tlm_wire_payload_isr(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_isr(stream_writer_t *s, const void *msg)
+{
+    const tlm_isr_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ ");
+    tlm_json_key(s, &first, TLM_KEY_UPTIME_US);
+    stream_printf(s, "%" PRIu64, m->uptime_us);
+    tlm_json_key(s, &first, TLM_KEY_CPU_HZ);
+    stream_printf(s, "%" PRIu32, m->cpu_hz);
+    tlm_json_key(s, &first, TLM_KEY_HIST_SHIFT);
+    stream_printf(s, "%" PRIu32, m->hist_shift);
+    tlm_json_key(s, &first, TLM_KEY_FREQ_CHANGES);
+    stream_printf(s, "%" PRIu32, m->freq_changes);
+    tlm_json_key(s, &first, TLM_KEY_BAD_TAG);
+    stream_printf(s, "%" PRIu32, m->bad_tag);
+    tlm_json_key(s, &first, TLM_KEY_ISR);
+    stream_puts(s, "[ ");
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_isr_entry_t r = {0};
+        m->get_isr(m->ctx, i, &r);
+        if (i) stream_puts(s, ", ");
+        tlm_json_put_isr_entry(s, &r);
+    }
+    stream_puts(s, " ]");
+    tlm_json_key(s, &first, TLM_KEY_HIST_UNIT);
+    stream_put_json_str(s, "ns");
+    stream_puts(s, " }");
+}
+
+static void tlm_cbor_isr(cbor_writer_t *w, const void *msg)
+{
+    const tlm_isr_t *m = msg;
+
+    cbor_put_map(w, 7);
+    cbor_put_text(w, TLM_KEY_UPTIME_US);
+    cbor_put_uint(w, m->uptime_us);
+    cbor_put_text(w, TLM_KEY_CPU_HZ);
+    cbor_put_uint(w, m->cpu_hz);
+    cbor_put_text(w, TLM_KEY_HIST_SHIFT);
+    cbor_put_uint(w, m->hist_shift);
+    cbor_put_text(w, TLM_KEY_FREQ_CHANGES);
+    cbor_put_uint(w, m->freq_changes);
+    cbor_put_text(w, TLM_KEY_BAD_TAG);
+    cbor_put_uint(w, m->bad_tag);
+    cbor_put_text(w, TLM_KEY_ISR);
+    cbor_put_array(w, m->count);
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_isr_entry_t r = {0};
+        m->get_isr(m->ctx, i, &r);
+        tlm_cbor_put_isr_entry(w, &r);
+    }
+    cbor_put_text(w, TLM_KEY_HIST_UNIT);
+    cbor_put_text(w, "ns");
+}
+
+const tlm_codec_t tlm_isr_codec = {
+    .type = WIRE_MSG_ISR,
+    .wire = tlm_wire_isr,
+    .payload = tlm_wire_payload_isr,
+    .json = tlm_json_isr,
+    .cbor = tlm_cbor_isr,
+};
+
+// --------------------------------------------------------------------
+// wakeup message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_wakeup(wire_writer_t *w, const void *msg)
+{
+    const tlm_wakeup_t *m = msg;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    wire_put_u8(w, (uint8_t)count);
+    for (uint32_t i = 0; i < count; i++) {
+        tlm_wakeup_entry_t r = {0};
+        m->get_wakeup(m->ctx, i, &r);
+        tlm_wire_put_wakeup_entry(w, &r);
+    }
+}
+
+static char *tlm_wire_wakeup(const void *msg)
+{
+    const tlm_wakeup_t *m = msg;
+    wire_writer_t w;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    if (!wire_begin(&w, TLM_WIRE_WAKEUP_SIZE + count * TLM_WIRE_WAKEUP_ENTRY_SIZE, WIRE_MSG_WAKEUP)) {
+        return NULL;
+    }
+    tlm_wire_payload_wakeup(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_wakeup(stream_writer_t *s, const void *msg)
+{
+    const tlm_wakeup_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ ");
+    tlm_json_key(s, &first, TLM_KEY_WAKEUP);
+    stream_puts(s, "[ ");
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_wakeup_entry_t r = {0};
+        m->get_wakeup(m->ctx, i, &r);
+        if (i) stream_puts(s, ", ");
+        tlm_json_put_wakeup_entry(s, &r);
+    }
+    stream_puts(s, " ]");
+    stream_puts(s, " }");
+}
+
+static void tlm_cbor_wakeup(cbor_writer_t *w, const void *msg)
+{
+    const tlm_wakeup_t *m = msg;
+
+    cbor_put_map(w, 1);
+    cbor_put_text(w, TLM_KEY_WAKEUP);
+    cbor_put_array(w, m->count);
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_wakeup_entry_t r = {0};
+        m->get_wakeup(m->ctx, i, &r);
+        tlm_cbor_put_wakeup_entry(w, &r);
+    }
+}
+
+const tlm_codec_t tlm_wakeup_codec = {
+    .type = WIRE_MSG_WAKEUP,
+    .wire = tlm_wire_wakeup,
+    .payload = tlm_wire_payload_wakeup,
+    .json = tlm_json_wakeup,
+    .cbor = tlm_cbor_wakeup,
+};
+
+// --------------------------------------------------------------------
+// report message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_report(wire_writer_t *w, const void *msg)
+{
+    const tlm_report_t *m = msg;
+    uint32_t core_count = tlm_sat(m->core_count, UINT8_MAX);
+    uint32_t task_count = tlm_sat(m->task_count, UINT8_MAX);
+
+    wire_put_u32(w, m->seq);
+    wire_put_u64(w, m->uptime_us);
+    wire_put_u32(w, m->window_us);
+    wire_put_u32(w, m->period_ms);
+    wire_put_u8(w, (uint8_t)tlm_sat(m->coalesced, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)core_count);
+    wire_put_u8(w, (uint8_t)task_count);
+    tlm_wire_array(w, m->cores, core_count, 1);
+    tlm_wire_array(w, m->isr_load, core_count, 1);
+    for (uint32_t i = 0; i < task_count; i++) {
+        tlm_task_t r = {0};
+        m->get_tasks(m->ctx, i, &r);
+        tlm_wire_put_task(w, &r);
+    }
+    wire_put_u32(w, m->heap_total);
+    wire_put_u32(w, m->heap_free);
+    wire_put_u32(w, m->internal_total);
+    wire_put_u32(w, m->internal_free);
+}
+
+static char *tlm_wire_report(const void *msg)
+{
+    const tlm_report_t *m = msg;
+    wire_writer_t w;
+    uint32_t core_count = tlm_sat(m->core_count, UINT8_MAX);
+    uint32_t task_count = tlm_sat(m->task_count, UINT8_MAX);
+
+    if (!wire_begin(&w, TLM_WIRE_REPORT_SIZE + core_count * 1 + core_count * 1 + task_count * TLM_WIRE_TASK_SIZE, WIRE_MSG_REPORT)) {
+        return NULL;
+    }
+    tlm_wire_payload_report(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_report(stream_writer_t *s, const void *msg)
+{
+    const tlm_report_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ \"" TLM_KEY_REPORT "\": { ");
+    tlm_json_key(s, &first, TLM_KEY_SEQ);
+    stream_printf(s, "%" PRIu32, m->seq);
+    tlm_json_key(s, &first, TLM_KEY_UPTIME_US);
+    stream_printf(s, "%" PRIu64, m->uptime_us);
+    tlm_json_key(s, &first, TLM_KEY_WINDOW_US);
+    stream_printf(s, "%" PRIu32, m->window_us);
+    tlm_json_key(s, &first, TLM_KEY_PERIOD_MS);
+    stream_printf(s, "%" PRIu32, m->period_ms);
+    tlm_json_key(s, &first, TLM_KEY_COALESCED);
+    stream_printf(s, "%" PRIu32, m->coalesced);
+    tlm_json_key(s, &first, TLM_KEY_CORES);
+    tlm_json_array(s, m->cores, m->core_count);
+    tlm_json_key(s, &first, TLM_KEY_ISR_LOAD);
+    tlm_json_array(s, m->isr_load, m->core_count);
+    tlm_json_key(s, &first, TLM_KEY_TASKS);
+    stream_puts(s, "[ ");
+    for (uint32_t i = 0; i < m->task_count; i++) {
+        tlm_task_t r = {0};
+        m->get_tasks(m->ctx, i, &r);
+        if (i) stream_puts(s, ", ");
+        tlm_json_put_task(s, &r);
+    }
+    stream_puts(s, " ]");
+    tlm_json_key(s, &first, TLM_KEY_HEAP_TOTAL);
+    stream_printf(s, "%" PRIu32, m->heap_total);
+    tlm_json_key(s, &first, TLM_KEY_HEAP_FREE);
+    stream_printf(s, "%" PRIu32, m->heap_free);
+    tlm_json_key(s, &first, TLM_KEY_INTERNAL_TOTAL);
+    stream_printf(s, "%" PRIu32, m->internal_total);
+    tlm_json_key(s, &first, TLM_KEY_INTERNAL_FREE);
+    stream_printf(s, "%" PRIu32, m->internal_free);
+    stream_puts(s, " } }");
+}
+
+static void tlm_cbor_report(cbor_writer_t *w, const void *msg)
+{
+    const tlm_report_t *m = msg;
+
+    cbor_put_map(w, 1);
+    cbor_put_text(w, TLM_KEY_REPORT);
+    cbor_put_map(w, 12);
+    cbor_put_text(w, TLM_KEY_SEQ);
+    cbor_put_uint(w, m->seq);
+    cbor_put_text(w, TLM_KEY_UPTIME_US);
+    cbor_put_uint(w, m->uptime_us);
+    cbor_put_text(w, TLM_KEY_WINDOW_US);
+    cbor_put_uint(w, m->window_us);
+    cbor_put_text(w, TLM_KEY_PERIOD_MS);
+    cbor_put_uint(w, m->period_ms);
+    cbor_put_text(w, TLM_KEY_COALESCED);
+    cbor_put_uint(w, m->coalesced);
+    cbor_put_text(w, TLM_KEY_CORES);
+    tlm_cbor_array(w, m->cores, m->core_count);
+    cbor_put_text(w, TLM_KEY_ISR_LOAD);
+    tlm_cbor_array(w, m->isr_load, m->core_count);
+    cbor_put_text(w, TLM_KEY_TASKS);
+    cbor_put_array(w, m->task_count);
+    for (uint32_t i = 0; i < m->task_count; i++) {
+        tlm_task_t r = {0};
+        m->get_tasks(m->ctx, i, &r);
+        tlm_cbor_put_task(w, &r);
+    }
+    cbor_put_text(w, TLM_KEY_HEAP_TOTAL);
+    cbor_put_uint(w, m->heap_total);
+    cbor_put_text(w, TLM_KEY_HEAP_FREE);
+    cbor_put_uint(w, m->heap_free);
+    cbor_put_text(w, TLM_KEY_INTERNAL_TOTAL);
+    cbor_put_uint(w, m->internal_total);
+    cbor_put_text(w, TLM_KEY_INTERNAL_FREE);
+    cbor_put_uint(w, m->internal_free);
+}
+
+const tlm_codec_t tlm_report_codec = {
+    .type = WIRE_MSG_REPORT,
+    .wire = tlm_wire_report,
+    .payload = tlm_wire_payload_report,
+    .json = tlm_json_report,
+    .cbor = tlm_cbor_report,
+};
+
+// --------------------------------------------------------------------
+// link message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_link(wire_writer_t *w, const void *msg)
+{
+    const tlm_link_t *m = msg;
+    uint32_t pattern_len = tlm_sat(m->pattern_len, UINT16_MAX);
+
+    wire_put_u32(w, m->baud);
+    wire_put_u8(w, (uint8_t)tlm_sat(m->status, UINT8_MAX));
+    wire_put_u16(w, (uint16_t)pattern_len);
+    tlm_wire_array(w, m->pattern, pattern_len, 1);
+}
+
+static char *tlm_wire_link(const void *msg)
+{
+    const tlm_link_t *m = msg;
+    wire_writer_t w;
+    uint32_t pattern_len = tlm_sat(m->pattern_len, UINT16_MAX);
+
+    if (!wire_begin(&w, TLM_WIRE_LINK_SIZE + pattern_len * 1, WIRE_MSG_LINK)) {
+        return NULL;
+    }
+    tlm_wire_payload_link(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_link(stream_writer_t *s, const void *msg)
+{
+    const tlm_link_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ \"" TLM_KEY_LINK "\": { ");
+    tlm_json_key(s, &first, TLM_KEY_BAUD);
+    stream_printf(s, "%" PRIu32, m->baud);
+    tlm_json_key(s, &first, TLM_KEY_STATUS);
+    stream_printf(s, "%" PRIu32, m->status);
+    tlm_json_key(s, &first, TLM_KEY_PATTERN);
+    tlm_json_array(s, m->pattern, m->pattern_len);
+    stream_puts(s, " } }");
+}
+
+static void tlm_cbor_link(cbor_writer_t *w, const void *msg)
+{
+    const tlm_link_t *m = msg;
+
+    cbor_put_map(w, 1);
+    cbor_put_text(w, TLM_KEY_LINK);
+    cbor_put_map(w, 3);
+    cbor_put_text(w, TLM_KEY_BAUD);
+    cbor_put_uint(w, m->baud);
+    cbor_put_text(w, TLM_KEY_STATUS);
+    cbor_put_uint(w, m->status);
+    cbor_put_text(w, TLM_KEY_PATTERN);
+    tlm_cbor_array(w, m->pattern, m->pattern_len);
+}
+
+const tlm_codec_t tlm_link_codec = {
+    .type = WIRE_MSG_LINK,
+    .wire = tlm_wire_link,
+    .payload = tlm_wire_payload_link,
+    .json = tlm_json_link,
+    .cbor = tlm_cbor_link,
+};
+
+// --------------------------------------------------------------------
+// budget message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_budget(wire_writer_t *w, const void *msg)
+{
+    const tlm_budget_t *m = msg;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    wire_put_u32(w, m->baud);
+    wire_put_u32(w, m->capacity);
+    wire_put_u32(w, m->used);
+    wire_put_u8(w, (uint8_t)count);
+    for (uint32_t i = 0; i < count; i++) {
+        tlm_budget_entry_t r = {0};
+        m->get_metrics(m->ctx, i, &r);
+        tlm_wire_put_budget_entry(w, &r);
+    }
+}
+
+static char *tlm_wire_budget(const void *msg)
+{
+    const tlm_budget_t *m = msg;
+    wire_writer_t w;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    if (!wire_begin(&w, TLM_WIRE_BUDGET_SIZE + count * TLM_WIRE_BUDGET_ENTRY_SIZE, WIRE_MSG_BUDGET)) {
+        return NULL;
+    }
+    tlm_wire_payload_budget(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_budget(stream_writer_t *s, const void *msg)
+{
+    const tlm_budget_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ \"" TLM_KEY_BUDGET "\": { ");
+    tlm_json_key(s, &first, TLM_KEY_BAUD);
+    stream_printf(s, "%" PRIu32, m->baud);
+    tlm_json_key(s, &first, TLM_KEY_CAPACITY);
+    stream_printf(s, "%" PRIu32, m->capacity);
+    tlm_json_key(s, &first, TLM_KEY_USED);
+    stream_printf(s, "%" PRIu32, m->used);
+    tlm_json_key(s, &first, TLM_KEY_METRICS);
+    stream_puts(s, "[ ");
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_budget_entry_t r = {0};
+        m->get_metrics(m->ctx, i, &r);
+        if (i) stream_puts(s, ", ");
+        tlm_json_put_budget_entry(s, &r);
+    }
+    stream_puts(s, " ]");
+    stream_puts(s, " } }");
+}
+
+static void tlm_cbor_budget(cbor_writer_t *w, const void *msg)
+{
+    const tlm_budget_t *m = msg;
+
+    cbor_put_map(w, 1);
+    cbor_put_text(w, TLM_KEY_BUDGET);
+    cbor_put_map(w, 4);
+    cbor_put_text(w, TLM_KEY_BAUD);
+    cbor_put_uint(w, m->baud);
+    cbor_put_text(w, TLM_KEY_CAPACITY);
+    cbor_put_uint(w, m->capacity);
+    cbor_put_text(w, TLM_KEY_USED);
+    cbor_put_uint(w, m->used);
+    cbor_put_text(w, TLM_KEY_METRICS);
+    cbor_put_array(w, m->count);
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_budget_entry_t r = {0};
+        m->get_metrics(m->ctx, i, &r);
+        tlm_cbor_put_budget_entry(w, &r);
+    }
+}
+
+const tlm_codec_t tlm_budget_codec = {
+    .type = WIRE_MSG_BUDGET,
+    .wire = tlm_wire_budget,
+    .payload = tlm_wire_payload_budget,
+    .json = tlm_json_budget,
+    .cbor = tlm_cbor_budget,
+};
+
+// --------------------------------------------------------------------
+// reply message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_reply(wire_writer_t *w, const void *msg)
+{
+    const tlm_reply_t *m = msg;
+
+    wire_put_u8(w, (uint8_t)tlm_sat(m->request, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)tlm_sat(m->cmd, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)tlm_sat(m->status, UINT8_MAX));
+}
+
+static char *tlm_wire_reply(const void *msg)
+{
+    wire_writer_t w;
+
+    if (!wire_begin(&w, TLM_WIRE_REPLY_SIZE, WIRE_MSG_REPLY)) {
+        return NULL;
+    }
+    tlm_wire_payload_reply(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_reply(stream_writer_t *s, const void *msg)
+{
+    const tlm_reply_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ \"" TLM_KEY_REPLY "\": { ");
+    tlm_json_key(s, &first, TLM_KEY_REQUEST);
+    stream_printf(s, "%" PRIu32, m->request);
+    tlm_json_key(s, &first, TLM_KEY_CMD);
+    stream_printf(s, "%" PRIu32, m->cmd);
+    tlm_json_key(s, &first, TLM_KEY_STATUS);
+    stream_printf(s, "%" PRIu32, m->status);
+    stream_puts(s, " } }");
+}
+
+static void tlm_cbor_reply(cbor_writer_t *w, const void *msg)
+{
+    const tlm_reply_t *m = msg;
+
+    cbor_put_map(w, 1);
+    cbor_put_text(w, TLM_KEY_REPLY);
+    cbor_put_map(w, 3);
+    cbor_put_text(w, TLM_KEY_REQUEST);
+    cbor_put_uint(w, m->request);
+    cbor_put_text(w, TLM_KEY_CMD);
+    cbor_put_uint(w, m->cmd);
+    cbor_put_text(w, TLM_KEY_STATUS);
+    cbor_put_uint(w, m->status);
+}
+
+const tlm_codec_t tlm_reply_codec = {
+    .type = WIRE_MSG_REPLY,
+    .wire = tlm_wire_reply,
+    .payload = tlm_wire_payload_reply,
+    .json = tlm_json_reply,
+    .cbor = tlm_cbor_reply,
+};
+
+// --------------------------------------------------------------------
+// task_info message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_task_info(wire_writer_t *w, const void *msg)
+{
+    const tlm_task_info_t *m = msg;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    wire_put_u8(w, (uint8_t)tlm_sat(m->request, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)count);
+    for (uint32_t i = 0; i < count; i++) {
+        tlm_task_detail_t r = {0};
+        m->get_tasks(m->ctx, i, &r);
+        tlm_wire_put_task_detail(w, &r);
+    }
+}
+
+static char *tlm_wire_task_info(const void *msg)
+{
+    const tlm_task_info_t *m = msg;
+    wire_writer_t w;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    if (!wire_begin(&w, TLM_WIRE_TASK_INFO_SIZE + count * TLM_WIRE_TASK_DETAIL_SIZE, WIRE_MSG_TASK_INFO)) {
+        return NULL;
+    }
+    tlm_wire_payload_task_info(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_task_info(stream_writer_t *s, const void *msg)
+{
+    const tlm_task_info_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ \"" TLM_KEY_TASK_INFO "\": { ");
+    tlm_json_key(s, &first, TLM_KEY_REQUEST);
+    stream_printf(s, "%" PRIu32, m->request);
+    tlm_json_key(s, &first, TLM_KEY_TASKS);
+    stream_puts(s, "[ ");
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_task_detail_t r = {0};
+        m->get_tasks(m->ctx, i, &r);
+        if (i) stream_puts(s, ", ");
+        tlm_json_put_task_detail(s, &r);
+    }
+    stream_puts(s, " ]");
+    stream_puts(s, " } }");
+}
+
+static void tlm_cbor_task_info(cbor_writer_t *w, const void *msg)
+{
+    const tlm_task_info_t *m = msg;
+
+    cbor_put_map(w, 1);
+    cbor_put_text(w, TLM_KEY_TASK_INFO);
+    cbor_put_map(w, 2);
+    cbor_put_text(w, TLM_KEY_REQUEST);
+    cbor_put_uint(w, m->request);
+    cbor_put_text(w, TLM_KEY_TASKS);
+    cbor_put_array(w, m->count);
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_task_detail_t r = {0};
+        m->get_tasks(m->ctx, i, &r);
+        tlm_cbor_put_task_detail(w, &r);
+    }
+}
+
+const tlm_codec_t tlm_task_info_codec = {
+    .type = WIRE_MSG_TASK_INFO,
+    .wire = tlm_wire_task_info,
+    .payload = tlm_wire_payload_task_info,
+    .json = tlm_json_task_info,
+    .cbor = tlm_cbor_task_info,
+};
+
+// --------------------------------------------------------------------
+// heap message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_heap(wire_writer_t *w, const void *msg)
+{
+    const tlm_heap_t *m = msg;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    wire_put_u8(w, (uint8_t)tlm_sat(m->request, UINT8_MAX));
+    wire_put_u8(w, (uint8_t)count);
+    for (uint32_t i = 0; i < count; i++) {
+        tlm_heap_region_t r = {0};
+        m->get_regions(m->ctx, i, &r);
+        tlm_wire_put_heap_region(w, &r);
+    }
+}
+
+static char *tlm_wire_heap(const void *msg)
+{
+    const tlm_heap_t *m = msg;
+    wire_writer_t w;
+    uint32_t count = tlm_sat(m->count, UINT8_MAX);
+
+    if (!wire_begin(&w, TLM_WIRE_HEAP_SIZE + count * TLM_WIRE_HEAP_REGION_SIZE, WIRE_MSG_HEAP)) {
+        return NULL;
+    }
+    tlm_wire_payload_heap(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_heap(stream_writer_t *s, const void *msg)
+{
+    const tlm_heap_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ \"" TLM_KEY_HEAP "\": { ");
+    tlm_json_key(s, &first, TLM_KEY_REQUEST);
+    stream_printf(s, "%" PRIu32, m->request);
+    tlm_json_key(s, &first, TLM_KEY_REGIONS);
+    stream_puts(s, "[ ");
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_heap_region_t r = {0};
+        m->get_regions(m->ctx, i, &r);
+        if (i) stream_puts(s, ", ");
+        tlm_json_put_heap_region(s, &r);
+    }
+    stream_puts(s, " ]");
+    stream_puts(s, " } }");
+}
+
+static void tlm_cbor_heap(cbor_writer_t *w, const void *msg)
+{
+    const tlm_heap_t *m = msg;
+
+    cbor_put_map(w, 1);
+    cbor_put_text(w, TLM_KEY_HEAP);
+    cbor_put_map(w, 2);
+    cbor_put_text(w, TLM_KEY_REQUEST);
+    cbor_put_uint(w, m->request);
+    cbor_put_text(w, TLM_KEY_REGIONS);
+    cbor_put_array(w, m->count);
+    for (uint32_t i = 0; i < m->count; i++) {
+        tlm_heap_region_t r = {0};
+        m->get_regions(m->ctx, i, &r);
+        tlm_cbor_put_heap_region(w, &r);
+    }
+}
+
+const tlm_codec_t tlm_heap_codec = {
+    .type = WIRE_MSG_HEAP,
+    .wire = tlm_wire_heap,
+    .payload = tlm_wire_payload_heap,
+    .json = tlm_json_heap,
+    .cbor = tlm_cbor_heap,
+};
+
+// --------------------------------------------------------------------
+// log_info message
+// --------------------------------------------------------------------
+static void tlm_wire_payload_log_info(wire_writer_t *w, const void *msg)
+{
+    const tlm_log_info_t *m = msg;
+
+    wire_put_u8(w, (uint8_t)tlm_sat(m->request, UINT8_MAX));
+    wire_put_u32(w, m->records);
+    wire_put_u32(w, m->bytes);
+    wire_put_u32(w, m->capacity);
+    wire_put_u16(w, (uint16_t)tlm_sat(m->sectors, UINT16_MAX));
+    wire_put_u32(w, m->sector_size);
+}
+
+static char *tlm_wire_log_info(const void *msg)
+{
+    wire_writer_t w;
+
+    if (!wire_begin(&w, TLM_WIRE_LOG_INFO_SIZE, WIRE_MSG_LOG_INFO)) {
+        return NULL;
+    }
+    tlm_wire_payload_log_info(&w, msg);
+    return wire_finish(&w);
+}
+
+static void tlm_json_log_info(stream_writer_t *s, const void *msg)
+{
+    const tlm_log_info_t *m = msg;
+    bool first = true;
+
+    stream_puts(s, "{ \"" TLM_KEY_LOG_INFO "\": { ");
+    tlm_json_key(s, &first, TLM_KEY_REQUEST);
+    stream_printf(s, "%" PRIu32, m->request);
+    tlm_json_key(s, &first, TLM_KEY_RECORDS);
+    stream_printf(s, "%" PRIu32, m->records);
+    tlm_json_key(s, &first, TLM_KEY_BYTES);
+    stream_printf(s, "%" PRIu32, m->bytes);
+    tlm_json_key(s, &first, TLM_KEY_CAPACITY);
+    stream_printf(s, "%" PRIu32, m->capacity);
+    tlm_json_key(s, &first, TLM_KEY_SECTORS);
+    stream_printf(s, "%" PRIu32, m->sectors);
+    tlm_json_key(s, &first, TLM_KEY_SECTOR_SIZE);
+    stream_printf(s, "%" PRIu32, m->sector_size);
+    stream_puts(s, " } }");
+}
+
+static void tlm_cbor_log_info(cbor_writer_t *w, const void *msg)
+{
+    const tlm_log_info_t *m = msg;
+
+    cbor_put_map(w, 1);
+    cbor_put_text(w, TLM_KEY_LOG_INFO);
+    cbor_put_map(w, 6);
+    cbor_put_text(w, TLM_KEY_REQUEST);
+    cbor_put_uint(w, m->request);
+    cbor_put_text(w, TLM_KEY_RECORDS);
+    cbor_put_uint(w, m->records);
+    cbor_put_text(w, TLM_KEY_BYTES);
+    cbor_put_uint(w, m->bytes);
+    cbor_put_text(w, TLM_KEY_CAPACITY);
+    cbor_put_uint(w, m->capacity);
+    cbor_put_text(w, TLM_KEY_SECTORS);
+    cbor_put_uint(w, m->sectors);
+    cbor_put_text(w, TLM_KEY_SECTOR_SIZE);
+    cbor_put_uint(w, m->sector_size);
+}
+
+const tlm_codec_t tlm_log_info_codec = {
+    .type = WIRE_MSG_LOG_INFO,
+    .wire = tlm_wire_log_info,
+    .payload = tlm_wire_payload_log_info,
+    .json = tlm_json_log_info,
+    .cbor = tlm_cbor_log_info,
+};
@@ -0,0 +1,214 @@
+// Generated by schema/generate.py from schema/telemetry.py, do not edit.
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "telemetry_defs.h"
+#include "wire.h"
+#include "stream.h"
+#include "cbor.h"
+
+
+// --------------------------------------------------------------------
+// List entries. Integers are 32 bits here, the binary encoder saturates
+// them to the wire type. Names may be NULL.
+// --------------------------------------------------------------------
+typedef struct {
+    const char *task_name;
+    uint32_t run_time;
+    uint32_t isr_time;
+    uint32_t percentage;
+    int32_t core;
+    uint32_t flags;             // selects the JSON variant
+} tlm_task_t;
+
+typedef struct {
+    uint32_t tag;
+    int32_t core;
+    const char *name;
+    uint32_t count;
+    uint32_t dropped;
+    uint32_t incl_min_ns;
+    uint32_t incl_avg_ns;
+    uint32_t incl_max_ns;
+    uint32_t excl_min_ns;
+    uint32_t excl_avg_ns;
+    uint32_t excl_max_ns;
+    const uint32_t *hist;       // 16 values
+} tlm_isr_entry_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t bytes_per_s;
+    uint32_t msgs_per_min;
+} tlm_budget_entry_t;
+
+typedef struct {
+    const char *task_name;
+    uint32_t number;
+    uint32_t state;
+    uint32_t priority;
+    uint32_t base_priority;
+    int32_t core;
+    uint32_t stack_free;
+    uint32_t run_time;
+} tlm_task_detail_t;
+
+typedef struct {
+    uint32_t caps;
+    uint32_t total;
+    uint32_t free;
+    uint32_t largest_free;
+    uint32_t min_free;
+    uint32_t allocated_blocks;
+    uint32_t free_blocks;
+} tlm_heap_region_t;
+
+typedef struct {
+    uint32_t channel;
+    uint32_t count;
+    uint32_t coalesced;
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t max_us;
+    const uint32_t *hist;       // 16 values
+} tlm_wakeup_entry_t;
+
+
+// --------------------------------------------------------------------
+// Messages. Lists are read through a getter, called with the index of
+// the entry (0 .. count-1) once per encoding pass, so the caller does not
+// need to build an array of entries.
+// --------------------------------------------------------------------
+typedef struct {
+    uint32_t cores;
+    uint32_t cpu_hz;
+    const char *tag;
+} tlm_device_t;
+
+typedef void (*tlm_get_task_fn)(const void *ctx, uint32_t index, tlm_task_t *out);
+typedef struct {
+    uint32_t core_count;
+    uint32_t task_count;
+    const uint32_t *cores;      // core_count values
+    const uint32_t *isr_load;   // core_count values
+    tlm_get_task_fn get_tasks;
+    const void *ctx;            // passed to the getters
+} tlm_tasks_t;
+
+typedef struct {
+    uint32_t heap_total;
+    uint32_t heap_free;
+    uint32_t internal_total;
+    uint32_t internal_free;
+} tlm_memory_t;
+
+typedef void (*tlm_get_isr_entry_fn)(const void *ctx, uint32_t index, tlm_isr_entry_t *out);
+typedef struct {
+    uint64_t uptime_us;
+    uint32_t cpu_hz;
+    uint32_t hist_shift;
+    uint32_t freq_changes;
+    uint32_t bad_tag;
+    uint32_t count;
+    tlm_get_isr_entry_fn get_isr;
+    const void *ctx;            // passed to the getters
+} tlm_isr_t;
+
+typedef void (*tlm_get_wakeup_entry_fn)(const void *ctx, uint32_t index, tlm_wakeup_entry_t *out);
+typedef struct {
+    uint32_t count;
+    tlm_get_wakeup_entry_fn get_wakeup;
+    const void *ctx;            // passed to the getters
+} tlm_wakeup_t;
+
+typedef struct {
+    uint32_t seq;
+    uint64_t uptime_us;
+    uint32_t window_us;
+    uint32_t period_ms;
+    uint32_t coalesced;
+    uint32_t core_count;
+    uint32_t task_count;
+    const uint32_t *cores;      // core_count values
+    const uint32_t *isr_load;   // core_count values
+    tlm_get_task_fn get_tasks;
+    uint32_t heap_total;
+    uint32_t heap_free;
+    uint32_t internal_total;
+    uint32_t internal_free;
+    const void *ctx;            // passed to the getters
+} tlm_report_t;
+
+typedef struct {
+    uint32_t baud;
+    uint32_t status;
+    uint32_t pattern_len;
+    const uint32_t *pattern;    // pattern_len values
+} tlm_link_t;
+
+typedef void (*tlm_get_budget_entry_fn)(const void *ctx, uint32_t index, tlm_budget_entry_t *out);
+typedef struct {
+    uint32_t baud;
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t count;
+    tlm_get_budget_entry_fn get_metrics;
+    const void *ctx;            // passed to the getters
+} tlm_budget_t;
+
+typedef struct {
+    uint32_t request;
+    uint32_t cmd;
+    uint32_t status;
+} tlm_reply_t;
+
+typedef void (*tlm_get_task_detail_fn)(const void *ctx, uint32_t index, tlm_task_detail_t *out);
+typedef struct {
+    uint32_t request;
+    uint32_t count;
+    tlm_get_task_detail_fn get_tasks;
+    const void *ctx;            // passed to the getters
+} tlm_task_info_t;
+
+typedef void (*tlm_get_heap_region_fn)(const void *ctx, uint32_t index, tlm_heap_region_t *out);
+typedef struct {
+    uint32_t request;
+    uint32_t count;
+    tlm_get_heap_region_fn get_regions;
+    const void *ctx;            // passed to the getters
+} tlm_heap_t;
+
+typedef struct {
+    uint32_t request;
+    uint32_t records;
+    uint32_t bytes;
+    uint32_t capacity;
+    uint32_t sectors;
+    uint32_t sector_size;
+} tlm_log_info_t;
+
+
+// --------------------------------------------------------------------
+// One codec per message, msg points to its tlm_<name>_t
+// --------------------------------------------------------------------
+typedef struct {
+    wire_msg_type_t type;
+    char *(*wire)(const void *msg);                        // COBS frame, NULL on no memory
+    void (*payload)(wire_writer_t *w, const void *msg);    // binary payload only (delta.h)
+    void (*json)(stream_writer_t *s, const void *msg);     // a stream_emit_fn
+    void (*cbor)(cbor_writer_t *w, const void *msg);
+} tlm_codec_t;
+
+extern const tlm_codec_t tlm_device_codec;
+extern const tlm_codec_t tlm_tasks_codec;
+extern const tlm_codec_t tlm_memory_codec;
+extern const tlm_codec_t tlm_isr_codec;
+extern const tlm_codec_t tlm_wakeup_codec;
+extern const tlm_codec_t tlm_report_codec;
+extern const tlm_codec_t tlm_link_codec;
+extern const tlm_codec_t tlm_budget_codec;
+extern const tlm_codec_t tlm_reply_codec;
+extern const tlm_codec_t tlm_task_info_codec;
+extern const tlm_codec_t tlm_heap_codec;
+extern const tlm_codec_t tlm_log_info_codec;
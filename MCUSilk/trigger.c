@@ -0,0 +1,345 @@
+#include <stdlib.h>
+#include "trigger.h"
+#include "isr_trace.h"
+#include "stream.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+
+// --------------------------------------------------------------------
+// Globals
+// --------------------------------------------------------------------
+#define TRIGGER_RING_SIZE   (TRIGGER_PRE_SAMPLES + 1 + TRIGGER_POST_SAMPLES)
+
+static trigger_cfg_t trig_cfg = {
+    .core_load_pct = TRIGGER_CORE_LOAD_PCT,
+    .task_load_pct = TRIGGER_TASK_LOAD_PCT,
+    .heap_free_min = TRIGGER_HEAP_FREE_MIN,
+    .isr_duration_us = TRIGGER_ISR_DURATION_US,
+};
+
+static TaskStatus_t *trig_status[2];      // previous and current snapshot
+static UBaseType_t trig_status_size;        // entries in each, grown with the task count
+static bool trig_stopped;                   // out of memory for them, reported once
+static trigger_sample_t trig_ring[TRIGGER_RING_SIZE];
+
+static const char *trigger_cause_name[] = {
+    [TRIGGER_CAUSE_NONE]         = "none",
+    [TRIGGER_CAUSE_CORE_LOAD]    = "core_load",
+    [TRIGGER_CAUSE_TASK_LOAD]    = "task_load",
+    [TRIGGER_CAUSE_HEAP_LOW]     = "heap_low",
+    [TRIGGER_CAUSE_ISR_DURATION] = "isr_duration",
+};
+
+
+void trigger_configure(const trigger_cfg_t *cfg)
+{
+    if (cfg) {
+        trig_cfg = *cfg;
+    }
+}
+
+// --------------------------------------------------------------------
+// Room in both snapshots for every task, with the same headroom as the
+// stats task. realloc keeps the previous snapshot for the next delta.
+// Without the memory the engine stops, with one alert saying so.
+// --------------------------------------------------------------------
+static bool trigger_status_fit(void)
+{
+    UBaseType_t tasks = uxTaskGetNumberOfTasks();
+
+    if (tasks <= trig_status_size) {
+        return true;
+    }
+
+    UBaseType_t size = tasks + ARRAY_SIZE_OFFSET;
+    for (int i = 0; i < 2; i++)
+    {
+        TaskStatus_t *grown = realloc(trig_status[i], sizeof(TaskStatus_t) * size);
+        if (grown == NULL)
+        {
+            if (!trig_stopped)
+            {
+                char alert[128];
+                snprintf(alert, sizeof(alert),
+                         "{ \"error\": \"trigger stopped\", \"code\": \"ESP_ERR_NO_MEM\", \"tasks\": %u }",
+                         (unsigned)tasks);
+                cpu_usage_alert_json(alert);
+                trig_stopped = true;
+            }
+            return false;
+        }
+        trig_status[i] = grown;
+    }
+
+    trig_status_size = size;
+    trig_stopped = false;
+    return true;
+}
+
+// --------------------------------------------------------------------
+// Take one high-resolution sample from the delta against the previous one.
+// Returns false if there is no valid previous snapshot yet.
+// --------------------------------------------------------------------
+static bool trigger_take_sample(trigger_sample_t *s, int *snap, UBaseType_t *prev_count,
+                                configRUN_TIME_COUNTER_TYPE *prev_total)
+{
+    configRUN_TIME_COUNTER_TYPE total;
+
+    if (!trigger_status_fit()) {
+        return false;
+    }
+
+    TaskStatus_t *prev = trig_status[*snap];
+    TaskStatus_t *curr = trig_status[*snap ^ 1];
+
+    UBaseType_t count = uxTaskGetSystemState(curr, trig_status_size, &total);
+    if (count == 0) {
+        return false;   // tasks created since the fit, there is room next time
+    }
+
+    uint32_t elapsed = total - *prev_total;
+    bool valid = (*prev_count > 0 && elapsed > 0);
+
+    if (valid)
+    {
+        memset(s, 0, sizeof(*s));
+        s->timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        s->heap_free = esp_get_free_heap_size();
+        s->isr_max_us = ISR_Trace_Take_Max_Ns() / 1000;
+
+        for (int core = 0; core < (int)cpu_usage_core_count(); core++) {
+            s->core_load[core] = 100;
+        }
+
+        for (UBaseType_t i = 0; i < count; i++)
+        {
+            uint32_t delta = 0;
+            for (UBaseType_t j = 0; j < *prev_count; j++) {
+                if (prev[j].xHandle == curr[i].xHandle) {
+                    delta = curr[i].ulRunTimeCounter - prev[j].ulRunTimeCounter;
+                    break;
+                }
+            }
+
+            uint32_t pct = (uint32_t)(((uint64_t)delta * 100ULL) / elapsed);
+            if (pct > 100) pct = 100;
+
+            // Core load is everything the idle task did not get
+            bool idle = false;
+            for (int core = 0; core < (int)cpu_usage_core_count(); core++) {
+                if (curr[i].xHandle == xTaskGetIdleTaskHandleForCore(core)) {
+                    s->core_load[core] = (uint8_t)(100 - pct);
+                    idle = true;
+                }
+            }
+            if (idle) {
+                continue;
+            }
+
+            // Keep the TRIGGER_TOP_TASKS busiest tasks
+            int slot = s->task_count;
+            if (slot == TRIGGER_TOP_TASKS)
+            {
+                slot = 0;
+                for (int k = 1; k < TRIGGER_TOP_TASKS; k++) {
+                    if (s->tasks[k].percentage < s->tasks[slot].percentage) {
+                        slot = k;
+                    }
+                }
+                if (s->tasks[slot].percentage >= pct) {
+                    continue;
+                }
+            }
+            else
+            {
+                s->task_count++;
+            }
+
+            snprintf(s->tasks[slot].task_name, sizeof(s->tasks[slot].task_name), "%s", curr[i].pcTaskName);
+            s->tasks[slot].percentage = (uint8_t)pct;
+            s->tasks[slot].core_id = (int8_t)cpu_usage_task_core(curr[i].xHandle);
+        }
+    }
+
+    *snap ^= 1;
+    *prev_count = count;
+    *prev_total = total;
+    return valid;
+}
+
+// --------------------------------------------------------------------
+// Check the sample against the thresholds
+// --------------------------------------------------------------------
+static trigger_cause_t trigger_evaluate(const trigger_sample_t *s, uint32_t *value)
+{
+    if (trig_cfg.core_load_pct) {
+        for (int core = 0; core < (int)cpu_usage_core_count(); core++) {
+            if (s->core_load[core] > trig_cfg.core_load_pct) {
+                *value = s->core_load[core];
+                return TRIGGER_CAUSE_CORE_LOAD;
+            }
+        }
+    }
+
+    if (trig_cfg.task_load_pct) {
+        for (int i = 0; i < s->task_count; i++) {
+            if (s->tasks[i].percentage > trig_cfg.task_load_pct) {
+                *value = s->tasks[i].percentage;
+                return TRIGGER_CAUSE_TASK_LOAD;
+            }
+        }
+    }
+
+    if (trig_cfg.heap_free_min && s->heap_free < trig_cfg.heap_free_min) {
+        *value = s->heap_free;
+        return TRIGGER_CAUSE_HEAP_LOW;
+    }
+
+    if (trig_cfg.isr_duration_us && s->isr_max_us > trig_cfg.isr_duration_us) {
+        *value = s->isr_max_us;
+        return TRIGGER_CAUSE_ISR_DURATION;
+    }
+
+    return TRIGGER_CAUSE_NONE;
+}
+
+// --------------------------------------------------------------------
+// One sample of a captured window as a JSON line
+// --------------------------------------------------------------------
+typedef struct {
+    uint32_t id;
+    trigger_cause_t cause;
+    uint32_t value;
+    const char *phase;
+    const trigger_sample_t *s;
+} trigger_line_t;
+
+static void trigger_json(stream_writer_t *w, const void *ctx)
+{
+    const trigger_line_t *l = ctx;
+    const trigger_sample_t *s = l->s;
+
+    // Each item well within a stream chunk
+    stream_printf(w, "{ \"trigger\": { \"id\": %" PRIu32 ", \"cause\": \"%s\", \"value\": %" PRIu32 ", ",
+                  l->id, trigger_cause_name[l->cause], l->value);
+    stream_printf(w, "\"phase\": \"%s\", \"time_ms\": %" PRIu32 ", ", l->phase, s->timestamp_ms);
+    stream_printf(w, "\"heap_free\": %" PRIu32 ", \"isr_max_us\": %" PRIu32 ", \"cores\": [",
+                  s->heap_free, s->isr_max_us);
+
+    for (int core = 0; core < (int)cpu_usage_core_count(); core++) {
+        stream_printf(w, "%s%u", core ? ", " : "", s->core_load[core]);
+    }
+
+    stream_puts(w, "], \"tasks\": [ ");
+    for (int i = 0; i < s->task_count; i++) {
+        stream_puts(w, "{\"task_name\": ");
+        stream_put_json_str(w, s->tasks[i].task_name);
+        stream_printf(w, ", \"percentage\": %u, \"core\": %d}%s",
+                      s->tasks[i].percentage, s->tasks[i].core_id,
+                      (i < s->task_count - 1) ? "," : "");
+    }
+    stream_puts(w, " ] } }");
+}
+
+// Straight into the sink buffer, a line that does not fit is dropped and counted
+static bool trigger_encode(const void *ctx, cpu_usage_format_t fmt, cpu_usage_msg_t *msg)
+{
+    if (fmt != CPU_USAGE_FORMAT_JSON) {
+        return false;
+    }
+    // + 1 for the NUL stream_fill() ends with
+    msg->len = stream_fill(trigger_json, ctx, msg->data, msg->cap + 1);
+    return msg->len != 0;
+}
+
+// --------------------------------------------------------------------
+// Emit the captured window, oldest first, one JSON line per sample
+// --------------------------------------------------------------------
+static void trigger_emit(uint32_t id, trigger_cause_t cause, uint32_t value,
+                         uint32_t first, uint32_t count, uint32_t fire_pos)
+{
+    for (uint32_t n = 0; n < count; n++)
+    {
+        trigger_line_t l = {
+            .id = id,
+            .cause = cause,
+            .value = value,
+            .phase = (n < fire_pos) ? "pre" : (n == fire_pos) ? "fire" : "post",
+            .s = &trig_ring[(first + n) % TRIGGER_RING_SIZE],
+        };
+
+        // A capture is rare and bursty, wait for the print task instead of dropping
+        cpu_usage_publish(trigger_encode, &l, pdMS_TO_TICKS(500));
+    }
+}
+
+// --------------------------------------------------------------------
+// Task that samples at high rate and dumps the window around a spike
+// --------------------------------------------------------------------
+void trigger_task(void *arg)
+{
+    int snap = 0;
+    UBaseType_t prev_count = 0;
+    configRUN_TIME_COUNTER_TYPE prev_total = 0;
+
+    uint32_t head = 0;          // next ring slot
+    uint32_t filled = 0;        // valid samples in the ring
+    uint32_t post_left = 0;     // post-trigger samples still to capture
+    uint32_t holdoff = 0;
+    uint32_t trigger_id = 0;
+    uint32_t fire_head = 0;
+    uint32_t fire_value = 0;
+    trigger_cause_t fire_cause = TRIGGER_CAUSE_NONE;
+
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1)
+    {
+        vTaskDelayUntil(&last_wake, TRIGGER_SAMPLE_TICKS);
+
+        trigger_sample_t *s = &trig_ring[head];
+        if (!trigger_take_sample(s, &snap, &prev_count, &prev_total)) {
+            continue;
+        }
+
+        head = (head + 1) % TRIGGER_RING_SIZE;
+        if (filled < TRIGGER_RING_SIZE) filled++;
+
+        if (post_left > 0)
+        {
+            if (--post_left == 0)
+            {
+                // Window complete: up to PRE samples, the fire sample, POST samples
+                uint32_t pre = (filled - 1 - TRIGGER_POST_SAMPLES);
+                if (pre > TRIGGER_PRE_SAMPLES) pre = TRIGGER_PRE_SAMPLES;
+                uint32_t first = (fire_head + TRIGGER_RING_SIZE - pre) % TRIGGER_RING_SIZE;
+
+                trigger_emit(trigger_id, fire_cause, fire_value, first,
+                             pre + 1 + TRIGGER_POST_SAMPLES, pre);
+
+                // Samples were not taken while printing, restart the deltas
+                prev_count = 0;
+                filled = 0;
+                holdoff = TRIGGER_HOLDOFF_SAMPLES;
+                last_wake = xTaskGetTickCount();
+            }
+            continue;
+        }
+
+        if (holdoff > 0)
+        {
+            holdoff--;
+            continue;
+        }
+
+        fire_cause = trigger_evaluate(s, &fire_value);
+        if (fire_cause != TRIGGER_CAUSE_NONE)
+        {
+            trigger_id++;
+            fire_head = (head + TRIGGER_RING_SIZE - 1) % TRIGGER_RING_SIZE;
+            post_left = TRIGGER_POST_SAMPLES;
+        }
+    }
+}
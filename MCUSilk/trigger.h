@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "CPU_usage.h"
+
+
+// --------------------------------------------------------------------
+// Configuration
+// --------------------------------------------------------------------
+
+// The trigger task samples at TRIGGER_SAMPLE_TICKS (high resolution) but prints
+// nothing until a condition fires. The normal stats task stays the low-rate baseline.
+#define TRIGGER_ENABLE              1
+#define TRIGGER_SAMPLE_TICKS        pdMS_TO_TICKS(100)
+#define TRIGGER_PRE_SAMPLES         20      // kept before the trigger
+#define TRIGGER_POST_SAMPLES        20      // captured after the trigger
+#define TRIGGER_HOLDOFF_SAMPLES     50      // quiet time before re-arming
+#define TRIGGER_TOP_TASKS           4       // busiest tasks stored per sample
+
+// Default thresholds, 0 disables a condition
+#define TRIGGER_CORE_LOAD_PCT       90      // any core busier than this
+#define TRIGGER_TASK_LOAD_PCT       80      // any task using more of its core than this
+#define TRIGGER_HEAP_FREE_MIN       16384   // free heap below this (bytes)
+#define TRIGGER_ISR_DURATION_US     0       // any traced ISR longer than this
+
+
+// --------------------------------------------------------------------
+// Structs
+// --------------------------------------------------------------------
+typedef enum {
+    TRIGGER_CAUSE_NONE = 0,
+    TRIGGER_CAUSE_CORE_LOAD,
+    TRIGGER_CAUSE_TASK_LOAD,
+    TRIGGER_CAUSE_HEAP_LOW,
+    TRIGGER_CAUSE_ISR_DURATION,
+} trigger_cause_t;
+
+typedef struct {
+    uint8_t core_load_pct;
+    uint8_t task_load_pct;
+    uint32_t heap_free_min;
+    uint32_t isr_duration_us;
+} trigger_cfg_t;
+
+typedef struct {
+    char task_name[16];
+    uint8_t percentage;         // % of the core the task ran on
+    int8_t core_id;
+} trigger_task_t;
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint32_t heap_free;
+    uint32_t isr_max_us;
+    uint8_t core_load[CPU_USAGE_MAX_CORES];
+    uint8_t task_count;
+    trigger_task_t tasks[TRIGGER_TOP_TASKS];
+} trigger_sample_t;
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+void trigger_configure(const trigger_cfg_t *cfg);
+void trigger_task(void *arg);
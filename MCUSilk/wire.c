@@ -0,0 +1,322 @@
+#include <stdlib.h>
+#include <string.h>
+#include "wire.h"
+
+
+// --------------------------------------------------------------------
+// Frame building
+// --------------------------------------------------------------------
+
+// Allocate room for the header, payload_size bytes of payload and the CRC
+bool wire_begin(wire_writer_t *w, size_t payload_size, wire_msg_type_t type)
+{
+    uint8_t *buf = malloc(2 + payload_size + 2);
+    if (!buf) {
+        return false;
+    }
+
+    wire_begin_buffer(w, buf, 2 + payload_size + 2, type);
+    return true;
+}
+
+// Write the frame into the caller's buffer, finished with wire_frame()
+void wire_begin_buffer(wire_writer_t *w, uint8_t *buf, size_t cap, wire_msg_type_t type)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = false;
+    w->collect = false;
+
+    wire_put_u8(w, WIRE_VERSION);
+    wire_put_u8(w, (uint8_t)type);
+}
+
+// Collect the payload fields instead of writing them, see wire_writer_t
+void wire_begin_values(wire_writer_t *w, uint32_t *values, size_t cap)
+{
+    w->buf = NULL;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = false;
+    w->collect = true;
+    w->values = values;
+    w->shape = 2166136261u;
+}
+
+static void wire_shape(wire_writer_t *w, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        w->shape = (w->shape ^ data[i]) * 16777619u;
+    }
+}
+
+static void wire_put_value(wire_writer_t *w, uint32_t v, uint8_t size)
+{
+    wire_shape(w, &size, 1);
+    if (w->len < w->cap) {
+        w->values[w->len] = v;
+    } else {
+        w->overflow = true;
+    }
+    w->len++;
+}
+
+void wire_put_bytes(wire_writer_t *w, const void *data, size_t len)
+{
+    if (w->collect) {
+        wire_shape(w, data, len);
+        return;
+    }
+    if (w->overflow || w->len + len > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+void wire_put_u8(wire_writer_t *w, uint8_t v)
+{
+    if (w->collect) {
+        wire_put_value(w, v, 1);
+        return;
+    }
+    wire_put_bytes(w, &v, 1);
+}
+
+void wire_put_u16(wire_writer_t *w, uint16_t v)
+{
+    if (w->collect) {
+        wire_put_value(w, v, 2);
+        return;
+    }
+    uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) };
+    wire_put_bytes(w, b, sizeof(b));
+}
+
+void wire_put_u32(wire_writer_t *w, uint32_t v)
+{
+    if (w->collect) {
+        wire_put_value(w, v, 4);
+        return;
+    }
+    uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    wire_put_bytes(w, b, sizeof(b));
+}
+
+// Low half first, which is also how values mode sees it: two u32 fields
+void wire_put_u64(wire_writer_t *w, uint64_t v)
+{
+    wire_put_u32(w, (uint32_t)v);
+    wire_put_u32(w, (uint32_t)(v >> 32));
+}
+
+// LEB128: 7 bits per byte, low group first, top bit set on all but the last
+void wire_put_varint(wire_writer_t *w, uint32_t v)
+{
+    uint8_t b[5];
+    size_t len = 0;
+
+    do {
+        b[len] = v & 0x7F;
+        v >>= 7;
+        if (v) {
+            b[len] |= 0x80;
+        }
+        len++;
+    } while (v);
+
+    wire_put_bytes(w, b, len);
+}
+
+// Fixed WIRE_NAME_LEN field, truncated and NUL padded
+void wire_put_name(wire_writer_t *w, const char *name)
+{
+    char field[WIRE_NAME_LEN] = {0};
+    if (name) {
+        strncpy(field, name, WIRE_NAME_LEN);
+    }
+    wire_put_bytes(w, field, WIRE_NAME_LEN);
+}
+
+// CRC-16/CCITT-FALSE, bitwise to keep it table free (frames are short)
+uint16_t wire_crc16(const uint8_t *data, size_t len)
+{
+    return wire_crc16_update(0xFFFF, data, len);
+}
+
+uint16_t wire_crc16_update(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// --------------------------------------------------------------------
+// COBS, fed piece by piece so the CRC and a payload need not be copied
+// together first. The output has no zero bytes and is NUL terminated.
+// --------------------------------------------------------------------
+typedef struct {
+    char *out;
+    size_t cap;                 // including the terminator
+    size_t pos;
+    size_t code_pos;
+    uint8_t code;
+    bool overflow;
+} wire_cobs_t;
+
+static void wire_cobs_init(wire_cobs_t *c, char *out, size_t cap)
+{
+    c->out = out;
+    c->cap = cap;
+    c->pos = 1;
+    c->code_pos = 0;
+    c->code = 1;
+    c->overflow = cap < 2;
+}
+
+static void wire_cobs_put(wire_cobs_t *c, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len && !c->overflow; i++)
+    {
+        // Worst case this byte and the next code byte, then the terminator
+        if (c->pos + 2 > c->cap) {
+            c->overflow = true;
+            return;
+        }
+
+        if (data[i] == 0) {
+            c->out[c->code_pos] = (char)c->code;
+            c->code_pos = c->pos++;
+            c->code = 1;
+            continue;
+        }
+
+        c->out[c->pos++] = (char)data[i];
+        if (++c->code == 0xFF) {
+            // The run is full, its new code byte must leave room for the terminator too
+            if (c->pos + 2 > c->cap) {
+                c->overflow = true;
+                return;
+            }
+            c->out[c->code_pos] = (char)c->code;
+            c->code_pos = c->pos++;
+            c->code = 1;
+        }
+    }
+}
+
+// Length without the terminator, 0 if it did not fit
+static size_t wire_cobs_end(wire_cobs_t *c)
+{
+    if (c->overflow) {
+        return 0;
+    }
+    c->out[c->code_pos] = (char)c->code;
+    c->out[c->pos] = '\0';
+    return c->pos;
+}
+
+static void wire_cobs_crc(wire_cobs_t *c, uint16_t crc)
+{
+    uint8_t b[2] = { (uint8_t)crc, (uint8_t)(crc >> 8) };
+    wire_cobs_put(c, b, sizeof(b));
+}
+
+// --------------------------------------------------------------------
+// Append the CRC and COBS encode. The result has no zero bytes, so it is
+// returned as a NUL terminated string. Frees the raw buffer, returns NULL
+// on overflow or out of memory.
+// --------------------------------------------------------------------
+char *wire_finish(wire_writer_t *w)
+{
+    char *out = NULL;
+
+    if (!w->buf) {
+        return NULL;
+    }
+
+    if (!w->overflow)
+    {
+        // One code byte per 254 data bytes plus the leading one, plus the terminator
+        size_t size = w->len + 2 + (w->len + 2) / 254 + 2;
+        out = malloc(size);
+        if (out && wire_frame(w->buf, w->len, out, size) == 0) {
+            free(out);
+            out = NULL;
+        }
+    }
+
+    free(w->buf);
+    w->buf = NULL;
+    return out;
+}
+
+// --------------------------------------------------------------------
+// COBS frame of a raw frame (version | type | payload) and its CRC into
+// out. Returns the length without the terminator, 0 if it does not fit.
+// --------------------------------------------------------------------
+size_t wire_frame(const uint8_t *raw, size_t len, char *out, size_t cap)
+{
+    wire_cobs_t c;
+
+    wire_cobs_init(&c, out, cap);
+    wire_cobs_put(&c, raw, len);
+    wire_cobs_crc(&c, wire_crc16(raw, len));
+    return wire_cobs_end(&c);
+}
+
+// Frame an already encoded payload (JSON text, CBOR) into out, as wire_frame()
+size_t wire_payload_frame(wire_msg_type_t type, const void *payload, size_t len, char *out, size_t cap)
+{
+    wire_cobs_t c;
+    uint8_t header[2] = { WIRE_VERSION, (uint8_t)type };
+
+    wire_cobs_init(&c, out, cap);
+    wire_cobs_put(&c, header, sizeof(header));
+    wire_cobs_put(&c, payload, len);
+    wire_cobs_crc(&c, wire_crc16_update(wire_crc16(header, sizeof(header)), payload, len));
+    return wire_cobs_end(&c);
+}
+
+// --------------------------------------------------------------------
+// Decode a received frame (without its 0x00 delimiter) in place. Returns
+// the length of version | type | payload, 0 if the COBS, CRC or version
+// does not check out.
+// --------------------------------------------------------------------
+size_t wire_unframe(uint8_t *buf, size_t len)
+{
+    size_t in = 0;
+    size_t out = 0;
+
+    // Decoded data is never longer than the COBS, so out stays behind in
+    while (in < len)
+    {
+        uint8_t code = buf[in];
+        if (code == 0 || in + code > len) {
+            return 0;
+        }
+        memmove(&buf[out], &buf[in + 1], code - 1);
+        out += code - 1;
+        in += code;
+        if (code < 0xFF && in < len) {
+            buf[out++] = 0;
+        }
+    }
+
+    if (out < 4) {
+        return 0;
+    }
+    out -= 2;
+    uint16_t crc = (uint16_t)(buf[out] | buf[out + 1] << 8);
+    if (wire_crc16(buf, out) != crc || buf[0] != WIRE_VERSION) {
+        return 0;
+    }
+    return out;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "telemetry_defs.h"
+
+
+// --------------------------------------------------------------------
+// Binary wire protocol
+// --------------------------------------------------------------------
+//
+// One frame = COBS( version | type | payload | crc16 ) followed by a 0x00 delimiter.
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over version..payload, little-endian.
+// All multi-byte payload fields are little-endian, strings are fixed size and
+// NUL padded. The payload layouts, message types and WIRE_VERSION are generated
+// from schema/telemetry.py into telemetry_defs.h.
+//
+
+// Raw (not yet COBS encoded) frame under construction. In values mode
+// (wire_begin_values) nothing is written: every integer field is collected
+// into values[] and the names only go into shape, which lets the delta
+// encoder compare two reports field by field.
+typedef struct {
+    uint8_t *buf;
+    size_t cap;                 // bytes, or values in values mode
+    size_t len;                 // bytes, or values seen (may exceed cap)
+    bool overflow;
+    bool collect;               // values mode
+    uint32_t *values;
+    uint32_t shape;             // FNV-1a of the field sizes and names
+} wire_writer_t;
+
+
+// --------------------------------------------------------------------
+// Function prototypes
+// --------------------------------------------------------------------
+bool wire_begin(wire_writer_t *w, size_t payload_size, wire_msg_type_t type);
+void wire_begin_buffer(wire_writer_t *w, uint8_t *buf, size_t cap, wire_msg_type_t type);
+void wire_begin_values(wire_writer_t *w, uint32_t *values, size_t cap);
+void wire_put_u8(wire_writer_t *w, uint8_t v);
+void wire_put_u16(wire_writer_t *w, uint16_t v);
+void wire_put_u32(wire_writer_t *w, uint32_t v);
+void wire_put_u64(wire_writer_t *w, uint64_t v);
+void wire_put_varint(wire_writer_t *w, uint32_t v);
+void wire_put_bytes(wire_writer_t *w, const void *data, size_t len);
+void wire_put_name(wire_writer_t *w, const char *name);
+char *wire_finish(wire_writer_t *w);
+size_t wire_frame(const uint8_t *raw, size_t len, char *out, size_t cap);
+size_t wire_payload_frame(wire_msg_type_t type, const void *payload, size_t len, char *out, size_t cap);
+uint16_t wire_crc16(const uint8_t *data, size_t len);
+uint16_t wire_crc16_update(uint16_t crc, const uint8_t *data, size_t len);
+
+// Received frame, decoded in place
+size_t wire_unframe(uint8_t *buf, size_t len);
@@ -0,0 +1,1123 @@
+// Generated by schema/generate.py from schema/telemetry.py, do not edit.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+
+// Decoder for the MCUSilk telemetry, binary frames and JSON messages.
+// JSON goes through any type with the nlohmann::json interface
+// (contains / at / get<T> / range-for), so there is no hard dependency.
+namespace telemetry {
+
+constexpr uint8_t WIRE_VERSION = 3;
+constexpr size_t NAME_LEN = 16;
+constexpr unsigned LZ_WINDOW_BITS = 8;
+constexpr unsigned LZ_LOOKAHEAD_BITS = 4;
+
+enum class MsgType : uint8_t {
+    Device = 1,
+    Tasks = 2,
+    Memory = 3,
+    Isr = 4,
+    Wakeup = 5,
+    Json = 6,
+    Cbor = 7,
+    Delta = 8,
+    Lz = 9,
+    Report = 10,
+    Cmd = 11,
+    Link = 12,
+    Budget = 13,
+    Reply = 14,
+    TaskInfo = 15,
+    Heap = 16,
+    LogInfo = 17,
+};
+
+constexpr uint32_t WIRE_TASK_CREATED = 0x01;
+constexpr uint32_t WIRE_TASK_DELETED = 0x02;
+constexpr uint32_t WIRE_TASK_ISR = 0x04;
+
+constexpr uint32_t WIRE_CMD_BAUD = 1;
+constexpr uint32_t WIRE_CMD_LINK_TEST = 2;
+constexpr uint32_t WIRE_CMD_SNAPSHOT = 3;
+constexpr uint32_t WIRE_CMD_TASK = 4;
+constexpr uint32_t WIRE_CMD_STACKS = 5;
+constexpr uint32_t WIRE_CMD_HEAP = 6;
+constexpr uint32_t WIRE_CMD_DUMP = 7;
+constexpr uint32_t LINK_ACK = 0;
+constexpr uint32_t LINK_CONFIRMED = 1;
+constexpr uint32_t LINK_REFUSED = 2;
+constexpr uint32_t LINK_REVERTED = 3;
+constexpr uint32_t LINK_TEST_LEN = 256;
+constexpr uint32_t QUERY_OK = 0;
+constexpr uint32_t QUERY_UNKNOWN = 1;
+constexpr uint32_t QUERY_NOT_FOUND = 2;
+constexpr uint32_t QUERY_NO_MEM = 3;
+constexpr uint32_t QUERY_BAD_ARGS = 4;
+constexpr uint32_t QUERY_FAILED = 5;
+
+struct Task {
+    std::string task_name;
+    uint32_t run_time = 0;
+    uint32_t isr_time = 0;
+    uint32_t percentage = 0;
+    int32_t core = 0;
+    uint32_t flags = 0;
+};
+
+struct IsrEntry {
+    uint32_t tag = 0;
+    int32_t core = 0;
+    std::string name;
+    uint32_t count = 0;
+    uint32_t dropped = 0;
+    uint32_t incl_min_ns = 0;
+    uint32_t incl_avg_ns = 0;
+    uint32_t incl_max_ns = 0;
+    uint32_t excl_min_ns = 0;
+    uint32_t excl_avg_ns = 0;
+    uint32_t excl_max_ns = 0;
+    std::array<uint32_t, 16> hist{};
+};
+
+struct BudgetEntry {
+    uint32_t type = 0;
+    uint32_t bytes_per_s = 0;
+    uint32_t msgs_per_min = 0;
+};
+
+struct TaskDetail {
+    std::string task_name;
+    uint32_t number = 0;
+    uint32_t state = 0;
+    uint32_t priority = 0;
+    uint32_t base_priority = 0;
+    int32_t core = 0;
+    uint32_t stack_free = 0;
+    uint32_t run_time = 0;
+};
+
+struct HeapRegion {
+    uint32_t caps = 0;
+    uint32_t total = 0;
+    uint32_t free = 0;
+    uint32_t largest_free = 0;
+    uint32_t min_free = 0;
+    uint32_t allocated_blocks = 0;
+    uint32_t free_blocks = 0;
+};
+
+struct WakeupEntry {
+    uint32_t channel = 0;
+    uint32_t count = 0;
+    uint32_t coalesced = 0;
+    uint32_t min_us = 0;
+    uint32_t avg_us = 0;
+    uint32_t max_us = 0;
+    std::array<uint32_t, 16> hist{};
+};
+
+struct DeviceMsg {
+    uint32_t cores = 0;
+    uint32_t cpu_hz = 0;
+    std::string tag;
+};
+
+struct TasksMsg {
+    std::vector<uint32_t> cores;
+    std::vector<uint32_t> isr_load;
+    std::vector<Task> tasks;
+};
+
+struct MemoryMsg {
+    uint32_t heap_total = 0;
+    uint32_t heap_free = 0;
+    uint32_t internal_total = 0;
+    uint32_t internal_free = 0;
+};
+
+struct IsrMsg {
+    uint64_t uptime_us = 0;
+    uint32_t cpu_hz = 0;
+    uint32_t hist_shift = 0;
+    uint32_t freq_changes = 0;
+    uint32_t bad_tag = 0;
+    std::vector<IsrEntry> isr;
+};
+
+struct WakeupMsg {
+    std::vector<WakeupEntry> wakeup;
+};
+
+struct ReportMsg {
+    uint32_t seq = 0;
+    uint64_t uptime_us = 0;
+    uint32_t window_us = 0;
+    uint32_t period_ms = 0;
+    uint32_t coalesced = 0;
+    std::vector<uint32_t> cores;
+    std::vector<uint32_t> isr_load;
+    std::vector<Task> tasks;
+    uint32_t heap_total = 0;
+    uint32_t heap_free = 0;
+    uint32_t internal_total = 0;
+    uint32_t internal_free = 0;
+};
+
+struct LinkMsg {
+    uint32_t baud = 0;
+    uint32_t status = 0;
+    std::vector<uint32_t> pattern;
+};
+
+struct BudgetMsg {
+    uint32_t baud = 0;
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+    std::vector<BudgetEntry> metrics;
+};
+
+struct ReplyMsg {
+    uint32_t request = 0;
+    uint32_t cmd = 0;
+    uint32_t status = 0;
+};
+
+struct TaskInfoMsg {
+    uint32_t request = 0;
+    std::vector<TaskDetail> tasks;
+};
+
+struct HeapMsg {
+    uint32_t request = 0;
+    std::vector<HeapRegion> regions;
+};
+
+struct LogInfoMsg {
+    uint32_t request = 0;
+    uint32_t records = 0;
+    uint32_t bytes = 0;
+    uint32_t capacity = 0;
+    uint32_t sectors = 0;
+    uint32_t sector_size = 0;
+};
+
+using Message = std::variant<DeviceMsg, TasksMsg, MemoryMsg, IsrMsg, WakeupMsg, ReportMsg, LinkMsg, BudgetMsg, ReplyMsg, TaskInfoMsg, HeapMsg, LogInfoMsg>;
+
+// --------------------------------------------------------------------
+// Framing: COBS( version | type | payload | crc16 ) + 0x00, see MCUSilk/wire.h
+// --------------------------------------------------------------------
+struct Frame {
+    uint8_t type = 0;
+    std::vector<uint8_t> payload;
+};
+
+namespace detail {
+
+inline uint16_t crc16_update(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= static_cast<uint16_t>(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+inline uint16_t crc16(const uint8_t *data, size_t len)
+{
+    return crc16_update(0xFFFF, data, len);
+}
+
+inline std::optional<std::vector<uint8_t>> cobs_decode(const uint8_t *data, size_t len)
+{
+    std::vector<uint8_t> out;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t code = data[i];
+        if (code == 0 || i + code > len) {
+            return std::nullopt;
+        }
+        out.insert(out.end(), data + i + 1, data + i + code);
+        i += code;
+        if (code < 0xFF && i < len) {
+            out.push_back(0);
+        }
+    }
+    return out;
+}
+
+// Bounds-checked little-endian reader, ok() turns false on a short payload
+class Reader {
+public:
+    Reader(const uint8_t *data, size_t len) : data_(data), len_(len) {}
+
+    bool ok() const { return ok_; }
+
+    uint32_t u8() { return take(1) ? data_[pos_ - 1] : 0; }
+    int32_t i8() { return static_cast<int8_t>(u8()); }
+    uint32_t u16() { return take(2) ? data_[pos_ - 2] | (data_[pos_ - 1] << 8) : 0; }
+    uint32_t u32()
+    {
+        if (!take(4)) return 0;
+        const uint8_t *p = data_ + pos_ - 4;
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+    uint64_t u64()
+    {
+        uint64_t lo = u32();
+        return lo | (static_cast<uint64_t>(u32()) << 32);
+    }
+    std::string name()
+    {
+        if (!take(NAME_LEN)) return {};
+        const char *p = reinterpret_cast<const char *>(data_ + pos_ - NAME_LEN);
+        return std::string(p, strnlen(p, NAME_LEN));
+    }
+
+private:
+    bool take(size_t n)
+    {
+        if (!ok_ || len_ - pos_ < n) {
+            ok_ = false;
+            return false;
+        }
+        pos_ += n;
+        return true;
+    }
+
+    const uint8_t *data_;
+    size_t len_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+template <class Json, class T>
+void get(const Json &j, const char *key, T &out)
+{
+    if (j.contains(key)) {
+        out = j.at(key).template get<T>();
+    }
+}
+
+template <class Json>
+void get_array(const Json &j, const char *key, std::vector<uint32_t> &out)
+{
+    if (j.contains(key)) {
+        for (const auto &v : j.at(key)) {
+            out.push_back(v.template get<uint32_t>());
+        }
+    }
+}
+
+} // namespace detail
+
+// Frame without its 0x00 delimiter -> type and payload, nullopt on a bad COBS / CRC / version
+inline std::optional<Frame> unpack_frame(const uint8_t *data, size_t len)
+{
+    auto raw = detail::cobs_decode(data, len);
+    if (!raw || raw->size() < 4) {
+        return std::nullopt;
+    }
+
+    size_t body = raw->size() - 2;
+    uint16_t crc = static_cast<uint16_t>((*raw)[body] | ((*raw)[body + 1] << 8));
+    if (detail::crc16(raw->data(), body) != crc || (*raw)[0] != WIRE_VERSION) {
+        return std::nullopt;
+    }
+
+    Frame frame;
+    frame.type = (*raw)[1];
+    frame.payload.assign(raw->begin() + 2, raw->begin() + body);
+    return frame;
+}
+
+// LZ frame (MCUSilk/lz.h) -> the frame it replaces, other frames as they are.
+// nullopt on a corrupt stream.
+inline std::optional<Frame> expand_lz(const Frame &frame)
+{
+    if (frame.type != static_cast<uint8_t>(MsgType::Lz)) {
+        return frame;
+    }
+
+    const std::vector<uint8_t> &p = frame.payload;
+    if (p.size() < 3) {
+        return std::nullopt;
+    }
+    Frame out;
+    out.type = p[0];
+    size_t size = p[1] | (p[2] << 8);
+
+    size_t bit = 24;
+    size_t end = 8 * p.size();
+    auto take = [&](unsigned n) {
+        uint32_t v = 0;
+        for (unsigned i = 0; i < n; i++, bit++) {
+            v = (v << 1) | ((p[bit / 8] >> (7 - bit % 8)) & 1);
+        }
+        return v;
+    };
+
+    while (end - bit >= 9 && out.payload.size() < size) {
+        if (take(1)) {
+            out.payload.push_back(static_cast<uint8_t>(take(8)));
+        } else if (end - bit >= LZ_WINDOW_BITS + LZ_LOOKAHEAD_BITS) {
+            size_t distance = take(LZ_WINDOW_BITS) + 1;
+            size_t length = take(LZ_LOOKAHEAD_BITS) + 1;
+            if (distance > out.payload.size()) {
+                return std::nullopt;
+            }
+            for (size_t i = 0; i < length; i++) {
+                out.payload.push_back(out.payload[out.payload.size() - distance]);
+            }
+        } else {
+            break;
+        }
+    }
+    if (out.payload.size() != size) {
+        return std::nullopt;
+    }
+    return out;
+}
+
+namespace detail {
+
+inline Task read_task(Reader &r)
+{
+    Task e;
+    e.task_name = r.name();
+    e.run_time = r.u32();
+    e.isr_time = r.u32();
+    e.percentage = r.u8();
+    e.core = r.i8();
+    e.flags = r.u8();
+    return e;
+}
+
+inline IsrEntry read_isr_entry(Reader &r)
+{
+    IsrEntry e;
+    e.tag = r.u8();
+    e.core = r.i8();
+    e.name = r.name();
+    e.count = r.u32();
+    e.dropped = r.u32();
+    e.incl_min_ns = r.u32();
+    e.incl_avg_ns = r.u32();
+    e.incl_max_ns = r.u32();
+    e.excl_min_ns = r.u32();
+    e.excl_avg_ns = r.u32();
+    e.excl_max_ns = r.u32();
+    for (auto &v : e.hist) v = r.u32();
+    return e;
+}
+
+inline BudgetEntry read_budget_entry(Reader &r)
+{
+    BudgetEntry e;
+    e.type = r.u8();
+    e.bytes_per_s = r.u32();
+    e.msgs_per_min = r.u32();
+    return e;
+}
+
+inline TaskDetail read_task_detail(Reader &r)
+{
+    TaskDetail e;
+    e.task_name = r.name();
+    e.number = r.u32();
+    e.state = r.u8();
+    e.priority = r.u8();
+    e.base_priority = r.u8();
+    e.core = r.i8();
+    e.stack_free = r.u32();
+    e.run_time = r.u32();
+    return e;
+}
+
+inline HeapRegion read_heap_region(Reader &r)
+{
+    HeapRegion e;
+    e.caps = r.u32();
+    e.total = r.u32();
+    e.free = r.u32();
+    e.largest_free = r.u32();
+    e.min_free = r.u32();
+    e.allocated_blocks = r.u32();
+    e.free_blocks = r.u32();
+    return e;
+}
+
+inline WakeupEntry read_wakeup_entry(Reader &r)
+{
+    WakeupEntry e;
+    e.channel = r.u8();
+    e.count = r.u32();
+    e.coalesced = r.u32();
+    e.min_us = r.u32();
+    e.avg_us = r.u32();
+    e.max_us = r.u32();
+    for (auto &v : e.hist) v = r.u32();
+    return e;
+}
+
+} // namespace detail
+
+// Payload of a typed frame -> message, nullopt for JSON / CBOR frames or a short payload
+inline std::optional<Message> decode_payload(uint8_t type, const uint8_t *data, size_t len)
+{
+    detail::Reader r(data, len);
+
+    switch (static_cast<MsgType>(type)) {
+    case MsgType::Device: {
+        DeviceMsg m;
+        m.cores = r.u8();
+        m.cpu_hz = r.u32();
+        m.tag = r.name();
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::Tasks: {
+        TasksMsg m;
+        uint32_t core_count = r.u8();
+        uint32_t task_count = r.u8();
+        for (uint32_t i = 0; i < core_count && r.ok(); i++) m.cores.push_back(r.u8());
+        for (uint32_t i = 0; i < core_count && r.ok(); i++) m.isr_load.push_back(r.u8());
+        for (uint32_t i = 0; i < task_count && r.ok(); i++) m.tasks.push_back(detail::read_task(r));
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::Memory: {
+        MemoryMsg m;
+        m.heap_total = r.u32();
+        m.heap_free = r.u32();
+        m.internal_total = r.u32();
+        m.internal_free = r.u32();
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::Isr: {
+        IsrMsg m;
+        m.uptime_us = r.u64();
+        m.cpu_hz = r.u32();
+        m.hist_shift = r.u8();
+        m.freq_changes = r.u16();
+        m.bad_tag = r.u16();
+        uint32_t count = r.u8();
+        for (uint32_t i = 0; i < count && r.ok(); i++) m.isr.push_back(detail::read_isr_entry(r));
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::Wakeup: {
+        WakeupMsg m;
+        uint32_t count = r.u8();
+        for (uint32_t i = 0; i < count && r.ok(); i++) m.wakeup.push_back(detail::read_wakeup_entry(r));
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::Report: {
+        ReportMsg m;
+        m.seq = r.u32();
+        m.uptime_us = r.u64();
+        m.window_us = r.u32();
+        m.period_ms = r.u32();
+        m.coalesced = r.u8();
+        uint32_t core_count = r.u8();
+        uint32_t task_count = r.u8();
+        for (uint32_t i = 0; i < core_count && r.ok(); i++) m.cores.push_back(r.u8());
+        for (uint32_t i = 0; i < core_count && r.ok(); i++) m.isr_load.push_back(r.u8());
+        for (uint32_t i = 0; i < task_count && r.ok(); i++) m.tasks.push_back(detail::read_task(r));
+        m.heap_total = r.u32();
+        m.heap_free = r.u32();
+        m.internal_total = r.u32();
+        m.internal_free = r.u32();
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::Link: {
+        LinkMsg m;
+        m.baud = r.u32();
+        m.status = r.u8();
+        uint32_t pattern_len = r.u16();
+        for (uint32_t i = 0; i < pattern_len && r.ok(); i++) m.pattern.push_back(r.u8());
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::Budget: {
+        BudgetMsg m;
+        m.baud = r.u32();
+        m.capacity = r.u32();
+        m.used = r.u32();
+        uint32_t count = r.u8();
+        for (uint32_t i = 0; i < count && r.ok(); i++) m.metrics.push_back(detail::read_budget_entry(r));
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::Reply: {
+        ReplyMsg m;
+        m.request = r.u8();
+        m.cmd = r.u8();
+        m.status = r.u8();
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::TaskInfo: {
+        TaskInfoMsg m;
+        m.request = r.u8();
+        uint32_t count = r.u8();
+        for (uint32_t i = 0; i < count && r.ok(); i++) m.tasks.push_back(detail::read_task_detail(r));
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::Heap: {
+        HeapMsg m;
+        m.request = r.u8();
+        uint32_t count = r.u8();
+        for (uint32_t i = 0; i < count && r.ok(); i++) m.regions.push_back(detail::read_heap_region(r));
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    case MsgType::LogInfo: {
+        LogInfoMsg m;
+        m.request = r.u8();
+        m.records = r.u32();
+        m.bytes = r.u32();
+        m.capacity = r.u32();
+        m.sectors = r.u16();
+        m.sector_size = r.u32();
+        if (!r.ok()) return std::nullopt;
+        return m;
+    }
+    default:
+        return std::nullopt;
+    }
+}
+
+namespace detail {
+
+using Fields = std::vector<std::pair<size_t, size_t>>;
+
+// (offset, size) of every integer field of a payload, in wire order
+inline std::optional<Fields> integer_fields(uint8_t type, const uint8_t *data, size_t len)
+{
+    Fields f;
+    size_t pos = 0;
+    auto take = [&](size_t size, uint32_t n = 1) {
+        for (uint32_t i = 0; i < n; i++, pos += size) f.emplace_back(pos, size);
+    };
+    auto read_count = [&](size_t size) {
+        uint32_t v = 0;
+        for (size_t i = 0; i < size && pos + i < len; i++) v |= static_cast<uint32_t>(data[pos + i]) << (8 * i);
+        take(size);
+        return v;
+    };
+
+    switch (static_cast<MsgType>(type)) {
+    case MsgType::Device: {
+        take(1);
+        take(4);
+        pos += NAME_LEN;
+        break;
+    }
+    case MsgType::Tasks: {
+        uint32_t core_count = read_count(1);
+        uint32_t task_count = read_count(1);
+        take(1, core_count);
+        take(1, core_count);
+        for (uint32_t i = 0; i < task_count; i++) {
+            pos += NAME_LEN;
+            take(4);
+            take(4);
+            take(1);
+            take(1);
+            take(1);
+        }
+        break;
+    }
+    case MsgType::Memory: {
+        take(4);
+        take(4);
+        take(4);
+        take(4);
+        break;
+    }
+    case MsgType::Isr: {
+        take(4, 2);
+        take(4);
+        take(1);
+        take(2);
+        take(2);
+        uint32_t count = read_count(1);
+        for (uint32_t i = 0; i < count; i++) {
+            take(1);
+            take(1);
+            pos += NAME_LEN;
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4, 16);
+        }
+        break;
+    }
+    case MsgType::Wakeup: {
+        uint32_t count = read_count(1);
+        for (uint32_t i = 0; i < count; i++) {
+            take(1);
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4, 16);
+        }
+        break;
+    }
+    case MsgType::Report: {
+        take(4);
+        take(4, 2);
+        take(4);
+        take(4);
+        take(1);
+        uint32_t core_count = read_count(1);
+        uint32_t task_count = read_count(1);
+        take(1, core_count);
+        take(1, core_count);
+        for (uint32_t i = 0; i < task_count; i++) {
+            pos += NAME_LEN;
+            take(4);
+            take(4);
+            take(1);
+            take(1);
+            take(1);
+        }
+        take(4);
+        take(4);
+        take(4);
+        take(4);
+        break;
+    }
+    case MsgType::Link: {
+        take(4);
+        take(1);
+        uint32_t pattern_len = read_count(2);
+        take(1, pattern_len);
+        break;
+    }
+    case MsgType::Budget: {
+        take(4);
+        take(4);
+        take(4);
+        uint32_t count = read_count(1);
+        for (uint32_t i = 0; i < count; i++) {
+            take(1);
+            take(4);
+            take(4);
+        }
+        break;
+    }
+    case MsgType::Reply: {
+        take(1);
+        take(1);
+        take(1);
+        break;
+    }
+    case MsgType::TaskInfo: {
+        take(1);
+        uint32_t count = read_count(1);
+        for (uint32_t i = 0; i < count; i++) {
+            pos += NAME_LEN;
+            take(4);
+            take(1);
+            take(1);
+            take(1);
+            take(1);
+            take(4);
+            take(4);
+        }
+        break;
+    }
+    case MsgType::Heap: {
+        take(1);
+        uint32_t count = read_count(1);
+        for (uint32_t i = 0; i < count; i++) {
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+            take(4);
+        }
+        break;
+    }
+    case MsgType::LogInfo: {
+        take(1);
+        take(4);
+        take(4);
+        take(4);
+        take(2);
+        take(4);
+        break;
+    }
+    default:
+        return std::nullopt;
+    }
+    if (pos > len) return std::nullopt;
+    return f;
+}
+
+} // namespace detail
+
+// Rebuilds DELTA frames (MCUSilk/delta.h) from the last full payload of the
+// same type. A delta names the integers it applies to by their CRC, so after a
+// lost frame the following deltas are skipped (counted in lost()) until the
+// next full frame.
+class DeltaDecoder {
+public:
+    // Full frames are remembered and returned as they are, deltas are expanded
+    // into the full frame they stand for. nullopt for a delta that does not apply.
+    std::optional<Frame> apply(const Frame &frame)
+    {
+        if (frame.type != static_cast<uint8_t>(MsgType::Delta)) {
+            base_[frame.type] = frame.payload;
+            return frame;
+        }
+
+        const std::vector<uint8_t> &p = frame.payload;
+        if (p.size() < 3) return miss();
+        uint8_t type = p[0];
+        uint16_t ref = static_cast<uint16_t>(p[1] | (p[2] << 8));
+
+        auto base = base_.find(type);
+        if (base == base_.end()) return miss();
+        auto fields = detail::integer_fields(type, base->second.data(), base->second.size());
+        if (!fields) return miss();
+
+        std::vector<uint32_t> values;
+        uint16_t crc = 0xFFFF;
+        for (auto [offset, size] : *fields) {
+            uint32_t v = 0;
+            for (size_t i = 0; i < size; i++) v |= static_cast<uint32_t>(base->second[offset + i]) << (8 * i);
+            uint8_t le[4] = { uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24) };
+            crc = detail::crc16_update(crc, le, 4);
+            values.push_back(v);
+        }
+        if (crc != ref) return miss();
+
+        Frame out{type, base->second};
+        size_t pos = 3;
+        for (size_t n = 0; n < fields->size(); n++) {
+            uint32_t z = 0;
+            for (int shift = 0;; shift += 7) {
+                if (pos >= p.size() || shift > 28) return miss();
+                uint8_t b = p[pos++];
+                z |= static_cast<uint32_t>(b & 0x7F) << shift;
+                if (!(b & 0x80)) break;
+            }
+            uint32_t v = values[n] + ((z >> 1) ^ (0u - (z & 1)));
+            auto [offset, size] = (*fields)[n];
+            for (size_t i = 0; i < size; i++) out.payload[offset + i] = static_cast<uint8_t>(v >> (8 * i));
+        }
+        if (pos != p.size()) return miss();
+
+        base->second = out.payload;
+        return out;
+    }
+
+    uint32_t lost() const { return lost_; }
+
+private:
+    std::optional<Frame> miss()
+    {
+        lost_++;
+        return std::nullopt;
+    }
+
+    std::map<uint8_t, std::vector<uint8_t>> base_;
+    uint32_t lost_ = 0;
+};
+
+
+// Loss and latency of the period reports, from their seq and uptime_us. Host
+// and device clocks have an unknown offset, so latency is the delay of a report
+// over the fastest of the last LATENCY_WINDOW ones: the part added by queueing
+// and a busy link. period_ms is the reporting period the device is at, longer
+// than the configured one while it coalesces for a saturated link.
+class LinkStats {
+public:
+    static constexpr size_t LATENCY_WINDOW = 64;
+
+    // now_us: host clock (any epoch, monotonic) when the report arrived
+    void update(const ReportMsg &r, int64_t now_us)
+    {
+        if (received_ && (r.seq <= seq_ || r.uptime_us < uptime_)) {
+            restarts_++;        // the device restarted, seq starts over
+            offsets_.clear();
+        } else if (received_) {
+            lost_ += r.seq - seq_ - 1;
+        }
+        seq_ = r.seq;
+        uptime_ = r.uptime_us;
+        received_++;
+        period_ms_ = r.period_ms;
+        coalesced_ = r.coalesced;
+
+        offsets_.push_back(now_us - static_cast<int64_t>(r.uptime_us));
+        if (offsets_.size() > LATENCY_WINDOW) offsets_.pop_front();
+        latency_ms_ = (offsets_.back() - *std::min_element(offsets_.begin(), offsets_.end())) / 1000.0;
+        max_latency_ms_ = std::max(max_latency_ms_, latency_ms_);
+    }
+
+    uint32_t received() const { return received_; }
+    uint32_t lost() const { return lost_; }
+    uint32_t restarts() const { return restarts_; }
+    double loss() const { return received_ + lost_ ? double(lost_) / (received_ + lost_) : 0.0; }
+    double latency_ms() const { return latency_ms_; }
+    double max_latency_ms() const { return max_latency_ms_; }
+    uint32_t period_ms() const { return period_ms_; }
+    uint32_t coalesced() const { return coalesced_; }
+
+private:
+    uint32_t received_ = 0;
+    uint32_t lost_ = 0;
+    uint32_t restarts_ = 0;
+    uint32_t seq_ = 0;
+    uint64_t uptime_ = 0;
+    std::deque<int64_t> offsets_;
+    double latency_ms_ = 0;
+    double max_latency_ms_ = 0;
+    uint32_t period_ms_ = 0;
+    uint32_t coalesced_ = 1;
+};
+
+namespace detail {
+
+template <class Json>
+Task json_task(const Json &j)
+{
+    Task e;
+    get(j, "task_name", e.task_name);
+    get(j, "run_time", e.run_time);
+    get(j, "isr_time", e.isr_time);
+    get(j, "percentage", e.percentage);
+    get(j, "core", e.core);
+    if ((j.contains("status") && j.at("status").template get<std::string>() == "created")) e.flags |= WIRE_TASK_CREATED;
+    if ((j.contains("status") && j.at("status").template get<std::string>() == "deleted")) e.flags |= WIRE_TASK_DELETED;
+    if ((j.contains("isr") && j.at("isr").template get<bool>())) e.flags |= WIRE_TASK_ISR;
+    return e;
+}
+
+template <class Json>
+IsrEntry json_isr_entry(const Json &j)
+{
+    IsrEntry e;
+    get(j, "tag", e.tag);
+    get(j, "core", e.core);
+    get(j, "name", e.name);
+    get(j, "count", e.count);
+    get(j, "dropped", e.dropped);
+    get(j, "incl_min_ns", e.incl_min_ns);
+    get(j, "incl_avg_ns", e.incl_avg_ns);
+    get(j, "incl_max_ns", e.incl_max_ns);
+    get(j, "excl_min_ns", e.excl_min_ns);
+    get(j, "excl_avg_ns", e.excl_avg_ns);
+    get(j, "excl_max_ns", e.excl_max_ns);
+    if (j.contains("hist")) {
+        size_t i = 0;
+        for (const auto &v : j.at("hist")) {
+            if (i < e.hist.size()) e.hist[i++] = v.template get<uint32_t>();
+        }
+    }
+    return e;
+}
+
+template <class Json>
+BudgetEntry json_budget_entry(const Json &j)
+{
+    BudgetEntry e;
+    get(j, "type", e.type);
+    get(j, "bytes_per_s", e.bytes_per_s);
+    get(j, "msgs_per_min", e.msgs_per_min);
+    return e;
+}
+
+template <class Json>
+TaskDetail json_task_detail(const Json &j)
+{
+    TaskDetail e;
+    get(j, "task_name", e.task_name);
+    get(j, "number", e.number);
+    get(j, "state", e.state);
+    get(j, "priority", e.priority);
+    get(j, "base_priority", e.base_priority);
+    get(j, "core", e.core);
+    get(j, "stack_free", e.stack_free);
+    get(j, "run_time", e.run_time);
+    return e;
+}
+
+template <class Json>
+HeapRegion json_heap_region(const Json &j)
+{
+    HeapRegion e;
+    get(j, "caps", e.caps);
+    get(j, "total", e.total);
+    get(j, "free", e.free);
+    get(j, "largest_free", e.largest_free);
+    get(j, "min_free", e.min_free);
+    get(j, "allocated_blocks", e.allocated_blocks);
+    get(j, "free_blocks", e.free_blocks);
+    return e;
+}
+
+template <class Json>
+WakeupEntry json_wakeup_entry(const Json &j)
+{
+    WakeupEntry e;
+    get(j, "channel", e.channel);
+    get(j, "count", e.count);
+    get(j, "coalesced", e.coalesced);
+    get(j, "min_us", e.min_us);
+    get(j, "avg_us", e.avg_us);
+    get(j, "max_us", e.max_us);
+    if (j.contains("hist")) {
+        size_t i = 0;
+        for (const auto &v : j.at("hist")) {
+            if (i < e.hist.size()) e.hist[i++] = v.template get<uint32_t>();
+        }
+    }
+    return e;
+}
+
+} // namespace detail
+
+// JSON message (or the "json" / decoded CBOR payload) -> message, nullopt for JSON-only ones
+template <class Json>
+std::optional<Message> from_json(const Json &j)
+{
+    if (j.contains("device")) {
+        DeviceMsg m;
+        const auto &o = j.at("device");
+        detail::get(o, "cores", m.cores);
+        detail::get(o, "cpu_hz", m.cpu_hz);
+        detail::get(o, "tag", m.tag);
+        return m;
+    }
+    if (j.contains("tasks")) {
+        TasksMsg m;
+        detail::get_array(j, "cores", m.cores);
+        detail::get_array(j, "isr_load", m.isr_load);
+        for (const auto &e : j.at("tasks")) m.tasks.push_back(detail::json_task(e));
+        return m;
+    }
+    if (j.contains("heap_total")) {
+        MemoryMsg m;
+        detail::get(j, "heap_total", m.heap_total);
+        detail::get(j, "heap_free", m.heap_free);
+        detail::get(j, "internal_total", m.internal_total);
+        detail::get(j, "internal_free", m.internal_free);
+        return m;
+    }
+    if (j.contains("isr")) {
+        IsrMsg m;
+        detail::get(j, "uptime_us", m.uptime_us);
+        detail::get(j, "cpu_hz", m.cpu_hz);
+        detail::get(j, "hist_shift", m.hist_shift);
+        detail::get(j, "freq_changes", m.freq_changes);
+        detail::get(j, "bad_tag", m.bad_tag);
+        for (const auto &e : j.at("isr")) m.isr.push_back(detail::json_isr_entry(e));
+        return m;
+    }
+    if (j.contains("wakeup")) {
+        WakeupMsg m;
+        for (const auto &e : j.at("wakeup")) m.wakeup.push_back(detail::json_wakeup_entry(e));
+        return m;
+    }
+    if (j.contains("report")) {
+        ReportMsg m;
+        const auto &o = j.at("report");
+        detail::get(o, "seq", m.seq);
+        detail::get(o, "uptime_us", m.uptime_us);
+        detail::get(o, "window_us", m.window_us);
+        detail::get(o, "period_ms", m.period_ms);
+        detail::get(o, "coalesced", m.coalesced);
+        detail::get_array(o, "cores", m.cores);
+        detail::get_array(o, "isr_load", m.isr_load);
+        for (const auto &e : o.at("tasks")) m.tasks.push_back(detail::json_task(e));
+        detail::get(o, "heap_total", m.heap_total);
+        detail::get(o, "heap_free", m.heap_free);
+        detail::get(o, "internal_total", m.internal_total);
+        detail::get(o, "internal_free", m.internal_free);
+        return m;
+    }
+    if (j.contains("link")) {
+        LinkMsg m;
+        const auto &o = j.at("link");
+        detail::get(o, "baud", m.baud);
+        detail::get(o, "status", m.status);
+        detail::get_array(o, "pattern", m.pattern);
+        return m;
+    }
+    if (j.contains("budget")) {
+        BudgetMsg m;
+        const auto &o = j.at("budget");
+        detail::get(o, "baud", m.baud);
+        detail::get(o, "capacity", m.capacity);
+        detail::get(o, "used", m.used);
+        for (const auto &e : o.at("metrics")) m.metrics.push_back(detail::json_budget_entry(e));
+        return m;
+    }
+    if (j.contains("reply")) {
+        ReplyMsg m;
+        const auto &o = j.at("reply");
+        detail::get(o, "request", m.request);
+        detail::get(o, "cmd", m.cmd);
+        detail::get(o, "status", m.status);
+        return m;
+    }
+    if (j.contains("task_info")) {
+        TaskInfoMsg m;
+        const auto &o = j.at("task_info");
+        detail::get(o, "request", m.request);
+        for (const auto &e : o.at("tasks")) m.tasks.push_back(detail::json_task_detail(e));
+        return m;
+    }
+    if (j.contains("heap")) {
+        HeapMsg m;
+        const auto &o = j.at("heap");
+        detail::get(o, "request", m.request);
+        for (const auto &e : o.at("regions")) m.regions.push_back(detail::json_heap_region(e));
+        return m;
+    }
+    if (j.contains("log_info")) {
+        LogInfoMsg m;
+        const auto &o = j.at("log_info");
+        detail::get(o, "request", m.request);
+        detail::get(o, "records", m.records);
+        detail::get(o, "bytes", m.bytes);
+        detail::get(o, "capacity", m.capacity);
+        detail::get(o, "sectors", m.sectors);
+        detail::get(o, "sector_size", m.sector_size);
+        return m;
+    }
+    return std::nullopt;
+}
+
+} // namespace telemetry
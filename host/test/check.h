@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdio.h>
+
+
+// Failed checks are printed and counted, the test carries on
+static int check_failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            check_failures++; \
+        } \
+    } while (0)
+
+static int check_result(void)
+{
+    printf("%s\n", check_failures ? "FAIL" : "PASS");
+    return check_failures ? 1 : 0;
+}
@@ -0,0 +1,305 @@
+// Flash log on the RAM backend: appends across the sector wrap, a reopen
+// after a reset, records torn by a power loss and the record size limit.
+//
+//   ./flashlog_test
+
+#include <string.h>
+#include <stdlib.h>
+#include "flashlog.h"
+#include "check.h"
+
+
+#define TEST_SECTOR     512
+#define TEST_SECTORS    4
+
+static uint8_t mem[TEST_SECTORS * TEST_SECTOR];
+static flashlog_backend_t ram;
+static uint32_t erases[TEST_SECTORS];
+static int tear_write = -1;         // writes until the one the power goes in, -1 = never
+static size_t tear_bytes;           // what that write gets done
+
+// RAM backend that counts erases per sector and can cut a write short
+static bool test_read(void *ctx, uint32_t offset, void *data, size_t len)
+{
+    return ram.read(ram.ctx, offset, data, len);
+}
+
+static bool test_write(void *ctx, uint32_t offset, const void *data, size_t len)
+{
+    if (tear_write < 0 || tear_write-- > 0) {
+        return ram.write(ram.ctx, offset, data, len);
+    }
+
+    ram.write(ram.ctx, offset, data, tear_bytes < len ? tear_bytes : len);
+    return false;
+}
+
+static bool test_erase(void *ctx, uint32_t offset, size_t len)
+{
+    for (uint32_t s = offset / TEST_SECTOR; s < (offset + len) / TEST_SECTOR; s++) {
+        erases[s]++;
+    }
+    return ram.erase(ram.ctx, offset, len);
+}
+
+static const flashlog_backend_t backend = {
+    .read = test_read,
+    .write = test_write,
+    .erase = test_erase,
+    .size = sizeof(mem),
+    .sector_size = TEST_SECTOR,
+};
+
+// Erased flash, as after flashing a new partition table
+static void test_format(void)
+{
+    memset(mem, 0xFF, sizeof(mem));
+    memset(erases, 0, sizeof(erases));
+    flashlog_ram_backend(&ram, mem, sizeof(mem), TEST_SECTOR);
+}
+
+// Record n: its number, then filler up to a length that changes with n
+static size_t test_record(uint32_t n, uint8_t *buf)
+{
+    size_t len = 8 + n % 97;
+
+    memset(buf, 'a' + n % 26, len);
+    memcpy(buf, &n, sizeof(n));
+    return len;
+}
+
+// Read pass: the records must be first..last in order, each as appended.
+// Returns how many there were.
+static uint32_t test_check_records(const flashlog_t *log, uint32_t *first, uint32_t *last)
+{
+    flashlog_cursor_t c;
+    uint8_t buf[TEST_SECTOR], want[TEST_SECTOR];
+    uint32_t count = 0;
+    size_t len;
+
+    flashlog_rewind(log, &c);
+    while ((len = flashlog_next(log, &c, buf, sizeof(buf))) > 0)
+    {
+        uint32_t n;
+        memcpy(&n, buf, sizeof(n));
+        if (count == 0) {
+            *first = n;
+        } else {
+            CHECK(n == *last + 1);
+        }
+        CHECK(len == test_record(n, want) && memcmp(buf, want, len) == 0);
+        *last = n;
+        count++;
+    }
+    return count;
+}
+
+// --------------------------------------------------------------------
+// Tests
+// --------------------------------------------------------------------
+
+// Several laps of the ring: the newest records are all there, at least
+// the capacity of them, and every sector is erased as often as the others
+static void test_wrap(void)
+{
+    flashlog_t log;
+    uint8_t rec[TEST_SECTOR];
+    uint32_t appended = 0, first = 0, last = 0;
+    size_t bytes = 0;
+
+    test_format();
+    CHECK(flashlog_open(&log, &backend));
+    CHECK(log.head == 0 && log.head_seq == 1);
+
+    while (log.head_seq < 5 * TEST_SECTORS)
+    {
+        CHECK(flashlog_append(&log, rec, test_record(appended, rec)));
+        appended++;
+    }
+    CHECK(log.appended == appended && log.failed == 0);
+
+    uint32_t count = test_check_records(&log, &first, &last);
+    CHECK(last == appended - 1);
+    CHECK(count == last - first + 1);
+    for (uint32_t n = first; n <= last; n++) {
+        bytes += 2 + test_record(n, rec);
+    }
+    CHECK(bytes + TEST_SECTOR > flashlog_capacity(&log));
+
+    for (uint32_t s = 1; s < TEST_SECTORS; s++) {
+        CHECK(erases[s] + 1 >= erases[0] && erases[s] <= erases[0] + 1);
+    }
+}
+
+// A reset finds the head and its end again, the records are the same and
+// new ones go after them
+static void test_reopen(void)
+{
+    flashlog_t log, again;
+    uint8_t rec[TEST_SECTOR];
+    uint32_t n, first = 0, last = 0, first2 = 0, last2 = 0;
+
+    test_format();
+    flashlog_open(&log, &backend);
+    for (n = 0; n < 50; n++) {
+        flashlog_append(&log, rec, test_record(n, rec));
+    }
+
+    CHECK(flashlog_open(&again, &backend));
+    CHECK(again.head == log.head);
+    CHECK(again.head_seq == log.head_seq);
+    CHECK(again.offset == log.offset);
+
+    uint32_t count = test_check_records(&log, &first, &last);
+    CHECK(test_check_records(&again, &first2, &last2) == count);
+    CHECK(first2 == first && last2 == last && last == n - 1);
+
+    for (; n < 60; n++) {
+        CHECK(flashlog_append(&again, rec, test_record(n, rec)));
+    }
+    test_check_records(&again, &first2, &last2);
+    CHECK(last2 == n - 1);
+
+    // Open on erased flash formats the first sector, nothing to read
+    test_format();
+    CHECK(flashlog_open(&log, &backend));
+    CHECK(test_check_records(&log, &first, &last) == 0);
+}
+
+// Power lost in the middle of a record: its length made it, so after the
+// reset the next record lands behind it. The reader hands out the torn
+// data, the CRC of the frame inside is what drops it.
+static void test_torn_data(void)
+{
+    flashlog_t log;
+    uint8_t rec[TEST_SECTOR], buf[TEST_SECTOR];
+    uint32_t n;
+
+    test_format();
+    flashlog_open(&log, &backend);
+    for (n = 0; n < 5; n++) {
+        flashlog_append(&log, rec, test_record(n, rec));
+    }
+
+    // The length is one write, the data the next
+    size_t torn = test_record(n, rec);
+    tear_write = 1;
+    tear_bytes = torn / 2;
+    CHECK(!flashlog_append(&log, rec, torn));
+    CHECK(log.failed == 1);
+
+    CHECK(flashlog_open(&log, &backend));
+    for (uint32_t i = n + 1; i <= n + 3; i++) {
+        CHECK(flashlog_append(&log, rec, test_record(i, rec)));
+    }
+
+    flashlog_cursor_t c;
+    size_t len;
+    uint32_t count = 0;
+    flashlog_rewind(&log, &c);
+    while ((len = flashlog_next(&log, &c, buf, sizeof(buf))) > 0)
+    {
+        uint8_t want[TEST_SECTOR];
+        if (count == n)
+        {
+            // Its first half, then erased flash
+            test_record(n, want);
+            CHECK(len == torn);
+            CHECK(memcmp(buf, want, torn / 2) == 0);
+            CHECK(buf[torn - 1] == 0xFF);
+        }
+        else
+        {
+            CHECK(len == test_record(count, want) && memcmp(buf, want, len) == 0);
+        }
+        count++;
+    }
+    CHECK(count == n + 4);
+}
+
+// A length torn to a value past the end of the sector: open counts the
+// sector as full, the reader stops there, new records go to the next sector
+static void test_torn_length(void)
+{
+    flashlog_t log;
+    uint8_t rec[TEST_SECTOR];
+    uint32_t n, first = 0, last = 0;
+
+    test_format();
+    flashlog_open(&log, &backend);
+    for (n = 0; n < 3; n++) {
+        flashlog_append(&log, rec, test_record(n, rec));
+    }
+
+    uint8_t l[2] = { 0x00, 0x04 };      // 1024, two sectors' worth
+    ram.write(ram.ctx, log.head * TEST_SECTOR + log.offset, l, sizeof(l));
+
+    uint32_t head = log.head;
+    CHECK(flashlog_open(&log, &backend));
+    CHECK(log.head == head && log.offset == TEST_SECTOR);
+
+    CHECK(test_check_records(&log, &first, &last) == n);
+    CHECK(first == 0 && last == n - 1);
+
+    for (; n < 6; n++) {
+        CHECK(flashlog_append(&log, rec, test_record(n, rec)));
+    }
+    CHECK(log.head == (head + 1) % TEST_SECTORS);
+
+    // The reader leaves the rest of the torn sector and goes on in the next
+    uint32_t count = test_check_records(&log, &first, &last);
+    CHECK(count == n);
+    CHECK(first == 0 && last == n - 1);
+}
+
+// The largest record fills a fresh sector exactly, anything longer (or
+// empty) is refused without counting as a failed write
+static void test_record_max(void)
+{
+    flashlog_t log;
+    static uint8_t big[TEST_SECTOR + 100];
+    uint8_t buf[TEST_SECTOR];
+
+    test_format();
+    flashlog_open(&log, &backend);
+
+    size_t max = flashlog_record_max(&log);
+    CHECK(max == TEST_SECTOR - FLASHLOG_HEADER - 2);
+
+    memset(big, 0x5A, sizeof(big));
+    CHECK(!flashlog_append(&log, big, max + 1));
+    CHECK(!flashlog_append(&log, big, 600));
+    CHECK(!flashlog_append(&log, big, 0));
+    CHECK(log.appended == 0 && log.failed == 0);
+    CHECK(log.offset == FLASHLOG_HEADER);
+
+    CHECK(flashlog_append(&log, big, max));
+    CHECK(log.head == 0 && log.offset == TEST_SECTOR);
+    CHECK(flashlog_append(&log, big, max));
+    CHECK(log.head == 1 && log.offset == TEST_SECTOR);
+
+    flashlog_cursor_t c;
+    size_t len;
+    uint32_t count = 0;
+    flashlog_rewind(&log, &c);
+    while ((len = flashlog_next(&log, &c, buf, sizeof(buf))) > 0)
+    {
+        CHECK(len == max && memcmp(buf, big, max) == 0);
+        count++;
+    }
+    CHECK(count == 2);
+
+    // A reader with less room skips them rather than cutting them short
+    flashlog_rewind(&log, &c);
+    CHECK(flashlog_next(&log, &c, buf, max - 1) == 0);
+}
+
+int main(void)
+{
+    test_wrap();
+    test_reopen();
+    test_torn_data();
+    test_torn_length();
+    test_record_max();
+    return check_result();
+}
@@ -0,0 +1,297 @@
+// Loopback of the query path: CMD frames as the GUI sends them go into
+// link_receive(), what link.c and query.c answer comes back through the
+// UART stand-in and is unframed and checked, message by message.
+//
+//   ./query_loopback
+
+#include <string.h>
+#include "shim.h"
+#include "CPU_usage.h"
+#include "link.h"
+#include "wire.h"
+#include "flashlog.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+#include "check.h"
+
+
+#define LOOP_LOG_RECORDS    40
+#define LOOP_MAX_FRAMES     (LOOP_LOG_RECORDS + 8)
+
+typedef struct {
+    uint8_t type;
+    const uint8_t *payload;
+    size_t len;
+} loop_frame_t;
+
+static uint8_t tx[64 * 1024];
+static size_t tx_len;
+static loop_frame_t frames[LOOP_MAX_FRAMES];
+static size_t frame_num;
+static size_t bad_frames;
+
+static flashlog_t flash;
+static uint8_t flash_mem[16 * 1024];
+static char records[LOOP_LOG_RECORDS][64];
+static size_t record_len[LOOP_LOG_RECORDS];
+
+
+static void loop_tx(const void *data, size_t len)
+{
+    if (tx_len + len > sizeof(tx))
+    {
+        printf("serial output overflows the capture\n");
+        exit(1);
+    }
+    memcpy(&tx[tx_len], data, len);
+    tx_len += len;
+}
+
+// Everything the device wrote for the last command, split at the delimiters
+static void loop_frames(void)
+{
+    size_t start = 0;
+
+    frame_num = 0;
+    bad_frames = 0;
+    for (size_t i = 0; i < tx_len; i++)
+    {
+        // Answers start with a delimiter of their own, to end a partial line
+        if (tx[i] != 0 || i == start)
+        {
+            start += tx[i] == 0;
+            continue;
+        }
+
+        size_t len = wire_unframe(&tx[start], i - start);
+        if (len == 0) {
+            bad_frames++;
+        } else if (frame_num < LOOP_MAX_FRAMES) {
+            frames[frame_num++] = (loop_frame_t) { tx[start + 1], &tx[start + 2], len - 2 };
+        }
+        start = i + 1;
+    }
+    CHECK(start == tx_len);     // nothing after the last delimiter
+}
+
+// One CMD frame as the host sends it, fed in pieces of at most chunk bytes
+static void loop_send(uint8_t cmd, uint8_t request, const void *args, size_t len, size_t chunk)
+{
+    uint8_t raw[LINK_FRAME_MAX];
+    char frame[LINK_FRAME_MAX + 8];
+
+    raw[0] = WIRE_VERSION;
+    raw[1] = WIRE_MSG_CMD;
+    raw[2] = cmd;
+    raw[3] = request;
+    if (len) {
+        memcpy(&raw[4], args, len);
+    }
+
+    size_t n = wire_frame(raw, 4 + len, frame, sizeof(frame));
+    frame[n++] = '\0';
+
+    tx_len = 0;
+    for (size_t i = 0; i < n; i += chunk) {
+        link_receive((const uint8_t *)&frame[i], n - i < chunk ? n - i : chunk);
+    }
+    loop_frames();
+}
+
+static void loop_query(uint8_t cmd, uint8_t request, const void *args, size_t len)
+{
+    loop_send(cmd, request, args, len, 64);
+}
+
+// The last frame of every answer
+static void check_reply(uint8_t request, uint8_t cmd, uint8_t status)
+{
+    CHECK(bad_frames == 0);
+    CHECK(frame_num > 0);
+    if (frame_num == 0) {
+        return;
+    }
+
+    const loop_frame_t *f = &frames[frame_num - 1];
+    CHECK(f->type == WIRE_MSG_REPLY);
+    CHECK(f->len == TLM_WIRE_REPLY_SIZE);
+    CHECK(f->payload[0] == request);
+    CHECK(f->payload[1] == cmd);
+    CHECK(f->payload[2] == status);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// --------------------------------------------------------------------
+// One test per query
+// --------------------------------------------------------------------
+static void test_stacks(void)
+{
+    loop_query(WIRE_CMD_STACKS, 1, NULL, 0);
+    check_reply(1, WIRE_CMD_STACKS, QUERY_OK);
+
+    uint32_t tasks = uxTaskGetNumberOfTasks();
+    CHECK(frame_num == 2);
+    CHECK(frames[0].type == WIRE_MSG_TASK_INFO);
+    CHECK(frames[0].payload[0] == 1);
+    CHECK(frames[0].payload[1] == tasks);
+    CHECK(frames[0].len == TLM_WIRE_TASK_INFO_SIZE + tasks * TLM_WIRE_TASK_DETAIL_SIZE);
+}
+
+static void test_task(void)
+{
+    loop_query(WIRE_CMD_TASK, 2, "stats", 5);
+    check_reply(2, WIRE_CMD_TASK, QUERY_OK);
+    CHECK(frame_num == 2);
+    CHECK(frames[0].type == WIRE_MSG_TASK_INFO);
+    CHECK(frames[0].payload[0] == 2);
+    CHECK(frames[0].payload[1] == 1);
+    CHECK(strncmp((const char *)&frames[0].payload[2], "stats", 16) == 0);
+
+    // The host pads the name with NULs
+    char padded[16] = "stats";
+    loop_query(WIRE_CMD_TASK, 3, padded, sizeof(padded));
+    check_reply(3, WIRE_CMD_TASK, QUERY_OK);
+
+    loop_query(WIRE_CMD_TASK, 4, "no such task", 12);
+    check_reply(4, WIRE_CMD_TASK, QUERY_NOT_FOUND);
+    CHECK(frame_num == 1);
+
+    loop_query(WIRE_CMD_TASK, 5, NULL, 0);
+    check_reply(5, WIRE_CMD_TASK, QUERY_BAD_ARGS);
+}
+
+static void test_heap(void)
+{
+    loop_query(WIRE_CMD_HEAP, 6, NULL, 0);
+    check_reply(6, WIRE_CMD_HEAP, QUERY_OK);
+
+    // The stand-in has one internal heap and nothing else
+    CHECK(frame_num == 2);
+    CHECK(frames[0].type == WIRE_MSG_HEAP);
+    CHECK(frames[0].payload[0] == 6);
+    CHECK(frames[0].payload[1] == 1);
+    CHECK(frames[0].len == TLM_WIRE_HEAP_SIZE + TLM_WIRE_HEAP_REGION_SIZE);
+    CHECK(get_u32(&frames[0].payload[2]) == (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    CHECK(get_u32(&frames[0].payload[6]) == heap_caps_get_total_size(MALLOC_CAP_INTERNAL));
+}
+
+static void test_snapshot(void)
+{
+    uint8_t window[2] = { 200, 0 };
+    TickType_t start = shim_ticks;
+
+    loop_query(WIRE_CMD_SNAPSHOT, 7, window, sizeof(window));
+    check_reply(7, WIRE_CMD_SNAPSHOT, QUERY_OK);
+    CHECK(shim_ticks - start == pdMS_TO_TICKS(200));
+    CHECK(frame_num == 3);
+    CHECK(frames[0].type == WIRE_MSG_TASKS);
+    CHECK(frames[1].type == WIRE_MSG_MEMORY);
+
+    uint8_t zero[2] = { 0, 0 };
+    loop_query(WIRE_CMD_SNAPSHOT, 8, zero, sizeof(zero));
+    check_reply(8, WIRE_CMD_SNAPSHOT, QUERY_BAD_ARGS);
+    CHECK(frame_num == 1);
+}
+
+// log_info, then every record as it was stored, oldest first
+static void test_dump(void)
+{
+    loop_query(WIRE_CMD_DUMP, 9, NULL, 0);
+    check_reply(9, WIRE_CMD_DUMP, QUERY_OK);
+    CHECK(frame_num == LOOP_LOG_RECORDS + 2);
+    CHECK(frames[0].type == WIRE_MSG_LOG_INFO);
+    CHECK(frames[0].len == TLM_WIRE_LOG_INFO_SIZE);
+    CHECK(frames[0].payload[0] == 9);
+    CHECK(get_u32(&frames[0].payload[1]) == LOOP_LOG_RECORDS);
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < LOOP_LOG_RECORDS; i++) {
+        bytes += record_len[i];
+    }
+    CHECK(get_u32(&frames[0].payload[5]) == bytes);
+
+    for (size_t i = 0; i < LOOP_LOG_RECORDS && i + 1 < frame_num; i++)
+    {
+        const loop_frame_t *f = &frames[i + 1];
+        char text[64];
+        snprintf(text, sizeof(text), "{ \"record\": %zu }", i);
+        CHECK(f->type == WIRE_MSG_JSON);
+        CHECK(f->len == strlen(text) && memcmp(f->payload, text, f->len) == 0);
+    }
+}
+
+static void test_unknown(void)
+{
+    loop_query(0x42, 10, NULL, 0);
+    check_reply(10, 0x42, QUERY_UNKNOWN);
+    CHECK(frame_num == 1);
+}
+
+// Line noise, a frame with a bad CRC and one too long for any command cost
+// nothing, the next command still gets its answer. So does one that comes
+// a byte at a time.
+static void test_noise(void)
+{
+    uint8_t noise[LINK_FRAME_MAX + 40];
+
+    memset(noise, 0x55, sizeof(noise));
+    noise[10] = 0;
+    noise[sizeof(noise) - 1] = 0;
+
+    tx_len = 0;
+    link_receive(noise, sizeof(noise));
+
+    // A CMD frame with one bit flipped
+    uint8_t raw[4] = { WIRE_VERSION, WIRE_MSG_CMD, WIRE_CMD_HEAP, 11 };
+    char frame[16];
+    size_t n = wire_frame(raw, sizeof(raw), frame, sizeof(frame));
+    frame[1] ^= 0x01;
+    frame[n++] = '\0';
+    link_receive((const uint8_t *)frame, n);
+
+    CHECK(tx_len == 0);
+
+    loop_send(WIRE_CMD_HEAP, 12, NULL, 0, 1);
+    check_reply(12, WIRE_CMD_HEAP, QUERY_OK);
+    CHECK(frame_num == 2);
+}
+
+int main(void)
+{
+    flashlog_backend_t backend;
+    flashlog_ram_backend(&backend, flash_mem, sizeof(flash_mem), 4096);
+    flashlog_open(&flash, &backend);
+
+    // Records are frames with their delimiter, as the flash log sink writes them
+    for (size_t i = 0; i < LOOP_LOG_RECORDS; i++)
+    {
+        char text[64];
+        snprintf(text, sizeof(text), "{ \"record\": %zu }", i);
+        size_t n = wire_payload_frame(WIRE_MSG_JSON, text, strlen(text), records[i], sizeof(records[i]) - 1);
+        records[i][n++] = '\0';
+        record_len[i] = n;
+        flashlog_append(&flash, records[i], n);
+    }
+
+    // JSON on the console UART, queries are answered in frames all the same
+    cpu_usage_cfg_t cfg = {
+        .tag = "loopback",
+        .flash_log = &flash,
+    };
+    shim_uart_tx = loop_tx;
+    CPU_usage_start(&cfg);
+
+    test_stacks();
+    test_task();
+    test_heap();
+    test_snapshot();
+    test_dump();
+    test_unknown();
+    test_noise();
+
+    return check_result();
+}
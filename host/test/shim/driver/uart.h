@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int uart_port_t;
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_size, int tx_size, int queue_size,
+                              QueueHandle_t *queue, int flags);
+bool uart_is_driver_installed(uart_port_t port);
+int uart_write_bytes(uart_port_t port, const void *data, size_t len);
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t len, TickType_t ticks);
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks);
+esp_err_t uart_set_baudrate(uart_port_t port, uint32_t baud);
+esp_err_t uart_get_baudrate(uart_port_t port, uint32_t *baud);
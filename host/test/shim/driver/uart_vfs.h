@@ -0,0 +1,6 @@
+#pragma once
+
+typedef enum { ESP_LINE_ENDINGS_CRLF, ESP_LINE_ENDINGS_CR, ESP_LINE_ENDINGS_LF } esp_line_endings_t;
+
+void uart_vfs_dev_use_driver(int port);
+int uart_vfs_dev_port_set_tx_line_endings(int port, esp_line_endings_t mode);
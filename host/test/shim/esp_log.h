@@ -0,0 +1,5 @@
+#pragma once
+
+#define ESP_LOGI(tag, ...)      (void)(tag)
+#define ESP_LOGW(tag, ...)      (void)(tag)
+#define ESP_LOGE(tag, ...)      (void)(tag)
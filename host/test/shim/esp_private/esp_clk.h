@@ -0,0 +1,3 @@
+#pragma once
+
+int esp_clk_cpu_freq(void);
@@ -0,0 +1,60 @@
+#pragma once
+
+// Host stand-ins for the ESP-IDF and FreeRTOS headers MCUSilk includes,
+// only what it uses. Implemented by shim.c: one thread, no preemption,
+// time only moves when a task delays or waits.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t configRUN_TIME_COUNTER_TYPE;
+
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+
+#define configTICK_RATE_HZ              100
+#define portTICK_PERIOD_MS              (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)               ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+#define configNUMBER_OF_CORES           2
+#define configMAX_TASK_NAME_LEN         16
+
+#define pdTRUE                          1
+#define pdFALSE                         0
+#define pdPASS                          pdTRUE
+#define pdFAIL                          pdFALSE
+#define portMAX_DELAY                   ((TickType_t)0xffffffffu)
+#define tskNO_AFFINITY                  0x7fffffff
+
+// Nothing runs concurrently, a critical section only has to compile
+typedef struct { int owner; int count; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    { 0, 0 }
+#define portMUX_INITIALIZE(m)           (void)(m)
+#define portENTER_CRITICAL(m)           (void)(m)
+#define portEXIT_CRITICAL(m)            (void)(m)
+#define portENTER_CRITICAL_ISR(m)       (void)(m)
+#define portEXIT_CRITICAL_ISR(m)        (void)(m)
+#define portYIELD_FROM_ISR(x)           (void)(x)
+#define xPortGetCoreID()                0
+#define configASSERT(x)
+
+typedef enum { eRunning, eReady, eBlocked, eSuspended, eDeleted, eInvalid } eTaskState;
+
+typedef struct {
+    TaskHandle_t xHandle;
+    const char *pcTaskName;
+    UBaseType_t xTaskNumber;
+    eTaskState eCurrentState;
+    UBaseType_t uxCurrentPriority;
+    UBaseType_t uxBasePriority;
+    configRUN_TIME_COUNTER_TYPE ulRunTimeCounter;
+    void *pxStackBase;
+    uint32_t usStackHighWaterMark;
+    BaseType_t xCoreID;
+} TaskStatus_t;
@@ -0,0 +1,431 @@
+#include <string.h>
+#include "shim.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/uart.h"
+#include "driver/uart_vfs.h"
+#include "esp_chip_info.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_private/esp_clk.h"
+#include "CPU_usage.h"
+#include "isr_trace.h"
+#include "postmortem.h"
+#include "trigger.h"
+#include "AWS_WIFI.h"
+
+
+#define SHIM_MAX_TASKS      64
+#define SHIM_RUN_TIME_HZ    1000000     // run-time counter ticks per second, as esp_timer
+#define SHIM_HEAP_TOTAL     300000
+#define SHIM_HEAP_FREE      180000
+
+TickType_t shim_ticks;
+void (*shim_uart_tx)(const void *data, size_t len);
+size_t (*shim_uart_rx)(void *buf, size_t len);
+void (*shim_mqtt_tx)(const char *data, size_t len);
+void (*shim_wait)(void);
+
+// The idle task of each core comes first, as the scheduler creates them
+static shim_task_t tasks[SHIM_MAX_TASKS] = {
+    { .name = "IDLE0", .core = 0 },
+    { .name = "IDLE1", .core = 1 },
+};
+static size_t task_num = configNUMBER_OF_CORES;
+static uint64_t run_time_total;
+
+
+// --------------------------------------------------------------------
+// Time
+// --------------------------------------------------------------------
+void shim_advance(TickType_t ticks)
+{
+    uint32_t elapsed = (uint32_t)((uint64_t)ticks * SHIM_RUN_TIME_HZ / configTICK_RATE_HZ);
+
+    // Each task takes 1..8 % of its core, different every time
+    for (size_t core = 0; core < configNUMBER_OF_CORES; core++)
+    {
+        uint32_t busy = 0;
+        for (size_t i = configNUMBER_OF_CORES; i < task_num; i++)
+        {
+            BaseType_t on = tasks[i].core == tskNO_AFFINITY ? 0 : tasks[i].core;
+            if ((size_t)on != core) {
+                continue;
+            }
+            uint32_t share = elapsed / 100 * (1 + (shim_ticks / 7 + i) % 8);
+            if (busy + share > elapsed) {
+                share = elapsed - busy;
+            }
+            tasks[i].run_time += share;
+            busy += share;
+        }
+        tasks[core].run_time += elapsed - busy;
+    }
+
+    shim_ticks += ticks;
+    run_time_total += elapsed;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return shim_ticks;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    shim_advance(ticks);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)run_time_total;
+}
+
+// --------------------------------------------------------------------
+// Tasks
+// --------------------------------------------------------------------
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    if (task_num == SHIM_MAX_TASKS) {
+        return pdFAIL;
+    }
+
+    shim_task_t *t = &tasks[task_num++];
+    *t = (shim_task_t) { .fn = fn, .name = name, .arg = arg, .core = core };
+    if (handle) {
+        *handle = t;
+    }
+    return pdPASS;
+}
+
+shim_task_t *shim_task(const char *name)
+{
+    for (size_t i = 0; i < task_num; i++)
+    {
+        if (strcmp(tasks[i].name, name) == 0) {
+            return &tasks[i];
+        }
+    }
+    return NULL;
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    return shim_task(name);
+}
+
+// Whoever calls runs as the first task created after the idle tasks
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return &tasks[configNUMBER_OF_CORES];
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core)
+{
+    return &tasks[core];
+}
+
+BaseType_t xTaskGetCoreID(TaskHandle_t task)
+{
+    return ((shim_task_t *)task)->core;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    return task_num;
+}
+
+void vTaskGetInfo(TaskHandle_t task, TaskStatus_t *status, BaseType_t stack, eTaskState state)
+{
+    shim_task_t *t = task;
+
+    *status = (TaskStatus_t) {
+        .xHandle = t,
+        .pcTaskName = t->name,
+        .xTaskNumber = (UBaseType_t)(t - tasks) + 1,
+        .eCurrentState = t == xTaskGetCurrentTaskHandle() ? eRunning : eBlocked,
+        .uxCurrentPriority = t < &tasks[configNUMBER_OF_CORES] ? 0 : 5,
+        .uxBasePriority = t < &tasks[configNUMBER_OF_CORES] ? 0 : 5,
+        .ulRunTimeCounter = t->run_time,
+        .usStackHighWaterMark = 512 + 16 * (uint32_t)(t - tasks),
+        .xCoreID = t->core,
+    };
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, configRUN_TIME_COUNTER_TYPE *total)
+{
+    if (size < task_num) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < task_num; i++) {
+        vTaskGetInfo(&tasks[i], &status[i], pdTRUE, eInvalid);
+    }
+    if (total) {
+        *total = (configRUN_TIME_COUNTER_TYPE)run_time_total;
+    }
+    return task_num;
+}
+
+// Nothing waits for a notification, the test runs the task's work itself
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    return 0;
+}
+
+// --------------------------------------------------------------------
+// Queues: a ring of items. Semaphores only have to be taken, there is
+// no one to contend with.
+// --------------------------------------------------------------------
+typedef struct {
+    uint8_t *items;
+    size_t item_size;
+    size_t length;
+    size_t head;
+    size_t used;
+} shim_queue_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    shim_queue_t *q = calloc(1, sizeof(shim_queue_t));
+
+    if (q == NULL) {
+        return NULL;
+    }
+    q->items = malloc((size_t)length * item_size);
+    if (q->items == NULL)
+    {
+        free(q);
+        return NULL;
+    }
+    q->item_size = item_size;
+    q->length = length;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    shim_queue_t *q = queue;
+
+    if (q->used == q->length && ticks > 0 && shim_wait) {
+        shim_wait();
+    }
+    if (q->used == q->length) {
+        return pdFALSE;
+    }
+
+    memcpy(q->items + (q->head + q->used) % q->length * q->item_size, item, q->item_size);
+    q->used++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    shim_queue_t *q = queue;
+
+    if (q->used == 0) {
+        return pdFALSE;
+    }
+
+    memcpy(item, q->items + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->used--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return ((shim_queue_t *)queue)->used;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    static uint8_t mutex;
+    return &mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    return xSemaphoreCreateMutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pdTRUE;
+}
+
+// --------------------------------------------------------------------
+// UART
+// --------------------------------------------------------------------
+static uint32_t uart_baud = 115200;
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_size, int tx_size, int queue_size,
+                              QueueHandle_t *queue, int flags)
+{
+    return ESP_OK;
+}
+
+bool uart_is_driver_installed(uart_port_t port)
+{
+    return true;
+}
+
+int uart_write_bytes(uart_port_t port, const void *data, size_t len)
+{
+    if (shim_uart_tx) {
+        shim_uart_tx(data, len);
+    }
+    return (int)len;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t len, TickType_t ticks)
+{
+    return shim_uart_rx ? (int)shim_uart_rx(buf, len) : 0;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t port, uint32_t baud)
+{
+    uart_baud = baud;
+    return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t port, uint32_t *baud)
+{
+    *baud = uart_baud;
+    return ESP_OK;
+}
+
+void uart_vfs_dev_use_driver(int port)
+{
+}
+
+int uart_vfs_dev_port_set_tx_line_endings(int port, esp_line_endings_t mode)
+{
+    return 0;
+}
+
+// --------------------------------------------------------------------
+// Chip and heap
+// --------------------------------------------------------------------
+void esp_chip_info(esp_chip_info_t *info)
+{
+    *info = (esp_chip_info_t) { .cores = configNUMBER_OF_CORES };
+}
+
+int esp_clk_cpu_freq(void)
+{
+    return 240000000;
+}
+
+const char *esp_err_to_name(esp_err_t err)
+{
+    switch (err)
+    {
+    case ESP_OK:                return "ESP_OK";
+    case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    default:                    return "ESP_FAIL";
+    }
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return SHIM_HEAP_FREE;
+}
+
+// One internal heap, nothing else
+size_t heap_caps_get_total_size(uint32_t caps)
+{
+    return caps & (MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) ? SHIM_HEAP_TOTAL : 0;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return heap_caps_get_total_size(caps) ? SHIM_HEAP_FREE : 0;
+}
+
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t caps)
+{
+    *info = (multi_heap_info_t) {
+        .total_free_bytes = heap_caps_get_free_size(caps),
+        .largest_free_block = heap_caps_get_free_size(caps) / 2,
+        .minimum_free_bytes = heap_caps_get_free_size(caps) / 3,
+        .allocated_blocks = 100,
+        .free_blocks = 10,
+        .total_blocks = 110,
+    };
+}
+
+// --------------------------------------------------------------------
+// Modules the host build leaves out: they need the chip (ISR trace,
+// RTC memory, trigger timer) or the network
+// --------------------------------------------------------------------
+uint64_t ISR_Trace_Core_Ns(int core)
+{
+    return 0;
+}
+
+uint64_t ISR_Trace_Task_Ns(TaskHandle_t task)
+{
+    return 0;
+}
+
+void ISR_Trace_Keep_Tasks(const TaskStatus_t *alive, UBaseType_t count)
+{
+}
+
+void ISR_uart_print_task(void *arg)
+{
+}
+
+bool postmortem_init(void (*print)(char *))
+{
+    return false;
+}
+
+void postmortem_record_stats(const stats_result_t *res, uint32_t heap_free)
+{
+}
+
+void trigger_task(void *arg)
+{
+}
+
+void aws_and_wifi_start(void)
+{
+}
+
+void aws_publish(void *ctx, const char *data, size_t len)
+{
+    if (shim_mqtt_tx) {
+        shim_mqtt_tx(data, len);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+
+
+// --------------------------------------------------------------------
+// Host build of MCUSilk: what the tests see of shim.c
+// --------------------------------------------------------------------
+//
+// Tasks are recorded but never run, a test calls what they would do
+// (sink_drain() for a sink task). Every task has a run-time counter that
+// grows with shim_advance(), so the stats engine measures something; the
+// idle task of each core gets whatever the others leave.
+//
+// Time moves in vTaskDelay() and when a send waits on a full queue: the
+// wait hook runs first, as the task that empties the queue would, and
+// the send tries again before giving up.
+//
+typedef struct {
+    void (*fn)(void *);
+    const char *name;
+    void *arg;
+    BaseType_t core;
+    configRUN_TIME_COUNTER_TYPE run_time;
+} shim_task_t;
+
+extern TickType_t shim_ticks;
+
+// Serial TX (uart_write_bytes) and RX (uart_read_bytes), NULL = nothing
+extern void (*shim_uart_tx)(const void *data, size_t len);
+extern size_t (*shim_uart_rx)(void *buf, size_t len);
+
+// aws_publish: what the MQTT sink writes, NULL = dropped
+extern void (*shim_mqtt_tx)(const char *data, size_t len);
+
+// A send with ticks to wait found the queue full
+extern void (*shim_wait)(void);
+
+// Let ticks pass: tick count, esp_timer and the run-time counters
+void shim_advance(TickType_t ticks);
+
+// Created task by name, NULL if there is none
+shim_task_t *shim_task(const char *name);
@@ -0,0 +1,408 @@
+// Soak test: 24 simulated hours of reports, alerts and queued JSON through
+// every sink, with the MQTT link down half of the time and the serial link
+// too slow for a while. The heap has to be flat, every buffer back in the
+// pool, every serial frame intact and the reports in order. Sinks that keep
+// up lose no alert, the stalled one writes the newest first once it is back.
+// At the end a report with more tasks than fit a pool buffer reaches every
+// sink, streamed or as an alert that it was too large.
+//
+//   ./soak <json|cbor|binary|delta>[-lz] [hours]
+//
+// Built with the real CPU_usage.c included, so the test can run one stats
+// period at a time (stats_period) in place of the stats task.
+
+#include <malloc.h>
+#include "CPU_usage.c"
+#include "shim.h"
+
+
+#define SOAK_FILE_RATE      400             // bytes per second of the extra sink
+#define SOAK_WIFI_PERIODS   500             // up, then down for as long
+#define SOAK_SLOW_PERIODS   2000            // slow serial link, then fast for as long
+#define SOAK_SLOW_BPS       1200            // bytes per second of the slow serial link
+#define SOAK_WARM_PERIODS   100             // every message type has been encoded by then
+#define SOAK_BIG_TASKS      60              // tasks of the report larger than CPU_USAGE_MSG_MAX
+
+static flashlog_t flash;
+static uint8_t flash_mem[64 * 1024];
+
+// --------------------------------------------------------------------
+// Heap: live blocks and bytes, through -Wl,--wrap
+// --------------------------------------------------------------------
+static size_t live_blocks, live_bytes, peak_bytes;
+
+static void soak_alloc(void *p)
+{
+    live_blocks++;
+    live_bytes += malloc_usable_size(p);
+    if (live_bytes > peak_bytes) {
+        peak_bytes = live_bytes;
+    }
+}
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+void *__wrap_malloc(size_t size)
+{
+    void *p = __real_malloc(size);
+    if (p) {
+        soak_alloc(p);
+    }
+    return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *p = __real_calloc(n, size);
+    if (p) {
+        soak_alloc(p);
+    }
+    return p;
+}
+
+void __wrap_free(void *p)
+{
+    if (p) {
+        live_blocks--;
+        live_bytes -= malloc_usable_size(p);
+    }
+    __real_free(p);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    if (p)
+    {
+        live_blocks--;
+        live_bytes -= malloc_usable_size(p);
+    }
+
+    // A failed realloc keeps the old block
+    void *q = __real_realloc(p, size);
+    if (q) {
+        soak_alloc(q);
+    } else if (p && size) {
+        soak_alloc(p);
+    }
+    return q;
+}
+
+// --------------------------------------------------------------------
+// Links
+// --------------------------------------------------------------------
+static bool wifi_up;
+static uint32_t serial_bps;                 // 0 = as fast as it gets
+static size_t serial_bytes, mqtt_bytes, file_bytes;
+
+// Serial frames and JSON lines, checked as they arrive
+static uint8_t rx[SINK_BUF_SIZE * 2];
+static size_t rx_len;
+static bool rx_overflow;
+static size_t frames, bad_frames;
+static long last_seq = -1;
+static size_t reports, out_of_order, long_reports;
+
+// Alerts
+static TickType_t last_alert;               // when the newest one was published
+static size_t outages, stale_alerts;
+
+static void soak_line(char *line, size_t len)
+{
+    const char *key = strstr(line, "\"" TLM_KEY_SEQ "\":");
+    if (key == NULL) {
+        return;
+    }
+
+    long seq = strtol(key + strlen(TLM_KEY_SEQ) + 3, NULL, 10);
+    if (seq <= last_seq) {
+        out_of_order++;
+    }
+    last_seq = seq;
+    reports++;
+    long_reports += len > CPU_USAGE_MSG_MAX;
+}
+
+static void soak_serial(const uint8_t *data, size_t len)
+{
+    bool framed = cpu_usage_serial_framed();
+    uint8_t end = framed ? 0 : '\n';
+
+    serial_bytes += len;
+    if (serial_bps) {
+        shim_advance((TickType_t)((uint64_t)len * configTICK_RATE_HZ / serial_bps));
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] != end)
+        {
+            if (rx_len < sizeof(rx) - 1) {
+                rx[rx_len++] = data[i];
+            } else {
+                rx_overflow = true;
+            }
+            continue;
+        }
+
+        if (rx_overflow) {
+            bad_frames++;
+        } else if (framed) {
+            frames++;
+            bad_frames += wire_unframe(rx, rx_len) == 0;
+        } else {
+            rx[rx_len] = '\0';
+            soak_line((char *)rx, rx_len);
+        }
+        rx_len = 0;
+        rx_overflow = false;
+    }
+}
+
+static void soak_mqtt(const char *data, size_t len)
+{
+    mqtt_bytes += len;
+}
+
+static void soak_file(void *ctx, const char *data, size_t len)
+{
+    file_bytes += len;
+}
+
+// What the sink tasks would do by now. The MQTT task is stuck without Wi-Fi.
+static void soak_sinks(void)
+{
+    for (size_t i = 0; i < sink_count(); i++)
+    {
+        sink_t *s = sink_get(i);
+        if (s->cfg.write != aws_publish || wifi_up) {
+            sink_drain(s);
+        }
+    }
+}
+
+// Wi-Fi is back: the MQTT task writes what its alert lane holds, and that
+// is the newest alert of the outage
+static void soak_link_back(void)
+{
+    for (size_t i = 0; i < sink_count(); i++)
+    {
+        sink_t *s = sink_get(i);
+        if (s->cfg.write != aws_publish) {
+            continue;
+        }
+
+        uint32_t sent = s->alerts_sent;
+        TickType_t wait = s->alert_wait;
+        TickType_t now = shim_ticks;
+
+        sink_drain(s);
+        outages++;
+        if (s->alerts_sent - sent != CPU_USAGE_ALERT_DEPTH || s->alert_wait - wait != now - last_alert) {
+            stale_alerts++;
+        }
+    }
+}
+
+// Buffers the pool hands out, all of them back afterwards
+static size_t soak_pool_free(void)
+{
+    sink_buf_t *taken[64];
+    size_t n = 0;
+
+    while (n < sizeof(taken) / sizeof(taken[0]) && (taken[n] = sink_buf_get(true)) != NULL) {
+        n++;
+    }
+    for (size_t i = 0; i < n; i++) {
+        sink_buf_put(taken[i]);
+    }
+    return n;
+}
+
+// A period with SOAK_BIG_TASKS tasks, after long enough for every rate
+// limit to have its full burst. Returns the sinks that wrote nothing, the
+// report or the alert about it.
+static uint32_t soak_big_report(uint32_t seq)
+{
+    static char names[SOAK_BIG_TASKS][16];
+    uint32_t sent[CPU_USAGE_MAX_SINKS];
+    uint32_t silent = 0;
+
+    for (size_t i = uxTaskGetNumberOfTasks(); i < SOAK_BIG_TASKS; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "soak task %05zu", i);
+        xTaskCreatePinnedToCore(spin_task, names[i], 2048, NULL, SPIN_TASK_PRIO, NULL, (BaseType_t)(i % 2));
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(600 * 1000));
+    soak_sinks();
+    for (size_t i = 0; i < sink_count(); i++) {
+        sent[i] = sink_get(i)->sent;
+    }
+
+    stats_period(seq % DEVICE_INFO_PERIOD ? seq : seq + 1);
+    soak_sinks();
+    for (size_t i = 0; i < sink_count(); i++) {
+        silent |= (uint32_t)(sink_get(i)->sent == sent[i]) << i;
+    }
+    return silent;
+}
+
+static bool soak_format(const char *name, cpu_usage_format_t *format, bool *compress)
+{
+    static const char *names[] = { "json", "binary", "cbor", "delta" };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        size_t n = strlen(names[i]);
+        if (strncmp(name, names[i], n) == 0 && (name[n] == '\0' || strcmp(&name[n], "-lz") == 0))
+        {
+            *format = (cpu_usage_format_t)i;
+            *compress = name[n] != '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    cpu_usage_format_t format;
+    bool compress;
+
+    if (argc < 2 || !soak_format(argv[1], &format, &compress))
+    {
+        fprintf(stderr, "usage: %s <json|cbor|binary|delta>[-lz] [hours]\n", argv[0]);
+        return 2;
+    }
+    uint32_t hours = argc > 2 ? (uint32_t)atoi(argv[2]) : 24;
+
+    flashlog_backend_t backend;
+    flashlog_ram_backend(&backend, flash_mem, sizeof(flash_mem), 4096);
+    flashlog_open(&flash, &backend);
+
+    cpu_usage_sink_cfg_t file = {
+        .name = "file",
+        .format = CPU_USAGE_FORMAT_DELTA,
+        .write = soak_file,
+        .depth = 2,
+        .rate = SOAK_FILE_RATE,
+        .drop = CPU_USAGE_BLOCK,
+    };
+    cpu_usage_cfg_t cfg = {
+        .tag = "soak",
+        .format = format,
+        .compress = compress,
+        .write_fn = soak_serial,
+        .enable_AWS_upload = true,
+        .aws_format = CPU_USAGE_FORMAT_CBOR,
+        .aws_compress = true,
+        .sinks = &file,
+        .sink_count = 1,
+        .flash_log = &flash,
+        .log_retention_s = 3600,
+    };
+    shim_mqtt_tx = soak_mqtt;
+    shim_wait = soak_sinks;
+    CPU_usage_start(&cfg);
+
+    TickType_t end = (TickType_t)hours * 3600 * configTICK_RATE_HZ;
+    size_t warm_blocks = 0, warm_bytes = 0, warm_pool = 0;
+    size_t heap_changes = 0;
+    uint32_t seq = 0;
+
+    for (seq = 0; shim_ticks < end; seq++)
+    {
+        bool up = seq / SOAK_WIFI_PERIODS % 2;
+        if (up && !wifi_up) {
+            soak_link_back();
+        }
+        wifi_up = up;
+        serial_bps = seq / SOAK_SLOW_PERIODS % 2 ? 0 : SOAK_SLOW_BPS;
+
+        stats_period(seq);
+        if (seq % 5 == 0) {
+            cpu_usage_queue_json("{ \"trigger\": { \"id\": 1 } }", pdMS_TO_TICKS(50));
+        }
+        if (seq % 7 == 3)
+        {
+            char alert[64];
+            snprintf(alert, sizeof(alert), "{ \"error\": \"soak\", \"code\": \"%" PRIu32 "\" }", seq);
+            cpu_usage_alert_json(alert);
+            last_alert = shim_ticks;
+        }
+        soak_sinks();
+        cpu_usage_adapt_rate();
+        vTaskDelay(MEASURING_TICKS * coalesce);
+
+        if (seq == SOAK_WARM_PERIODS)
+        {
+            // Count the pool with the MQTT queue emptied too, as at the end
+            wifi_up = true;
+            soak_sinks();
+            wifi_up = up;
+
+            warm_blocks = live_blocks;
+            warm_bytes = live_bytes;
+            warm_pool = soak_pool_free();
+        }
+        else if (seq > SOAK_WARM_PERIODS && (live_blocks != warm_blocks || live_bytes != warm_bytes))
+        {
+            heap_changes++;
+        }
+    }
+
+    wifi_up = true;
+    soak_sinks();
+    size_t end_pool = soak_pool_free();
+    uint32_t silent = soak_big_report(seq);
+
+    printf("%s: %" PRIu32 " reports in %" PRIu32 " h, heap %zu blocks %zu B (peak %zu B), pool %zu -> %zu\n",
+           argv[1], seq, hours, live_blocks, live_bytes, peak_bytes, warm_pool, end_pool);
+    printf("  serial %zu B, mqtt %zu B, file %zu B, flash log %" PRIu32 " appended, %" PRIu32 " failed\n",
+           serial_bytes, mqtt_bytes, file_bytes, flash.appended, flash.failed);
+    for (size_t i = 0; i < sink_count(); i++)
+    {
+        cpu_usage_sink_stats_t st;
+        cpu_usage_sink_stats(i, &st);
+        printf("  %-8s sent %u dropped %u alerts %u/%u dropped, wait avg %u ms max %u ms\n",
+               sink_get(i)->cfg.name, st.sent, st.dropped, st.alerts, st.alerts_dropped,
+               st.alert_wait_avg_ms, st.alert_wait_max_ms);
+    }
+    if (cpu_usage_serial_framed()) {
+        printf("  serial frames %zu, bad %zu\n", frames, bad_frames);
+    } else {
+        printf("  serial reports %zu, out of order %zu, longer than a buffer %zu\n",
+               reports, out_of_order, long_reports);
+    }
+
+    printf("  mqtt outages %zu, newest alert not written first %zu\n", outages, stale_alerts);
+
+    // Only the stalled sink may lose alerts, to newer ones
+    size_t alerts_lost = 0;
+    for (size_t i = 0; i < sink_count(); i++) {
+        if (sink_get(i)->cfg.write != aws_publish) {
+            alerts_lost += sink_get(i)->alerts_dropped;
+        }
+    }
+
+    bool ok = heap_changes == 0 && end_pool == warm_pool && bad_frames == 0 && out_of_order == 0 &&
+              (cpu_usage_serial_framed() ? frames > 0 : reports > 0) &&
+              outages > 0 && stale_alerts == 0 && alerts_lost == 0 &&
+              silent == 0 && (cpu_usage_serial_framed() || long_reports > 0);
+    if (heap_changes) {
+        printf("  FAIL: heap changed after %u reports, %zu times\n", SOAK_WARM_PERIODS, heap_changes);
+    }
+    if (alerts_lost) {
+        printf("  FAIL: %zu alerts dropped on sinks that keep up\n", alerts_lost);
+    }
+    for (size_t i = 0; i < sink_count(); i++) {
+        if (silent & (1u << i)) {
+            printf("  FAIL: %s dropped the %u task report without an alert\n", sink_get(i)->cfg.name, SOAK_BIG_TASKS);
+        }
+    }
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+
+# flashlog_dump.py
+"""Pull the flash log (MCUSilk/flashlog.h) off a device and save it.
+
+    python flashlog_dump.py COM5 -o field.jsonl --raw field.bin
+
+The link is moved to the fastest rate that works first (--fast 0 keeps it), then the
+device streams every record, oldest first, and holds the link until the dump is done.
+Each record becomes one JSON line, the same message the live stream would give.
+--raw keeps the bytes as received, which the GUI decoders and host/cpp read too.
+"""
+import os
+import sys
+import json
+import time
+import argparse
+import serial
+
+os.environ.setdefault("QT_API", "pyside6")
+from serial_thread import StreamDecoder, command_frame, negotiate_baud
+from telemetry_schema import WIRE_CMD_DUMP, QUERY_OK
+
+DUMP_REQUEST = 1
+DUMP_IDLE_TIMEOUT = 5.0     # seconds without a byte before the dump counts as lost
+
+
+def dump(ser, on_record, raw=None):
+    """Ask for the log and pass every record to on_record. Returns (log_info, reply)."""
+    decoder = StreamDecoder()
+    # Stored frames can hold '\n', never take them for JSON lines
+    decoder.binary = True
+    info = None
+    reply = None
+    received = 0
+
+    ser.reset_input_buffer()
+    ser.write(command_frame(WIRE_CMD_DUMP, b"", DUMP_REQUEST))
+    last = time.monotonic()
+
+    while reply is None and time.monotonic() - last < DUMP_IDLE_TIMEOUT:
+        data = ser.read(ser.in_waiting or 1)
+        if not data:
+            continue
+        last = time.monotonic()
+        if raw is not None:
+            raw.write(data)
+
+        for parsed in decoder.feed(data):
+            # Live messages sent before the device took the link come first
+            if info is None:
+                if parsed.get("log_info", {}).get("request") == DUMP_REQUEST:
+                    info = parsed["log_info"]
+                continue
+            if parsed.get("reply", {}).get("request") == DUMP_REQUEST:
+                reply = parsed["reply"]
+                break
+            on_record(parsed)
+
+        if info is not None and info["bytes"]:
+            received += len(data)
+            print(f"\r{min(received, info['bytes']) * 100 // info['bytes']}%", end="", file=sys.stderr)
+
+    print(file=sys.stderr)
+    return info, reply
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Dump the flash log of a device")
+    parser.add_argument("port", help="serial port or pyserial URL")
+    parser.add_argument("--baud", type=int, default=115200, help="rate the device starts at")
+    parser.add_argument("--fast", type=int, default=2000000, help="highest rate to negotiate, 0 = none")
+    parser.add_argument("-o", "--output", help="JSON lines file, default stdout")
+    parser.add_argument("--raw", help="also keep the received bytes")
+    args = parser.parse_args()
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    raw = open(args.raw, "wb") if args.raw else None
+    records = []
+
+    def on_record(parsed):
+        records.append(parsed)
+        out.write(json.dumps(parsed) + "\n")
+
+    with serial.serial_for_url(args.port, args.baud, timeout=0.1) as ser:
+        if args.fast:
+            baud = negotiate_baud(ser, StreamDecoder(), args.fast, lambda parsed: None)
+            print(f"link at {baud} baud", file=sys.stderr)
+        info, reply = dump(ser, on_record, raw)
+
+    if out is not sys.stdout:
+        out.close()
+    if raw is not None:
+        raw.close()
+
+    if reply is None:
+        print(f"dump incomplete, {len(records)} records", file=sys.stderr)
+        return 1
+    if reply["status"] != QUERY_OK:
+        print(f"device answered status {reply['status']}", file=sys.stderr)
+        return 1
+
+    # Records the CRC rejected (cut short by a reset) are the difference
+    seqs = [r["report"]["seq"] for r in records if "report" in r]
+    print(f"{len(records)} of {info['records']} records, {info['bytes']} bytes, "
+          f"log capacity {info['capacity']} bytes", file=sys.stderr)
+    if seqs:
+        print(f"reports {seqs[0]} to {seqs[-1]}", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,3 +1,4 @@
+import os
 import sys
 import json
 import serial
@@ -7,53 +8,14 @@ from PySide6.QtWidgets import (
     QApplication, QMainWindow, QWidget, QVBoxLayout,
     QHBoxLayout, QLabel, QComboBox, QPushButton,
     QTabWidget, QTableWidget, QTableWidgetItem,
-    QMessageBox, QRadioButton, QButtonGroup
+    QMessageBox, QRadioButton, QButtonGroup, QCheckBox, QLineEdit
 )
 
-# ------------------ SERIAL READER THREAD ------------------
-class SerialReaderThread(QThread):
-    data_received = Signal(dict)
-    error_received = Signal(str)
-    serial_error = Signal(str)
-
-    def __init__(self, port, baudrate):
-        super().__init__()
-        self.port = port
-        self.baudrate = baudrate
-        self.running = True
-
-    def run(self):
-        try:
-            with serial.Serial(self.port, self.baudrate, timeout=2) as ser:
-                buffer = ""
-                while self.running:
-                    if ser.in_waiting > 0:
-                        data = ser.read(ser.in_waiting).decode('utf-8', errors='ignore')
-                        buffer += data
-                        while '\n' in buffer:
-                            line, buffer = buffer.split('\n', 1)
-                            line = line.strip()
-                            if not line:
-                                continue
-                            try:
-                                parsed = json.loads(line)
-                                if "error" in parsed:
-                                    msg = parsed.get("error")
-                                    code = parsed.get("code")
-                                    if code:
-                                        self.error_received.emit(f"{msg} (code: {code})")
-                                    else:
-                                        self.error_received.emit(msg)
-                                else:
-                                    self.data_received.emit(parsed)
-                            except json.JSONDecodeError:
-                                continue
-        except serial.SerialException as e:
-            self.serial_error.emit(str(e))
-
-    def stop(self):
-        self.running = False
-
+# serial_thread uses qtpy, keep it on the same binding as this window
+os.environ.setdefault("QT_API", "pyside6")
+from serial_thread import SerialReaderThread     # JSON lines and binary frames
+from telemetry_schema import (message_kind, MESSAGES, WIRE_MSG_JSON, WIRE_CMD_SNAPSHOT, WIRE_CMD_TASK,
+                              WIRE_CMD_STACKS, WIRE_CMD_HEAP)
 
 # ------------------ MAIN WINDOW ------------------
 class MainWindow(QMainWindow):
@@ -67,14 +29,26 @@ class MainWindow(QMainWindow):
 
         self.settings_tab = QWidget()
         self.monitor_tab = QWidget()
+        self.queries_tab = QWidget()
         self.tabs.addTab(self.settings_tab, "Settings")
         self.tabs.addTab(self.monitor_tab, "Monitor")
+        self.tabs.addTab(self.queries_tab, "Queries")
 
         self.serial_thread = None
         self.latest_tasks = []
+        self.latest_core_load = []
+        self.device_info = {}
+
+        # Loss / latency of the period reports, filled by the serial thread
+        self.link_label = QLabel("")
+        self.statusBar().addPermanentWidget(self.link_label)
+        # Serial bandwidth per message type, from the device's budget messages
+        self.budget_label = QLabel("")
+        self.statusBar().addPermanentWidget(self.budget_label)
 
         self.init_settings_tab()
         self.init_monitor_tab()
+        self.init_queries_tab()
 
     # ---------------- SETTINGS TAB ----------------
     def init_settings_tab(self):
@@ -85,15 +59,19 @@ class MainWindow(QMainWindow):
         baud_layout = QHBoxLayout()
         baud_label = QLabel("Baudrate:")
         self.baudrate_combo = QComboBox()
-        self.baudrate_combo.addItems(["9600", "115200", "230400"])
+        self.baudrate_combo.addItems(["9600", "115200", "230400", "460800", "921600", "2000000"])
         self.baudrate_combo.setCurrentText("115200")  # Default selection
+        # Open at 115200 (the boot rate) and let the device move up to the selected rate
+        self.negotiate_check = QCheckBox("Negotiate")
         baud_layout.addWidget(baud_label)
         baud_layout.addWidget(self.baudrate_combo)
+        baud_layout.addWidget(self.negotiate_check)
 
         # COM port row
         port_layout = QHBoxLayout()
         port_label = QLabel("COM Port:")
         self.port_combo = QComboBox()
+        self.port_combo.setEditable(True)   # also takes pyserial URLs (socket://host:port)
         self.refresh_ports()
         port_layout.addWidget(port_label)
         port_layout.addWidget(self.port_combo)
@@ -119,18 +97,11 @@ class MainWindow(QMainWindow):
     def init_monitor_tab(self):
         layout = QVBoxLayout()
 
-        # ---- Core usage labels (always visible) ----
-        usage_layout = QHBoxLayout()
-        self.core0_label = QLabel("Core 0: 0%")
-        self.core1_label = QLabel("Core 1: 0%")
-
-        # Style: color background for distinction
-        self.core0_label.setStyleSheet("background-color: #004080; color: white; padding: 6px; border-radius: 5px;")
-        self.core1_label.setStyleSheet("background-color: #008000; color: white; padding: 6px; border-radius: 5px;")
-
-        usage_layout.addWidget(self.core0_label)
-        usage_layout.addWidget(self.core1_label)
-        layout.addLayout(usage_layout)
+        # ---- Core usage labels (one per core, sized from the device info) ----
+        self.usage_layout = QHBoxLayout()
+        self.core_labels = []
+        self.set_core_count(1)
+        layout.addLayout(self.usage_layout)
 
         # ---- Memory usage labels ----
         mem_layout = QHBoxLayout()
@@ -175,6 +146,105 @@ class MainWindow(QMainWindow):
         layout.addWidget(self.table)
         self.monitor_tab.setLayout(layout)
 
+    # Label colors, cycled for targets with many cores
+    CORE_COLORS = ["#004080", "#008000", "#806000", "#600080"]
+
+    def set_core_count(self, count):
+        count = max(1, int(count))
+        if count == len(self.core_labels):
+            return
+
+        for label in self.core_labels:
+            self.usage_layout.removeWidget(label)
+            label.deleteLater()
+        self.core_labels = []
+
+        for core in range(count):
+            label = QLabel(f"Core {core}: 0%")
+            color = self.CORE_COLORS[core % len(self.CORE_COLORS)]
+            label.setStyleSheet(f"background-color: {color}; color: white; padding: 6px; border-radius: 5px;")
+            self.usage_layout.addWidget(label)
+            self.core_labels.append(label)
+
+    # ---------------- QUERIES TAB ----------------
+    def init_queries_tab(self):
+        layout = QVBoxLayout()
+
+        # ---- Data the device only computes when asked ----
+        button_layout = QHBoxLayout()
+        for text, cmd in (("Snapshot", WIRE_CMD_SNAPSHOT), ("Stacks", WIRE_CMD_STACKS), ("Heap map", WIRE_CMD_HEAP)):
+            button = QPushButton(text)
+            button.clicked.connect(lambda checked=False, cmd=cmd: self.send_query(cmd))
+            button_layout.addWidget(button)
+        layout.addLayout(button_layout)
+
+        # ---- One task by name ----
+        task_layout = QHBoxLayout()
+        self.task_query_edit = QLineEdit()
+        self.task_query_edit.setPlaceholderText("Task name")
+        task_button = QPushButton("Task")
+        task_button.clicked.connect(lambda: self.send_query(WIRE_CMD_TASK, self.task_query_edit.text().encode()))
+        task_layout.addWidget(self.task_query_edit)
+        task_layout.addWidget(task_button)
+        layout.addLayout(task_layout)
+
+        self.query_label = QLabel("Snapshot results show on the monitor tab.")
+        layout.addWidget(self.query_label)
+
+        self.query_table = QTableWidget(0, 0)
+        layout.addWidget(self.query_table)
+        self.queries_tab.setLayout(layout)
+
+    def send_query(self, cmd, args=b""):
+        if self.serial_thread is None:
+            QMessageBox.warning(self, "Warning", "Please connect first.")
+            return
+        request = self.serial_thread.request(cmd, args)
+        self.query_label.setText(f"Request {request} sent")
+
+    # QUERY_* and eTaskState, in value order
+    QUERY_STATUS = ["done", "unknown command", "no such task", "out of memory", "bad arguments", "failed"]
+    TASK_STATES = ["running", "ready", "blocked", "suspended", "deleted"]
+    # MALLOC_CAP_* classes of the heap map (MCUSilk/query.c)
+    HEAP_CLASSES = {0x804: "Internal", 0x8: "DMA", 0x1: "IRAM (exec)", 0x400: "PSRAM", 0x8000: "RTC"}
+
+    def fill_query_table(self, headers, rows):
+        self.query_table.setColumnCount(len(headers))
+        self.query_table.setHorizontalHeaderLabels(headers)
+        self.query_table.setRowCount(len(rows))
+        for row, values in enumerate(rows):
+            for col, value in enumerate(values):
+                self.query_table.setItem(row, col, QTableWidgetItem(str(value)))
+
+    def update_query(self, kind, data):
+        if kind == "reply":
+            status = data["status"]
+            text = self.QUERY_STATUS[status] if status < len(self.QUERY_STATUS) else f"status {status}"
+            self.query_label.setText(f"Request {data['request']}: {text}")
+            return
+
+        if kind == "task_info":
+            rows = []
+            for t in sorted(data["tasks"], key=lambda t: t["stack_free"]):
+                state = t["state"]
+                priority = str(t["priority"])
+                if t["base_priority"] != t["priority"]:
+                    priority += f" (base {t['base_priority']})"
+                rows.append([t["task_name"], self.TASK_STATES[state] if state < len(self.TASK_STATES) else state,
+                             priority, "any" if t["core"] < 0 else t["core"], t["stack_free"], t["run_time"]])
+            self.fill_query_table(["Task", "State", "Priority", "Core", "Stack free (B)", "Run time"], rows)
+            return
+
+        if kind == "heap":
+            rows = []
+            for h in data["regions"]:
+                frag = 100 - h["largest_free"] * 100 // h["free"] if h["free"] else 0
+                rows.append([self.HEAP_CLASSES.get(h["caps"], hex(h["caps"])), h["total"], h["free"],
+                             h["largest_free"], h["min_free"], f"{frag}%",
+                             f"{h['allocated_blocks']} / {h['free_blocks']}"])
+            self.fill_query_table(["Heap", "Total", "Free", "Largest free", "Min free", "Fragmented",
+                                   "Blocks used / free"], rows)
+
     # ---------------- SERIAL HANDLING ----------------
     def start_serial(self):
         port = self.port_combo.currentText()
@@ -184,10 +254,15 @@ class MainWindow(QMainWindow):
             QMessageBox.warning(self, "Warning", "Please select a COM port first.")
             return
 
-        self.serial_thread = SerialReaderThread(port, baudrate)
+        if self.negotiate_check.isChecked() and baudrate > 115200:
+            self.serial_thread = SerialReaderThread(port, 115200, negotiate=baudrate)
+        else:
+            self.serial_thread = SerialReaderThread(port, baudrate)
         self.serial_thread.data_received.connect(self.update_data)
         self.serial_thread.error_received.connect(self.show_error)
         self.serial_thread.serial_error.connect(self.show_error)
+        self.serial_thread.link_stats.connect(self.update_link)
+        self.serial_thread.link_baud.connect(self.update_baud)
         self.serial_thread.start()
 
         # Switch automatically to Monitor tab
@@ -196,10 +271,63 @@ class MainWindow(QMainWindow):
     def show_error(self, msg):
         QMessageBox.critical(self, "Error", msg)
 
+    def update_link(self, link):
+        self.link_label.setText(
+            f"Reports {link['received']}, lost {link['lost']} ({link['loss'] * 100:.1f}%), "
+            f"latency {link['latency_ms']:.0f} ms (max {link['max_latency_ms']:.0f}), "
+            f"every {link['period_ms'] / 1000:.1f} s"
+            + (f" ({link['coalesced']} periods averaged, link saturated)" if link['coalesced'] > 1 else ""))
+
+    def update_baud(self, baud):
+        self.baudrate_combo.setCurrentText(str(baud))
+
+    @staticmethod
+    def message_name(msg_type):
+        if msg_type == WIRE_MSG_JSON:
+            return "json"
+        return MESSAGES.get(msg_type, {}).get("name", f"type {msg_type}")
+
+    def update_budget(self, budget):
+        metrics = sorted(budget["metrics"], key=lambda m: m["bytes_per_s"], reverse=True)
+        parts = [f"{self.message_name(m['type'])} {m['bytes_per_s'] / 1000:.1f} kB/s ({m['msgs_per_min']}/min)"
+                 for m in metrics]
+        if budget["capacity"]:
+            head = (f"{budget['baud']} baud: {budget['used'] / 1000:.1f} of {budget['capacity'] / 1000:.1f} kB/s "
+                    f"({budget['used'] * 100 / budget['capacity']:.0f}%)")
+        else:
+            head = f"{budget['used'] / 1000:.1f} kB/s"
+        self.budget_label.setText(head + (" - " + ", ".join(parts) if parts else ""))
+
     # ---------------- DATA HANDLING ----------------
     def update_data(self, data):
+        kind = message_kind(data)
+        # ---- Device info header ----
+        if kind == "device":
+            self.device_info = data["device"]
+            self.set_core_count(self.device_info.get("cores", 1))
+            return
+
+        # ---- Serial bandwidth budget (LINK replies only matter while negotiating) ----
+        if kind == "budget":
+            self.update_budget(data["budget"])
+            return
+        if kind == "link":
+            return
+
+        # ---- Answers to the queries tab ----
+        if kind in ("reply", "task_info", "heap"):
+            self.update_query(kind, data[kind])
+            return
+
+        # ---- One sampling period: memory and tasks of the same window ----
+        if kind == "report":
+            report = data["report"]
+            self.update_data({key: report[key] for key in ("heap_total", "heap_free", "internal_total", "internal_free")})
+            self.update_data({key: report[key] for key in ("cores", "isr_load", "tasks")})
+            return
+
         # ---- Memory data ----
-        if "heap_total" in data and "heap_free" in data:
+        if kind == "memory":
             heap_total = data.get("heap_total", 0)
             heap_free = data.get("heap_free", 0)
             internal_total = data.get("internal_total", 0)
@@ -222,10 +350,13 @@ class MainWindow(QMainWindow):
             return
 
         # ---- Task data ----
-        if "tasks" not in data:
+        if kind != "tasks":
             return
 
         self.latest_tasks = data["tasks"]
+        self.latest_core_load = data.get("cores", [])
+        if self.latest_core_load and "cores" not in self.device_info:
+            self.set_core_count(len(self.latest_core_load))
         self.apply_sorting()
 
 
@@ -243,17 +374,22 @@ class MainWindow(QMainWindow):
         else:
             tasks.sort(key=lambda t: t["percentage"], reverse=True)
 
-        # Compute total usage per core (only from tasks that have 'core')
-        core_usage = {0: 0.0, 1: 0.0}
-        for t in tasks:
-            core = t.get("core")
-            name = t.get("task_name", "").upper()
-            if core in core_usage and not name.startswith("IDLE"):
-                core_usage[core] += t.get("percentage", 0.0)
+        core_count = len(self.core_labels)
+
+        # Per-core load from the firmware, older firmware only has per-task percentages
+        if self.latest_core_load:
+            core_usage = {core: float(load) for core, load in enumerate(self.latest_core_load[:core_count])}
+        else:
+            core_usage = {core: 0.0 for core in range(core_count)}
+            for t in tasks:
+                core = t.get("core")
+                name = t.get("task_name", "").upper()
+                if core in core_usage and not name.startswith("IDLE"):
+                    core_usage[core] += t.get("percentage", 0.0)
 
         # Update the core usage labels
-        self.core0_label.setText(f"Core 0: {core_usage[0]:.1f}%")
-        self.core1_label.setText(f"Core 1: {core_usage[1]:.1f}%")
+        for core, label in enumerate(self.core_labels):
+            label.setText(f"Core {core}: {core_usage.get(core, 0.0):.1f}%")
 
         # Update table display
         self.table.setRowCount(len(tasks))
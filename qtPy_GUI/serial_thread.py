@@ -2,47 +2,285 @@
 # serial_thread.py
 import serial
 import json
+import time
+import queue
+import struct
+import binascii
 from qtpy.QtCore import QThread, Signal
+from telemetry_schema import (WIRE_VERSION, WIRE_MSG_JSON, WIRE_MSG_CBOR, WIRE_MSG_DELTA, WIRE_MSG_LZ,
+                              WIRE_MSG_CMD, WIRE_CMD_BAUD, WIRE_CMD_LINK_TEST, LINK_ACK, LINK_CONFIRMED,
+                              LINK_REFUSED, LINK_REVERTED, LINK_TEST_LEN,
+                              DeltaDecoder, LinkStats, decode_payload, lz_expand)
 
+try:
+    import cbor2        # only needed when the device sends CBOR (CPU_USAGE_FORMAT_CBOR)
+except ImportError:
+    cbor2 = None
+
+
+# ------------------ BINARY WIRE PROTOCOL (schema/telemetry.py) ------------------
+MAX_BUFFER = 65536      # drop garbage that never gets a delimiter
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            out.append(len(block) + 1)
+            out += block
+            block.clear()
+            continue
+        block.append(b)
+        if len(block) == 0xFE:
+            out.append(0xFF)
+            out += block
+            block.clear()
+    out.append(len(block) + 1)
+    out += block
+    return bytes(out)
+
+
+def command_frame(cmd, args=b"", request_id=0):
+    """CMD frame for the device's RX line, between two 0x00 so noise before it is dropped."""
+    body = bytes([WIRE_VERSION, WIRE_MSG_CMD, cmd, request_id]) + bytes(args)
+    return b"\0" + cobs_encode(body + struct.pack("<H", binascii.crc_hqx(body, 0xFFFF))) + b"\0"
+
+
+def link_pattern():
+    """Test pattern of WIRE_CMD_LINK_TEST, every byte value once."""
+    return bytes((i * 0x3B + 0x55) & 0xFF for i in range(LINK_TEST_LEN))
+
+
+def decode_frame(frame, delta=None):
+    """COBS frame (without the 0x00 delimiter) -> the same dict the JSON line would give, or None.
+
+    delta is the DeltaDecoder of the stream, DELTA frames are dropped without one.
+    """
+    raw = cobs_decode(frame)
+    if raw is None or len(raw) < 4:
+        return None
+
+    body, crc = raw[:-2], struct.unpack("<H", raw[-2:])[0]
+    if binascii.crc_hqx(body, 0xFFFF) != crc or body[0] != WIRE_VERSION:
+        return None
+
+    msg_type, p = body[1], body[2:]
+    try:
+        if msg_type == WIRE_MSG_LZ:
+            expanded = lz_expand(p)
+            if expanded is None:
+                return None
+            msg_type, p = expanded
+        if msg_type == WIRE_MSG_JSON:
+            return json.loads(p.decode("utf-8"))
+        if msg_type == WIRE_MSG_CBOR:
+            return cbor2.loads(p) if cbor2 is not None else None
+        if msg_type == WIRE_MSG_DELTA:
+            expanded = delta.apply(p) if delta is not None else None
+            if expanded is None:
+                return None
+            msg_type, p = expanded
+        elif delta is not None:
+            delta.full(msg_type, p)
+        return decode_payload(msg_type, p)
+    except (struct.error, IndexError, ValueError):
+        return None
+
+
+def parse_json_line(line):
+    line = line.strip()
+    if not line.startswith(b"{"):
+        return None
+    try:
+        return json.loads(line.decode("utf-8", errors="ignore"))
+    except json.JSONDecodeError:
+        return None
+
+
+class StreamDecoder:
+    """Splits a serial byte stream into messages, auto-detecting JSON lines and binary frames.
+
+    JSON lines end with '\\n', binary frames with 0x00. A frame may contain '\\n', so once
+    a valid frame was seen a line that is not JSON is kept until the next 0x00.
+    """
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.binary = False
+        self.delta = DeltaDecoder()
+
+    def feed(self, data):
+        self.buffer += data
+        messages = []
+
+        while True:
+            zero = self.buffer.find(b"\0")
+            newline = self.buffer.find(b"\n")
+
+            if newline >= 0 and (zero < 0 or newline < zero):
+                parsed = parse_json_line(bytes(self.buffer[:newline]))
+                if parsed is not None or not self.binary:
+                    del self.buffer[:newline + 1]
+                    if parsed is not None:
+                        messages.append(parsed)
+                    continue
+
+            if zero < 0:
+                break
+
+            segment = bytes(self.buffer[:zero])
+            del self.buffer[:zero + 1]
+
+            parsed = decode_frame(segment, self.delta)
+            if parsed is None and b"\n" in segment:
+                # Console text right before the frame
+                parsed = decode_frame(segment[segment.rfind(b"\n") + 1:], self.delta)
+            if parsed is not None:
+                self.binary = True
+                messages.append(parsed)
+
+        if len(self.buffer) > MAX_BUFFER:
+            self.buffer.clear()
+        return messages
+
+
+# ------------------ BAUD NEGOTIATION (MCUSilk/link.h) ------------------
+LINK_BAUDS = [2000000, 921600, 460800, 230400]     # tried from the requested rate down
+LINK_REPLY_TIMEOUT = 1.0        # seconds for ACK / CONFIRMED
+LINK_REVERT_TIMEOUT = 2.0       # the device gives up on a rate after one second
+
+
+def wait_link(ser, decoder, statuses, on_message, timeout=LINK_REPLY_TIMEOUT, running=lambda: True):
+    """First LINK reply with one of statuses, or None. Everything else goes to on_message."""
+    reply = None
+    deadline = time.monotonic() + timeout
+    while running() and reply is None and time.monotonic() < deadline:
+        data = ser.read(ser.in_waiting or 1)
+        for parsed in decoder.feed(data):
+            link = parsed.get("link")
+            if link is None:
+                on_message(parsed)
+            elif reply is None and link["status"] in statuses:
+                reply = link
+    return reply
+
+
+def negotiate_baud(ser, decoder, target, on_message, running=lambda: True):
+    """Move the link to the fastest of LINK_BAUDS up to target that the device, the
+    USB bridge and the cable all manage, and return the rate it ends up at.
+
+    The device ACKs at the old rate and switches. A rate is kept once the test pattern
+    comes back intact at it, otherwise both sides go back and the next lower one is tried.
+    A device that does not answer at all has no link control and is left where it is.
+    Messages that arrive meanwhile go to on_message.
+    """
+    timeout = ser.timeout
+    binary = decoder.binary
+    ser.timeout = 0.05
+    # The pattern echo has every byte value, '\n' included: hold lines until the
+    # delimiter even on a JSON link, which goes back to plain lines afterwards
+    decoder.binary = True
+    try:
+        for baud in [b for b in LINK_BAUDS if b <= target]:
+            if baud == ser.baudrate:
+                break
+            ser.write(command_frame(WIRE_CMD_BAUD, struct.pack("<I", baud)))
+            reply = wait_link(ser, decoder, (LINK_ACK, LINK_REFUSED), on_message, running=running)
+            if reply is None:
+                break
+            if reply["status"] == LINK_REFUSED:
+                continue
+
+            old = ser.baudrate
+            ser.baudrate = baud
+            ser.write(command_frame(WIRE_CMD_LINK_TEST, link_pattern()))
+            reply = wait_link(ser, decoder, (LINK_CONFIRMED,), on_message, running=running)
+            if reply is not None and bytes(reply.get("pattern", [])) == link_pattern():
+                break
+
+            ser.baudrate = old
+            wait_link(ser, decoder, (LINK_REVERTED,), on_message, LINK_REVERT_TIMEOUT, running)
+    finally:
+        ser.timeout = timeout
+        decoder.binary = binary
+    return ser.baudrate
+
+
+# ------------------ SERIAL READER THREAD ------------------
 class SerialReaderThread(QThread):
     data_received = Signal(dict)
     error_received = Signal(str)
     serial_error = Signal(str)
+    link_stats = Signal(dict)       # LinkStats.summary() after every period report
+    link_baud = Signal(int)         # rate the link ended up at after negotiating
+
+    def __init__(self, port, baudrate, negotiate=None):
+        """port: device name or pyserial URL (socket://host:port for a device behind a serial-to-TCP bridge).
 
-    def __init__(self, port, baudrate):
+        negotiate: highest rate to move the link to once it is open at baudrate.
+        """
         super().__init__()
         self.port = port
         self.baudrate = baudrate
+        self.negotiate = negotiate
         self.running = True
+        self.link = LinkStats()
+        self.requests = queue.Queue()       # CMD frames from the GUI thread
+        self.request_id = 0
 
     def run(self):
         try:
-            with serial.Serial(self.port, self.baudrate, timeout=2) as ser:
-                buffer = ""
+            with serial.serial_for_url(self.port, self.baudrate, timeout=2) as ser:
+                decoder = StreamDecoder()
+                if self.negotiate:
+                    self.link_baud.emit(negotiate_baud(ser, decoder, self.negotiate, self.dispatch,
+                                                       lambda: self.running))
                 while self.running:
+                    while not self.requests.empty():
+                        ser.write(self.requests.get_nowait())
                     if ser.in_waiting > 0:
-                        data = ser.read(ser.in_waiting).decode('utf-8', errors='ignore')
-                        buffer += data
-                        while '\n' in buffer:
-                            line, buffer = buffer.split('\n', 1)
-                            line = line.strip()
-                            if not line:
-                                continue
-                            try:
-                                parsed = json.loads(line)
-                                if "error" in parsed:
-                                    msg = parsed.get("error")
-                                    code = parsed.get("code")
-                                    if code:
-                                        self.error_received.emit(f"{msg} (code: {code})")
-                                    else:
-                                        self.error_received.emit(msg)
-                                else:
-                                    self.data_received.emit(parsed)
-                            except json.JSONDecodeError:
-                                continue
+                        for parsed in decoder.feed(ser.read(ser.in_waiting)):
+                            self.dispatch(parsed)
         except serial.SerialException as e:
             self.serial_error.emit(str(e))
 
+    def request(self, cmd, args=b""):
+        """Send a query (WIRE_CMD_SNAPSHOT and up) and return its request id.
+
+        The answer comes through data_received, ending with a "reply" that has the id.
+        """
+        self.request_id = self.request_id % 255 + 1
+        self.requests.put(command_frame(cmd, args, self.request_id))
+        return self.request_id
+
+    def dispatch(self, parsed):
+        if "report" in parsed:
+            self.link.update(parsed["report"], time.monotonic())
+            self.link_stats.emit(self.link.summary())
+        if "error" in parsed:
+            msg = parsed.get("error")
+            code = parsed.get("code")
+            if code:
+                self.error_received.emit(f"{msg} (code: {code})")
+            else:
+                self.error_received.emit(msg)
+        else:
+            self.data_received.emit(parsed)
+
     def stop(self):
         self.running = False
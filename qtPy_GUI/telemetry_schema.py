@@ -0,0 +1,525 @@
+# Generated by schema/generate.py from schema/telemetry.py, do not edit.
+"""Telemetry message tables and the binary decoder built on them."""
+import binascii
+import collections
+import struct
+
+
+WIRE_VERSION = 3
+NAME_LEN = 16
+HIST_BUCKETS = 16
+LZ_WINDOW_BITS = 8
+LZ_LOOKAHEAD_BITS = 4
+
+WIRE_MSG_DEVICE = 1
+WIRE_MSG_TASKS = 2
+WIRE_MSG_MEMORY = 3
+WIRE_MSG_ISR = 4
+WIRE_MSG_WAKEUP = 5
+WIRE_MSG_JSON = 6
+WIRE_MSG_CBOR = 7
+WIRE_MSG_DELTA = 8
+WIRE_MSG_LZ = 9
+WIRE_MSG_REPORT = 10
+WIRE_MSG_CMD = 11
+WIRE_MSG_LINK = 12
+WIRE_MSG_BUDGET = 13
+WIRE_MSG_REPLY = 14
+WIRE_MSG_TASK_INFO = 15
+WIRE_MSG_HEAP = 16
+WIRE_MSG_LOG_INFO = 17
+
+WIRE_TASK_CREATED = 0x01
+WIRE_TASK_DELETED = 0x02
+WIRE_TASK_ISR = 0x04
+
+FLAGS = {
+    'WIRE_TASK_CREATED': WIRE_TASK_CREATED,
+    'WIRE_TASK_DELETED': WIRE_TASK_DELETED,
+    'WIRE_TASK_ISR': WIRE_TASK_ISR,
+}
+
+WIRE_CMD_BAUD = 1
+WIRE_CMD_LINK_TEST = 2
+WIRE_CMD_SNAPSHOT = 3
+WIRE_CMD_TASK = 4
+WIRE_CMD_STACKS = 5
+WIRE_CMD_HEAP = 6
+WIRE_CMD_DUMP = 7
+LINK_ACK = 0
+LINK_CONFIRMED = 1
+LINK_REFUSED = 2
+LINK_REVERTED = 3
+LINK_TEST_LEN = 256
+QUERY_OK = 0
+QUERY_UNKNOWN = 1
+QUERY_NOT_FOUND = 2
+QUERY_NO_MEM = 3
+QUERY_BAD_ARGS = 4
+QUERY_FAILED = 5
+
+RECORDS = {
+    'task': [
+        ('task_name', 'name', {}),
+        ('run_time', 'u32', {}),
+        ('isr_time', 'u32', {}),
+        ('percentage', 'u8', {}),
+        ('core', 'i8', {}),
+        ('flags', 'u8', {'json': False}),
+    ],
+    'isr_entry': [
+        ('tag', 'u8', {}),
+        ('core', 'i8', {}),
+        ('name', 'name', {'optional': True}),
+        ('count', 'u32', {}),
+        ('dropped', 'u32', {}),
+        ('incl_min_ns', 'u32', {}),
+        ('incl_avg_ns', 'u32', {}),
+        ('incl_max_ns', 'u32', {}),
+        ('excl_min_ns', 'u32', {}),
+        ('excl_avg_ns', 'u32', {}),
+        ('excl_max_ns', 'u32', {}),
+        ('hist', 'u32', {'count': 16}),
+    ],
+    'budget_entry': [
+        ('type', 'u8', {}),
+        ('bytes_per_s', 'u32', {}),
+        ('msgs_per_min', 'u32', {}),
+    ],
+    'task_detail': [
+        ('task_name', 'name', {}),
+        ('number', 'u32', {}),
+        ('state', 'u8', {}),
+        ('priority', 'u8', {}),
+        ('base_priority', 'u8', {}),
+        ('core', 'i8', {}),
+        ('stack_free', 'u32', {}),
+        ('run_time', 'u32', {}),
+    ],
+    'heap_region': [
+        ('caps', 'u32', {}),
+        ('total', 'u32', {}),
+        ('free', 'u32', {}),
+        ('largest_free', 'u32', {}),
+        ('min_free', 'u32', {}),
+        ('allocated_blocks', 'u32', {}),
+        ('free_blocks', 'u32', {}),
+    ],
+    'wakeup_entry': [
+        ('channel', 'u8', {}),
+        ('count', 'u32', {}),
+        ('coalesced', 'u32', {}),
+        ('min_us', 'u32', {}),
+        ('avg_us', 'u32', {}),
+        ('max_us', 'u32', {}),
+        ('hist', 'u32', {'count': 16}),
+    ],
+}
+
+VARIANTS = {
+    'task': ('flags', [
+        ('WIRE_TASK_CREATED', ['task_name'], {'status': 'created'}),
+        ('WIRE_TASK_DELETED', ['task_name'], {'status': 'deleted'}),
+        ('WIRE_TASK_ISR', ['task_name', 'run_time', 'percentage', 'core'], {'isr': True}),
+        (None, ['task_name', 'run_time', 'isr_time', 'percentage', 'core'], {}),
+    ]),
+}
+
+MESSAGES = {
+    WIRE_MSG_DEVICE: {
+        'name': 'device',
+        'wrap': 'device',
+        'parts': [
+            ('field', 'cores', 'u8'),
+            ('field', 'cpu_hz', 'u32'),
+            ('field', 'tag', 'name'),
+        ],
+    },
+    WIRE_MSG_TASKS: {
+        'name': 'tasks',
+        'parts': [
+            ('count', 'core_count', 'u8'),
+            ('count', 'task_count', 'u8'),
+            ('array', 'cores', 'u8', 'core_count'),
+            ('array', 'isr_load', 'u8', 'core_count'),
+            ('list', 'tasks', 'task', 'task_count'),
+        ],
+    },
+    WIRE_MSG_MEMORY: {
+        'name': 'memory',
+        'parts': [
+            ('field', 'heap_total', 'u32'),
+            ('field', 'heap_free', 'u32'),
+            ('field', 'internal_total', 'u32'),
+            ('field', 'internal_free', 'u32'),
+        ],
+    },
+    WIRE_MSG_ISR: {
+        'name': 'isr',
+        'parts': [
+            ('field', 'uptime_us', 'u64'),
+            ('field', 'cpu_hz', 'u32'),
+            ('field', 'hist_shift', 'u8'),
+            ('field', 'freq_changes', 'u16'),
+            ('field', 'bad_tag', 'u16'),
+            ('count', 'count', 'u8'),
+            ('list', 'isr', 'isr_entry', 'count'),
+            ('const', 'hist_unit', 'ns'),
+        ],
+    },
+    WIRE_MSG_WAKEUP: {
+        'name': 'wakeup',
+        'parts': [
+            ('count', 'count', 'u8'),
+            ('list', 'wakeup', 'wakeup_entry', 'count'),
+        ],
+    },
+    WIRE_MSG_REPORT: {
+        'name': 'report',
+        'wrap': 'report',
+        'parts': [
+            ('field', 'seq', 'u32'),
+            ('field', 'uptime_us', 'u64'),
+            ('field', 'window_us', 'u32'),
+            ('field', 'period_ms', 'u32'),
+            ('field', 'coalesced', 'u8'),
+            ('count', 'core_count', 'u8'),
+            ('count', 'task_count', 'u8'),
+            ('array', 'cores', 'u8', 'core_count'),
+            ('array', 'isr_load', 'u8', 'core_count'),
+            ('list', 'tasks', 'task', 'task_count'),
+            ('field', 'heap_total', 'u32'),
+            ('field', 'heap_free', 'u32'),
+            ('field', 'internal_total', 'u32'),
+            ('field', 'internal_free', 'u32'),
+        ],
+    },
+    WIRE_MSG_LINK: {
+        'name': 'link',
+        'wrap': 'link',
+        'parts': [
+            ('field', 'baud', 'u32'),
+            ('field', 'status', 'u8'),
+            ('count', 'pattern_len', 'u16'),
+            ('array', 'pattern', 'u8', 'pattern_len'),
+        ],
+    },
+    WIRE_MSG_BUDGET: {
+        'name': 'budget',
+        'wrap': 'budget',
+        'parts': [
+            ('field', 'baud', 'u32'),
+            ('field', 'capacity', 'u32'),
+            ('field', 'used', 'u32'),
+            ('count', 'count', 'u8'),
+            ('list', 'metrics', 'budget_entry', 'count'),
+        ],
+    },
+    WIRE_MSG_REPLY: {
+        'name': 'reply',
+        'wrap': 'reply',
+        'parts': [
+            ('field', 'request', 'u8'),
+            ('field', 'cmd', 'u8'),
+            ('field', 'status', 'u8'),
+        ],
+    },
+    WIRE_MSG_TASK_INFO: {
+        'name': 'task_info',
+        'wrap': 'task_info',
+        'parts': [
+            ('field', 'request', 'u8'),
+            ('count', 'count', 'u8'),
+            ('list', 'tasks', 'task_detail', 'count'),
+        ],
+    },
+    WIRE_MSG_HEAP: {
+        'name': 'heap',
+        'wrap': 'heap',
+        'parts': [
+            ('field', 'request', 'u8'),
+            ('count', 'count', 'u8'),
+            ('list', 'regions', 'heap_region', 'count'),
+        ],
+    },
+    WIRE_MSG_LOG_INFO: {
+        'name': 'log_info',
+        'wrap': 'log_info',
+        'parts': [
+            ('field', 'request', 'u8'),
+            ('field', 'records', 'u32'),
+            ('field', 'bytes', 'u32'),
+            ('field', 'capacity', 'u32'),
+            ('field', 'sectors', 'u16'),
+            ('field', 'sector_size', 'u32'),
+        ],
+    },
+}
+
+# (key, message) pairs, the first key found in a dict names the message
+KINDS = [
+    ('device', 'device'),
+    ('tasks', 'tasks'),
+    ('heap_total', 'memory'),
+    ('isr', 'isr'),
+    ('wakeup', 'wakeup'),
+    ('report', 'report'),
+    ('link', 'link'),
+    ('budget', 'budget'),
+    ('reply', 'reply'),
+    ('task_info', 'task_info'),
+    ('heap', 'heap'),
+    ('log_info', 'log_info'),
+    ('trigger', 'trigger'),
+    ('error', 'error'),
+]
+
+
+_FORMAT = {"u8": "B", "i8": "b", "u16": "H", "u32": "I", "u64": "Q"}
+
+
+def message_kind(data):
+    """Name of the message a JSON / decoded dict is, or None."""
+    for key, kind in KINDS:
+        if key in data:
+            return kind
+    return None
+
+
+class _Reader:
+    def __init__(self, payload):
+        self.payload = payload
+        self.offset = 0
+
+    def read(self, ftype, count=None):
+        if ftype == "name":
+            raw = self.payload[self.offset:self.offset + NAME_LEN]
+            if len(raw) < NAME_LEN:
+                raise IndexError("short payload")
+            self.offset += NAME_LEN
+            return raw.split(b"\0", 1)[0].decode("utf-8", errors="replace")
+        fmt = "<" + str(1 if count is None else count) + _FORMAT[ftype]
+        values = struct.unpack_from(fmt, self.payload, self.offset)
+        self.offset += struct.calcsize(fmt)
+        return list(values) if count is not None else values[0]
+
+
+def _record(reader, name):
+    raw = {}
+    for key, ftype, options in RECORDS[name]:
+        raw[key] = reader.read(ftype, options.get("count"))
+
+    fields = [key for key, _, options in RECORDS[name] if options.get("json", True)]
+    consts = {}
+    if name in VARIANTS:
+        flag_field, cases = VARIANTS[name]
+        for flag, keys, case_consts in cases:
+            if flag is None or raw[flag_field] & FLAGS[flag]:
+                fields, consts = keys, case_consts
+                break
+
+    entry = {}
+    for key, ftype, options in RECORDS[name]:
+        if key in fields and not (options.get("optional") and not raw[key]):
+            entry[key] = raw[key]
+    entry.update(consts)
+    return entry
+
+
+def decode_payload(msg_type, payload):
+    """Binary payload -> the same dict the JSON message would give, None for other types.
+
+    Raises struct.error / IndexError on a short payload.
+    """
+    msg = MESSAGES.get(msg_type)
+    if msg is None:
+        return None
+
+    reader = _Reader(payload)
+    counts = {}
+    data = {}
+    for part in msg["parts"]:
+        kind = part[0]
+        if kind == "field":
+            data[part[1]] = reader.read(part[2])
+        elif kind == "count":
+            counts[part[1]] = reader.read(part[2])
+        elif kind == "array":
+            data[part[1]] = reader.read(part[2], counts[part[3]])
+        elif kind == "list":
+            data[part[1]] = [_record(reader, part[2]) for _ in range(counts[part[3]])]
+        elif kind == "const":
+            data[part[1]] = part[2]
+
+    if "wrap" in msg:
+        return {msg["wrap"]: data}
+    return data
+
+
+def _integer_fields(msg_type, payload):
+    """(offset, size) of every integer field of a binary payload, in wire order."""
+    fields = []
+    counts = {}
+    offset = 0
+
+    def take(ftype, n=1):
+        nonlocal offset
+        size = NAME_LEN if ftype == "name" else struct.calcsize(_FORMAT[ftype])
+        for _ in range(n):
+            if offset + size > len(payload):
+                raise IndexError("short payload")
+            if ftype != "name":
+                # u64 as two u32 halves, the delta encoder works on 32 bits
+                fields.extend((offset + half, min(size, 4)) for half in range(0, size, 4))
+            offset += size
+
+    for part in MESSAGES[msg_type]["parts"]:
+        kind = part[0]
+        if kind == "field":
+            take(part[2])
+        elif kind == "count":
+            take(part[2])
+            counts[part[1]] = int.from_bytes(payload[fields[-1][0]:offset], "little")
+        elif kind == "array":
+            take(part[2], counts[part[3]])
+        elif kind == "list":
+            for _ in range(counts[part[3]]):
+                for _, ftype, options in RECORDS[part[2]]:
+                    take(ftype, options.get("count", 1))
+    return fields
+
+
+def _varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+class DeltaDecoder:
+    """Rebuilds DELTA frames (MCUSilk/delta.h) from the last payload of the same type.
+
+    A delta names the integers it applies to by their CRC, so after a lost frame the
+    following deltas are skipped (counted in lost) until the next full frame.
+    """
+
+    def __init__(self):
+        self.base = {}
+        self.lost = 0
+
+    def full(self, msg_type, payload):
+        """Remember a full payload as the base of the next delta."""
+        if msg_type in MESSAGES:
+            self.base[msg_type] = bytes(payload)
+
+    def apply(self, payload):
+        """DELTA payload -> (msg_type, payload), None if it does not fit the base."""
+        msg_type, ref = struct.unpack_from("<BH", payload, 0)
+        base = self.base.get(msg_type)
+        if base is None:
+            self.lost += 1
+            return None
+
+        fields = _integer_fields(msg_type, base)
+        values = [int.from_bytes(base[o:o + n], "little") for o, n in fields]
+        if binascii.crc_hqx(struct.pack(f"<{len(values)}I", *values), 0xFFFF) != ref:
+            self.lost += 1
+            return None
+
+        out = bytearray(base)
+        pos = 3
+        for (o, n), value in zip(fields, values):
+            z, pos = _varint(payload, pos)
+            value = (value + ((z >> 1) ^ -(z & 1))) & 0xFFFFFFFF
+            out[o:o + n] = value.to_bytes(4, "little")[:n]
+        if pos != len(payload):
+            self.lost += 1
+            return None
+
+        self.base[msg_type] = bytes(out)
+        return msg_type, self.base[msg_type]
+
+
+def lz_expand(payload):
+    """LZ payload (MCUSilk/lz.h) -> (msg_type, payload) of the frame it replaces, None if corrupt."""
+    msg_type, size = struct.unpack_from("<BH", payload, 0)
+    bits = int.from_bytes(payload[3:], "big")
+    left = 8 * (len(payload) - 3)
+    out = bytearray()
+
+    def take(n):
+        nonlocal left
+        left -= n
+        return (bits >> left) & ((1 << n) - 1)
+
+    while left >= 9 and len(out) < size:
+        if take(1):
+            out.append(take(8))
+        elif left >= LZ_WINDOW_BITS + LZ_LOOKAHEAD_BITS:
+            distance = take(LZ_WINDOW_BITS) + 1
+            length = take(LZ_LOOKAHEAD_BITS) + 1
+            if distance > len(out):
+                return None
+            for _ in range(length):
+                out.append(out[-distance])
+        else:
+            break
+    return (msg_type, bytes(out)) if len(out) == size else None
+
+
+class LinkStats:
+    """Loss and latency of the period reports, from their seq and uptime_us.
+
+    Host and device clocks have an unknown offset, so latency is the delay of a report
+    over the fastest of the last LATENCY_WINDOW ones: the part added by queueing and
+    a busy link. period_ms is the reporting period the device is at, longer than the
+    configured one while it coalesces for a saturated link.
+    """
+
+    LATENCY_WINDOW = 64
+
+    def __init__(self):
+        self.received = 0
+        self.lost = 0
+        self.restarts = 0
+        self.latency_ms = 0.0
+        self.max_latency_ms = 0.0
+        self.period_ms = 0
+        self.coalesced = 1
+        self._seq = None
+        self._uptime = None
+        self._offsets = collections.deque(maxlen=self.LATENCY_WINDOW)
+
+    def update(self, report, now):
+        """report: the dict under "report", now: host time in seconds (time.monotonic())."""
+        seq, uptime = report["seq"], report["uptime_us"]
+        if self._seq is not None and (seq <= self._seq or uptime < self._uptime):
+            self.restarts += 1          # the device restarted, seq starts over
+            self._offsets.clear()
+        elif self._seq is not None:
+            self.lost += seq - self._seq - 1
+        self._seq, self._uptime = seq, uptime
+        self.received += 1
+        self.period_ms = report.get("period_ms", 0)
+        self.coalesced = report.get("coalesced", 1)
+
+        self._offsets.append(now - uptime / 1e6)
+        self.latency_ms = (self._offsets[-1] - min(self._offsets)) * 1000
+        self.max_latency_ms = max(self.max_latency_ms, self.latency_ms)
+
+    @property
+    def loss(self):
+        """Lost share of the reports, 0..1"""
+        total = self.received + self.lost
+        return self.lost / total if total else 0.0
+
+    def summary(self):
+        """The counters as a plain dict (e.g. for a Qt signal)."""
+        return {"received": self.received, "lost": self.lost, "loss": self.loss, "restarts": self.restarts,
+                "latency_ms": self.latency_ms, "max_latency_ms": self.max_latency_ms,
+                "period_ms": self.period_ms, "coalesced": self.coalesced}
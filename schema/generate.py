@@ -0,0 +1,1530 @@
+#!/usr/bin/env python3
+"""Generate the telemetry encoders and decoders from schema/telemetry.py.
+
+    python schema/generate.py           rewrite the generated files
+    python schema/generate.py --check   exit 1 if any of them is out of date
+"""
+import os
+import sys
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import telemetry as schema  # noqa: E402
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BANNER = "Generated by schema/generate.py from schema/telemetry.py, do not edit."
+
+WIRE_SIZE = {"u8": 1, "i8": 1, "u16": 2, "u32": 4, "u64": 8, "name": schema.NAME_LEN}
+WIRE_MAX = {"u8": "UINT8_MAX", "u16": "UINT16_MAX"}
+
+
+# ------------------ SCHEMA HELPERS ------------------
+def opts(item, index):
+    return item[index] if len(item) > index else {}
+
+
+def record_fields(name):
+    """(key, type, options) of a record, in binary order."""
+    return [(f[0], f[1], opts(f, 2)) for f in schema.RECORDS[name]]
+
+
+def field_size(ftype, options):
+    return WIRE_SIZE[ftype] * options.get("count", 1)
+
+
+def record_size(name):
+    return sum(field_size(t, o) for _, t, o in record_fields(name))
+
+
+def json_fields(name):
+    return [f for f in record_fields(name) if f[2].get("json", True)]
+
+
+def variants(name):
+    """[(flag or None, [fields], {const}), ...] for a record, one default entry if it has no variants."""
+    if name in schema.VARIANTS:
+        _, cases = schema.VARIANTS[name]
+        by_key = {f[0]: f for f in record_fields(name)}
+        return [(flag, [by_key[k] for k in keys], consts) for flag, keys, consts in cases]
+    return [(None, json_fields(name), {})]
+
+
+def message_fixed_size(msg):
+    size = 0
+    for part in msg["parts"]:
+        if part[0] in ("field", "count"):
+            size += field_size(part[2], opts(part, 3))
+    return size
+
+
+def json_parts(msg):
+    return [p for p in msg["parts"] if p[0] != "count"]
+
+
+def all_keys():
+    keys = []
+
+    def add(k):
+        if k not in keys:
+            keys.append(k)
+
+    for msg in schema.MESSAGES:
+        if "wrap" in msg:
+            add(msg["wrap"])
+        for part in json_parts(msg):
+            add(part[1])
+    for name in schema.RECORDS:
+        for key, _, _ in json_fields(name):
+            add(key)
+        for _, _, consts in variants(name):
+            for key in consts:
+                add(key)
+    for key in schema.JSON_ONLY:
+        add(key)
+    return keys
+
+
+def kinds():
+    return [(m["key"], m["name"]) for m in schema.MESSAGES] + [(k, k) for k in schema.JSON_ONLY]
+
+
+def wire_types():
+    """(name, type) of every frame type, by value"""
+    types = [(m["name"], m["type"]) for m in schema.MESSAGES]
+    types += [(name, value) for name, (value, _) in schema.RAW_MESSAGES.items()]
+    return sorted(types, key=lambda t: t[1])
+
+
+def upper(name):
+    return name.upper()
+
+
+def camel(name):
+    return "".join(p.capitalize() for p in name.split("_"))
+
+
+def c_key(key):
+    return "TLM_KEY_" + upper(key)
+
+
+def c_str(value):
+    return '"' + value.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+# ------------------ C: telemetry_defs.h ------------------
+def layout_comment():
+    lines = []
+
+    def describe(ftype, key, options):
+        count = options.get("count")
+        if ftype == "name":
+            return f"char {key}[{schema.NAME_LEN}]"
+        return f"{ftype} {key}[{count}]" if count else f"{ftype} {key}"
+
+    for msg in schema.MESSAGES:
+        items = []
+        for part in msg["parts"]:
+            if part[0] in ("field", "count"):
+                items.append(describe(part[2], part[1], opts(part, 3)))
+            elif part[0] == "array":
+                items.append(f"{part[2]} {part[1]}[{part[3]}]")
+            elif part[0] == "list":
+                rec = ", ".join(describe(t, k, o) for k, t, o in record_fields(part[2]))
+                items.append(f"\n//            {part[3]} x {{ {rec} }}")
+        lines.append((f"//  {upper(msg['name']):<8}: " + ", ".join(items)).replace(", \n", ",\n").replace(": \n//            ", ": "))
+    for name, (_, description) in schema.RAW_MESSAGES.items():
+        lines.append(f"//  {upper(name):<8}: " + description.replace("\n", "\n//            "))
+    return "\n".join(lines)
+
+
+def gen_c_defs():
+    out = [f"// {BANNER}", "#pragma once", "", "#include <inttypes.h>", "", ""]
+    out += [
+        "// --------------------------------------------------------------------",
+        "// Binary layouts (payload of a wire frame, see wire.h)",
+        "// --------------------------------------------------------------------",
+        "//",
+        layout_comment(),
+        "//",
+        f"#define WIRE_VERSION            {schema.VERSION}",
+        f"#define WIRE_NAME_LEN           {schema.NAME_LEN}",
+        f"#define TLM_HIST_BUCKETS        {schema.HIST_BUCKETS}",
+        f"#define WIRE_LZ_WINDOW_BITS     {schema.LZ_WINDOW_BITS}",
+        f"#define WIRE_LZ_LOOKAHEAD_BITS  {schema.LZ_LOOKAHEAD_BITS}",
+        "",
+    ]
+    for flag, value in schema.FLAGS.items():
+        out.append(f"#define {flag:<23} 0x{value:02X}")
+    out.append("")
+    for name, value in schema.CONSTANTS.items():
+        out.append(f"#define {name:<23} {value}")
+    out += ["", "typedef enum {"]
+    for name, value in wire_types():
+        out.append(f"    WIRE_MSG_{upper(name):<6} = {value},")
+    out += ["} wire_msg_type_t;", "", ""]
+
+    out += [
+        "// --------------------------------------------------------------------",
+        "// JSON / CBOR keys",
+        "// --------------------------------------------------------------------",
+    ]
+    for key in all_keys():
+        out.append(f"#define {c_key(key):<31} {c_str(key)}")
+    out += ["", ""]
+
+    out += [
+        "// --------------------------------------------------------------------",
+        "// Binary sizes: fixed part of each message, one list entry",
+        "// --------------------------------------------------------------------",
+    ]
+    for msg in schema.MESSAGES:
+        out.append(f"#define TLM_WIRE_{upper(msg['name'])}_SIZE{'':<{14 - len(msg['name'])}} {message_fixed_size(msg)}")
+    for name in schema.RECORDS:
+        out.append(f"#define TLM_WIRE_{upper(name)}_SIZE{'':<{14 - len(name)}} {record_size(name)}")
+    out += ["", ""]
+
+    out += [
+        "// --------------------------------------------------------------------",
+        "// printf formats of the flat JSON messages and entries, for targets",
+        "// without telemetry.c. Arguments in schema order: integers as",
+        "// uint32_t / int32_t, names as char * (not escaped).",
+        "// --------------------------------------------------------------------",
+    ]
+
+    def fmt_items(fields, consts):
+        items = []
+        for key, ftype, _ in fields:
+            if ftype == "name":
+                value = '\\"%s\\"'
+            elif ftype == "i8":
+                value = '%" PRId32 "'
+            elif ftype == "u64":
+                value = '%" PRIu64 "'
+            else:
+                value = '%" PRIu32 "'
+            items.append(f'\\"{key}\\": {value}')
+        for key, value in consts.items():
+            if value is True:
+                items.append(f'\\"{key}\\": true')
+            else:
+                items.append(f'\\"{key}\\": \\"{value}\\"')
+        return "{" + ", ".join(items) + "}"
+
+    for msg in schema.MESSAGES:
+        if any(p[0] != "field" for p in msg["parts"]):
+            continue
+        fields = [(p[1], p[2], opts(p, 3)) for p in msg["parts"]]
+        body = fmt_items(fields, {})
+        if "wrap" in msg:
+            body = '{\\"' + msg["wrap"] + '\\": ' + body + "}"
+        out.append(f'#define TLM_JSON_{upper(msg["name"])}_FMT "{body}"')
+    for name in schema.RECORDS:
+        if any(o.get("count") for _, _, o in record_fields(name)):
+            continue
+        for flag, fields, consts in variants(name):
+            suffix = "" if flag is None else "_" + flag.split("_")[-1]
+            out.append(f'#define TLM_JSON_{upper(name)}{suffix}_FMT "{fmt_items(fields, consts)}"')
+    out.append("")
+    return "\n".join(out)
+
+
+# ------------------ C: telemetry.h ------------------
+def c_type(ftype, options):
+    if ftype == "name":
+        return "const char *"
+    if options.get("count"):
+        return "const uint32_t *"
+    if ftype == "u64":
+        return "uint64_t "
+    return "int32_t " if ftype == "i8" else "uint32_t "
+
+
+def gen_c_header():
+    out = [f"// {BANNER}", "#pragma once", "",
+           "#include <stdint.h>", "#include <stdbool.h>",
+           '#include "telemetry_defs.h"', '#include "wire.h"', '#include "stream.h"', '#include "cbor.h"',
+           "", ""]
+
+    out += [
+        "// --------------------------------------------------------------------",
+        "// List entries. Integers are 32 bits here, the binary encoder saturates",
+        "// them to the wire type. Names may be NULL.",
+        "// --------------------------------------------------------------------",
+    ]
+    for name in schema.RECORDS:
+        out.append("typedef struct {")
+        for key, ftype, options in record_fields(name):
+            decl = f"{c_type(ftype, options)}{key};"
+            if options.get("count"):
+                decl = f"{decl:<28}// {options['count']} values"
+            elif not options.get("json", True):
+                decl = f"{decl:<28}// selects the JSON variant"
+            out.append(f"    {decl}")
+        out.append(f"}} tlm_{name}_t;")
+        out.append("")
+    out.append("")
+
+    out += [
+        "// --------------------------------------------------------------------",
+        "// Messages. Lists are read through a getter, called with the index of",
+        "// the entry (0 .. count-1) once per encoding pass, so the caller does not",
+        "// need to build an array of entries.",
+        "// --------------------------------------------------------------------",
+    ]
+    getters = set()
+    for msg in schema.MESSAGES:
+        lists = [p for p in msg["parts"] if p[0] == "list"]
+        for part in lists:
+            if part[2] not in getters:
+                out.append(f"typedef void (*tlm_get_{part[2]}_fn)(const void *ctx, uint32_t index, tlm_{part[2]}_t *out);")
+                getters.add(part[2])
+        out.append("typedef struct {")
+        for part in msg["parts"]:
+            kind = part[0]
+            if kind in ("field", "count"):
+                out.append(f"    {c_type(part[2], opts(part, 3))}{part[1]};")
+            elif kind == "array":
+                decl = f"const uint32_t *{part[1]};"
+                out.append(f"    {decl:<28}// {part[3]} values")
+            elif kind == "list":
+                out.append(f"    tlm_get_{part[2]}_fn get_{part[1]};")
+        if lists:
+            out.append(f"    {'const void *ctx;':<28}// passed to the getters")
+        out.append(f"}} tlm_{msg['name']}_t;")
+        out.append("")
+    out.append("")
+
+    out += [
+        "// --------------------------------------------------------------------",
+        "// One codec per message, msg points to its tlm_<name>_t",
+        "// --------------------------------------------------------------------",
+        "typedef struct {",
+        "    wire_msg_type_t type;",
+        "    char *(*wire)(const void *msg);                        // COBS frame, NULL on no memory",
+        "    void (*payload)(wire_writer_t *w, const void *msg);    // binary payload only (delta.h)",
+        "    void (*json)(stream_writer_t *s, const void *msg);     // a stream_emit_fn",
+        "    void (*cbor)(cbor_writer_t *w, const void *msg);",
+        "} tlm_codec_t;",
+        "",
+    ]
+    for msg in schema.MESSAGES:
+        out.append(f"extern const tlm_codec_t tlm_{msg['name']}_codec;")
+    out.append("")
+    return "\n".join(out)
+
+
+# ------------------ C: telemetry.c ------------------
+C_HELPERS = r'''
+// --------------------------------------------------------------------
+// Shared helpers
+// --------------------------------------------------------------------
+static uint32_t tlm_sat(uint32_t v, uint32_t max)
+{
+    return v > max ? max : v;
+}
+
+static void tlm_wire_array(wire_writer_t *w, const uint32_t *v, uint32_t n, size_t size)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t x = v ? v[i] : 0;
+        if (size == 1) {
+            wire_put_u8(w, (uint8_t)tlm_sat(x, UINT8_MAX));
+        } else if (size == 2) {
+            wire_put_u16(w, (uint16_t)tlm_sat(x, UINT16_MAX));
+        } else {
+            wire_put_u32(w, x);
+        }
+    }
+}
+
+static void tlm_json_key(stream_writer_t *s, bool *first, const char *key)
+{
+    stream_puts(s, *first ? "\"" : ", \"");
+    stream_puts(s, key);
+    stream_puts(s, "\": ");
+    *first = false;
+}
+
+static void tlm_json_array(stream_writer_t *s, const uint32_t *v, uint32_t n)
+{
+    stream_puts(s, "[");
+    for (uint32_t i = 0; i < n; i++) {
+        stream_printf(s, "%s%" PRIu32, i ? ", " : "", v ? v[i] : 0);
+    }
+    stream_puts(s, "]");
+}
+
+static void tlm_cbor_array(cbor_writer_t *w, const uint32_t *v, uint32_t n)
+{
+    cbor_put_array(w, n);
+    for (uint32_t i = 0; i < n; i++) {
+        cbor_put_uint(w, v ? v[i] : 0);
+    }
+}
+
+static bool tlm_has_name(const char *name)
+{
+    return name && name[0];
+}
+'''
+
+
+def c_wire_put(ftype, options, expr):
+    if options.get("count"):
+        return f"tlm_wire_array(w, {expr}, {options['count']}, {WIRE_SIZE[ftype]});"
+    if ftype == "name":
+        return f"wire_put_name(w, {expr});"
+    if ftype == "i8":
+        return f"wire_put_u8(w, (uint8_t)(int8_t){expr});"
+    if ftype in ("u32", "u64"):
+        return f"wire_put_{ftype}(w, {expr});"
+    bits = WIRE_SIZE[ftype] * 8
+    return f"wire_put_u{bits}(w, (uint{bits}_t)tlm_sat({expr}, {WIRE_MAX[ftype]}));"
+
+
+def c_json_value(ftype, options, expr):
+    if options.get("count"):
+        return f"tlm_json_array(s, {expr}, {options['count']});"
+    if ftype == "name" and options.get("optional"):
+        return f"stream_put_json_str(s, {expr});"
+    if ftype == "name":
+        return f'stream_put_json_str(s, {expr} ? {expr} : "");'
+    if ftype == "i8":
+        return f'stream_printf(s, "%" PRId32, {expr});'
+    if ftype == "u64":
+        return f'stream_printf(s, "%" PRIu64, {expr});'
+    return f'stream_printf(s, "%" PRIu32, {expr});'
+
+
+def c_json_const(value):
+    if value is True:
+        return 'stream_puts(s, "true");'
+    return f"stream_put_json_str(s, {c_str(value)});"
+
+
+def c_cbor_value(ftype, options, expr):
+    if options.get("count"):
+        return f"tlm_cbor_array(w, {expr}, {options['count']});"
+    if ftype == "name" and options.get("optional"):
+        return f"cbor_put_text(w, {expr});"
+    if ftype == "name":
+        return f'cbor_put_text(w, {expr} ? {expr} : "");'
+    if ftype == "i8":
+        return f"cbor_put_int(w, {expr});"
+    return f"cbor_put_uint(w, {expr});"
+
+
+def c_cbor_const(value):
+    if value is True:
+        return "cbor_put_bool(w, true);"
+    return f"cbor_put_text(w, {c_str(value)});"
+
+
+def c_record_functions(name):
+    out = []
+    t = f"tlm_{name}_t"
+
+    out.append(f"static void tlm_wire_put_{name}(wire_writer_t *w, const {t} *r)")
+    out.append("{")
+    for key, ftype, options in record_fields(name):
+        out.append("    " + c_wire_put(ftype, options, f"r->{key}"))
+    out += ["}", ""]
+
+    def variant_blocks(emit_body):
+        cases = variants(name)
+        lines = []
+        if len(cases) == 1:
+            return emit_body(*cases[0][1:], "    ")
+        for i, (flag, fields, consts) in enumerate(cases):
+            if flag is None:
+                lines.append("    else {" if i else "    {")
+            else:
+                flag_field = schema.VARIANTS[name][0]
+                lines.append(f"    {'else ' if i else ''}if (r->{flag_field} & {flag}) {{")
+            lines += emit_body(fields, consts, "        ")
+            lines.append("    }")
+        return lines
+
+    def json_body(fields, consts, ind):
+        lines = []
+        for key, ftype, options in fields:
+            if options.get("optional"):
+                lines.append(f"{ind}if (tlm_has_name(r->{key})) {{")
+                lines.append(f"{ind}    tlm_json_key(s, &first, {c_key(key)});")
+                lines.append(f"{ind}    {c_json_value(ftype, options, f'r->{key}')}")
+                lines.append(f"{ind}}}")
+                continue
+            lines.append(f"{ind}tlm_json_key(s, &first, {c_key(key)});")
+            lines.append(f"{ind}{c_json_value(ftype, options, f'r->{key}')}")
+        for key, value in consts.items():
+            lines.append(f"{ind}tlm_json_key(s, &first, {c_key(key)});")
+            lines.append(f"{ind}{c_json_const(value)}")
+        return lines
+
+    out.append(f"static void tlm_json_put_{name}(stream_writer_t *s, const {t} *r)")
+    out.append("{")
+    out.append("    bool first = true;")
+    out.append("")
+    out.append('    stream_puts(s, "{");')
+    out += variant_blocks(json_body)
+    out.append('    stream_puts(s, "}");')
+    out += ["}", ""]
+
+    def cbor_body(fields, consts, ind):
+        count = len(fields) + len(consts)
+        optional = [k for k, _, o in fields if o.get("optional")]
+        expr = str(count - len(optional)) + "".join(f" + tlm_has_name(r->{k})" for k in optional)
+        lines = [f"{ind}cbor_put_map(w, {expr});"]
+        for key, ftype, options in fields:
+            value = c_cbor_value(ftype, options, f"r->{key}")
+            if options.get("optional"):
+                lines.append(f"{ind}if (tlm_has_name(r->{key})) {{")
+                lines.append(f"{ind}    cbor_put_text(w, {c_key(key)});")
+                lines.append(f"{ind}    {value}")
+                lines.append(f"{ind}}}")
+                continue
+            lines.append(f"{ind}cbor_put_text(w, {c_key(key)});")
+            lines.append(f"{ind}{value}")
+        for key, value in consts.items():
+            lines.append(f"{ind}cbor_put_text(w, {c_key(key)});")
+            lines.append(f"{ind}{c_cbor_const(value)}")
+        return lines
+
+    out.append(f"static void tlm_cbor_put_{name}(cbor_writer_t *w, const {t} *r)")
+    out.append("{")
+    out += variant_blocks(cbor_body)
+    out += ["}", ""]
+    return out
+
+
+def c_message_functions(msg):
+    name = msg["name"]
+    t = f"tlm_{name}_t"
+    counts = {p[1]: p[2] for p in msg["parts"] if p[0] == "count"}
+    out = []
+
+    # Binary
+    def count_decls():
+        return [f"    uint32_t {cname} = tlm_sat(m->{cname}, {WIRE_MAX.get(ctype, 'UINT32_MAX')});"
+                for cname, ctype in counts.items()]
+
+    out.append(f"static void tlm_wire_payload_{name}(wire_writer_t *w, const void *msg)")
+    out.append("{")
+    out.append(f"    const {t} *m = msg;")
+    out += count_decls()
+    out.append("")
+    for part in msg["parts"]:
+        kind = part[0]
+        if kind == "field":
+            out.append("    " + c_wire_put(part[2], opts(part, 3), f"m->{part[1]}"))
+        elif kind == "count":
+            bits = WIRE_SIZE[part[2]] * 8
+            out.append(f"    wire_put_u{bits}(w, (uint{bits}_t){part[1]});")
+        elif kind == "array":
+            out.append(f"    tlm_wire_array(w, m->{part[1]}, {part[3]}, {WIRE_SIZE[part[2]]});")
+        elif kind == "list":
+            out.append(f"    for (uint32_t i = 0; i < {part[3]}; i++) {{")
+            out.append(f"        tlm_{part[2]}_t r = {{0}};")
+            out.append(f"        m->get_{part[1]}(m->ctx, i, &r);")
+            out.append(f"        tlm_wire_put_{part[2]}(w, &r);")
+            out.append("    }")
+    out += ["}", ""]
+
+    size = [f"TLM_WIRE_{upper(name)}_SIZE"]
+    for part in msg["parts"]:
+        if part[0] == "array":
+            size.append(f"{part[3]} * {WIRE_SIZE[part[2]]}")
+        elif part[0] == "list":
+            size.append(f"{part[3]} * TLM_WIRE_{upper(part[2])}_SIZE")
+    out.append(f"static char *tlm_wire_{name}(const void *msg)")
+    out.append("{")
+    if counts:
+        out.append(f"    const {t} *m = msg;")
+    out.append("    wire_writer_t w;")
+    out += count_decls()
+    out.append("")
+    out.append(f"    if (!wire_begin(&w, {' + '.join(size)}, WIRE_MSG_{upper(name)})) {{")
+    out.append("        return NULL;")
+    out.append("    }")
+    out.append(f"    tlm_wire_payload_{name}(&w, msg);")
+    out.append("    return wire_finish(&w);")
+    out += ["}", ""]
+
+    # JSON
+    out.append(f"static void tlm_json_{name}(stream_writer_t *s, const void *msg)")
+    out.append("{")
+    out.append(f"    const {t} *m = msg;")
+    out.append("    bool first = true;")
+    out.append("")
+    if "wrap" in msg:
+        out.append(f'    stream_puts(s, "{{ \\"" {c_key(msg["wrap"])} "\\": {{ ");')
+    else:
+        out.append('    stream_puts(s, "{ ");')
+    for part in json_parts(msg):
+        kind, key = part[0], part[1]
+        out.append(f"    tlm_json_key(s, &first, {c_key(key)});")
+        if kind == "field":
+            out.append("    " + c_json_value(part[2], opts(part, 3), f"m->{key}"))
+        elif kind == "array":
+            out.append(f"    tlm_json_array(s, m->{key}, m->{part[3]});")
+        elif kind == "const":
+            out.append("    " + c_json_const(part[2]))
+        elif kind == "list":
+            out.append('    stream_puts(s, "[ ");')
+            out.append(f"    for (uint32_t i = 0; i < m->{part[3]}; i++) {{")
+            out.append(f"        tlm_{part[2]}_t r = {{0}};")
+            out.append(f"        m->get_{key}(m->ctx, i, &r);")
+            out.append('        if (i) stream_puts(s, ", ");')
+            out.append(f"        tlm_json_put_{part[2]}(s, &r);")
+            out.append("    }")
+            out.append('    stream_puts(s, " ]");')
+    out.append('    stream_puts(s, "{}");'.format(" } }" if "wrap" in msg else " }"))
+    out += ["}", ""]
+
+    # CBOR
+    out.append(f"static void tlm_cbor_{name}(cbor_writer_t *w, const void *msg)")
+    out.append("{")
+    out.append(f"    const {t} *m = msg;")
+    out.append("")
+    if "wrap" in msg:
+        out.append("    cbor_put_map(w, 1);")
+        out.append(f"    cbor_put_text(w, {c_key(msg['wrap'])});")
+    out.append(f"    cbor_put_map(w, {len(json_parts(msg))});")
+    for part in json_parts(msg):
+        kind, key = part[0], part[1]
+        out.append(f"    cbor_put_text(w, {c_key(key)});")
+        if kind == "field":
+            out.append("    " + c_cbor_value(part[2], opts(part, 3), f"m->{key}"))
+        elif kind == "array":
+            out.append(f"    tlm_cbor_array(w, m->{key}, m->{part[3]});")
+        elif kind == "const":
+            out.append("    " + c_cbor_const(part[2]))
+        elif kind == "list":
+            out.append(f"    cbor_put_array(w, m->{part[3]});")
+            out.append(f"    for (uint32_t i = 0; i < m->{part[3]}; i++) {{")
+            out.append(f"        tlm_{part[2]}_t r = {{0}};")
+            out.append(f"        m->get_{key}(m->ctx, i, &r);")
+            out.append(f"        tlm_cbor_put_{part[2]}(w, &r);")
+            out.append("    }")
+    out += ["}", ""]
+
+    out.append(f"const tlm_codec_t tlm_{name}_codec = {{")
+    out.append(f"    .type = WIRE_MSG_{upper(name)},")
+    out.append(f"    .wire = tlm_wire_{name},")
+    out.append(f"    .payload = tlm_wire_payload_{name},")
+    out.append(f"    .json = tlm_json_{name},")
+    out.append(f"    .cbor = tlm_cbor_{name},")
+    out += ["};", ""]
+    return out
+
+
+def gen_c_source():
+    out = [f"// {BANNER}", "#include <inttypes.h>", '#include "telemetry.h"', ""]
+    out.append(C_HELPERS)
+    for name in schema.RECORDS:
+        out += [
+            "// --------------------------------------------------------------------",
+            f"// {name} entries",
+            "// --------------------------------------------------------------------",
+        ]
+        out += c_record_functions(name)
+    for msg in schema.MESSAGES:
+        out += [
+            "// --------------------------------------------------------------------",
+            f"// {msg['name']} message",
+            "// --------------------------------------------------------------------",
+        ]
+        out += c_message_functions(msg)
+    return "\n".join(out).rstrip() + "\n"
+
+
+# ------------------ PYTHON ------------------
+PY_ENGINE = r'''
+_FORMAT = {"u8": "B", "i8": "b", "u16": "H", "u32": "I", "u64": "Q"}
+
+
+def message_kind(data):
+    """Name of the message a JSON / decoded dict is, or None."""
+    for key, kind in KINDS:
+        if key in data:
+            return kind
+    return None
+
+
+class _Reader:
+    def __init__(self, payload):
+        self.payload = payload
+        self.offset = 0
+
+    def read(self, ftype, count=None):
+        if ftype == "name":
+            raw = self.payload[self.offset:self.offset + NAME_LEN]
+            if len(raw) < NAME_LEN:
+                raise IndexError("short payload")
+            self.offset += NAME_LEN
+            return raw.split(b"\0", 1)[0].decode("utf-8", errors="replace")
+        fmt = "<" + str(1 if count is None else count) + _FORMAT[ftype]
+        values = struct.unpack_from(fmt, self.payload, self.offset)
+        self.offset += struct.calcsize(fmt)
+        return list(values) if count is not None else values[0]
+
+
+def _record(reader, name):
+    raw = {}
+    for key, ftype, options in RECORDS[name]:
+        raw[key] = reader.read(ftype, options.get("count"))
+
+    fields = [key for key, _, options in RECORDS[name] if options.get("json", True)]
+    consts = {}
+    if name in VARIANTS:
+        flag_field, cases = VARIANTS[name]
+        for flag, keys, case_consts in cases:
+            if flag is None or raw[flag_field] & FLAGS[flag]:
+                fields, consts = keys, case_consts
+                break
+
+    entry = {}
+    for key, ftype, options in RECORDS[name]:
+        if key in fields and not (options.get("optional") and not raw[key]):
+            entry[key] = raw[key]
+    entry.update(consts)
+    return entry
+
+
+def decode_payload(msg_type, payload):
+    """Binary payload -> the same dict the JSON message would give, None for other types.
+
+    Raises struct.error / IndexError on a short payload.
+    """
+    msg = MESSAGES.get(msg_type)
+    if msg is None:
+        return None
+
+    reader = _Reader(payload)
+    counts = {}
+    data = {}
+    for part in msg["parts"]:
+        kind = part[0]
+        if kind == "field":
+            data[part[1]] = reader.read(part[2])
+        elif kind == "count":
+            counts[part[1]] = reader.read(part[2])
+        elif kind == "array":
+            data[part[1]] = reader.read(part[2], counts[part[3]])
+        elif kind == "list":
+            data[part[1]] = [_record(reader, part[2]) for _ in range(counts[part[3]])]
+        elif kind == "const":
+            data[part[1]] = part[2]
+
+    if "wrap" in msg:
+        return {msg["wrap"]: data}
+    return data
+
+
+def _integer_fields(msg_type, payload):
+    """(offset, size) of every integer field of a binary payload, in wire order."""
+    fields = []
+    counts = {}
+    offset = 0
+
+    def take(ftype, n=1):
+        nonlocal offset
+        size = NAME_LEN if ftype == "name" else struct.calcsize(_FORMAT[ftype])
+        for _ in range(n):
+            if offset + size > len(payload):
+                raise IndexError("short payload")
+            if ftype != "name":
+                # u64 as two u32 halves, the delta encoder works on 32 bits
+                fields.extend((offset + half, min(size, 4)) for half in range(0, size, 4))
+            offset += size
+
+    for part in MESSAGES[msg_type]["parts"]:
+        kind = part[0]
+        if kind == "field":
+            take(part[2])
+        elif kind == "count":
+            take(part[2])
+            counts[part[1]] = int.from_bytes(payload[fields[-1][0]:offset], "little")
+        elif kind == "array":
+            take(part[2], counts[part[3]])
+        elif kind == "list":
+            for _ in range(counts[part[3]]):
+                for _, ftype, options in RECORDS[part[2]]:
+                    take(ftype, options.get("count", 1))
+    return fields
+
+
+def _varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+class DeltaDecoder:
+    """Rebuilds DELTA frames (MCUSilk/delta.h) from the last payload of the same type.
+
+    A delta names the integers it applies to by their CRC, so after a lost frame the
+    following deltas are skipped (counted in lost) until the next full frame.
+    """
+
+    def __init__(self):
+        self.base = {}
+        self.lost = 0
+
+    def full(self, msg_type, payload):
+        """Remember a full payload as the base of the next delta."""
+        if msg_type in MESSAGES:
+            self.base[msg_type] = bytes(payload)
+
+    def apply(self, payload):
+        """DELTA payload -> (msg_type, payload), None if it does not fit the base."""
+        msg_type, ref = struct.unpack_from("<BH", payload, 0)
+        base = self.base.get(msg_type)
+        if base is None:
+            self.lost += 1
+            return None
+
+        fields = _integer_fields(msg_type, base)
+        values = [int.from_bytes(base[o:o + n], "little") for o, n in fields]
+        if binascii.crc_hqx(struct.pack(f"<{len(values)}I", *values), 0xFFFF) != ref:
+            self.lost += 1
+            return None
+
+        out = bytearray(base)
+        pos = 3
+        for (o, n), value in zip(fields, values):
+            z, pos = _varint(payload, pos)
+            value = (value + ((z >> 1) ^ -(z & 1))) & 0xFFFFFFFF
+            out[o:o + n] = value.to_bytes(4, "little")[:n]
+        if pos != len(payload):
+            self.lost += 1
+            return None
+
+        self.base[msg_type] = bytes(out)
+        return msg_type, self.base[msg_type]
+
+
+def lz_expand(payload):
+    """LZ payload (MCUSilk/lz.h) -> (msg_type, payload) of the frame it replaces, None if corrupt."""
+    msg_type, size = struct.unpack_from("<BH", payload, 0)
+    bits = int.from_bytes(payload[3:], "big")
+    left = 8 * (len(payload) - 3)
+    out = bytearray()
+
+    def take(n):
+        nonlocal left
+        left -= n
+        return (bits >> left) & ((1 << n) - 1)
+
+    while left >= 9 and len(out) < size:
+        if take(1):
+            out.append(take(8))
+        elif left >= LZ_WINDOW_BITS + LZ_LOOKAHEAD_BITS:
+            distance = take(LZ_WINDOW_BITS) + 1
+            length = take(LZ_LOOKAHEAD_BITS) + 1
+            if distance > len(out):
+                return None
+            for _ in range(length):
+                out.append(out[-distance])
+        else:
+            break
+    return (msg_type, bytes(out)) if len(out) == size else None
+
+
+class LinkStats:
+    """Loss and latency of the period reports, from their seq and uptime_us.
+
+    Host and device clocks have an unknown offset, so latency is the delay of a report
+    over the fastest of the last LATENCY_WINDOW ones: the part added by queueing and
+    a busy link. period_ms is the reporting period the device is at, longer than the
+    configured one while it coalesces for a saturated link.
+    """
+
+    LATENCY_WINDOW = 64
+
+    def __init__(self):
+        self.received = 0
+        self.lost = 0
+        self.restarts = 0
+        self.latency_ms = 0.0
+        self.max_latency_ms = 0.0
+        self.period_ms = 0
+        self.coalesced = 1
+        self._seq = None
+        self._uptime = None
+        self._offsets = collections.deque(maxlen=self.LATENCY_WINDOW)
+
+    def update(self, report, now):
+        """report: the dict under "report", now: host time in seconds (time.monotonic())."""
+        seq, uptime = report["seq"], report["uptime_us"]
+        if self._seq is not None and (seq <= self._seq or uptime < self._uptime):
+            self.restarts += 1          # the device restarted, seq starts over
+            self._offsets.clear()
+        elif self._seq is not None:
+            self.lost += seq - self._seq - 1
+        self._seq, self._uptime = seq, uptime
+        self.received += 1
+        self.period_ms = report.get("period_ms", 0)
+        self.coalesced = report.get("coalesced", 1)
+
+        self._offsets.append(now - uptime / 1e6)
+        self.latency_ms = (self._offsets[-1] - min(self._offsets)) * 1000
+        self.max_latency_ms = max(self.max_latency_ms, self.latency_ms)
+
+    @property
+    def loss(self):
+        """Lost share of the reports, 0..1"""
+        total = self.received + self.lost
+        return self.lost / total if total else 0.0
+
+    def summary(self):
+        """The counters as a plain dict (e.g. for a Qt signal)."""
+        return {"received": self.received, "lost": self.lost, "loss": self.loss, "restarts": self.restarts,
+                "latency_ms": self.latency_ms, "max_latency_ms": self.max_latency_ms,
+                "period_ms": self.period_ms, "coalesced": self.coalesced}
+'''
+
+
+def gen_python():
+    out = [f"# {BANNER}", '"""Telemetry message tables and the binary decoder built on them."""',
+           "import binascii", "import collections", "import struct", "", ""]
+    out.append(f"WIRE_VERSION = {schema.VERSION}")
+    out.append(f"NAME_LEN = {schema.NAME_LEN}")
+    out.append(f"HIST_BUCKETS = {schema.HIST_BUCKETS}")
+    out.append(f"LZ_WINDOW_BITS = {schema.LZ_WINDOW_BITS}")
+    out.append(f"LZ_LOOKAHEAD_BITS = {schema.LZ_LOOKAHEAD_BITS}")
+    out.append("")
+    for name, value in wire_types():
+        out.append(f"WIRE_MSG_{upper(name)} = {value}")
+    out.append("")
+    for flag, value in schema.FLAGS.items():
+        out.append(f"{flag} = 0x{value:02X}")
+    out.append("")
+    out.append("FLAGS = {")
+    for flag in schema.FLAGS:
+        out.append(f"    {flag!r}: {flag},")
+    out.append("}")
+    out.append("")
+    for name, value in schema.CONSTANTS.items():
+        out.append(f"{name} = {value}")
+    out.append("")
+
+    out.append("RECORDS = {")
+    for name in schema.RECORDS:
+        out.append(f"    {name!r}: [")
+        for key, ftype, options in record_fields(name):
+            out.append(f"        ({key!r}, {ftype!r}, {options!r}),")
+        out.append("    ],")
+    out.append("}")
+    out.append("")
+    out.append("VARIANTS = {")
+    for name, (flag_field, cases) in schema.VARIANTS.items():
+        out.append(f"    {name!r}: ({flag_field!r}, [")
+        for case in cases:
+            out.append(f"        {case!r},")
+        out.append("    ]),")
+    out.append("}")
+    out.append("")
+    out.append("MESSAGES = {")
+    for msg in schema.MESSAGES:
+        out.append(f"    WIRE_MSG_{upper(msg['name'])}: {{")
+        out.append(f"        'name': {msg['name']!r},")
+        if "wrap" in msg:
+            out.append(f"        'wrap': {msg['wrap']!r},")
+        out.append("        'parts': [")
+        for part in msg["parts"]:
+            out.append(f"            {part!r},")
+        out.append("        ],")
+        out.append("    },")
+    out.append("}")
+    out.append("")
+    out.append("# (key, message) pairs, the first key found in a dict names the message")
+    out.append("KINDS = [")
+    for key, kind in kinds():
+        out.append(f"    ({key!r}, {kind!r}),")
+    out.append("]")
+    out.append("")
+    out.append(PY_ENGINE)
+    return "\n".join(out).rstrip() + "\n"
+
+
+# ------------------ C++ ------------------
+CPP_FRAMING = r'''
+// --------------------------------------------------------------------
+// Framing: COBS( version | type | payload | crc16 ) + 0x00, see MCUSilk/wire.h
+// --------------------------------------------------------------------
+struct Frame {
+    uint8_t type = 0;
+    std::vector<uint8_t> payload;
+};
+
+namespace detail {
+
+inline uint16_t crc16_update(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= static_cast<uint16_t>(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+inline uint16_t crc16(const uint8_t *data, size_t len)
+{
+    return crc16_update(0xFFFF, data, len);
+}
+
+inline std::optional<std::vector<uint8_t>> cobs_decode(const uint8_t *data, size_t len)
+{
+    std::vector<uint8_t> out;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t code = data[i];
+        if (code == 0 || i + code > len) {
+            return std::nullopt;
+        }
+        out.insert(out.end(), data + i + 1, data + i + code);
+        i += code;
+        if (code < 0xFF && i < len) {
+            out.push_back(0);
+        }
+    }
+    return out;
+}
+
+// Bounds-checked little-endian reader, ok() turns false on a short payload
+class Reader {
+public:
+    Reader(const uint8_t *data, size_t len) : data_(data), len_(len) {}
+
+    bool ok() const { return ok_; }
+
+    uint32_t u8() { return take(1) ? data_[pos_ - 1] : 0; }
+    int32_t i8() { return static_cast<int8_t>(u8()); }
+    uint32_t u16() { return take(2) ? data_[pos_ - 2] | (data_[pos_ - 1] << 8) : 0; }
+    uint32_t u32()
+    {
+        if (!take(4)) return 0;
+        const uint8_t *p = data_ + pos_ - 4;
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+    uint64_t u64()
+    {
+        uint64_t lo = u32();
+        return lo | (static_cast<uint64_t>(u32()) << 32);
+    }
+    std::string name()
+    {
+        if (!take(NAME_LEN)) return {};
+        const char *p = reinterpret_cast<const char *>(data_ + pos_ - NAME_LEN);
+        return std::string(p, strnlen(p, NAME_LEN));
+    }
+
+private:
+    bool take(size_t n)
+    {
+        if (!ok_ || len_ - pos_ < n) {
+            ok_ = false;
+            return false;
+        }
+        pos_ += n;
+        return true;
+    }
+
+    const uint8_t *data_;
+    size_t len_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+template <class Json, class T>
+void get(const Json &j, const char *key, T &out)
+{
+    if (j.contains(key)) {
+        out = j.at(key).template get<T>();
+    }
+}
+
+template <class Json>
+void get_array(const Json &j, const char *key, std::vector<uint32_t> &out)
+{
+    if (j.contains(key)) {
+        for (const auto &v : j.at(key)) {
+            out.push_back(v.template get<uint32_t>());
+        }
+    }
+}
+
+} // namespace detail
+
+// Frame without its 0x00 delimiter -> type and payload, nullopt on a bad COBS / CRC / version
+inline std::optional<Frame> unpack_frame(const uint8_t *data, size_t len)
+{
+    auto raw = detail::cobs_decode(data, len);
+    if (!raw || raw->size() < 4) {
+        return std::nullopt;
+    }
+
+    size_t body = raw->size() - 2;
+    uint16_t crc = static_cast<uint16_t>((*raw)[body] | ((*raw)[body + 1] << 8));
+    if (detail::crc16(raw->data(), body) != crc || (*raw)[0] != WIRE_VERSION) {
+        return std::nullopt;
+    }
+
+    Frame frame;
+    frame.type = (*raw)[1];
+    frame.payload.assign(raw->begin() + 2, raw->begin() + body);
+    return frame;
+}
+
+// LZ frame (MCUSilk/lz.h) -> the frame it replaces, other frames as they are.
+// nullopt on a corrupt stream.
+inline std::optional<Frame> expand_lz(const Frame &frame)
+{
+    if (frame.type != static_cast<uint8_t>(MsgType::Lz)) {
+        return frame;
+    }
+
+    const std::vector<uint8_t> &p = frame.payload;
+    if (p.size() < 3) {
+        return std::nullopt;
+    }
+    Frame out;
+    out.type = p[0];
+    size_t size = p[1] | (p[2] << 8);
+
+    size_t bit = 24;
+    size_t end = 8 * p.size();
+    auto take = [&](unsigned n) {
+        uint32_t v = 0;
+        for (unsigned i = 0; i < n; i++, bit++) {
+            v = (v << 1) | ((p[bit / 8] >> (7 - bit % 8)) & 1);
+        }
+        return v;
+    };
+
+    while (end - bit >= 9 && out.payload.size() < size) {
+        if (take(1)) {
+            out.payload.push_back(static_cast<uint8_t>(take(8)));
+        } else if (end - bit >= LZ_WINDOW_BITS + LZ_LOOKAHEAD_BITS) {
+            size_t distance = take(LZ_WINDOW_BITS) + 1;
+            size_t length = take(LZ_LOOKAHEAD_BITS) + 1;
+            if (distance > out.payload.size()) {
+                return std::nullopt;
+            }
+            for (size_t i = 0; i < length; i++) {
+                out.payload.push_back(out.payload[out.payload.size() - distance]);
+            }
+        } else {
+            break;
+        }
+    }
+    if (out.payload.size() != size) {
+        return std::nullopt;
+    }
+    return out;
+}
+'''
+
+
+CPP_DELTA = r'''
+// Rebuilds DELTA frames (MCUSilk/delta.h) from the last full payload of the
+// same type. A delta names the integers it applies to by their CRC, so after a
+// lost frame the following deltas are skipped (counted in lost()) until the
+// next full frame.
+class DeltaDecoder {
+public:
+    // Full frames are remembered and returned as they are, deltas are expanded
+    // into the full frame they stand for. nullopt for a delta that does not apply.
+    std::optional<Frame> apply(const Frame &frame)
+    {
+        if (frame.type != static_cast<uint8_t>(MsgType::Delta)) {
+            base_[frame.type] = frame.payload;
+            return frame;
+        }
+
+        const std::vector<uint8_t> &p = frame.payload;
+        if (p.size() < 3) return miss();
+        uint8_t type = p[0];
+        uint16_t ref = static_cast<uint16_t>(p[1] | (p[2] << 8));
+
+        auto base = base_.find(type);
+        if (base == base_.end()) return miss();
+        auto fields = detail::integer_fields(type, base->second.data(), base->second.size());
+        if (!fields) return miss();
+
+        std::vector<uint32_t> values;
+        uint16_t crc = 0xFFFF;
+        for (auto [offset, size] : *fields) {
+            uint32_t v = 0;
+            for (size_t i = 0; i < size; i++) v |= static_cast<uint32_t>(base->second[offset + i]) << (8 * i);
+            uint8_t le[4] = { uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24) };
+            crc = detail::crc16_update(crc, le, 4);
+            values.push_back(v);
+        }
+        if (crc != ref) return miss();
+
+        Frame out{type, base->second};
+        size_t pos = 3;
+        for (size_t n = 0; n < fields->size(); n++) {
+            uint32_t z = 0;
+            for (int shift = 0;; shift += 7) {
+                if (pos >= p.size() || shift > 28) return miss();
+                uint8_t b = p[pos++];
+                z |= static_cast<uint32_t>(b & 0x7F) << shift;
+                if (!(b & 0x80)) break;
+            }
+            uint32_t v = values[n] + ((z >> 1) ^ (0u - (z & 1)));
+            auto [offset, size] = (*fields)[n];
+            for (size_t i = 0; i < size; i++) out.payload[offset + i] = static_cast<uint8_t>(v >> (8 * i));
+        }
+        if (pos != p.size()) return miss();
+
+        base->second = out.payload;
+        return out;
+    }
+
+    uint32_t lost() const { return lost_; }
+
+private:
+    std::optional<Frame> miss()
+    {
+        lost_++;
+        return std::nullopt;
+    }
+
+    std::map<uint8_t, std::vector<uint8_t>> base_;
+    uint32_t lost_ = 0;
+};
+'''
+
+
+CPP_LINK = r'''
+// Loss and latency of the period reports, from their seq and uptime_us. Host
+// and device clocks have an unknown offset, so latency is the delay of a report
+// over the fastest of the last LATENCY_WINDOW ones: the part added by queueing
+// and a busy link. period_ms is the reporting period the device is at, longer
+// than the configured one while it coalesces for a saturated link.
+class LinkStats {
+public:
+    static constexpr size_t LATENCY_WINDOW = 64;
+
+    // now_us: host clock (any epoch, monotonic) when the report arrived
+    void update(const ReportMsg &r, int64_t now_us)
+    {
+        if (received_ && (r.seq <= seq_ || r.uptime_us < uptime_)) {
+            restarts_++;        // the device restarted, seq starts over
+            offsets_.clear();
+        } else if (received_) {
+            lost_ += r.seq - seq_ - 1;
+        }
+        seq_ = r.seq;
+        uptime_ = r.uptime_us;
+        received_++;
+        period_ms_ = r.period_ms;
+        coalesced_ = r.coalesced;
+
+        offsets_.push_back(now_us - static_cast<int64_t>(r.uptime_us));
+        if (offsets_.size() > LATENCY_WINDOW) offsets_.pop_front();
+        latency_ms_ = (offsets_.back() - *std::min_element(offsets_.begin(), offsets_.end())) / 1000.0;
+        max_latency_ms_ = std::max(max_latency_ms_, latency_ms_);
+    }
+
+    uint32_t received() const { return received_; }
+    uint32_t lost() const { return lost_; }
+    uint32_t restarts() const { return restarts_; }
+    double loss() const { return received_ + lost_ ? double(lost_) / (received_ + lost_) : 0.0; }
+    double latency_ms() const { return latency_ms_; }
+    double max_latency_ms() const { return max_latency_ms_; }
+    uint32_t period_ms() const { return period_ms_; }
+    uint32_t coalesced() const { return coalesced_; }
+
+private:
+    uint32_t received_ = 0;
+    uint32_t lost_ = 0;
+    uint32_t restarts_ = 0;
+    uint32_t seq_ = 0;
+    uint64_t uptime_ = 0;
+    std::deque<int64_t> offsets_;
+    double latency_ms_ = 0;
+    double max_latency_ms_ = 0;
+    uint32_t period_ms_ = 0;
+    uint32_t coalesced_ = 1;
+};
+'''
+
+
+def cpp_type(ftype, options):
+    if options.get("count"):
+        return f"std::array<uint32_t, {options['count']}>"
+    if ftype == "name":
+        return "std::string"
+    if ftype == "u64":
+        return "uint64_t"
+    return "int32_t" if ftype == "i8" else "uint32_t"
+
+
+def cpp_take(ftype, count=""):
+    """integer_fields() step over a field, u64 as two u32 halves"""
+    if ftype == "u64":
+        return f"take(4, {count + ' * ' if count else ''}2);"
+    return f"take({WIRE_SIZE[ftype]}{', ' + count if count else ''});"
+
+
+def cpp_read(ftype, options, target, ind):
+    if options.get("count"):
+        return [f"{ind}for (auto &v : {target}) v = r.{ftype}();"]
+    return [f"{ind}{target} = r.{ftype}();"]
+
+
+def gen_cpp():
+    out = [f"// {BANNER}", "#pragma once", ""]
+    out += ["#include <algorithm>", "#include <array>", "#include <cstdint>", "#include <cstring>", "#include <deque>",
+            "#include <map>", "#include <optional>",
+            "#include <string>", "#include <utility>", "#include <variant>", "#include <vector>", "", ""]
+    out.append("// Decoder for the MCUSilk telemetry, binary frames and JSON messages.")
+    out.append("// JSON goes through any type with the nlohmann::json interface")
+    out.append("// (contains / at / get<T> / range-for), so there is no hard dependency.")
+    out.append("namespace telemetry {")
+    out.append("")
+    out.append(f"constexpr uint8_t WIRE_VERSION = {schema.VERSION};")
+    out.append(f"constexpr size_t NAME_LEN = {schema.NAME_LEN};")
+    out.append(f"constexpr unsigned LZ_WINDOW_BITS = {schema.LZ_WINDOW_BITS};")
+    out.append(f"constexpr unsigned LZ_LOOKAHEAD_BITS = {schema.LZ_LOOKAHEAD_BITS};")
+    out.append("")
+    out.append("enum class MsgType : uint8_t {")
+    for name, value in wire_types():
+        out.append(f"    {camel(name)} = {value},")
+    out.append("};")
+    out.append("")
+    for flag, value in schema.FLAGS.items():
+        out.append(f"constexpr uint32_t {flag} = 0x{value:02X};")
+    out.append("")
+    for name, value in schema.CONSTANTS.items():
+        out.append(f"constexpr uint32_t {name} = {value};")
+    out.append("")
+
+    for name in schema.RECORDS:
+        out.append(f"struct {camel(name)} {{")
+        for key, ftype, options in record_fields(name):
+            init = "" if ftype == "name" or options.get("count") else " = 0"
+            value = "{}" if options.get("count") else ""
+            out.append(f"    {cpp_type(ftype, options)} {key}{init}{value};")
+        out.append("};")
+        out.append("")
+    for msg in schema.MESSAGES:
+        out.append(f"struct {camel(msg['name'])}Msg {{")
+        for part in json_parts(msg):
+            kind = part[0]
+            if kind == "field":
+                init = "" if part[2] == "name" else " = 0"
+                out.append(f"    {cpp_type(part[2], opts(part, 3))} {part[1]}{init};")
+            elif kind == "array":
+                out.append(f"    std::vector<uint32_t> {part[1]};")
+            elif kind == "list":
+                out.append(f"    std::vector<{camel(part[2])}> {part[1]};")
+        out.append("};")
+        out.append("")
+    out.append("using Message = std::variant<" + ", ".join(camel(m["name"]) + "Msg" for m in schema.MESSAGES) + ">;")
+    out.append(CPP_FRAMING)
+
+    # Binary
+    out.append("namespace detail {")
+    out.append("")
+    for name in schema.RECORDS:
+        out.append(f"inline {camel(name)} read_{name}(Reader &r)")
+        out.append("{")
+        out.append(f"    {camel(name)} e;")
+        for key, ftype, options in record_fields(name):
+            out += cpp_read(ftype, options, f"e.{key}", "    ")
+        out.append("    return e;")
+        out.append("}")
+        out.append("")
+    out.append("} // namespace detail")
+    out.append("")
+    out.append("// Payload of a typed frame -> message, nullopt for JSON / CBOR frames or a short payload")
+    out.append("inline std::optional<Message> decode_payload(uint8_t type, const uint8_t *data, size_t len)")
+    out.append("{")
+    out.append("    detail::Reader r(data, len);")
+    out.append("")
+    out.append("    switch (static_cast<MsgType>(type)) {")
+    for msg in schema.MESSAGES:
+        out.append(f"    case MsgType::{camel(msg['name'])}: {{")
+        out.append(f"        {camel(msg['name'])}Msg m;")
+        for part in msg["parts"]:
+            kind = part[0]
+            if kind == "field":
+                out += cpp_read(part[2], opts(part, 3), f"m.{part[1]}", "        ")
+            elif kind == "count":
+                out.append(f"        uint32_t {part[1]} = r.{part[2]}();")
+            elif kind == "array":
+                out.append(f"        for (uint32_t i = 0; i < {part[3]} && r.ok(); i++) m.{part[1]}.push_back(r.{part[2]}());")
+            elif kind == "list":
+                out.append(f"        for (uint32_t i = 0; i < {part[3]} && r.ok(); i++) m.{part[1]}.push_back(detail::read_{part[2]}(r));")
+        out.append("        if (!r.ok()) return std::nullopt;")
+        out.append("        return m;")
+        out.append("    }")
+    out.append("    default:")
+    out.append("        return std::nullopt;")
+    out.append("    }")
+    out.append("}")
+    out.append("")
+
+    # Delta
+    out.append("namespace detail {")
+    out.append("")
+    out.append("using Fields = std::vector<std::pair<size_t, size_t>>;")
+    out.append("")
+    out.append("// (offset, size) of every integer field of a payload, in wire order")
+    out.append("inline std::optional<Fields> integer_fields(uint8_t type, const uint8_t *data, size_t len)")
+    out.append("{")
+    out.append("    Fields f;")
+    out.append("    size_t pos = 0;")
+    out.append("    auto take = [&](size_t size, uint32_t n = 1) {")
+    out.append("        for (uint32_t i = 0; i < n; i++, pos += size) f.emplace_back(pos, size);")
+    out.append("    };")
+    out.append("    auto read_count = [&](size_t size) {")
+    out.append("        uint32_t v = 0;")
+    out.append("        for (size_t i = 0; i < size && pos + i < len; i++) v |= static_cast<uint32_t>(data[pos + i]) << (8 * i);")
+    out.append("        take(size);")
+    out.append("        return v;")
+    out.append("    };")
+    out.append("")
+    out.append("    switch (static_cast<MsgType>(type)) {")
+    for msg in schema.MESSAGES:
+        out.append(f"    case MsgType::{camel(msg['name'])}: {{")
+        for part in msg["parts"]:
+            kind = part[0]
+            if kind == "field":
+                out.append("        pos += NAME_LEN;" if part[2] == "name" else f"        {cpp_take(part[2])}")
+            elif kind == "count":
+                out.append(f"        uint32_t {part[1]} = read_count({WIRE_SIZE[part[2]]});")
+            elif kind == "array":
+                out.append(f"        {cpp_take(part[2], part[3])}")
+            elif kind == "list":
+                out.append(f"        for (uint32_t i = 0; i < {part[3]}; i++) {{")
+                for key, ftype, options in record_fields(part[2]):
+                    n = str(options["count"]) if options.get("count") else ""
+                    out.append("            pos += NAME_LEN;" if ftype == "name" else f"            {cpp_take(ftype, n)}")
+                out.append("        }")
+        out.append("        break;")
+        out.append("    }")
+    out.append("    default:")
+    out.append("        return std::nullopt;")
+    out.append("    }")
+    out.append("    if (pos > len) return std::nullopt;")
+    out.append("    return f;")
+    out.append("}")
+    out.append("")
+    out.append("} // namespace detail")
+    out.append(CPP_DELTA)
+    out.append(CPP_LINK)
+
+    # JSON
+    out.append("namespace detail {")
+    out.append("")
+    for name in schema.RECORDS:
+        out.append("template <class Json>")
+        out.append(f"{camel(name)} json_{name}(const Json &j)")
+        out.append("{")
+        out.append(f"    {camel(name)} e;")
+        for key, ftype, options in json_fields(name):
+            if options.get("count"):
+                out.append(f"    if (j.contains(\"{key}\")) {{")
+                out.append("        size_t i = 0;")
+                out.append(f"        for (const auto &v : j.at(\"{key}\")) {{")
+                out.append(f"            if (i < e.{key}.size()) e.{key}[i++] = v.template get<uint32_t>();")
+                out.append("        }")
+                out.append("    }")
+            else:
+                out.append(f"    get(j, \"{key}\", e.{key});")
+        if name in schema.VARIANTS:
+            flag_field, cases = schema.VARIANTS[name]
+            for flag, _, consts in cases:
+                if flag is None:
+                    continue
+                conds = []
+                for key, value in consts.items():
+                    if value is True:
+                        conds.append(f"(j.contains(\"{key}\") && j.at(\"{key}\").template get<bool>())")
+                    else:
+                        conds.append(f"(j.contains(\"{key}\") && j.at(\"{key}\").template get<std::string>() == \"{value}\")")
+                out.append(f"    if ({' && '.join(conds)}) e.{flag_field} |= {flag};")
+        out.append("    return e;")
+        out.append("}")
+        out.append("")
+    out.append("} // namespace detail")
+    out.append("")
+    out.append("// JSON message (or the \"json\" / decoded CBOR payload) -> message, nullopt for JSON-only ones")
+    out.append("template <class Json>")
+    out.append("std::optional<Message> from_json(const Json &j)")
+    out.append("{")
+    for msg in schema.MESSAGES:
+        out.append(f"    if (j.contains(\"{msg['key']}\")) {{")
+        out.append(f"        {camel(msg['name'])}Msg m;")
+        src = "j"
+        if "wrap" in msg:
+            out.append(f"        const auto &o = j.at(\"{msg['wrap']}\");")
+            src = "o"
+        for part in json_parts(msg):
+            kind = part[0]
+            if kind == "field":
+                out.append(f"        detail::get({src}, \"{part[1]}\", m.{part[1]});")
+            elif kind == "array":
+                out.append(f"        detail::get_array({src}, \"{part[1]}\", m.{part[1]});")
+            elif kind == "list":
+                out.append(f"        for (const auto &e : {src}.at(\"{part[1]}\")) m.{part[1]}.push_back(detail::json_{part[2]}(e));")
+        out.append("        return m;")
+        out.append("    }")
+    out.append("    return std::nullopt;")
+    out.append("}")
+    out.append("")
+    out.append("} // namespace telemetry")
+    out.append("")
+    return "\n".join(out)
+
+
+# ------------------ MAIN ------------------
+OUTPUTS = [
+    ("MCUSilk/telemetry_defs.h", gen_c_defs),
+    ("MCUSilk/telemetry.h", gen_c_header),
+    ("MCUSilk/telemetry.c", gen_c_source),
+    ("Examples/STM32/Core/Inc/telemetry_defs.h", gen_c_defs),
+    ("GUI/telemetry_schema.py", gen_python),
+    ("qtPy_GUI/telemetry_schema.py", gen_python),
+    ("host/cpp/telemetry.hpp", gen_cpp),
+]
+
+
+def main():
+    check = "--check" in sys.argv[1:]
+    stale = []
+
+    for path, generate in OUTPUTS:
+        full = os.path.join(ROOT, path)
+        text = generate()
+        current = open(full).read() if os.path.exists(full) else None
+        if current == text:
+            continue
+        stale.append(path)
+        if not check:
+            os.makedirs(os.path.dirname(full), exist_ok=True)
+            with open(full, "w", newline="\n") as f:
+                f.write(text)
+
+    for path in stale:
+        print(("out of date: " if check else "wrote ") + path)
+    return 1 if check and stale else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
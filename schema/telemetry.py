@@ -0,0 +1,270 @@
+"""Telemetry schema, the one place that defines every report the firmware sends.
+
+`python schema/generate.py` turns it into the firmware encoders (MCUSilk/telemetry*.{h,c}),
+the Python decoder (GUI/ and qtPy_GUI/telemetry_schema.py) and the C++ decoder
+(host/cpp/telemetry.hpp). Adding a metric is a change here plus filling the new field
+where the firmware builds the message.
+
+Wire types:  u8, i8, u16, u32, u64 (little-endian), name (NAME_LEN bytes, NUL padded).
+In the C structs every integer is 32 bits wide (u64: 64); the binary encoder saturates
+unsigned values to the wire type. Field options:
+    json=False      binary only (e.g. flags that select a JSON variant)
+    optional=True   name left out of JSON / CBOR when empty
+    count=N         fixed size array of N values
+Message parts, in binary order (JSON / CBOR are maps, so their key order does not matter):
+    ("field", key, type[, options])
+    ("count", name, type)               binary only, element count of arrays and lists
+    ("array", key, type, count)         list of integers
+    ("list", key, record, count)        list of RECORDS entries
+    ("const", key, value)               JSON / CBOR only
+"""
+
+VERSION = 3             # WIRE_VERSION, bump when a binary layout changes
+NAME_LEN = 16
+HIST_BUCKETS = 16
+LZ_WINDOW_BITS = 8      # LZ frames: back reference distance 1..256
+LZ_LOOKAHEAD_BITS = 4   # and length 1..16, see MCUSilk/lz.h
+
+
+RECORDS = {
+    "task": [
+        ("task_name", "name"),
+        ("run_time", "u32"),
+        ("isr_time", "u32"),
+        ("percentage", "u8"),
+        ("core", "i8"),
+        ("flags", "u8", {"json": False}),
+    ],
+    "isr_entry": [
+        ("tag", "u8"),
+        ("core", "i8"),
+        ("name", "name", {"optional": True}),
+        ("count", "u32"),
+        ("dropped", "u32"),
+        ("incl_min_ns", "u32"),
+        ("incl_avg_ns", "u32"),
+        ("incl_max_ns", "u32"),
+        ("excl_min_ns", "u32"),
+        ("excl_avg_ns", "u32"),
+        ("excl_max_ns", "u32"),
+        ("hist", "u32", {"count": HIST_BUCKETS}),
+    ],
+    "budget_entry": [
+        ("type", "u8"),                 # WIRE_MSG_* of the messages it covers
+        ("bytes_per_s", "u32"),
+        ("msgs_per_min", "u32"),
+    ],
+    "task_detail": [
+        ("task_name", "name"),
+        ("number", "u32"),              # FreeRTOS task number, unique while the task lives
+        ("state", "u8"),                # eTaskState: running, ready, blocked, suspended, deleted
+        ("priority", "u8"),
+        ("base_priority", "u8"),        # differs from priority while a mutex holder is boosted
+        ("core", "i8"),                 # -1: not pinned
+        ("stack_free", "u32"),          # bytes never used so far (high water mark)
+        ("run_time", "u32"),            # total run time counter since boot
+    ],
+    "heap_region": [
+        ("caps", "u32"),                # MALLOC_CAP_* the heaps of this line share
+        ("total", "u32"),
+        ("free", "u32"),
+        ("largest_free", "u32"),        # biggest block that can be allocated
+        ("min_free", "u32"),            # low water mark since boot
+        ("allocated_blocks", "u32"),
+        ("free_blocks", "u32"),
+    ],
+    "wakeup_entry": [
+        ("channel", "u8"),
+        ("count", "u32"),
+        ("coalesced", "u32"),
+        ("min_us", "u32"),
+        ("avg_us", "u32"),
+        ("max_us", "u32"),
+        ("hist", "u32", {"count": HIST_BUCKETS}),
+    ],
+}
+
+# Records whose JSON shape depends on a flag bit: (flag, JSON fields, constant keys),
+# first match wins, flag None is the default.
+FLAGS = {
+    "WIRE_TASK_CREATED": 0x01,
+    "WIRE_TASK_DELETED": 0x02,
+    "WIRE_TASK_ISR": 0x04,
+}
+
+VARIANTS = {
+    "task": ("flags", [
+        ("WIRE_TASK_CREATED", ["task_name"], {"status": "created"}),
+        ("WIRE_TASK_DELETED", ["task_name"], {"status": "deleted"}),
+        ("WIRE_TASK_ISR", ["task_name", "run_time", "percentage", "core"], {"isr": True}),
+        (None, ["task_name", "run_time", "isr_time", "percentage", "core"], {}),
+    ]),
+}
+
+
+# Host -> device commands (CMD frames) and the status of their replies, see MCUSilk/link.h
+# and MCUSilk/query.h
+CONSTANTS = {
+    "WIRE_CMD_BAUD": 1,         # u32 baud: switch the serial link, LINK reply ACK (old rate) or REFUSED
+    "WIRE_CMD_LINK_TEST": 2,    # LINK_TEST_LEN pattern bytes at the new rate, LINK reply CONFIRMED with the echo
+    "WIRE_CMD_SNAPSHOT": 3,     # [u16 window ms]: tasks and memory measured now, then REPLY
+    "WIRE_CMD_TASK": 4,         # task name: task_info of that task, then REPLY
+    "WIRE_CMD_STACKS": 5,       # task_info of every task, then REPLY
+    "WIRE_CMD_HEAP": 6,         # heap map, then REPLY
+    "WIRE_CMD_DUMP": 7,         # log_info, every record of the flash log as it was stored, then REPLY
+    "LINK_ACK": 0,
+    "LINK_CONFIRMED": 1,
+    "LINK_REFUSED": 2,
+    "LINK_REVERTED": 3,         # no test pattern in time, back at the old rate
+    "LINK_TEST_LEN": 256,       # byte i = (i * 0x3B + 0x55) & 0xFF, every value once
+    "QUERY_OK": 0,
+    "QUERY_UNKNOWN": 1,         # command not known to this firmware
+    "QUERY_NOT_FOUND": 2,       # no task of that name, no flash log
+    "QUERY_NO_MEM": 3,
+    "QUERY_BAD_ARGS": 4,
+    "QUERY_FAILED": 5,          # the measurement itself failed
+}
+
+
+# "wrap" nests the JSON object under that key. "key" identifies the message on the host.
+MESSAGES = [
+    {
+        "name": "device", "type": 1, "key": "device", "wrap": "device",
+        "parts": [
+            ("field", "cores", "u8"),
+            ("field", "cpu_hz", "u32"),
+            ("field", "tag", "name"),
+        ],
+    },
+    {
+        "name": "tasks", "type": 2, "key": "tasks",
+        "parts": [
+            ("count", "core_count", "u8"),
+            ("count", "task_count", "u8"),
+            ("array", "cores", "u8", "core_count"),
+            ("array", "isr_load", "u8", "core_count"),
+            ("list", "tasks", "task", "task_count"),
+        ],
+    },
+    {
+        "name": "memory", "type": 3, "key": "heap_total",
+        "parts": [
+            ("field", "heap_total", "u32"),
+            ("field", "heap_free", "u32"),
+            ("field", "internal_total", "u32"),
+            ("field", "internal_free", "u32"),
+        ],
+    },
+    {
+        "name": "isr", "type": 4, "key": "isr",
+        "parts": [
+            ("field", "uptime_us", "u64"),
+            ("field", "cpu_hz", "u32"),
+            ("field", "hist_shift", "u8"),
+            ("field", "freq_changes", "u16"),
+            ("field", "bad_tag", "u16"),
+            ("count", "count", "u8"),
+            ("list", "isr", "isr_entry", "count"),
+            ("const", "hist_unit", "ns"),
+        ],
+    },
+    {
+        "name": "wakeup", "type": 5, "key": "wakeup",
+        "parts": [
+            ("count", "count", "u8"),
+            ("list", "wakeup", "wakeup_entry", "count"),
+        ],
+    },
+    {
+        # One sampling period: the tasks and memory messages plus when and how long
+        "name": "report", "type": 10, "key": "report", "wrap": "report",
+        "parts": [
+            ("field", "seq", "u32"),
+            ("field", "uptime_us", "u64"),
+            ("field", "window_us", "u32"),
+            ("field", "period_ms", "u32"),      # time between reports, widened when the link saturates
+            ("field", "coalesced", "u8"),       # base periods in this report's window
+            ("count", "core_count", "u8"),
+            ("count", "task_count", "u8"),
+            ("array", "cores", "u8", "core_count"),
+            ("array", "isr_load", "u8", "core_count"),
+            ("list", "tasks", "task", "task_count"),
+            ("field", "heap_total", "u32"),
+            ("field", "heap_free", "u32"),
+            ("field", "internal_total", "u32"),
+            ("field", "internal_free", "u32"),
+        ],
+    },
+    {
+        # Reply to a CMD frame about the serial link, always sent as a frame
+        "name": "link", "type": 12, "key": "link", "wrap": "link",
+        "parts": [
+            ("field", "baud", "u32"),
+            ("field", "status", "u8"),
+            ("count", "pattern_len", "u16"),
+            ("array", "pattern", "u8", "pattern_len"),
+        ],
+    },
+    {
+        # Bytes per second each kind of message takes on the serial link, against its capacity
+        "name": "budget", "type": 13, "key": "budget", "wrap": "budget",
+        "parts": [
+            ("field", "baud", "u32"),
+            ("field", "capacity", "u32"),       # bytes per second, baud / 10 (8N1), 0 = not a UART
+            ("field", "used", "u32"),
+            ("count", "count", "u8"),
+            ("list", "metrics", "budget_entry", "count"),
+        ],
+    },
+    {
+        # Last frame of every query (WIRE_CMD_SNAPSHOT and up), after its data
+        "name": "reply", "type": 14, "key": "reply", "wrap": "reply",
+        "parts": [
+            ("field", "request", "u8"),         # request id of the CMD frame
+            ("field", "cmd", "u8"),
+            ("field", "status", "u8"),          # QUERY_*
+        ],
+    },
+    {
+        "name": "task_info", "type": 15, "key": "task_info", "wrap": "task_info",
+        "parts": [
+            ("field", "request", "u8"),
+            ("count", "count", "u8"),
+            ("list", "tasks", "task_detail", "count"),
+        ],
+    },
+    {
+        "name": "heap", "type": 16, "key": "heap", "wrap": "heap",
+        "parts": [
+            ("field", "request", "u8"),
+            ("count", "count", "u8"),
+            ("list", "regions", "heap_region", "count"),
+        ],
+    },
+    {
+        # Start of a flash log dump, the records follow as the frames they were stored as
+        "name": "log_info", "type": 17, "key": "log_info", "wrap": "log_info",
+        "parts": [
+            ("field", "request", "u8"),
+            ("field", "records", "u32"),
+            ("field", "bytes", "u32"),          # records as sent, frame delimiters included
+            ("field", "capacity", "u32"),       # bytes the log keeps at least
+            ("field", "sectors", "u16"),
+            ("field", "sector_size", "u32"),
+        ],
+    },
+]
+
+# Frames that carry a message in another encoding
+RAW_MESSAGES = {
+    "json": (6, "UTF-8 JSON text without terminator (messages with no binary layout)"),
+    "cbor": (7, "one CBOR map, same keys and nesting as the JSON message"),
+    "delta": (8, "u8 type, u16 CRC-16 of the previous integers of that type (u32 LE, u64 as\n"
+                 "low and high half), zig-zag varint of the change of every integer field, see delta.h"),
+    "lz": (9, "u8 type of the frame it replaces (JSON or CBOR), u16 length uncompressed,\n"
+              "LZSS bit stream of that payload, see lz.h"),
+    "cmd": (11, "host to device: u8 WIRE_CMD_*, u8 request id, arguments, see link.h"),
+}
+
+# JSON-only messages, listed so the host can tell every message apart by its key
+JSON_ONLY = ["trigger", "error"]